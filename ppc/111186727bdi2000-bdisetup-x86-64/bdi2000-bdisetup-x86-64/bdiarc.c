@@ -0,0 +1,582 @@
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdiarc.c
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX / UNIX
+|  TARGET HW   : PC
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  This module reads firmware/logic files directly out of release
+|  archives (zip or uncompressed tar), so the archive has not to be
+|  unpacked. A file within an archive is named archive.zip#path/name.
+|
+|  The archive is mapped into memory and indexed once, by the central
+|  directory of a zip or by the headers of a tar archive. A file is read
+|  through a stream that decompresses the data as the parser reads it.
+|  The CRC-32 of a zip member is checked when the end is reached.
+|
+|  Zip64, encrypted members and compressed tar archives are not
+|  supported.
+|
+|*************************************************************************/
+
+/*************************************************************************
+|  INCLUDES
+|*************************************************************************/
+
+#if defined(__GLIBC__) || defined(__linux__)
+#define _GNU_SOURCE     /* fopencookie */
+#endif
+
+#if defined(WIN32)
+#include <windows.h>
+#define MAXPATHLEN  _MAX_PATH
+#else
+#include <sys/param.h>
+#endif /* defined(WIN32) */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <stdio.h>
+#include <zlib.h>
+
+#include "bdierror.h"
+#include "bdidll.h"
+#include "bdiimg.h"
+#include "bdifuse.h"
+#include "bdicnf.h"
+#include "bdicache.h"
+#include "bdiarc.h"
+
+#if defined(__GLIBC__)
+#define ARC_HAS_COOKIE  1
+#endif
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define ARC_ZIP_LOCAL       0x04034b50UL    /* local file header       */
+#define ARC_ZIP_CENTRAL     0x02014b50UL    /* central directory entry */
+#define ARC_ZIP_END         0x06054b50UL    /* end of central directory */
+#define ARC_ZIP_END_SIZE    22
+#define ARC_ZIP_MAX_COMMENT 0xFFFF
+
+#define ARC_TAR_BLOCK       512
+
+#define ARC_MEMBER_GROW     64      /* number of members to add at once */
+
+/*************************************************************************
+|  TYPEDEFS
+|*************************************************************************/
+
+/* state of an open file within an archive */
+typedef struct {
+  const BYTE*         data;       /* the (compressed) data */
+  const ARC_MemberT*  member;
+  DWORD               pos;        /* number of bytes delivered */
+  DWORD               crc;
+  BOOL                inflating;
+  BOOL                failed;
+  z_stream            zs;
+} ARC_StreamT;
+
+/*************************************************************************
+|  LOCALS
+|*************************************************************************/
+
+static ARC_ArchiveT arcCurrent;    /* the last opened archive stays mapped */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    ARC_GetWord / ARC_GetLong :
+
+    Load a little endian number.
+
+ ****************************************************************************/
+
+static DWORD ARC_GetWord(const BYTE* buffer)
+{
+  return (DWORD)buffer[0] | ((DWORD)buffer[1] << 8);
+} /* ARC_GetWord */
+
+
+static DWORD ARC_GetLong(const BYTE* buffer)
+{
+  return   (DWORD)buffer[0]         | ((DWORD)buffer[1] <<  8)
+         | ((DWORD)buffer[2] << 16) | ((DWORD)buffer[3] << 24);
+} /* ARC_GetLong */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    ARC_AddMember :
+
+    Adds a member to the archive index. The data must lie within the
+    archive, stored data is read with its packed size.
+
+ ****************************************************************************/
+
+static int ARC_AddMember(ARC_ArchiveT* archive,
+                         const char*   szName,
+                         size_t        nameLen,
+                         DWORD         offset,
+                         DWORD         packedSize,
+                         DWORD         size,
+                         DWORD         crc,
+                         WORD          method)
+{
+  ARC_MemberT*  newMember;
+  ARC_MemberT*  member;
+
+  if ((offset > archive->size) || (packedSize > (archive->size - offset))) {
+    return BDI_ERR_FIRMWARE_FILE;
+  } /* if */
+  if ((method == 0) && (size != packedSize)) return BDI_ERR_FIRMWARE_FILE;
+  if (archive->count == archive->alloc) {
+    newMember = (ARC_MemberT*)realloc(archive->member,
+                  (archive->alloc + ARC_MEMBER_GROW) * sizeof(ARC_MemberT));
+    if (newMember == NULL) return BDI_ERR_FILE_ACCESS;
+    archive->member = newMember;
+    archive->alloc += ARC_MEMBER_GROW;
+  } /* if */
+  member = &archive->member[archive->count];
+  member->szName = (char*)malloc(nameLen + 1);
+  if (member->szName == NULL) return BDI_ERR_FILE_ACCESS;
+  (void)memcpy(member->szName, szName, nameLen);
+  member->szName[nameLen] = 0;
+  member->offset     = offset;
+  member->packedSize = packedSize;
+  member->size       = size;
+  member->crc        = crc;
+  member->method     = method;
+  archive->count++;
+  return BDI_OKAY;
+} /* ARC_AddMember */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    ARC_IndexZip :
+
+    Indexes a zip archive by its central directory.
+
+ ****************************************************************************/
+
+static int ARC_IndexZip(ARC_ArchiveT* archive)
+{
+  const BYTE*   data;
+  const BYTE*   entry;
+  const BYTE*   local;
+  DWORD         pos;
+  DWORD         stop;
+  DWORD         entries;
+  DWORD         cdOffset;
+  DWORD         nameLen;
+  DWORD         offset;
+  int           result;
+
+  /* find the end of central directory record */
+  data = archive->data;
+  if (archive->size < ARC_ZIP_END_SIZE) return BDI_ERR_FIRMWARE_FILE;
+  pos  = archive->size - ARC_ZIP_END_SIZE;
+  stop = (pos > ARC_ZIP_MAX_COMMENT) ? (pos - ARC_ZIP_MAX_COMMENT) : 0;
+  while ((ARC_GetLong(data + pos) != ARC_ZIP_END) && (pos > stop)) pos--;
+  if (ARC_GetLong(data + pos) != ARC_ZIP_END) return BDI_ERR_FIRMWARE_FILE;
+  entries  = ARC_GetWord(data + pos + 10);
+  cdOffset = ARC_GetLong(data + pos + 16);
+
+  /* walk the central directory */
+  result = BDI_OKAY;
+  pos    = cdOffset;
+  while ((entries-- > 0) && (result == BDI_OKAY)) {
+    if (   (archive->size < 46)
+        || (pos > (archive->size - 46))
+        || (ARC_GetLong(data + pos) != ARC_ZIP_CENTRAL)) return BDI_ERR_FIRMWARE_FILE;
+    entry   = data + pos;
+    nameLen = ARC_GetWord(entry + 28);
+    if ((pos + 46 + nameLen) > archive->size) return BDI_ERR_FIRMWARE_FILE;
+
+    /* the data follows the local header, skip directories and encrypted files */
+    offset = ARC_GetLong(entry + 42);
+    if (   (nameLen > 0) && (entry[46 + nameLen - 1] != '/')
+        && ((ARC_GetWord(entry + 8) & 0x0001) == 0)) {
+      if ((archive->size < 30) || (offset > (archive->size - 30))) return BDI_ERR_FIRMWARE_FILE;
+      local = data + offset;
+      if (ARC_GetLong(local) != ARC_ZIP_LOCAL) return BDI_ERR_FIRMWARE_FILE;
+      result = ARC_AddMember(archive, (const char*)entry + 46, nameLen,
+                             offset + 30 + ARC_GetWord(local + 26) + ARC_GetWord(local + 28),
+                             ARC_GetLong(entry + 20),
+                             ARC_GetLong(entry + 24),
+                             ARC_GetLong(entry + 16),
+                             (WORD)ARC_GetWord(entry + 10));
+    } /* if */
+    pos += 46 + nameLen + ARC_GetWord(entry + 30) + ARC_GetWord(entry + 32);
+  } /* while */
+  return result;
+} /* ARC_IndexZip */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    ARC_IndexTar :
+
+    Indexes an uncompressed tar archive by walking its headers.
+
+ ****************************************************************************/
+
+static DWORD ARC_Octal(const BYTE* field, int length)
+{
+  DWORD value;
+
+  value = 0;
+  while ((length > 0) && (*field == ' ')) {
+    field++;
+    length--;
+  } /* while */
+  while ((length > 0) && (*field >= '0') && (*field <= '7')) {
+    value = (value << 3) + (*field++ - '0');
+    length--;
+  } /* while */
+  return value;
+} /* ARC_Octal */
+
+
+static int ARC_IndexTar(ARC_ArchiveT* archive)
+{
+  const BYTE*   header;
+  DWORD         pos;
+  DWORD         size;
+  char          szName[256 + 1];
+  size_t        prefixLen;
+  int           result;
+
+  result = BDI_OKAY;
+  pos    = 0;
+  while (((pos + ARC_TAR_BLOCK) <= archive->size) && (result == BDI_OKAY)) {
+    header = archive->data + pos;
+    if (header[0] == 0) break;      /* end of archive */
+    size = ARC_Octal(header + 124, 12);
+
+    /* regular files only, the ustar prefix extends the name */
+    if ((header[156] == '0') || (header[156] == 0)) {
+      szName[0] = 0;
+      if (memcmp(header + 257, "ustar", 5) == 0) {
+        (void)strncat(szName, (const char*)header + 345, 155);
+        prefixLen = strlen(szName);
+        if (prefixLen > 0) szName[prefixLen++] = '/';
+        szName[prefixLen] = 0;
+      } /* if */
+      (void)strncat(szName, (const char*)header, 100);
+      result = ARC_AddMember(archive, szName, strlen(szName),
+                             pos + ARC_TAR_BLOCK, size, size, 0, 0);
+    } /* if */
+    pos += ARC_TAR_BLOCK + ((size + ARC_TAR_BLOCK - 1) / ARC_TAR_BLOCK) * ARC_TAR_BLOCK;
+  } /* while */
+  return result;
+} /* ARC_IndexTar */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    ARC_IsArchive :
+
+    Checks if a file name selects an archive (by the extension).
+
+     INPUT  : szFileName    the file name
+     OUTPUT : RETURN        TRUE if a zip or tar file
+
+ ****************************************************************************/
+
+BOOL ARC_IsArchive(const char* szFileName)
+{
+  struct stat   st;
+  const char*   szExt;
+  char          szLower[5];
+  int           i;
+
+  if (strlen(szFileName) < 4) return FALSE;
+  szExt = szFileName + strlen(szFileName) - 4;
+  for (i = 0; i < 4; i++) szLower[i] = (char)tolower((unsigned char)szExt[i]);
+  szLower[4] = 0;
+  if ((strcmp(szLower, ".zip") != 0) && (strcmp(szLower, ".tar") != 0)) return FALSE;
+  return ((stat(szFileName, &st) == 0) && ((st.st_mode & S_IFMT) == S_IFREG));
+} /* ARC_IsArchive */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    ARC_Open :
+
+    Maps and indexes an archive. The last opened archive stays mapped,
+    opening it again does not read it again.
+
+     INPUT  : szArchive     the archive file name
+     OUTPUT : archive       the indexed archive
+              RETURN        error code
+
+ ****************************************************************************/
+
+static void ARC_Close(ARC_ArchiveT* archive)
+{
+  int   i;
+
+  for (i = 0; i < archive->count; i++) free(archive->member[i].szName);
+  free(archive->member);
+  free(archive->szName);
+  CCH_UnmapFile(archive->data, archive->size);
+  (void)memset(archive, 0, sizeof(ARC_ArchiveT));
+} /* ARC_Close */
+
+
+int ARC_Open(const char* szArchive, const ARC_ArchiveT** archive)
+{
+  struct stat   st;
+  int           result;
+
+  if (stat(szArchive, &st) != 0) return BDI_ERR_FIRMWARE_FILE;
+  if (   (arcCurrent.szName != NULL) && (strcmp(arcCurrent.szName, szArchive) == 0)
+      && (arcCurrent.size == (DWORD)st.st_size) && (arcCurrent.mtime == (DWORD)st.st_mtime)) {
+    *archive = &arcCurrent;
+    return BDI_OKAY;
+  } /* if */
+
+  ARC_Close(&arcCurrent);
+  arcCurrent.szName = (char*)malloc(strlen(szArchive) + 1);
+  if (arcCurrent.szName == NULL) return BDI_ERR_FILE_ACCESS;
+  strcpy(arcCurrent.szName, szArchive);
+  arcCurrent.mtime = (DWORD)st.st_mtime;
+  arcCurrent.data  = CCH_MapFile(szArchive, &arcCurrent.size);
+  if (arcCurrent.data == NULL) {
+    ARC_Close(&arcCurrent);
+    return BDI_ERR_FIRMWARE_FILE;
+  } /* if */
+
+  if (   (arcCurrent.size >= 4)
+      && (ARC_GetLong(arcCurrent.data) == ARC_ZIP_LOCAL)) result = ARC_IndexZip(&arcCurrent);
+  else                                                     result = ARC_IndexTar(&arcCurrent);
+  if (result != BDI_OKAY) {
+    ARC_Close(&arcCurrent);
+    return result;
+  } /* if */
+  *archive = &arcCurrent;
+  return BDI_OKAY;
+} /* ARC_Open */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    ARC_MemberName :
+
+    Splits the name of a file within an archive.
+
+     INPUT  : szFileName    the file name (archive.zip#path/name)
+     OUTPUT : szArchive     the archive file name (MAXPATHLEN)
+              RETURN        the path within the archive, NULL if the file
+                            is not within an archive
+
+ ****************************************************************************/
+
+const char* ARC_MemberName(const char* szFileName, char* szArchive)
+{
+  const char*   szMember;
+  size_t        length;
+
+  for (szMember = strchr(szFileName, ARC_SEPARATOR);
+       szMember != NULL;
+       szMember = strchr(szMember + 1, ARC_SEPARATOR)) {
+    length = (size_t)(szMember - szFileName);
+    if (length >= MAXPATHLEN) break;
+    (void)memcpy(szArchive, szFileName, length);
+    szArchive[length] = 0;
+    if (ARC_IsArchive(szArchive)) return szMember + 1;
+  } /* for */
+  return NULL;
+} /* ARC_MemberName */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    ARC_StreamRead / ARC_StreamClose :
+
+    Delivers the data of an archive member, deflated data is inflated as
+    it is read. A CRC mismatch is reported as read error at the end.
+    Inflated data must have the size of the member, at most one byte
+    more is inflated to detect a member that is too long.
+
+ ****************************************************************************/
+
+static long ARC_StreamRead(ARC_StreamT* stream, char* buffer, size_t size)
+{
+  const ARC_MemberT*  member = stream->member;
+  size_t              count;
+  size_t              avail;
+  int                 zResult;
+
+  if (stream->failed) return -1;
+  if (member->method == 0) {
+    count = member->size - stream->pos;
+    if (count > size) count = size;
+    (void)memcpy(buffer, stream->data + stream->pos, count);
+  } /* if */
+  else {
+    avail = (size_t)(member->size - stream->pos) + 1;
+    if (avail > size) avail = size;
+    stream->zs.next_out  = (Bytef*)buffer;
+    stream->zs.avail_out = (uInt)avail;
+    zResult = inflate(&stream->zs, Z_NO_FLUSH);
+    if ((zResult != Z_OK) && (zResult != Z_STREAM_END) && (zResult != Z_BUF_ERROR)) {
+      stream->failed = TRUE;
+      return -1;
+    } /* if */
+    count = avail - stream->zs.avail_out;
+    if (   ((count == 0) && (zResult != Z_STREAM_END) && (stream->pos < member->size))
+        || ((zResult == Z_STREAM_END) && ((stream->pos + count) < member->size))) {
+      stream->failed = TRUE;    /* truncated data */
+      return -1;
+    } /* if */
+    if ((stream->pos + count) > member->size) {
+      stream->failed = TRUE;    /* more data than the member size */
+      return -1;
+    } /* if */
+  } /* else */
+
+  stream->crc  = crc32(stream->crc, (const Bytef*)buffer, (uInt)count);
+  stream->pos += (DWORD)count;
+
+  /* check the zip CRC when the last data is delivered */
+  if (   (count > 0) && (stream->pos == member->size) && (member->crc != 0)
+      && (stream->crc != member->crc)) {
+    stream->failed = TRUE;
+    return -1;
+  } /* if */
+  return (long)count;
+} /* ARC_StreamRead */
+
+
+static void ARC_StreamClose(ARC_StreamT* stream)
+{
+  if (stream->inflating) (void)inflateEnd(&stream->zs);
+  free(stream);
+} /* ARC_StreamClose */
+
+
+#if defined(ARC_HAS_COOKIE)
+
+static ssize_t ARC_CookieRead(void* cookie, char* buffer, size_t size)
+{
+  return (ssize_t)ARC_StreamRead((ARC_StreamT*)cookie, buffer, size);
+} /* ARC_CookieRead */
+
+
+static int ARC_CookieClose(void* cookie)
+{
+  ARC_StreamClose((ARC_StreamT*)cookie);
+  return 0;
+} /* ARC_CookieClose */
+
+#endif /* defined(ARC_HAS_COOKIE) */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    ARC_OpenFile :
+
+    Opens a file for reading, the file may be within an archive.
+    Where custom streams are not available, the file is decompressed into
+    a temporary file.
+
+     INPUT  : szFileName    the file name (archive.zip#path/name or a path)
+              szMode        the fopen mode for files outside an archive
+     OUTPUT : RETURN        the open file or NULL if error
+
+ ****************************************************************************/
+
+FILE* ARC_OpenFile(const char* szFileName, const char* szMode)
+{
+  char                szArchive[MAXPATHLEN];
+  const char*         szMember;
+  const ARC_ArchiveT* archive;
+  const ARC_MemberT*  member;
+  ARC_StreamT*        stream;
+  FILE*               file;
+  int                 i;
+#if defined(ARC_HAS_COOKIE)
+  cookie_io_functions_t io;
+#else
+  char                buffer[4096];
+  long                count;
+#endif
+
+  szMember = ARC_MemberName(szFileName, szArchive);
+  if (szMember == NULL) return fopen(szFileName, szMode);
+
+  /* find the member */
+  if (ARC_Open(szArchive, &archive) != BDI_OKAY) return NULL;
+  member = NULL;
+  for (i = 0; i < archive->count; i++) {
+    if (strcmp(archive->member[i].szName, szMember) == 0) {
+      member = &archive->member[i];
+      break;
+    } /* if */
+  } /* for */
+  if ((member == NULL) || ((member->method != 0) && (member->method != 8))) return NULL;
+
+  /* prepare the stream */
+  stream = (ARC_StreamT*)calloc(1, sizeof(ARC_StreamT));
+  if (stream == NULL) return NULL;
+  stream->data   = archive->data + member->offset;
+  stream->member = member;
+  stream->crc    = crc32(0L, Z_NULL, 0);
+  if (member->method == 8) {
+    stream->zs.next_in  = (Bytef*)stream->data;
+    stream->zs.avail_in = (uInt)member->packedSize;
+    if (inflateInit2(&stream->zs, -MAX_WBITS) != Z_OK) {
+      free(stream);
+      return NULL;
+    } /* if */
+    stream->inflating = TRUE;
+  } /* if */
+
+#if defined(ARC_HAS_COOKIE)
+  io.read  = ARC_CookieRead;
+  io.write = NULL;
+  io.seek  = NULL;
+  io.close = ARC_CookieClose;
+  file = fopencookie(stream, "r", io);
+  if (file == NULL) ARC_StreamClose(stream);
+#else
+  file = tmpfile();
+  while ((file != NULL) && ((count = ARC_StreamRead(stream, buffer, sizeof buffer)) > 0)) {
+    if (fwrite(buffer, 1, (size_t)count, file) != (size_t)count) count = -1;
+    if (count < 0) break;
+  } /* while */
+  if ((file != NULL) && (stream->failed || (count < 0))) {
+    fclose(file);
+    file = NULL;
+  } /* if */
+  ARC_StreamClose(stream);
+  if (file != NULL) rewind(file);
+#endif
+  return file;
+} /* ARC_OpenFile */
@@ -0,0 +1,74 @@
+#ifndef __BDIARC_H__
+#define __BDIARC_H__
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdiarc.h
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX
+|  TARGET HW   : PC
+|
+|  PROGRAMMER  : Abatron / RD
+|  CREATION    : 19.10.26
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  Read firmware/logic files out of zip or tar release archives
+|
+|
+|*************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define ARC_SEPARATOR   '#'     /* archive.zip#path/B20PPCGD.105 */
+
+/*************************************************************************
+|  TYPEDEFS
+|*************************************************************************/
+
+/* a file within an archive */
+typedef struct {
+  char*   szName;         /* path within the archive */
+  DWORD   offset;         /* offset of the (compressed) data */
+  DWORD   packedSize;     /* size of the (compressed) data */
+  DWORD   size;           /* size of the file */
+  DWORD   crc;            /* CRC-32 of the file, zip only */
+  WORD    method;         /* 0 = stored, 8 = deflated */
+} ARC_MemberT;
+
+/* an indexed archive, the archive file is mapped into memory */
+typedef struct {
+  char*         szName;
+  BYTE*         data;
+  DWORD         size;
+  DWORD         mtime;
+  int           count;
+  int           alloc;
+  ARC_MemberT*  member;
+} ARC_ArchiveT;
+
+/*************************************************************************
+|  FUNCTIONS
+|*************************************************************************/
+
+BOOL  ARC_IsArchive(const char* szFileName);
+int   ARC_Open(const char* szArchive, const ARC_ArchiveT** archive);
+const char* ARC_MemberName(const char* szFileName, char* szArchive);
+FILE* ARC_OpenFile(const char* szFileName, const char* szMode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
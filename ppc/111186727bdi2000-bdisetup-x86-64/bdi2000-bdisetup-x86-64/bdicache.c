@@ -0,0 +1,825 @@
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdicache.c
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX / UNIX
+|  TARGET HW   : PC
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  This module caches parsed firmware images, JEDEC fuse maps and built
+|  configurations in a directory, so provisioning many BDIs from the same
+|  release or configuration parses every file only once.
+|
+|  An entry is named after a hash of the full source path and holds:
+|  - the source path, size, modification time and content hash
+|  - the payload (sparse image, packed fuse rows or configuration) and
+|    its CRC
+|  An entry is used if size and time match, or if only the time changed
+|  and the content hash still matches. A configuration entry also lists
+|  the register definition files it was built from, checked the same
+|  way. Their names are resolved again, a relative name may refer to
+|  another file in another working directory. Entries are written to a
+|  temporary file and renamed, so concurrent users never see a partial
+|  entry.
+|  All numbers are stored big endian, the cache may be shared by hosts.
+|
+|*************************************************************************/
+
+/*************************************************************************
+|  INCLUDES
+|*************************************************************************/
+
+#if defined(WIN32)
+#include <windows.h>
+#include <process.h>
+#define MAXPATHLEN  _MAX_PATH
+#define getpid      _getpid
+#else
+#include <sys/param.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif /* defined(WIN32) */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "bdierror.h"
+#include "bdidll.h"
+#include "bdiimg.h"
+#include "bdicrc.h"
+#include "bdiarc.h"
+#include "bdifuse.h"
+#include "bdicnf.h"
+#include "bdicache.h"
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define CCH_MAGIC           0x42444943UL    /* "BDIC" */
+#define CCH_FORMAT          2
+
+#define CCH_KIND_IMAGE      1
+#define CCH_KIND_FUSE       2
+#define CCH_KIND_CONFIG     3
+
+#define CCH_HEADER_SIZE     40              /* header without the path */
+
+#define CCH_HASH_PRIME      0x100000001b3ULL
+
+/*************************************************************************
+|  LOCALS
+|*************************************************************************/
+
+static char cchDir[MAXPATHLEN] = "";     /* empty if cache is disabled */
+
+static const char* CCH_KindExt[] = { "", ".img", ".fus", ".cnf" };
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CCH_PutLong / CCH_GetLong :
+
+    Store / load a 32 bit number in big endian byte order.
+
+ ****************************************************************************/
+
+static BYTE* CCH_PutLong(DWORD value, BYTE* buffer)
+{
+  *buffer++ = (BYTE)(value >> 24);
+  *buffer++ = (BYTE)(value >> 16);
+  *buffer++ = (BYTE)(value >>  8);
+  *buffer++ = (BYTE)(value);
+  return buffer;
+} /* CCH_PutLong */
+
+
+static DWORD CCH_GetLong(const BYTE* buffer)
+{
+  return   ((DWORD)buffer[0] << 24) | ((DWORD)buffer[1] << 16)
+         | ((DWORD)buffer[2] <<  8) |  (DWORD)buffer[3];
+} /* CCH_GetLong */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CCH_MapFile / CCH_UnmapFile :
+
+    Maps a whole file read only into memory. Where mmap is not available
+    the file is read into an allocated buffer.
+
+     INPUT  : szFileName    the file name
+     OUTPUT : size          the file size
+              RETURN        the file data or NULL if error
+
+ ****************************************************************************/
+
+#if defined(WIN32)
+
+BYTE* CCH_MapFile(const char* szFileName, DWORD* size)
+{
+  FILE*   file;
+  long    length;
+  BYTE*   data;
+
+  file = fopen(szFileName, "rb");
+  if (file == NULL) return NULL;
+  data = NULL;
+  if ((fseek(file, 0, SEEK_END) == 0) && ((length = ftell(file)) >= 0)) {
+    rewind(file);
+    data = (BYTE*)malloc(length + 1);
+    if ((data != NULL) && (fread(data, 1, length, file) != (size_t)length)) {
+      free(data);
+      data = NULL;
+    } /* if */
+    *size = (DWORD)length;
+  } /* if */
+  fclose(file);
+  return data;
+} /* CCH_MapFile */
+
+
+void CCH_UnmapFile(BYTE* data, DWORD size)
+{
+  (void)size;
+  free(data);
+} /* CCH_UnmapFile */
+
+#else
+
+static BYTE cchEmpty[1];   /* mmap does not accept empty files */
+
+BYTE* CCH_MapFile(const char* szFileName, DWORD* size)
+{
+  int           fd;
+  struct stat   st;
+  void*         data;
+
+  fd = open(szFileName, O_RDONLY);
+  if (fd < 0) return NULL;
+  if ((fstat(fd, &st) != 0) || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return NULL;
+  } /* if */
+  *size = (DWORD)st.st_size;
+  if (st.st_size == 0) data = cchEmpty;
+  else                 data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return NULL;
+  return (BYTE*)data;
+} /* CCH_MapFile */
+
+
+void CCH_UnmapFile(BYTE* data, DWORD size)
+{
+  if ((data != NULL) && (data != cchEmpty)) (void)munmap(data, size);
+} /* CCH_UnmapFile */
+
+#endif /* defined(WIN32) */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CCH_Hash :
+
+    64 bit FNV-1a hash, start with CCH_HASH_INIT.
+
+ ****************************************************************************/
+
+unsigned long long CCH_Hash(unsigned long long hash, const BYTE* data, DWORD count)
+{
+  while (count--) {
+    hash ^= *data++;
+    hash *= CCH_HASH_PRIME;
+  } /* while */
+  return hash;
+} /* CCH_Hash */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CCH_SetDirectory :
+
+    Sets / gets the cache directory, the directory is created if necessary.
+
+     INPUT  : szDir     the directory, NULL or empty disables the cache
+     OUTPUT : RETURN    the directory, NULL if the cache is disabled
+
+ ****************************************************************************/
+
+void CCH_SetDirectory(const char* szDir)
+{
+  cchDir[0] = 0;
+  if ((szDir == NULL) || (*szDir == 0)) return;
+  if (strlen(szDir) >= (sizeof cchDir - 32)) return;
+#if defined(WIN32)
+  (void)CreateDirectory(szDir, NULL);
+#else
+  (void)mkdir(szDir, 0777);
+#endif
+  strcpy(cchDir, szDir);
+} /* CCH_SetDirectory */
+
+
+const char* CCH_GetDirectory(void)
+{
+  return (cchDir[0] != 0) ? cchDir : NULL;
+} /* CCH_GetDirectory */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CCH_FullPath :
+
+    Gets the full path of a file, a relative name is resolved against
+    the working directory.
+
+ ****************************************************************************/
+
+static BOOL CCH_FullPath(const char* szFileName, char* szFullName)
+{
+#if defined(WIN32)
+  return _fullpath(szFullName, szFileName, MAXPATHLEN) != NULL;
+#else
+  return realpath(szFileName, szFullName) != NULL;
+#endif
+} /* CCH_FullPath */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CCH_SourceInfo :
+
+    Gets the full path, size and modification time of a source file and
+    the name of its cache entry. A file within an archive is identified by
+    the full path of the archive and the path within the archive.
+
+ ****************************************************************************/
+
+static BOOL CCH_SourceInfo(const char* szFileName,
+                           const char* szExt,
+                           char*       szFullName,
+                           char*       szEntryName,
+                           DWORD*      size,
+                           DWORD*      mtime)
+{
+  struct stat         st;
+  char                szArchive[MAXPATHLEN];
+  const char*         szMember;
+  const ARC_ArchiveT* archive;
+  size_t              length;
+  int                 i;
+
+  if (cchDir[0] == 0) return FALSE;
+  szMember = ARC_MemberName(szFileName, szArchive);
+  if (szMember != NULL) szFileName = szArchive;
+  if (stat(szFileName, &st) != 0) return FALSE;
+  if (!CCH_FullPath(szFileName, szFullName)) return FALSE;
+  *size  = (DWORD)st.st_size;
+  *mtime = (DWORD)st.st_mtime;
+  if (szMember != NULL) {
+    length = strlen(szFullName);
+    if ((length + 1 + strlen(szMember)) >= MAXPATHLEN) return FALSE;
+    sprintf(szFullName + length, "%c%s", ARC_SEPARATOR, szMember);
+    if (ARC_Open(szArchive, &archive) != BDI_OKAY) return FALSE;
+    for (i = 0; (i < archive->count) && (strcmp(archive->member[i].szName, szMember) != 0); i++);
+    if (i == archive->count) return FALSE;
+    *size = archive->member[i].size;
+  } /* if */
+  sprintf(szEntryName, "%s/%016llx%s", cchDir,
+          CCH_Hash(CCH_HASH_INIT, (const BYTE*)szFullName, strlen(szFullName)), szExt);
+  return TRUE;
+} /* CCH_SourceInfo */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CCH_HashFile :
+
+    Calculates the content hash of a file, the file may be within an
+    archive.
+
+     INPUT  : szFileName    the file name
+     OUTPUT : hash          the FNV-1a hash of the file content
+              RETURN        TRUE if the file could be read
+
+ ****************************************************************************/
+
+BOOL CCH_HashFile(const char* szFileName, unsigned long long* hash)
+{
+  char    szArchive[MAXPATHLEN];
+  BYTE    buffer[4096];
+  FILE*   file;
+  size_t  count;
+  BYTE*   data;
+  DWORD   size;
+
+  /* a file within an archive is hashed as it is decompressed */
+  if (ARC_MemberName(szFileName, szArchive) != NULL) {
+    file = ARC_OpenFile(szFileName, "rb");
+    if (file == NULL) return FALSE;
+    *hash = CCH_HASH_INIT;
+    while ((count = fread(buffer, 1, sizeof buffer, file)) > 0) {
+      *hash = CCH_Hash(*hash, buffer, (DWORD)count);
+    } /* while */
+    if (ferror(file)) {
+      fclose(file);
+      return FALSE;
+    } /* if */
+    fclose(file);
+    return TRUE;
+  } /* if */
+
+  data = CCH_MapFile(szFileName, &size);
+  if (data == NULL) return FALSE;
+  *hash = CCH_Hash(CCH_HASH_INIT, data, size);
+  CCH_UnmapFile(data, size);
+  return TRUE;
+} /* CCH_HashFile */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CCH_Lookup :
+
+    Maps the cache entry of a source file and checks if it is valid.
+
+     INPUT  : szFileName    the source file name
+              kind          the expected entry kind
+     OUTPUT : entrySize     the size of the mapped entry
+              payload       the payload within the entry
+              payloadSize   the size of the payload
+              RETURN        the mapped entry or NULL if not valid
+
+ ****************************************************************************/
+
+static BYTE* CCH_Lookup(const char*   szFileName,
+                        DWORD         kind,
+                        DWORD*        entrySize,
+                        const BYTE**  payload,
+                        DWORD*        payloadSize)
+{
+  char          szFullName[MAXPATHLEN];
+  char          szEntryName[MAXPATHLEN];
+  DWORD         size;
+  DWORD         mtime;
+  DWORD         pathLen;
+  BYTE*         entry;
+  BOOL          valid;
+  unsigned long long hash;
+
+  if (!CCH_SourceInfo(szFileName, CCH_KindExt[kind],
+                      szFullName, szEntryName, &size, &mtime)) return NULL;
+  entry = CCH_MapFile(szEntryName, entrySize);
+  if (entry == NULL) return NULL;
+
+  /* check header and source path */
+  valid = (*entrySize >= CCH_HEADER_SIZE);
+  if (valid) {
+    pathLen = CCH_GetLong(entry + 36);
+    *payloadSize = CCH_GetLong(entry + 28);
+    valid = (   (CCH_GetLong(entry)     == CCH_MAGIC)
+             && (CCH_GetLong(entry + 4) == CCH_FORMAT)
+             && (CCH_GetLong(entry + 8) == kind)
+             && (pathLen == strlen(szFullName))
+             && (*entrySize == (CCH_HEADER_SIZE + pathLen + *payloadSize))
+             && (memcmp(entry + CCH_HEADER_SIZE, szFullName, pathLen) == 0));
+  } /* if */
+
+  /* check source, the content hash is only needed if the time changed */
+  if (valid && (CCH_GetLong(entry + 12) != size)) valid = FALSE;
+  if (valid && (CCH_GetLong(entry + 16) != mtime)) {
+    valid = (   CCH_HashFile(szFileName, &hash)
+             && (CCH_GetLong(entry + 20) == (DWORD)(hash >> 32))
+             && (CCH_GetLong(entry + 24) == (DWORD)(hash & 0xFFFFFFFFUL)));
+  } /* if */
+
+  /* check payload */
+  if (valid) {
+    *payload = entry + CCH_HEADER_SIZE + pathLen;
+    valid = (CCH_GetLong(entry + 32) == CRC_Accumulate(0, *payload, *payloadSize));
+  } /* if */
+
+  if (!valid) {
+    CCH_UnmapFile(entry, *entrySize);
+    return NULL;
+  } /* if */
+  return entry;
+} /* CCH_Lookup */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CCH_Store :
+
+    Writes the cache entry of a source file. The entry is written to a
+    temporary file first and then renamed. Errors are ignored, the
+    cache is only an optimization.
+
+     INPUT  : szFileName    the source file name
+              kind          the entry kind
+              payload       the payload
+              payloadSize   the size of the payload
+
+ ****************************************************************************/
+
+static void CCH_Store(const char* szFileName, DWORD kind, const BYTE* payload, DWORD payloadSize)
+{
+  char          szFullName[MAXPATHLEN];
+  char          szEntryName[MAXPATHLEN];
+  char          szTempName[MAXPATHLEN + 32];
+  BYTE          header[CCH_HEADER_SIZE];
+  BYTE*         headerPtr;
+  DWORD         size;
+  DWORD         mtime;
+  FILE*         file;
+  BOOL          okay;
+  unsigned long long hash;
+
+  if (!CCH_SourceInfo(szFileName, CCH_KindExt[kind],
+                      szFullName, szEntryName, &size, &mtime)) return;
+  if (!CCH_HashFile(szFileName, &hash)) return;
+
+  headerPtr = CCH_PutLong(CCH_MAGIC,   header);
+  headerPtr = CCH_PutLong(CCH_FORMAT,  headerPtr);
+  headerPtr = CCH_PutLong(kind,        headerPtr);
+  headerPtr = CCH_PutLong(size,        headerPtr);
+  headerPtr = CCH_PutLong(mtime,       headerPtr);
+  headerPtr = CCH_PutLong((DWORD)(hash >> 32), headerPtr);
+  headerPtr = CCH_PutLong((DWORD)(hash & 0xFFFFFFFFUL), headerPtr);
+  headerPtr = CCH_PutLong(payloadSize, headerPtr);
+  headerPtr = CCH_PutLong(CRC_Accumulate(0, payload, payloadSize), headerPtr);
+  headerPtr = CCH_PutLong((DWORD)strlen(szFullName), headerPtr);
+
+  sprintf(szTempName, "%s.%ld.tmp", szEntryName, (long)getpid());
+  file = fopen(szTempName, "wb");
+  if (file == NULL) return;
+  okay = (   (fwrite(header, 1, sizeof header, file) == sizeof header)
+          && (fwrite(szFullName, 1, strlen(szFullName), file) == strlen(szFullName))
+          && (fwrite(payload, 1, payloadSize, file) == payloadSize));
+  if (fclose(file) != 0) okay = FALSE;
+#if defined(WIN32)
+  if (okay) (void)remove(szEntryName);
+#endif
+  if (!okay || (rename(szTempName, szEntryName) != 0)) (void)remove(szTempName);
+} /* CCH_Store */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CCH_LoadImage / CCH_StoreImage :
+
+    Load a firmware image from the cache / store it into the cache.
+    Payload: segment count, then address, size and data of every segment.
+
+     INPUT  : szFileName    the firmware file name
+              image         the image (must be initialized for load)
+     OUTPUT : RETURN        TRUE if the image was loaded from the cache
+
+ ****************************************************************************/
+
+BOOL CCH_LoadImage(const char* szFileName, IMG_ImageT* image)
+{
+  BYTE*         entry;
+  DWORD         entrySize;
+  const BYTE*   payload;
+  DWORD         payloadSize;
+  DWORD         count;
+  DWORD         addr;
+  DWORD         size;
+  BOOL          valid;
+
+  entry = CCH_Lookup(szFileName, CCH_KIND_IMAGE, &entrySize, &payload, &payloadSize);
+  if (entry == NULL) return FALSE;
+
+  valid = (payloadSize >= 4);
+  if (valid) {
+    count        = CCH_GetLong(payload);
+    payload     += 4;
+    payloadSize -= 4;
+    while (valid && (count-- > 0)) {
+      valid = (payloadSize >= 8);
+      if (!valid) break;
+      addr  = CCH_GetLong(payload);
+      size  = CCH_GetLong(payload + 4);
+      valid = ((payloadSize - 8) >= size);
+      if (valid) valid = (IMG_AddData(image, addr, payload + 8, size) == BDI_OKAY);
+      payload     += 8 + size;
+      payloadSize -= 8 + size;
+    } /* while */
+  } /* if */
+
+  CCH_UnmapFile(entry, entrySize);
+  if (!valid) IMG_Free(image);
+  return valid;
+} /* CCH_LoadImage */
+
+
+void CCH_StoreImage(const char* szFileName, const IMG_ImageT* image)
+{
+  BYTE*   payload;
+  BYTE*   payloadPtr;
+  DWORD   payloadSize;
+  int     i;
+
+  if (cchDir[0] == 0) return;
+  payloadSize = 4 + 8 * image->count + IMG_GetSize(image);
+  payload = (BYTE*)malloc(payloadSize);
+  if (payload == NULL) return;
+
+  payloadPtr = CCH_PutLong((DWORD)image->count, payload);
+  for (i = 0; i < image->count; i++) {
+    payloadPtr = CCH_PutLong(image->segment[i].addr, payloadPtr);
+    payloadPtr = CCH_PutLong(image->segment[i].size, payloadPtr);
+    (void)memcpy(payloadPtr, image->segment[i].data, image->segment[i].size);
+    payloadPtr += image->segment[i].size;
+  } /* for */
+
+  CCH_Store(szFileName, CCH_KIND_IMAGE, payload, payloadSize);
+  free(payload);
+} /* CCH_StoreImage */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CCH_LoadFuseMap / CCH_StoreFuseMap :
+
+    Load a fuse map from the cache / store it into the cache.
+    Payload: rows, bits per row, then every row packed MSB first.
+
+     INPUT  : szFileName    the JEDEC file name
+              map           the fuse map with the geometry
+     OUTPUT : map           the fuse map
+              RETURN        TRUE if the fuse map was loaded from the cache
+
+ ****************************************************************************/
+
+BOOL CCH_LoadFuseMap(const char* szFileName, FUS_MapT* map)
+{
+  BYTE*         entry;
+  DWORD         entrySize;
+  const BYTE*   payload;
+  DWORD         payloadSize;
+  DWORD         rowBytes;
+  int           rows;
+  int           rowBits;
+  int           row;
+  int           bit;
+  BOOL          valid;
+
+  entry = CCH_Lookup(szFileName, CCH_KIND_FUSE, &entrySize, &payload, &payloadSize);
+  if (entry == NULL) return FALSE;
+
+  rows     = map->geometry->rows;
+  rowBits  = map->geometry->rowBits;
+  rowBytes = (rowBits + 7) / 8;
+  valid = (   (payloadSize == (8 + rows * rowBytes))
+           && (CCH_GetLong(payload)     == (DWORD)rows)
+           && (CCH_GetLong(payload + 4) == (DWORD)rowBits));
+  if (valid) {
+    FUS_Init(map, map->geometry);
+    payload += 8;
+    for (row = 0; row < rows; row++) {
+      for (bit = 0; bit < rowBits; bit++) {
+        if (payload[bit / 8] & (0x80 >> (bit % 8))) FUS_SetBit(map->row[row], bit, TRUE);
+      } /* for */
+      payload += rowBytes;
+    } /* for */
+  } /* if */
+
+  CCH_UnmapFile(entry, entrySize);
+  return valid;
+} /* CCH_LoadFuseMap */
+
+
+void CCH_StoreFuseMap(const char* szFileName, const FUS_MapT* map)
+{
+  BYTE*         payload;
+  BYTE*         payloadPtr;
+  DWORD         payloadSize;
+  DWORD         rowBytes;
+  int           rows;
+  int           rowBits;
+  int           row;
+  int           bit;
+
+  if (cchDir[0] == 0) return;
+  rows        = map->geometry->rows;
+  rowBits     = map->geometry->rowBits;
+  rowBytes    = (rowBits + 7) / 8;
+  payloadSize = 8 + rows * rowBytes;
+  payload = (BYTE*)calloc(1, payloadSize);
+  if (payload == NULL) return;
+
+  payloadPtr = CCH_PutLong((DWORD)rows,    payload);
+  payloadPtr = CCH_PutLong((DWORD)rowBits, payloadPtr);
+  for (row = 0; row < rows; row++) {
+    for (bit = 0; bit < rowBits; bit++) {
+      if (FUS_GetBit(map->row[row], bit)) payloadPtr[bit / 8] |= (BYTE)(0x80 >> (bit % 8));
+    } /* for */
+    payloadPtr += rowBytes;
+  } /* for */
+
+  CCH_Store(szFileName, CCH_KIND_FUSE, payload, payloadSize);
+  free(payload);
+} /* CCH_StoreFuseMap */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CCH_MapConfig / CCH_StoreConfig :
+
+    Map the configuration and register definitions built from a
+    configuration file from the cache / store them into the cache.
+    The mapped images are used in place until the entry is unmapped
+    with CCH_UnmapFile.
+    Payload: options, the register definition files (size, time, hash,
+    full path and the name as used by the configuration of each), then
+    size, CRC and data of the configuration and of the register
+    definitions. A dependency is only valid if its name still resolves
+    to the same full path.
+
+     INPUT  : szFileName    the configuration file name
+              options       build options, the entry must match them
+              config        the configuration to store
+              regdef        the register definitions to store, its
+                            files are the dependencies of the entry
+     OUTPUT : entrySize     size of the mapped entry
+              config        the configuration within the entry
+              configSize    number of configuration bytes
+              regdef        the register definitions within the entry
+              regdefSize    number of register definition bytes
+              RETURN        the mapped entry, NULL if not in the cache
+
+ ****************************************************************************/
+
+static BOOL CCH_CheckDependency(const BYTE** payload, DWORD* payloadSize)
+{
+  char          szFullName[MAXPATHLEN];
+  char          szName[MAXPATHLEN];
+  char          szResolved[MAXPATHLEN];
+  DWORD         pathLen;
+  DWORD         nameLen;
+  struct stat   st;
+  unsigned long long hash;
+  const BYTE*   dep;
+
+  dep = *payload;
+  if (*payloadSize < 20) return FALSE;
+  pathLen = CCH_GetLong(dep + 16);
+  if ((pathLen >= MAXPATHLEN) || ((*payloadSize - 20) < pathLen + 4)) return FALSE;
+  nameLen = CCH_GetLong(dep + 20 + pathLen);
+  if ((nameLen >= MAXPATHLEN) || ((*payloadSize - 24 - pathLen) < nameLen)) return FALSE;
+  (void)memcpy(szFullName, dep + 20, pathLen);
+  szFullName[pathLen] = 0;
+  (void)memcpy(szName, dep + 24 + pathLen, nameLen);
+  szName[nameLen] = 0;
+  *payload     += 24 + pathLen + nameLen;
+  *payloadSize -= 24 + pathLen + nameLen;
+
+  /* the name must still refer to the same file */
+  if (!CCH_FullPath(szName, szResolved) || (strcmp(szResolved, szFullName) != 0)) return FALSE;
+  if (stat(szFullName, &st) != 0) return FALSE;
+  if (CCH_GetLong(dep) != (DWORD)st.st_size) return FALSE;
+  if (CCH_GetLong(dep + 4) == (DWORD)st.st_mtime) return TRUE;
+  return (   CCH_HashFile(szFullName, &hash)
+          && (CCH_GetLong(dep + 8)  == (DWORD)(hash >> 32))
+          && (CCH_GetLong(dep + 12) == (DWORD)(hash & 0xFFFFFFFFUL)));
+} /* CCH_CheckDependency */
+
+
+static BOOL CCH_GetRomImage(const BYTE** payload, DWORD* payloadSize, DWORD maxSize,
+                            const BYTE** data, int* size)
+{
+  DWORD         count;
+
+  if (*payloadSize < 8) return FALSE;
+  count = CCH_GetLong(*payload);
+  if ((count >= maxSize) || ((*payloadSize - 8) < count)) return FALSE;
+  if (CCH_GetLong(*payload + 4) != CRC_Accumulate(0, *payload + 8, count)) return FALSE;
+  *data         = *payload + 8;
+  *size         = (int)count;
+  *payload     += 8 + count;
+  *payloadSize -= 8 + count;
+  return TRUE;
+} /* CCH_GetRomImage */
+
+
+BYTE* CCH_MapConfig(const char*  szFileName,
+                    DWORD        options,
+                    DWORD*       entrySize,
+                    const BYTE** config,
+                    int*         configSize,
+                    const BYTE** regdef,
+                    int*         regdefSize)
+{
+  BYTE*         entry;
+  const BYTE*   payload;
+  DWORD         payloadSize;
+  DWORD         count;
+  BOOL          valid;
+
+  entry = CCH_Lookup(szFileName, CCH_KIND_CONFIG, entrySize, &payload, &payloadSize);
+  if (entry == NULL) return NULL;
+
+  valid = (payloadSize >= 8) && (CCH_GetLong(payload) == options);
+  if (valid) {
+    count        = CCH_GetLong(payload + 4);
+    payload     += 8;
+    payloadSize -= 8;
+    while (valid && (count-- > 0)) valid = CCH_CheckDependency(&payload, &payloadSize);
+  } /* if */
+  if (valid) valid = CCH_GetRomImage(&payload, &payloadSize, BDI_MAX_CONFIG_SIZE, config, configSize);
+  if (valid) valid = CCH_GetRomImage(&payload, &payloadSize, BDI_MAX_REGDEF_SIZE, regdef, regdefSize);
+
+  if (valid) return entry;
+  CCH_UnmapFile(entry, *entrySize);
+  return NULL;
+} /* CCH_MapConfig */
+
+
+void CCH_StoreConfig(const char*        szFileName,
+                     DWORD              options,
+                     CNF_StreamT*       config,
+                     CNF_StreamT*       regdef)
+{
+  char          szFullName[MAXPATHLEN];
+  BYTE*         payload;
+  BYTE*         payloadPtr;
+  BYTE*         configData;
+  BYTE*         regdefData;
+  DWORD         payloadSize;
+  struct stat   st;
+  unsigned long long hash;
+  const char*   szDepName;
+  int           depCount;
+  int           i;
+
+  /* the files of the register definitions are the dependencies */
+  if (cchDir[0] == 0) return;
+  depCount = 0;
+  for (i = 0; i < regdef->count; i++) {
+    if (regdef->segment[i].kind == CNF_SEG_FILE) depCount++;
+  } /* for */
+  payloadSize = 8 + depCount * (24 + 2 * MAXPATHLEN)
+              + 8 + CNF_IMAGE_SIZE(config->size) + 8 + CNF_IMAGE_SIZE(regdef->size);
+  payload = (BYTE*)malloc(payloadSize);
+  if (payload == NULL) return;
+
+  payloadPtr = CCH_PutLong(options, payload);
+  payloadPtr = CCH_PutLong((DWORD)depCount, payloadPtr);
+  for (i = 0; i < regdef->count; i++) {
+    if (regdef->segment[i].kind != CNF_SEG_FILE) continue;
+    szDepName = regdef->segment[i].szFileName;
+    if ((strlen(szDepName) >= MAXPATHLEN) || !CCH_FullPath(szDepName, szFullName)) break;
+    if ((stat(szFullName, &st) != 0) || !CCH_HashFile(szFullName, &hash)) break;
+    payloadPtr = CCH_PutLong((DWORD)st.st_size, payloadPtr);
+    payloadPtr = CCH_PutLong((DWORD)st.st_mtime, payloadPtr);
+    payloadPtr = CCH_PutLong((DWORD)(hash >> 32), payloadPtr);
+    payloadPtr = CCH_PutLong((DWORD)(hash & 0xFFFFFFFFUL), payloadPtr);
+    payloadPtr = CCH_PutLong((DWORD)strlen(szFullName), payloadPtr);
+    (void)memcpy(payloadPtr, szFullName, strlen(szFullName));
+    payloadPtr += strlen(szFullName);
+    payloadPtr = CCH_PutLong((DWORD)strlen(szDepName), payloadPtr);
+    (void)memcpy(payloadPtr, szDepName, strlen(szDepName));
+    payloadPtr += strlen(szDepName);
+  } /* for */
+
+  /* an entry without all dependencies is never stored */
+  configData = payloadPtr + 8;
+  regdefData = configData + config->size + 8;
+  if (   (i == regdef->count)
+      && (CNF_ReadImage(config, configData) >= 0)
+      && (CNF_ReadImage(regdef, regdefData) >= 0)) {
+    payloadPtr = CCH_PutLong(config->size, payloadPtr);
+    payloadPtr = CCH_PutLong(CRC_Accumulate(0, configData, config->size), payloadPtr);
+    payloadPtr = CCH_PutLong(regdef->size, configData + config->size);
+    payloadPtr = CCH_PutLong(CRC_Accumulate(0, regdefData, regdef->size), payloadPtr);
+    payloadPtr = regdefData + regdef->size;
+    CCH_Store(szFileName, CCH_KIND_CONFIG, payload, (DWORD)(payloadPtr - payload));
+  } /* if */
+  free(payload);
+} /* CCH_StoreConfig */
@@ -0,0 +1,64 @@
+#ifndef __BDICACHE_H__
+#define __BDICACHE_H__
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdicache.h
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX
+|  TARGET HW   : PC
+|
+|  PROGRAMMER  : Abatron / RD
+|  CREATION    : 19.10.26
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  On-disk cache of parsed firmware images, fuse maps and configurations
+|
+|
+|*************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define CCH_HASH_INIT   0xcbf29ce484222325ULL   /* FNV-1a offset basis */
+
+/*************************************************************************
+|  FUNCTIONS
+|*************************************************************************/
+
+/* file helpers, mapped files are read only */
+BYTE* CCH_MapFile(const char* szFileName, DWORD* size);
+void  CCH_UnmapFile(BYTE* data, DWORD size);
+unsigned long long CCH_Hash(unsigned long long hash, const BYTE* data, DWORD count);
+BOOL  CCH_HashFile(const char* szFileName, unsigned long long* hash);
+
+/* the cache is disabled until a directory is set */
+void  CCH_SetDirectory(const char* szDir);
+const char* CCH_GetDirectory(void);
+BOOL  CCH_LoadImage(const char* szFileName, IMG_ImageT* image);
+void  CCH_StoreImage(const char* szFileName, const IMG_ImageT* image);
+BOOL  CCH_LoadFuseMap(const char* szFileName, FUS_MapT* map);
+void  CCH_StoreFuseMap(const char* szFileName, const FUS_MapT* map);
+
+/* built configuration, valid while the file and its dependencies are unchanged */
+BYTE* CCH_MapConfig(const char* szFileName, DWORD options, DWORD* entrySize,
+                    const BYTE** config, int* configSize, const BYTE** regdef, int* regdefSize);
+void  CCH_StoreConfig(const char* szFileName, DWORD options,
+                      CNF_StreamT* config, CNF_StreamT* regdef);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
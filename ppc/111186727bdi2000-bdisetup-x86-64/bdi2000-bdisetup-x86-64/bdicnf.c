@@ -14,6 +14,10 @@
 |
 |  DESCRIPTION :
 |  This module builds the configuration stored into the BDI flash memory.
+|  The configuration file is compiled first: every line is tokenized,
+|  the keywords are looked up in a perfect hash table and the arguments
+|  of known keywords are validated. The configuration is programmed as
+|  read or stripped of comments, blank lines and redundant white space.
 |
 |*************************************************************************/
 
@@ -41,6 +45,17 @@
 #define MAX_LINE_LEN    256
 #define BDI_FW_COUNT    40
 
+#define CNF_HASH_SIZE   251     /* keyword hash table, collision free with */
+#define CNF_HASH_MULT   953     /* this multiplier for the keywords below  */
+#define CNF_ENTRY_GROW  256
+
+/* configuration parts of a keyword */
+#define IN_INIT         (1 << CNF_PART_INIT)
+#define IN_TARGET       (1 << CNF_PART_TARGET)
+#define IN_HOST         (1 << CNF_PART_HOST)
+#define IN_FLASH        (1 << CNF_PART_FLASH)
+#define IN_REGS         (1 << CNF_PART_REGS)
+
 
 /* ASCII codes */
 #define HT              9
@@ -56,14 +71,88 @@
 |  TYPEDEFS
 |*************************************************************************/
 
+typedef struct {
+  const char* szName;
+  int         keyword;        /* CNF_KEY_xxx */
+  int         parts;          /* IN_xxx */
+  int         size;           /* access size of memory keywords */
+  int         minArgs;
+  const char* szArgs;         /* argument types, see CNF_CheckEntry */
+} CNF_KeywordT;
+
 /*************************************************************************
 |  TABLES
 |*************************************************************************/
 
+static const CNF_KeywordT KeywordTable[] = {
+  {"WGPR",      CNF_KEY_WGPR,       IN_INIT,              0, 2, "nw"},
+  {"WSPR",      CNF_KEY_WSPR,       IN_INIT,              0, 2, "nw"},
+  {"WSR",       CNF_KEY_WSR,        IN_INIT,              0, 2, "nn"},
+  {"WREG",      CNF_KEY_WREG,       IN_INIT,              0, 2, "sw"},
+  {"WM8",       CNF_KEY_WM8,        IN_INIT,              1, 2, "nn"},
+  {"WM16",      CNF_KEY_WM16,       IN_INIT,              2, 2, "nn"},
+  {"WM32",      CNF_KEY_WM32,       IN_INIT,              4, 2, "nn"},
+  {"WM64",      CNF_KEY_WM64,       IN_INIT,              8, 2, "nw"},
+  {"RM8",       CNF_KEY_RM8,        IN_INIT,              1, 1, "nn"},
+  {"RM16",      CNF_KEY_RM16,       IN_INIT,              2, 1, "nn"},
+  {"RM32",      CNF_KEY_RM32,       IN_INIT,              4, 1, "nn"},
+  {"RM64",      CNF_KEY_RM64,       IN_INIT,              8, 1, "nw"},
+  {"DELAY",     CNF_KEY_DELAY,      IN_INIT,              0, 1, "n"},
+  {"SUPM",      CNF_KEY_SUPM,       IN_INIT,              0, 2, "nn"},
+  {"WUPM",      CNF_KEY_WUPM,       IN_INIT,              0, 2, "nn"},
+  {"TSZ1",      CNF_KEY_TSZ1,       IN_INIT,              1, 2, "nn"},
+  {"TSZ2",      CNF_KEY_TSZ2,       IN_INIT,              2, 2, "nn"},
+  {"TSZ4",      CNF_KEY_TSZ4,       IN_INIT,              4, 2, "nn"},
+  {"TSZ8",      CNF_KEY_TSZ8,       IN_INIT,              8, 2, "nn"},
+  {"MMAP",      CNF_KEY_MMAP,       IN_INIT,              0, 2, "nn"},
+  {"CPUTYPE",   CNF_KEY_CPUTYPE,    IN_TARGET,            0, 1, "s*"},
+  {"JTAGCLOCK", CNF_KEY_JTAGCLOCK,  IN_TARGET,            0, 1, "n*"},
+  {"BDIMODE",   CNF_KEY_BDIMODE,    IN_TARGET,            0, 1, "s*"},
+  {"STARTUP",   CNF_KEY_STARTUP,    IN_TARGET,            0, 1, "s*"},
+  {"BOOTADDR",  CNF_KEY_BOOTADDR,   IN_TARGET,            0, 1, "n"},
+  {"WORKSPACE", CNF_KEY_WORKSPACE,  IN_TARGET | IN_FLASH, 0, 1, "n*"},
+  {"BREAKMODE", CNF_KEY_BREAKMODE,  IN_TARGET,            0, 1, "s*"},
+  {"STEPMODE",  CNF_KEY_STEPMODE,   IN_TARGET,            0, 1, "s*"},
+  {"VECTOR",    CNF_KEY_VECTOR,     IN_TARGET,            0, 1, "s*"},
+  {"DCACHE",    CNF_KEY_DCACHE,     IN_TARGET,            0, 1, "s*"},
+  {"POWERUP",   CNF_KEY_POWERUP,    IN_TARGET,            0, 1, "n"},
+  {"WAKEUP",    CNF_KEY_WAKEUP,     IN_TARGET,            0, 1, "n"},
+  {"MEMDELAY",  CNF_KEY_MEMDELAY,   IN_TARGET,            0, 1, "n"},
+  {"L2PM",      CNF_KEY_L2PM,       IN_TARGET,            0, 2, "nn"},
+  {"MMU",       CNF_KEY_MMU,        IN_TARGET,            0, 1, "s*"},
+  {"PTBASE",    CNF_KEY_PTBASE,     IN_TARGET,            0, 1, "n"},
+  {"PARITY",    CNF_KEY_PARITY,     IN_TARGET,            0, 1, "s"},
+  {"REGLIST",   CNF_KEY_REGLIST,    IN_TARGET,            0, 1, "s*"},
+  {"VIO",       CNF_KEY_VIO,        IN_TARGET,            0, 1, "s*"},
+  {"SIO",       CNF_KEY_SIO,        IN_TARGET,            0, 1, "s*"},
+  {"SCANPRED",  CNF_KEY_SCANPRED,   IN_TARGET,            0, 2, "nn"},
+  {"SCANSUCC",  CNF_KEY_SCANSUCC,   IN_TARGET,            0, 2, "nn"},
+  {"IP",        CNF_KEY_IP,         IN_HOST,              0, 1, "i"},
+  {"FILE",      CNF_KEY_FILE,       IN_HOST | IN_FLASH | IN_REGS, 0, 1, "s*"},
+  {"FORMAT",    CNF_KEY_FORMAT,     IN_HOST | IN_FLASH,   0, 1, "s*"},
+  {"LOAD",      CNF_KEY_LOAD,       IN_HOST,              0, 1, "s*"},
+  {"START",     CNF_KEY_START,      IN_HOST,              0, 1, "n"},
+  {"DEBUGPORT", CNF_KEY_DEBUGPORT,  IN_HOST,              0, 1, "n"},
+  {"PROMPT",    CNF_KEY_PROMPT,     IN_HOST,              0, 1, "s"},
+  {"DUMP",      CNF_KEY_DUMP,       IN_HOST,              0, 1, "s*"},
+  {"TELNET",    CNF_KEY_TELNET,     IN_HOST,              0, 1, "s"},
+  {"CHIPTYPE",  CNF_KEY_CHIPTYPE,   IN_FLASH,             0, 1, "s"},
+  {"CHIPSIZE",  CNF_KEY_CHIPSIZE,   IN_FLASH,             0, 1, "n"},
+  {"BUSWIDTH",  CNF_KEY_BUSWIDTH,   IN_FLASH,             0, 1, "n"},
+  {"ERASE",     CNF_KEY_ERASE,      IN_FLASH,             0, 1, "n*"},
+  {"DMM1",      CNF_KEY_DMM1,       IN_REGS,              0, 1, "n"},
+  {"DMM2",      CNF_KEY_DMM2,       IN_REGS,              0, 1, "n"},
+  {"DMM3",      CNF_KEY_DMM3,       IN_REGS,              0, 1, "n"},
+  {"DMM4",      CNF_KEY_DMM4,       IN_REGS,              0, 1, "n"}
+};
+
 /*************************************************************************
 |  LOCALS
 |*************************************************************************/
 
+static const CNF_KeywordT*  keywordHash[CNF_HASH_SIZE];
+static BOOL                 keywordHashValid = FALSE;
+
 /****************************************************************************
  ****************************************************************************
 
@@ -148,81 +237,538 @@ static BYTE* BDI_ExtractLong(DWORD* value, BYTE* buffer)
   return buffer;
 } /* BDI_ExtractLong */
 
-static char* BDI_ExtractString (WORD size, char* string, char* getPtr)
+/****************************************************************************
+ ****************************************************************************
+
+    CNF_FindKeyword :
+
+    Looks up a keyword in the perfect hash table. The hash is collision free
+    for the keywords of KeywordTable, check this when adding a keyword.
+
+     INPUT  : szName    keyword in upper case
+              part      configuration part of the line
+     OUTPUT : RETURN    the keyword, NULL if not known in this part
+
+ ****************************************************************************/
+
+static int CNF_Hash(const char* szName)
+{
+  DWORD hash;
+
+  hash = 0;
+  while (*szName != 0) {
+    hash = (hash * CNF_HASH_MULT + (BYTE)*szName++) & 0xFFFFFFFF;
+  } /* while */
+  return (int)(hash % CNF_HASH_SIZE);
+} /* CNF_Hash */
+
+static const CNF_KeywordT* CNF_FindKeyword(const char* szName, int part)
+{
+  const CNF_KeywordT* keyword;
+  int                 i;
+
+  /* fill the hash table at first use */
+  if (!keywordHashValid) {
+    for (i = 0; i < (int)(sizeof KeywordTable / sizeof KeywordTable[0]); i++) {
+      keywordHash[CNF_Hash(KeywordTable[i].szName)] = &KeywordTable[i];
+    } /* for */
+    keywordHashValid = TRUE;
+  } /* if */
+
+  keyword = keywordHash[CNF_Hash(szName)];
+  if (keyword == NULL) return NULL;
+  if (strcmp(keyword->szName, szName) != 0) return NULL;
+  if ((keyword->parts & (1 << part)) == 0) return NULL;
+  return keyword;
+} /* CNF_FindKeyword */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CNF_ParseNumber :
+
+    Parses a decimal or hex (0x prefix) number of up to 64 bits.
+
+     INPUT  : szText    the text of the number
+              len       number of characters
+     OUTPUT : value     the number
+              RETURN    TRUE if the whole text is a valid number
+
+ ****************************************************************************/
+
+static BOOL CNF_ParseNumber(const char* szText, int len, unsigned long long* value)
+{
+  unsigned long long  x;
+  int                 base;
+  int                 digit;
+  char                c;
+
+  base = 10;
+  if ((len > 2) && (szText[0] == '0') && (toupper((BYTE)szText[1]) == 'X')) {
+    base = 16;
+    szText += 2;
+    len -= 2;
+  } /* if */
+  if (len <= 0) return FALSE;
+
+  x = 0;
+  while (len > 0) {
+    c = (char)toupper((BYTE)*szText++);
+    if      ((c >= '0') && (c <= '9'))                  digit = c - '0';
+    else if ((base == 16) && (c >= 'A') && (c <= 'F'))  digit = c - 'A' + 10;
+    else return FALSE;
+    if (x > (~0ULL - (unsigned long long)digit) / (unsigned long long)base) return FALSE;
+    x = x * (unsigned long long)base + (unsigned long long)digit;
+    len--;
+  } /* while */
+
+  *value = x;
+  return TRUE;
+} /* CNF_ParseNumber */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CNF_Get___ :
+
+    Access to the arguments of a compiled line.
+
+     INPUT  : config    the compiled configuration
+              entry     the line
+              index     argument index
+              size      size of the string buffer
+     OUTPUT : value     the numeric value of the argument
+              string    the argument without quotes
+              RETURN    the text of the line, FALSE if no valid argument
+
+ ****************************************************************************/
+
+const char* CNF_GetText(const CNF_ConfigT* config, const CNF_EntryT* entry)
+{
+  return config->text + entry->text;
+} /* CNF_GetText */
+
+BOOL CNF_GetNumber(const CNF_ConfigT* config, const CNF_EntryT* entry, int index,
+                   unsigned long long* value)
+{
+  if ((index < 0) || (index >= entry->argCount)) return FALSE;
+  return CNF_ParseNumber(config->text + entry->text + entry->arg[index].pos,
+                         entry->arg[index].len, value);
+} /* CNF_GetNumber */
+
+BOOL CNF_GetString(const CNF_ConfigT* config, const CNF_EntryT* entry, int index,
+                   char* string, int size)
 {
-  /* skip spaces */
-  while (*getPtr == ' ') getPtr++;
+  const char* getPtr;
+  int         len;
 
-  /* copy string */
+  if ((index < 0) || (index >= entry->argCount)) return FALSE;
+  getPtr = config->text + entry->text + entry->arg[index].pos;
+  len    = entry->arg[index].len;
   if (*getPtr == '"') {
     getPtr++;
-    while ((*getPtr != '"') && (*getPtr != 0)) {
-      if (size > 1) {
-        *string++ = *getPtr;
-        size--;
+    len -= 2;
+  } /* if */
+  if (len >= size) return FALSE;
+  memcpy(string, getPtr, (size_t)len);
+  string[len] = 0;
+  return TRUE;
+} /* CNF_GetString */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CNF_CheckEntry :
+
+    Validates the arguments of a known keyword. The argument types are
+    n (32 bit number), w (64 bit number), i (IP address), s (string)
+    and * (any further arguments).
+
+     INPUT  : config    the compiled configuration
+              entry     the line
+              keyword   the keyword of the line
+     OUTPUT : RETURN    NULL or the error message
+
+ ****************************************************************************/
+
+static BOOL CNF_IsIPAddr(const char* szText, int len)
+{
+  int   parts;
+  int   digits;
+  int   value;
+
+  parts  = 1;
+  digits = 0;
+  value  = 0;
+  while (len > 0) {
+    if (*szText == '.') {
+      if ((digits == 0) || (parts == 4)) return FALSE;
+      parts++;
+      digits = 0;
+      value  = 0;
+    } /* if */
+    else if (isdigit((BYTE)*szText)) {
+      value = 10 * value + (*szText - '0');
+      if ((++digits > 3) || (value > 255)) return FALSE;
+    } /* else if */
+    else {
+      return FALSE;
+    } /* else */
+    szText++;
+    len--;
+  } /* while */
+  return (parts == 4) && (digits > 0);
+} /* CNF_IsIPAddr */
+
+static const char* CNF_CheckEntry(const CNF_ConfigT* config, const CNF_EntryT* entry,
+                                  const CNF_KeywordT* keyword)
+{
+  unsigned long long  value[CNF_MAX_ARGS];
+  const char*         types;
+  int                 i;
+
+  /* number and type of the arguments */
+  if (entry->argCount < keyword->minArgs) return "missing argument";
+  types = keyword->szArgs;
+  for (i = 0; i < entry->argCount; i++) {
+    value[i] = 0;
+    if (*types == '*') break;
+    if (*types == 0) return "too many arguments";
+    if ((*types == 'n') || (*types == 'w')) {
+      if (!CNF_GetNumber(config, entry, i, &value[i])) return "invalid number";
+      if ((*types == 'n') && (value[i] > 0xFFFFFFFFULL)) return "number out of range";
+    } /* if */
+    else if (*types == 'i') {
+      if (!CNF_IsIPAddr(CNF_GetText(config, entry) + entry->arg[i].pos, entry->arg[i].len)) {
+        return "invalid IP address";
       } /* if */
-      getPtr++;
-    } /* while */
-    if (*getPtr != 0) getPtr++;
+    } /* else if */
+    types++;
+  } /* for */
+
+  /* values */
+  switch (keyword->keyword) {
+  case CNF_KEY_WGPR:
+    if (value[0] > 31) return "invalid register number";
+    break;
+  case CNF_KEY_WSPR:
+    if (value[0] > 1023) return "invalid register number";
+    break;
+  case CNF_KEY_WSR:
+    if (value[0] > 15) return "invalid register number";
+    break;
+  case CNF_KEY_WM8:
+  case CNF_KEY_WM16:
+  case CNF_KEY_WM32:
+  case CNF_KEY_WM64:
+  case CNF_KEY_RM8:
+  case CNF_KEY_RM16:
+  case CNF_KEY_RM32:
+  case CNF_KEY_RM64:
+    if ((value[0] % (unsigned)keyword->size) != 0) return "address not aligned";
+    if ((entry->argCount > 1) && (keyword->size < 8) && ((value[1] >> (8 * keyword->size)) != 0)) {
+      return "value wider than the access";
+    } /* if */
+    break;
+  case CNF_KEY_DELAY:
+    if (value[0] > 30000) return "delay above 30000 ms";
+    break;
+  case CNF_KEY_TSZ1:
+  case CNF_KEY_TSZ2:
+  case CNF_KEY_TSZ4:
+  case CNF_KEY_TSZ8:
+  case CNF_KEY_MMAP:
+    if (value[0] > value[1]) return "start above end";
+    break;
+  case CNF_KEY_DEBUGPORT:
+    if ((value[0] == 0) || (value[0] > 0xFFFF)) return "invalid port";
+    break;
+  case CNF_KEY_CHIPSIZE:
+    if (value[0] == 0) return "invalid chip size";
+    break;
+  case CNF_KEY_BUSWIDTH:
+    if ((value[0] != 8) && (value[0] != 16) && (value[0] != 32) && (value[0] != 64)) {
+      return "invalid bus width";
+    } /* if */
+    break;
+  default:
+    break;
+  } /* switch */
+
+  return NULL;
+} /* CNF_CheckEntry */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CNF_CompileText :
+
+    Compiles the text of a configuration file. Every line is split into
+    tokens, comments are removed. The keywords are looked up and the
+    arguments of known keywords validated. Unknown keywords are kept
+    unchecked, they may be specific to a firmware.
+
+     INPUT  : data      the configuration file text
+              size      size of the text
+     OUTPUT : config    the compiled configuration, release with CNF_Free
+              RETURN    error code, BDI_ERR_CONFIG_SYNTAX with the line and
+                        the message in config
+
+ ****************************************************************************/
+
+static int CNF_Error(CNF_ConfigT* config, int line, const char* szError, const char* szToken, int len)
+{
+  config->errorLine = line;
+  if (szToken == NULL) {
+    sprintf(config->szError, "%.60s", szError);
   } /* if */
   else {
-    while ((*getPtr != ' ') && (*getPtr != ';') && (*getPtr != 0)) {
-      if (size > 1) {
-        *string++ = *getPtr;
-        size--;
-      } /* if */
-      getPtr++;
-    } /* while */
+    if (len > 16) len = 16;
+    sprintf(config->szError, "%.60s '%.*s'", szError, len, szToken);
   } /* else */
+  return BDI_ERR_CONFIG_SYNTAX;
+} /* CNF_Error */
 
-  *string = 0;
-  return getPtr;
-} /* BDI_ExtractString */
+static CNF_EntryT* CNF_AddEntry(CNF_ConfigT* config)
+{
+  CNF_EntryT* newEntry;
+
+  if (config->count == config->alloc) {
+    newEntry = (CNF_EntryT*)realloc(config->entry, (config->alloc + CNF_ENTRY_GROW) * sizeof(CNF_EntryT));
+    if (newEntry == NULL) return NULL;
+    config->entry  = newEntry;
+    config->alloc += CNF_ENTRY_GROW;
+  } /* if */
+  newEntry = &config->entry[config->count++];
+  memset(newEntry, 0, sizeof *newEntry);
+  return newEntry;
+} /* CNF_AddEntry */
 
-static BYTE* BDI_ExtractLine(WORD count, char* line, BYTE* buffer)
+int CNF_CompileText(const BYTE* data, int size, CNF_ConfigT* config)
 {
-  BYTE  rxChar;
-  char* putPtr;
+  const CNF_KeywordT* keyword;
+  CNF_EntryT*         entry;
+  CNF_ArgT            token[CNF_MAX_ARGS + 3];
+  char*               lineText;
+  char*               putPtr;
+  const char*         szError;
+  char                szName[16];
+  unsigned long long  value;
+  int                 tokenCount;
+  int                 first;
+  int                 core;
+  int                 part;
+  int                 line;
+  int                 pos;
+  int                 i;
+  BYTE                c;
 
-  /* skip leading control chars and spaces */
-  rxChar = *buffer;
-  while (rxChar <= ' ') {
-    buffer++;
-    rxChar = *buffer;
-  } /* while */
+  memset(config, 0, sizeof *config);
+  config->source = (BYTE*)malloc((size_t)size + 1);
+  /* a separator is added between tokens even if the source has none ("a""b") */
+  config->text   = (char*)malloc((size_t)size + (size_t)size / 2 + 2);
+  if ((config->source == NULL) || (config->text == NULL)) {
+    CNF_Free(config);
+    return BDI_ERR_FILE_ACCESS;
+  } /* if */
+  memcpy(config->source, data, (size_t)size);
+  config->sourceSize = size;
+
+  part = CNF_PART_NONE;
+  line = 0;
+  pos  = 0;
+  while (pos < size) {
+    line++;
 
-  /* read next line */
-  putPtr = line;
-  while ((rxChar <= 0x7f) && (rxChar != CR) && (rxChar != LF) && (count > 0)) {
-    if (rxChar == HT) rxChar = ' ';
-    *putPtr++ = (char)rxChar;
-    buffer++;
-    rxChar = *buffer;
-    count--;
+    /* split the line into tokens, quoted strings are one token */
+    lineText   = config->text + config->textSize;
+    putPtr     = lineText;
+    tokenCount = 0;
+    while ((pos < size) && (data[pos] != CR) && (data[pos] != LF)) {
+      c = data[pos];
+      if (c <= ' ') {
+        pos++;
+        continue;
+      } /* if */
+      if (c == ';') {
+        while ((pos < size) && (data[pos] != CR) && (data[pos] != LF)) pos++;
+        break;
+      } /* if */
+      if (tokenCount == CNF_MAX_ARGS + 3) return CNF_Error(config, line, "too many arguments", NULL, 0);
+      if (putPtr - lineText >= MAX_LINE_LEN - 2) return CNF_Error(config, line, "line too long", NULL, 0);
+      if (tokenCount > 0) *putPtr++ = ' ';
+      token[tokenCount].pos = (int)(putPtr - lineText);
+      if (c == '"') {
+        *putPtr++ = (char)data[pos++];
+        while ((pos < size) && (data[pos] != '"') && (data[pos] != CR) && (data[pos] != LF)) {
+          if (putPtr - lineText >= MAX_LINE_LEN - 1) return CNF_Error(config, line, "line too long", NULL, 0);
+          *putPtr++ = (char)data[pos++];
+        } /* while */
+        if ((pos == size) || (data[pos] != '"')) return CNF_Error(config, line, "missing quote", NULL, 0);
+        if (putPtr - lineText >= MAX_LINE_LEN - 1) return CNF_Error(config, line, "line too long", NULL, 0);
+        *putPtr++ = (char)data[pos++];
+      } /* if */
+      else {
+        while ((pos < size) && (data[pos] > ' ') && (data[pos] != ';')) {
+          if (putPtr - lineText >= MAX_LINE_LEN - 1) return CNF_Error(config, line, "line too long", NULL, 0);
+          *putPtr++ = (char)data[pos++];
+        } /* while */
+      } /* else */
+      token[tokenCount].len = (int)(putPtr - lineText) - token[tokenCount].pos;
+      for (i = token[tokenCount].pos; i < token[tokenCount].pos + token[tokenCount].len; i++) {
+        if ((BYTE)lineText[i] > 0x7E) {
+          return CNF_Error(config, line, "invalid character in", lineText + token[tokenCount].pos,
+                           token[tokenCount].len);
+        } /* if */
+      } /* for */
+      tokenCount++;
+    } /* while */
+    if ((pos < size) && (data[pos] == CR)) pos++;
+    if ((pos < size) && (data[pos] == LF)) pos++;
+    if (tokenCount == 0) continue;
+    *putPtr = 0;
+
+    entry = CNF_AddEntry(config);
+    if (entry == NULL) {
+      CNF_Free(config);
+      return BDI_ERR_FILE_ACCESS;
+    } /* if */
+    entry->line = line;
+    entry->text = config->textSize;
+    entry->core = -1;
+    config->textSize += (int)(putPtr - lineText) + 1;
+
+    /* part line */
+    if (lineText[0] == '[') {
+      if ((tokenCount > 1) || (lineText[token[0].len - 1] != ']') || (token[0].len > 10)) {
+        return CNF_Error(config, line, "invalid part", lineText, token[0].len);
+      } /* if */
+      for (i = 0; i < token[0].len; i++) szName[i] = (char)toupper((BYTE)lineText[i]);
+      szName[i] = 0;
+      if      (strcmp(szName, "[INIT]")   == 0) part = CNF_PART_INIT;
+      else if (strcmp(szName, "[TARGET]") == 0) part = CNF_PART_TARGET;
+      else if (strcmp(szName, "[HOST]")   == 0) part = CNF_PART_HOST;
+      else if (strcmp(szName, "[FLASH]")  == 0) part = CNF_PART_FLASH;
+      else if (strcmp(szName, "[REGS]")   == 0) part = CNF_PART_REGS;
+      else                                      part = CNF_PART_OTHER;
+      entry->part    = part;
+      entry->keyword = CNF_KEY_PART;
+      continue;
+    } /* if */
+    if (part == CNF_PART_NONE) return CNF_Error(config, line, "line outside of a part", NULL, 0);
+    entry->part = part;
+
+    /* core prefix #n */
+    first = 0;
+    if (lineText[0] == '#') {
+      if (token[0].len > 1) {
+        core  = CNF_ParseNumber(lineText + 1, token[0].len - 1, &value) ? (int)value : -1;
+        first = 1;
+      } /* if */
+      else {
+        core  = ((tokenCount > 1) && CNF_ParseNumber(lineText + token[1].pos, token[1].len, &value))
+                ? (int)value : -1;
+        first = 2;
+      } /* else */
+      if ((core < 0) || (core > 0x3F)) return CNF_Error(config, line, "invalid core", lineText, token[0].len);
+      entry->core = core;
+    } /* if */
+    if (first >= tokenCount) return CNF_Error(config, line, "missing keyword", NULL, 0);
+
+    /* keyword and arguments */
+    entry->argCount = tokenCount - first - 1;
+    if (entry->argCount > CNF_MAX_ARGS) return CNF_Error(config, line, "too many arguments", NULL, 0);
+    for (i = 0; i < entry->argCount; i++) entry->arg[i] = token[first + 1 + i];
+    keyword = NULL;
+    if ((part != CNF_PART_OTHER) && (token[first].len < (int)sizeof szName)) {
+      for (i = 0; i < token[first].len; i++) {
+        szName[i] = (char)toupper((BYTE)lineText[token[first].pos + i]);
+      } /* for */
+      szName[i] = 0;
+      keyword = CNF_FindKeyword(szName, part);
+    } /* if */
+    if (keyword != NULL) {
+      entry->keyword = keyword->keyword;
+      szError = CNF_CheckEntry(config, entry, keyword);
+      if (szError != NULL) {
+        return CNF_Error(config, line, szError, lineText + token[first].pos, token[first].len);
+      } /* if */
+    } /* if */
   } /* while */
 
-  *putPtr = 0;  /* terminating zero */
-  return buffer;
-} /* BDI_ExtractLine */
+  return BDI_OKAY;
+} /* CNF_CompileText */
 
 
 /****************************************************************************
  ****************************************************************************
-    Build the configuration data from the configuration file
 
-    INPUT:  szFileName  the configuration file name
-    OUTPUT: data        the data to program into the BDI flash
-            return      number of bytes to program
+    CNF_Compile :
+
+    Reads and compiles a configuration file.
+
+     INPUT  : szFileName  the configuration file name
+     OUTPUT : config      the compiled configuration, release with CNF_Free
+              RETURN      error code
 
  ****************************************************************************/
 
-/* configuration parts */
-#define CNF_PART_NONE           0
-#define CNF_PART_INIT           1
-#define CNF_PART_TARGET         2
-#define CNF_PART_HOST           3
-#define CNF_PART_FLASH          4
-#define CNF_PART_REGS           5
+int CNF_Compile(const char* szFileName, CNF_ConfigT* config)
+{
+  int     result;
+  long    size;
+  BYTE*   data;
+  FILE*   configFile;
+
+  memset(config, 0, sizeof *config);
+  configFile = fopen(szFileName, "rb");
+  if (configFile == NULL) return BDI_ERR_FILE_ACCESS;
+  data = NULL;
+  size = -1;
+  if (fseek(configFile, 0, SEEK_END) == 0) size = ftell(configFile);
+  if (size >= 0) {
+    rewind(configFile);
+    data = (BYTE*)malloc((size_t)size + 1);
+  } /* if */
+  if ((data == NULL) || (fread(data, 1, (size_t)size, configFile) != (size_t)size)) {
+    fclose(configFile);
+    free(data);
+    return BDI_ERR_FILE_ACCESS;
+  } /* if */
+  fclose(configFile);
+
+  result = CNF_CompileText(data, (int)size, config);
+  free(data);
+  return result;
+} /* CNF_Compile */
+
+
+void CNF_Free(CNF_ConfigT* config)
+{
+  free(config->source);
+  free(config->text);
+  free(config->entry);
+  config->source = NULL;
+  config->text   = NULL;
+  config->entry  = NULL;
+  config->count  = 0;
+  config->alloc  = 0;
+} /* CNF_Free */
+
+
+/****************************************************************************
+ ****************************************************************************
+    Build a file name in the directory of another file
+
+    INPUT:  p           the other file
+            n           the name
+    OUTPUT: s           the file name
+
+ ****************************************************************************/
 
 static void BuildFileName(char* s, const char* p, const char* n)
 {
@@ -242,84 +788,270 @@ static void BuildFileName(char* s, const char* p, const char* n)
 } /* BuildFileName */
 
 
-int CNF_BuildRomConfig(const char* szFileName, BYTE* data)
+/****************************************************************************
+ ****************************************************************************
+    The configuration and register definitions to program into the BDI
+    flash. An image is a list of segments, every block is produced when
+    it is programmed or compared, the whole image is never held in memory.
+    Files are read while their blocks are produced, the configuration
+    comes from the compiled configuration, which must live as long as
+    the stream. The register definitions are per file the core byte
+    (0x80 | core) and the file.
+
+    INPUT:  config      the compiled configuration
+            strip       without comments, blank lines and redundant spaces
+            data        the bytes of an image built before
+            size        number of bytes
+    OUTPUT: stream      the opened stream, closed by CNF_Close also on error
+            block       the next block, the rest after the image is 0xFF
+            return      the image size / bytes of the image in the block /
+                        error code
+
+ ****************************************************************************/
+
+static CNF_SegmentT* CNF_AddSegment(CNF_StreamT* stream, int kind, DWORD size)
+{
+  CNF_SegmentT* newSegment;
+
+  newSegment = (CNF_SegmentT*)realloc(stream->segment, (stream->count + 1) * sizeof(CNF_SegmentT));
+  if (newSegment == NULL) return NULL;
+  stream->segment = newSegment;
+  newSegment = &stream->segment[stream->count++];
+  memset(newSegment, 0, sizeof *newSegment);
+  newSegment->kind = kind;
+  newSegment->size = size;
+  stream->size    += size;
+  return newSegment;
+} /* CNF_AddSegment */
+
+
+int CNF_OpenRomConfig(const CNF_ConfigT* config, BOOL strip, CNF_StreamT* stream)
+{
+  CNF_SegmentT* segment;
+  DWORD         size;
+  int           i;
+
+  memset(stream, 0, sizeof *stream);
+  stream->config = config;
+
+  /* the file as it is or one line per entry */
+  size = (DWORD)config->sourceSize;
+  if (strip) {
+    size = 0;
+    for (i = 0; i < config->count; i++) size += (DWORD)strlen(CNF_GetText(config, &config->entry[i])) + 1;
+  } /* if */
+  if (size >= BDI_MAX_CONFIG_SIZE) return BDI_ERR_FILE_ACCESS;
+  segment = CNF_AddSegment(stream, strip ? CNF_SEG_LINES : CNF_SEG_DATA, size);
+  if (segment == NULL) return BDI_ERR_FILE_ACCESS;
+  segment->data = config->source;
+  return (int)stream->size;
+} /* CNF_OpenRomConfig */
+
+
+int CNF_OpenData(const BYTE* data, int size, CNF_StreamT* stream)
+{
+  CNF_SegmentT* segment;
+
+  memset(stream, 0, sizeof *stream);
+  segment = CNF_AddSegment(stream, CNF_SEG_DATA, (DWORD)size);
+  if (segment == NULL) return BDI_ERR_FILE_ACCESS;
+  segment->data = data;
+  return size;
+} /* CNF_OpenData */
+
+
+static void CNF_ReadLines(CNF_StreamT* stream, BYTE* data, DWORD count)
+{
+  const char* text;
+
+  while (count-- > 0) {
+    text = CNF_GetText(stream->config, &stream->config->entry[stream->entry]);
+    if (text[stream->entryPos] != 0) {
+      *data++ = (BYTE)text[stream->entryPos++];
+    } /* if */
+    else {
+      *data++ = LF;
+      stream->entry++;
+      stream->entryPos = 0;
+    } /* else */
+  } /* while */
+} /* CNF_ReadLines */
+
+
+int CNF_ReadBlock(CNF_StreamT* stream, BYTE* block)
+{
+  CNF_SegmentT* segment;
+  DWORD         count;
+  DWORD         chunk;
+
+  count = 0;
+  while ((count < CNF_BLOCK_SIZE) && (stream->seg < stream->count)) {
+    segment = &stream->segment[stream->seg];
+    chunk = segment->size - stream->offset;
+    if (chunk > CNF_BLOCK_SIZE - count) chunk = CNF_BLOCK_SIZE - count;
+    switch (segment->kind) {
+      case CNF_SEG_DATA:
+        memcpy(block + count, segment->data + stream->offset, (size_t)chunk);
+        break;
+      case CNF_SEG_BYTE:
+        block[count] = segment->value;
+        break;
+      case CNF_SEG_FILE:
+        if (stream->file == NULL) stream->file = fopen(segment->szFileName, "rb");
+        if (   (stream->file == NULL)
+            || (fread(block + count, 1, (size_t)chunk, stream->file) != (size_t)chunk)) {
+          return BDI_ERR_FILE_ACCESS;
+        } /* if */
+        break;
+      default:
+        CNF_ReadLines(stream, block + count, chunk);
+        break;
+    } /* switch */
+    count          += chunk;
+    stream->offset += chunk;
+    if (stream->offset == segment->size) {
+      if (stream->file != NULL) fclose(stream->file);
+      stream->file   = NULL;
+      stream->offset = 0;
+      stream->seg++;
+    } /* if */
+  } /* while */
+
+  stream->pos += count;
+  memset(block + count, 0xff, (size_t)(CNF_BLOCK_SIZE - count));
+  return (int)count;
+} /* CNF_ReadBlock */
+
+
+/* the whole image with its 0xFF, data holds CNF_IMAGE_SIZE(size) bytes */
+int CNF_ReadImage(CNF_StreamT* stream, BYTE* data)
+{
+  DWORD   offset;
+  int     result;
+
+  CNF_Rewind(stream);
+  result = (int)stream->size;
+  for (offset = 0; (offset < CNF_IMAGE_SIZE(stream->size)) && (result >= 0); offset += CNF_BLOCK_SIZE) {
+    if (CNF_ReadBlock(stream, data + offset) < 0) result = BDI_ERR_FILE_ACCESS;
+  } /* for */
+  return result;
+} /* CNF_ReadImage */
+
+
+void CNF_Rewind(CNF_StreamT* stream)
+{
+  if (stream->file != NULL) fclose(stream->file);
+  stream->file     = NULL;
+  stream->pos      = 0;
+  stream->seg      = 0;
+  stream->offset   = 0;
+  stream->entry    = 0;
+  stream->entryPos = 0;
+} /* CNF_Rewind */
+
+
+void CNF_Close(CNF_StreamT* stream)
+{
+  int     i;
+
+  CNF_Rewind(stream);
+  for (i = 0; i < stream->count; i++) free(stream->segment[i].szFileName);
+  free(stream->segment);
+  stream->segment = NULL;
+  stream->count   = 0;
+  stream->size    = 0;
+} /* CNF_Close */
+
+
+/****************************************************************************
+ ****************************************************************************
+    Get the number and the names of the register definition files of the
+    [REGS] part, a name starting with $ is relative to the configuration file
+
+    INPUT:  szFileName  the configuration file name
+            config      the compiled configuration
+            index       the index of the FILE line within [REGS]
+            size        size of the name buffer
+    OUTPUT: regdefName  the register definition file name
+            core        the core of the file
+            return      number of files / FALSE if there is no such file
+
+ ****************************************************************************/
+
+int CNF_GetRegdefCount(const CNF_ConfigT* config)
 {
   int     count;
-  FILE*   configFile;
+  int     i;
 
-  /* open configuration file */
-  configFile = fopen(szFileName, "rb");
-  if (configFile == NULL)  return BDI_ERR_FILE_ACCESS;
-  count = (int)fread(data, 1, BDI_MAX_CONFIG_SIZE, configFile);
-  fclose(configFile);
+  count = 0;
+  for (i = 0; i < config->count; i++) {
+    if (   (config->entry[i].part == CNF_PART_REGS)
+        && (config->entry[i].keyword == CNF_KEY_FILE)) count++;
+  } /* for */
   return count;
-} /* BDI_BuildRomConfig */
+} /* CNF_GetRegdefCount */
 
 
-int CNF_BuildRomRegdef(const char* szFileName, BYTE* config, BYTE* regdef)
+BOOL CNF_GetRegdefName(const char* szFileName, const CNF_ConfigT* config, int index,
+                       char* regdefName, int size, int* core)
 {
-  size_t  count;
-  BYTE*   pConfig;
-  BYTE*   pRegdef;
-  char*   pLine;
-  char    line[256];
   char    string[256];
-  char    regdefName[256];
-  int     configPart;
-  int     core;
-  FILE*   regdefFile;
-
-  pConfig = config;
-  pRegdef = regdef;
-  configPart = CNF_PART_NONE;
-  do {
-    pConfig = BDI_ExtractLine(sizeof line, line, pConfig);
-    if (line[0] != 0) {
-      pLine = line;
-      pLine = BDI_ExtractString(sizeof string, string, pLine);
-
-      /* process part line */
-      if (string[0] == '[') {
-        if (strcmp(string, "[REGS]") == 0) {
-          configPart = CNF_PART_REGS;
-        } /* else if */
-        else {
-          configPart = CNF_PART_NONE;
-        } /* else */
-      } /* if */
+  int     i;
 
-      /* process config line */
-      else if ((string[0] != 0) && (configPart == CNF_PART_REGS)) {
-        core = 0;
-        pLine = line;
-        if (*pLine == '#') {
-          pLine++;
-          pLine = BDI_ExtractString(sizeof string, string, pLine);
-          core = atoi(string);
-        } /* if */
-        pLine = BDI_ExtractString(sizeof string, string, pLine);
-        if (strcmp(string, "FILE") == 0) {
-          pLine = BDI_ExtractString(sizeof string, string, pLine);
-          if (string[0] == '$') {
-            BuildFileName(regdefName, szFileName, string + 1);
-          } /* if */
-          else {
-            (void)strcpy(regdefName, string);
-          } /* else */
-          regdefFile = fopen(regdefName,"rb");
-          if (regdefFile == NULL) return BDI_ERR_FILE_ACCESS;
-          *pRegdef++ = 0x80 | (core & 0x3f);
-          count = fread(pRegdef, 1, BDI_MAX_REGDEF_SIZE - (pRegdef - regdef), regdefFile);
-          fclose(regdefFile);
-          pRegdef += count;
-        } /* else if */
-      } /* else if */
+  for (i = 0; i < config->count; i++) {
+    if (   (config->entry[i].part != CNF_PART_REGS)
+        || (config->entry[i].keyword != CNF_KEY_FILE)) continue;
+    if (index-- > 0) continue;
+    if (!CNF_GetString(config, &config->entry[i], 0, string, (int)sizeof string)) return FALSE;
+    if (string[0] == '$') {
+      if (strlen(szFileName) + strlen(string) >= (size_t)size) return FALSE;
+      BuildFileName(regdefName, szFileName, string + 1);
+    } /* if */
+    else {
+      if (strlen(string) >= (size_t)size) return FALSE;
+      (void)strcpy(regdefName, string);
+    } /* else */
+    *core = (config->entry[i].core < 0) ? 0 : config->entry[i].core;
+    return TRUE;
+  } /* for */
+  return FALSE;
+} /* CNF_GetRegdefName */
+
+
+int CNF_OpenRomRegdef(const char* szFileName, const CNF_ConfigT* config, CNF_StreamT* stream)
+{
+  CNF_SegmentT* segment;
+  char          regdefName[256];
+  int           core;
+  int           index;
+  long          size;
+  FILE*         regdefFile;
 
+  /* per file the core byte and the file */
+  memset(stream, 0, sizeof *stream);
+  for (index = 0; index < CNF_GetRegdefCount(config); index++) {
+    if (!CNF_GetRegdefName(szFileName, config, index, regdefName, (int)sizeof regdefName, &core)) {
+      return BDI_ERR_FILE_ACCESS;
     } /* if */
-  } while (*pConfig != 0xff);
+    regdefFile = fopen(regdefName, "rb");
+    if (regdefFile == NULL) return BDI_ERR_FILE_ACCESS;
+    size = -1;
+    if (fseek(regdefFile, 0, SEEK_END) == 0) size = ftell(regdefFile);
+    fclose(regdefFile);
+    if (size < 0) return BDI_ERR_FILE_ACCESS;
+    segment = CNF_AddSegment(stream, CNF_SEG_BYTE, 1);
+    if (segment == NULL) return BDI_ERR_FILE_ACCESS;
+    segment->value = (BYTE)(0x80 | (core & 0x3f));
+    if (stream->size + (DWORD)size >= BDI_MAX_REGDEF_SIZE) return BDI_ERR_FILE_ACCESS;
+    segment = CNF_AddSegment(stream, CNF_SEG_FILE, (DWORD)size);
+    if (segment == NULL) return BDI_ERR_FILE_ACCESS;
+    segment->szFileName = (char*)malloc(strlen(regdefName) + 1);
+    if (segment->szFileName == NULL) return BDI_ERR_FILE_ACCESS;
+    (void)strcpy(segment->szFileName, regdefName);
+  } /* for */
 
-  return (int)(pRegdef - regdef);
-} /* BDI_BuildRomRegdef */
+  return (int)stream->size;
+} /* CNF_OpenRomRegdef */
 
 #if 0
 /****************************************************************************
@@ -18,7 +18,8 @@
 |*************************************************************************
 |
 |  DESCRIPTION :
-|  Helper functions to build the BDI configuration structure
+|  Helper functions to build the BDI configuration structure and the
+|  compiler of the configuration file
 |
 |
 |*************************************************************************/
@@ -42,16 +43,174 @@ extern "C" {
 #define BDI_TYPE_30             4      /* BDI3000       */
 #define BDI_TYPE_LAST           4
 
+/* configuration parts */
+#define CNF_PART_NONE           0
+#define CNF_PART_INIT           1
+#define CNF_PART_TARGET         2
+#define CNF_PART_HOST           3
+#define CNF_PART_FLASH          4
+#define CNF_PART_REGS           5
+#define CNF_PART_OTHER          6      /* unknown part, passed unchecked */
+
+/* keywords, CNF_KEY_NONE for lines not known to the compiler */
+#define CNF_KEY_NONE            0
+#define CNF_KEY_PART            1      /* the [PART] line itself */
+#define CNF_KEY_WGPR            2      /* [INIT] */
+#define CNF_KEY_WSPR            3
+#define CNF_KEY_WSR             4
+#define CNF_KEY_WREG            5
+#define CNF_KEY_WM8             6
+#define CNF_KEY_WM16            7
+#define CNF_KEY_WM32            8
+#define CNF_KEY_WM64            9
+#define CNF_KEY_RM8             10
+#define CNF_KEY_RM16            11
+#define CNF_KEY_RM32            12
+#define CNF_KEY_RM64            13
+#define CNF_KEY_DELAY           14
+#define CNF_KEY_SUPM            15
+#define CNF_KEY_WUPM            16
+#define CNF_KEY_TSZ1            17
+#define CNF_KEY_TSZ2            18
+#define CNF_KEY_TSZ4            19
+#define CNF_KEY_TSZ8            20
+#define CNF_KEY_MMAP            21
+#define CNF_KEY_CPUTYPE         22     /* [TARGET] */
+#define CNF_KEY_JTAGCLOCK       23
+#define CNF_KEY_BDIMODE         24
+#define CNF_KEY_STARTUP         25
+#define CNF_KEY_BOOTADDR        26
+#define CNF_KEY_WORKSPACE       27     /* [TARGET] and [FLASH] */
+#define CNF_KEY_BREAKMODE       28
+#define CNF_KEY_STEPMODE        29
+#define CNF_KEY_VECTOR          30
+#define CNF_KEY_DCACHE          31
+#define CNF_KEY_POWERUP         32
+#define CNF_KEY_WAKEUP          33
+#define CNF_KEY_MEMDELAY        34
+#define CNF_KEY_L2PM            35
+#define CNF_KEY_MMU             36
+#define CNF_KEY_PTBASE          37
+#define CNF_KEY_PARITY          38
+#define CNF_KEY_REGLIST         39
+#define CNF_KEY_VIO             40
+#define CNF_KEY_SIO             41
+#define CNF_KEY_SCANPRED        42
+#define CNF_KEY_SCANSUCC        43
+#define CNF_KEY_IP              44     /* [HOST] */
+#define CNF_KEY_FILE            45     /* [HOST], [FLASH] and [REGS] */
+#define CNF_KEY_FORMAT          46     /* [HOST] and [FLASH] */
+#define CNF_KEY_LOAD            47
+#define CNF_KEY_START           48
+#define CNF_KEY_DEBUGPORT       49
+#define CNF_KEY_PROMPT          50
+#define CNF_KEY_DUMP            51
+#define CNF_KEY_TELNET          52
+#define CNF_KEY_CHIPTYPE        53     /* [FLASH] */
+#define CNF_KEY_CHIPSIZE        54
+#define CNF_KEY_BUSWIDTH        55
+#define CNF_KEY_ERASE           56
+#define CNF_KEY_DMM1            57     /* [REGS] */
+#define CNF_KEY_DMM2            58
+#define CNF_KEY_DMM3            59
+#define CNF_KEY_DMM4            60
+
+#define CNF_MAX_ARGS            16     /* arguments of one line */
+
+/* flash images, produced in blocks of the loader */
+#define CNF_BLOCK_SIZE          1024
+#define CNF_IMAGE_SIZE(size)    (((size) / CNF_BLOCK_SIZE + 1) * CNF_BLOCK_SIZE)  /* with its 0xFF */
+
+/* parts of a flash image */
+#define CNF_SEG_DATA            0      /* bytes in memory */
+#define CNF_SEG_BYTE            1      /* one byte */
+#define CNF_SEG_FILE            2      /* a file, read while produced */
+#define CNF_SEG_LINES           3      /* the entries of a configuration, one line each */
+
 /*************************************************************************
 |  TYPEDEFS
 |*************************************************************************/
 
+/* an argument, position within the text of its line */
+typedef struct {
+  int           pos;
+  int           len;
+} CNF_ArgT;
+
+/* a compiled line, the text holds the tokens separated by one space */
+typedef struct {
+  int           line;           /* line number in the configuration file */
+  int           part;           /* CNF_PART_xxx */
+  int           keyword;        /* CNF_KEY_xxx */
+  int           core;           /* core of a #n prefix, -1 if none */
+  int           text;           /* offset of the line text */
+  int           argCount;
+  CNF_ArgT      arg[CNF_MAX_ARGS];
+} CNF_EntryT;
+
+/* a compiled configuration file */
+typedef struct {
+  BYTE*         source;         /* the file as read */
+  int           sourceSize;
+  char*         text;           /* the line texts, zero terminated */
+  int           textSize;
+  CNF_EntryT*   entry;
+  int           count;
+  int           alloc;
+  int           errorLine;      /* line of the first error */
+  char          szError[80];
+} CNF_ConfigT;
+
+typedef struct {
+  int           kind;           /* CNF_SEG_xxx */
+  const BYTE*   data;
+  char*         szFileName;
+  DWORD         size;
+  BYTE          value;
+} CNF_SegmentT;
+
+/* a flash image produced block by block, the rest of the last block is 0xFF */
+typedef struct {
+  const CNF_ConfigT* config;    /* the entries of CNF_SEG_LINES */
+  CNF_SegmentT* segment;
+  int           count;
+  DWORD         size;           /* bytes of the image */
+  DWORD         pos;            /* bytes produced */
+  int           seg;            /* the segment at pos */
+  DWORD         offset;         /* position within it */
+  FILE*         file;           /* the open CNF_SEG_FILE */
+  int           entry;          /* the entry at offset of CNF_SEG_LINES */
+  int           entryPos;
+} CNF_StreamT;
+
 /*************************************************************************
 |  FUNCTIONS
 |*************************************************************************/
 
-int CNF_BuildRomConfig(const char* szFileName, BYTE* data);
-int CNF_BuildRomRegdef(const char* szFileName, BYTE* config, BYTE* regdef);
+int   CNF_Compile(const char* szFileName, CNF_ConfigT* config);
+int   CNF_CompileText(const BYTE* data, int size, CNF_ConfigT* config);
+void  CNF_Free(CNF_ConfigT* config);
+
+const char* CNF_GetText(const CNF_ConfigT* config, const CNF_EntryT* entry);
+BOOL  CNF_GetNumber(const CNF_ConfigT* config, const CNF_EntryT* entry, int index,
+                    unsigned long long* value);
+BOOL  CNF_GetString(const CNF_ConfigT* config, const CNF_EntryT* entry, int index,
+                    char* string, int size);
+
+/* the flash images, the open functions return the image size
+   strip: without comments, blank lines and redundant white space */
+int   CNF_OpenRomConfig(const CNF_ConfigT* config, BOOL strip, CNF_StreamT* stream);
+int   CNF_OpenRomRegdef(const char* szFileName, const CNF_ConfigT* config, CNF_StreamT* stream);
+int   CNF_OpenData(const BYTE* data, int size, CNF_StreamT* stream);
+int   CNF_ReadBlock(CNF_StreamT* stream, BYTE* block);
+int   CNF_ReadImage(CNF_StreamT* stream, BYTE* data);
+void  CNF_Rewind(CNF_StreamT* stream);
+void  CNF_Close(CNF_StreamT* stream);
+
+/* the register definition files, the dependencies of a configuration */
+int   CNF_GetRegdefCount(const CNF_ConfigT* config);
+BOOL  CNF_GetRegdefName(const char* szFileName, const CNF_ConfigT* config, int index,
+                        char* regdefName, int size, int* core);
 
 #ifdef __cplusplus
 }
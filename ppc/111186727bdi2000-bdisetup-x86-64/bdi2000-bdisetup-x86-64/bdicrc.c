@@ -0,0 +1,267 @@
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdicrc.c
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX / UNIX
+|  TARGET HW   : PC
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  CRC-16 calculation (polynomial x^16 + x^15 + x^2 + 1, reflected 0xA001,
+|  no final xor) used to checksum BDI flash contents and firmware images.
+|
+|  Two implementations produce identical results:
+|  - slice-by-8, eight 256 entry tables built on first use
+|  - carry-less multiply folding (PCLMULQDQ), selected at runtime if the
+|    CPU supports it. The folding reduces the data to 16 bytes which are
+|    then processed by the table implementation.
+|
+|*************************************************************************/
+
+/*************************************************************************
+|  INCLUDES
+|*************************************************************************/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "bdidll.h"
+#include "bdicrc.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(CRC_NO_PCLMUL)
+#define CRC_HAS_PCLMUL  1
+#include <immintrin.h>
+#endif
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define CRC_POLY            0x18005UL   /* x^16 + x^15 + x^2 + 1 */
+#define CRC_POLY_REFLECTED  0xA001
+
+#define CRC_FOLD_MIN        256         /* minimal count for folding  */
+
+/*************************************************************************
+|  LOCALS
+|*************************************************************************/
+
+static BOOL     crcInitDone = FALSE;
+static WORD     crcTable[8][256];
+
+#if defined(CRC_HAS_PCLMUL)
+static BOOL     crcFoldOkay = FALSE;
+static unsigned long long crcK128[2];  /* fold by 128 bit: x^191, x^127 */
+static unsigned long long crcK512[2];  /* fold by 512 bit: x^575, x^511 */
+#endif
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CRC_Table :
+
+    Slice-by-8 CRC over a data block.
+
+ ****************************************************************************/
+
+static WORD CRC_Table(WORD crc, const BYTE* data, DWORD count)
+{
+  BYTE  b0;
+  BYTE  b1;
+
+  while (count >= 8) {
+    b0  = (BYTE)(crc ^ data[0]);
+    b1  = (BYTE)((crc >> 8) ^ data[1]);
+    crc = (WORD)(  crcTable[7][b0]      ^ crcTable[6][b1]
+                 ^ crcTable[5][data[2]] ^ crcTable[4][data[3]]
+                 ^ crcTable[3][data[4]] ^ crcTable[2][data[5]]
+                 ^ crcTable[1][data[6]] ^ crcTable[0][data[7]]);
+    data  += 8;
+    count -= 8;
+  } /* while */
+
+  while (count--) {
+    crc = (WORD)((crc >> 8) ^ crcTable[0][(crc ^ *data++) & 0xFF]);
+  } /* while */
+  return crc;
+} /* CRC_Table */
+
+
+#if defined(CRC_HAS_PCLMUL)
+
+/****************************************************************************
+ ****************************************************************************
+
+    CRC_Fold :
+
+    Folding CRC over a data block with carry-less multiplication.
+    In the reflected domain bit 0 of the first byte is the highest power.
+    A 128 bit chunk H = Hh * x^64 + Hl is moved n bits ahead by
+    Hh * (x^(n+63) mod P) + Hl * (x^(n-1) mod P), the missing factor x
+    is added by the reflected multiplication itself.
+    The count must be at least 64 bytes.
+
+ ****************************************************************************/
+
+__attribute__((target("pclmul,sse2")))
+static WORD CRC_Fold(WORD crc, const BYTE* data, DWORD count)
+{
+  __m128i   k128;
+  __m128i   k512;
+  __m128i   acc[4];
+  __m128i   t;
+  BYTE      rest[16];
+  int       i;
+
+  k128 = _mm_loadu_si128((const __m128i*)crcK128);
+  k512 = _mm_loadu_si128((const __m128i*)crcK512);
+
+  /* the initial CRC is the same as xor into the first two bytes */
+  for (i = 0; i < 4; i++) {
+    acc[i] = _mm_loadu_si128((const __m128i*)(data + 16 * i));
+  } /* for */
+  acc[0] = _mm_xor_si128(acc[0], _mm_cvtsi32_si128(crc));
+  data  += 64;
+  count -= 64;
+
+  /* fold four chunks in parallel */
+  while (count >= 64) {
+    for (i = 0; i < 4; i++) {
+      t      = _mm_clmulepi64_si128(acc[i], k512, 0x00);
+      acc[i] = _mm_clmulepi64_si128(acc[i], k512, 0x11);
+      acc[i] = _mm_xor_si128(acc[i], t);
+      acc[i] = _mm_xor_si128(acc[i], _mm_loadu_si128((const __m128i*)(data + 16 * i)));
+    } /* for */
+    data  += 64;
+    count -= 64;
+  } /* while */
+
+  /* fold the four chunks into one */
+  for (i = 1; i < 4; i++) {
+    t      = _mm_clmulepi64_si128(acc[0], k128, 0x00);
+    acc[0] = _mm_clmulepi64_si128(acc[0], k128, 0x11);
+    acc[0] = _mm_xor_si128(acc[0], t);
+    acc[0] = _mm_xor_si128(acc[0], acc[i]);
+  } /* for */
+
+  /* fold remaining chunks */
+  while (count >= 16) {
+    t      = _mm_clmulepi64_si128(acc[0], k128, 0x00);
+    acc[0] = _mm_clmulepi64_si128(acc[0], k128, 0x11);
+    acc[0] = _mm_xor_si128(acc[0], t);
+    acc[0] = _mm_xor_si128(acc[0], _mm_loadu_si128((const __m128i*)data));
+    data  += 16;
+    count -= 16;
+  } /* while */
+
+  /* the folded chunk is congruent to the data processed so far */
+  _mm_storeu_si128((__m128i*)rest, acc[0]);
+  crc = CRC_Table(0, rest, sizeof rest);
+  return CRC_Table(crc, data, count);
+} /* CRC_Fold */
+
+
+/* x^n mod P as reflected 64 bit multiplier (x^0 in bit 63) */
+static unsigned long long CRC_FoldConstant(int n)
+{
+  unsigned long r;
+  unsigned long long k;
+  int   i;
+
+  r = 1;
+  for (i = 0; i < n; i++) {
+    r <<= 1;
+    if (r & 0x10000UL) r ^= CRC_POLY;
+  } /* for */
+  k = 0;
+  for (i = 0; i < 16; i++) {
+    if (r & (1UL << i)) k |= 1ULL << (63 - i);
+  } /* for */
+  return k;
+} /* CRC_FoldConstant */
+
+#endif /* CRC_HAS_PCLMUL */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CRC_Init :
+
+    Builds the slice-by-8 tables. If the CPU supports carry-less multiply,
+    the folding constants are set up and the folding is checked against
+    the table implementation before it is enabled.
+
+ ****************************************************************************/
+
+static void CRC_Init(void)
+{
+  WORD  crc;
+  int   i;
+  int   j;
+#if defined(CRC_HAS_PCLMUL)
+  BYTE  test[3 * CRC_FOLD_MIN];
+#endif
+
+  for (i = 0; i < 256; i++) {
+    crc = (WORD)i;
+    for (j = 0; j < 8; j++) {
+      if (crc & 1) crc = (WORD)((crc >> 1) ^ CRC_POLY_REFLECTED);
+      else         crc = (WORD)(crc >> 1);
+    } /* for */
+    crcTable[0][i] = crc;
+  } /* for */
+  for (j = 1; j < 8; j++) {
+    for (i = 0; i < 256; i++) {
+      crc = crcTable[j - 1][i];
+      crcTable[j][i] = (WORD)((crc >> 8) ^ crcTable[0][crc & 0xFF]);
+    } /* for */
+  } /* for */
+
+#if defined(CRC_HAS_PCLMUL)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse2")) {
+    crcK128[0] = CRC_FoldConstant(128 + 63);
+    crcK128[1] = CRC_FoldConstant(128 - 1);
+    crcK512[0] = CRC_FoldConstant(512 + 63);
+    crcK512[1] = CRC_FoldConstant(512 - 1);
+    for (i = 0; i < (int)sizeof test; i++) test[i] = (BYTE)(i * 167 + 13);
+    crcFoldOkay = (   (CRC_Fold(0x1234, test, sizeof test)     == CRC_Table(0x1234, test, sizeof test))
+                   && (CRC_Fold(0, test + 1, sizeof test - 7)  == CRC_Table(0, test + 1, sizeof test - 7)));
+  } /* if */
+#endif
+
+  crcInitDone = TRUE;
+} /* CRC_Init */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    CRC_Accumulate :
+
+    Accumulates the CRC over a data block. Start with crc = 0 and pass the
+    result of the previous call to process data as it arrives.
+
+     INPUT  : crc       the CRC of the preceding data
+              data      the data
+              count     number of data bytes
+     OUTPUT : RETURN    the CRC including data
+
+ ****************************************************************************/
+
+WORD CRC_Accumulate(WORD crc, const BYTE* data, DWORD count)
+{
+  if (!crcInitDone) CRC_Init();
+#if defined(CRC_HAS_PCLMUL)
+  if (crcFoldOkay && (count >= CRC_FOLD_MIN)) return CRC_Fold(crc, data, count);
+#endif
+  return CRC_Table(crc, data, count);
+} /* CRC_Accumulate */
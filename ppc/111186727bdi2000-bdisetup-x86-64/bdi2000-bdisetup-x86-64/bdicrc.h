@@ -0,0 +1,41 @@
+#ifndef __BDICRC_H__
+#define __BDICRC_H__
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdicrc.h
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX
+|  TARGET HW   : PC
+|
+|  PROGRAMMER  : Abatron / RD
+|  CREATION    : 19.10.26
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  CRC-16 (polynomial 0xA001 reflected) as used by the BDI loader
+|
+|
+|*************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*************************************************************************
+|  FUNCTIONS
+|*************************************************************************/
+
+/* The CRC can be accumulated over any number of consecutive calls */
+WORD CRC_Accumulate(WORD crc, const BYTE* data, DWORD count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
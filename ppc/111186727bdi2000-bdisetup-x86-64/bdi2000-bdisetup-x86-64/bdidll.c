@@ -58,6 +58,9 @@
 
 #define NET_TRANSFER_TIMEOUT            100
 
+#define TRANSACTION_SEND_COUNT          5   /* sends of a command until answered */
+#define PROBE_SEND_COUNT                2   /* sends of a command the BDI may not know */
+
 /* Frame control */
 #define FRAME_COUNT_FIELD               (3<<6)
 #define FRAME_LENGTH_MASK               7
@@ -88,8 +91,18 @@ typedef struct {BOOL    connected;
                 BYTE    frameType;
                 BYTE    frameCount;
                 DWORD   repeatCount;
+                int     pipeDepth;      /* frames in flight, 1 = stop and wait */
                } BDI_ChannelT;
 
+/* a frame in flight */
+typedef struct {BYTE    frame[BDI_MAX_FRAME_SIZE];
+                int     frameLength;
+                DWORD   commandTime;
+                int     sendCount;
+                int     rxCount;        /* answer length, 0 if no answer yet  */
+                BYTE    answer[BDI_MAX_FRAME_SIZE];
+               } BDI_PipeSlotT;
+
 
 /*************************************************************************
 |  LOCALS
@@ -102,6 +115,11 @@ static  BDI_ChannelT    channelInfo;
 static  BYTE            txFrame[BDI_MAX_FRAME_SIZE];
 static  BYTE            rxFrame[BDI_MAX_FRAME_SIZE];
 
+/* frames in flight, oldest first */
+static  BDI_PipeSlotT   pipeSlot[BDI_PIPE_DEPTH];
+static  int             pipeFirst;
+static  int             pipeCount;
+
 
 /****************************************************************************
  ****************************************************************************
@@ -842,6 +860,9 @@ int BDI_Open(const char* port, DWORD baudrate)
   channelInfo.frameCount    = 0;
   channelInfo.repeatCount   = 0;
   channelInfo.frameType     = FRAME_STD_TYPE;
+  channelInfo.pipeDepth     = channelInfo.asynConnection ? 1 : BDI_PIPE_DEPTH;
+  pipeFirst                 = 0;
+  pipeCount                 = 0;
   return BDI_OKAY;
 } /* BDI_Open */
 
@@ -871,9 +892,10 @@ void BDI_Close(void)
 /****************************************************************************
  ****************************************************************************
 
-    BDI_Transaction:
+    BDI_DoTransaction / BDI_Transaction:
 
      Executes a command / answer transaction with the BDI
+     BDI_Transaction sends the command up to TRANSACTION_SEND_COUNT times.
      commandTime: The time the command needs to execute, not the transfer time.
                   The time is used to calculate the timeout before the command
                   is repeated.
@@ -882,17 +904,20 @@ void BDI_Close(void)
               commandData   the command <code,parameter>
               answerSize    the size of the answer buffer
               commandTime   the time in ms the command needs to execute
+              maxSend       how many times the command is sent at most
+                            (BDI_DoTransaction only)
      OUTPUT : answerData    the answer <code,parameter>
               RETURN        the length of the answer block
                             or a negativ number if error.
 
  ****************************************************************************/
 
-int  BDI_Transaction(      int       commandLength,
-                     const void     *commandData,
-                           int       answerSize,
-                           void     *answerData,
-                           DWORD     commandTime)
+static int BDI_DoTransaction(      int       commandLength,
+                             const void     *commandData,
+                                   int       answerSize,
+                                   void     *answerData,
+                                   DWORD     commandTime,
+                                   int       maxSend)
 {
         BYTE*   framePtr;
   const BYTE*   commandPtr;
@@ -911,6 +936,7 @@ int  BDI_Transaction(      int       commandLength,
   if (!channelInfo.connected)                    result = BDI_ERR_NOT_CONNECTED;
   else if (channelInfo.lastError != BDI_OKAY)    result = channelInfo.lastError;
   else if (commandLength > (sizeof txFrame - 2)) result = BDI_ERR_INVALID_PARAMETER;
+  else if (pipeCount != 0)                       result = BDI_ERR_INVALID_PARAMETER;
   if (result != BDI_OKAY) {
 	return result;
   } /* if */
@@ -993,7 +1019,7 @@ int  BDI_Transaction(      int       commandLength,
       } /* if */
 
     } /* if */
-  } while ((rxCount == 0) && (sendCount < 5));
+  } while ((rxCount == 0) && (sendCount < maxSend));
 
   if (rxCount > answerSize) {
     return BDI_ERR_ANSWER_TOO_BIG;
@@ -1005,6 +1031,340 @@ int  BDI_Transaction(      int       commandLength,
     if (channelInfo.frameType == FRAME_STD_TYPE) channelInfo.lastError = BDI_ERR_NO_RESPONSE;
     return BDI_ERR_NO_RESPONSE;
   } /* else */
+} /* BDI_DoTransaction */
+
+
+int  BDI_Transaction(      int       commandLength,
+                     const void     *commandData,
+                           int       answerSize,
+                           void     *answerData,
+                           DWORD     commandTime)
+{
+  return BDI_DoTransaction(commandLength, commandData, answerSize, answerData, commandTime,
+                           TRANSACTION_SEND_COUNT);
 } /* BDI_Transaction */
 
 
+/****************************************************************************
+ ****************************************************************************
+
+    BDI_Probe:
+
+     Executes a transaction with a command the BDI may not know.
+     A loader or firmware ignores unknown commands, so the command is sent
+     only PROBE_SEND_COUNT times and the missing answer is returned as
+     BDI_ERR_NO_RESPONSE. Unlike BDI_Transaction the error is not stored,
+     so the caller can fall back to other commands.
+
+     INPUT  : commandLength the length of the command block
+              commandData   the command <code,parameter>
+              answerSize    the size of the answer buffer
+              commandTime   the time in ms the command needs to execute
+     OUTPUT : answerData    the answer <code,parameter>
+              RETURN        the length of the answer block
+                            or a negativ number if error.
+
+ ****************************************************************************/
+
+int  BDI_Probe(      int       commandLength,
+               const void     *commandData,
+                     int       answerSize,
+                     void     *answerData,
+                     DWORD     commandTime)
+{
+  int     result;
+
+  if (channelInfo.connected && (channelInfo.lastError != BDI_OKAY)) {
+    return channelInfo.lastError;
+  } /* if */
+  result = BDI_DoTransaction(commandLength, commandData, answerSize, answerData, commandTime,
+                             PROBE_SEND_COUNT);
+  if (result == BDI_ERR_NO_RESPONSE) channelInfo.lastError = BDI_OKAY;
+  return result;
+} /* BDI_Probe */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    BDI_PipeSend / BDI_PipeReceive:
+
+     Pipelined transactions: up to BDI_PipeDepth() commands are sent before
+     their answers are received. The BDI executes the commands in the order
+     they arrive, BDI_PipeReceive returns the answers in the same order.
+     BDI_PipeDepth() is BDI_PIPE_DEPTH on a network link and 1 on a serial
+     link, where the pipe is stop and wait like BDI_Transaction.
+     A command is only repeated if its own answer is missing or has a wrong
+     length, so the commands in flight must not depend on each other.
+     If a command is repeated while several are in flight, the link falls
+     back to stop and wait until it is reopened.
+     BDI_Transaction must not be used while commands are in flight.
+
+     INPUT  : commandLength the length of the command block
+              commandData   the command <code,parameter>
+              commandTime   the time in ms the command needs to execute
+              answerSize    the size of the answer buffer
+     OUTPUT : answerData    the answer <code,parameter> of the oldest command
+              RETURN        error code / the length of the answer block
+                            or a negativ number if error.
+
+ ****************************************************************************/
+
+int BDI_PipeDepth(void)
+{
+  return channelInfo.pipeDepth;
+} /* BDI_PipeDepth */
+
+
+static int BDI_PipeSendSlot(BDI_PipeSlotT* slot)
+{
+  slot->sendCount++;
+  if (channelInfo.asynConnection) {
+    return AsynSendFrame(&channelInfo, slot->frameLength, slot->frame);
+  } /* if */
+  else {
+    return NetSendFrame(&channelInfo, slot->frameLength, slot->frame);
+  } /* else */
+} /* BDI_PipeSendSlot */
+
+
+int BDI_PipeSend(int commandLength, const void* commandData, DWORD commandTime)
+{
+  BDI_PipeSlotT*  slot;
+  int             result;
+
+  /* check if everthing is okay */
+  result = BDI_OKAY;
+  if (!channelInfo.connected)                           result = BDI_ERR_NOT_CONNECTED;
+  else if (channelInfo.lastError != BDI_OKAY)           result = channelInfo.lastError;
+  else if (commandLength > (int)sizeof slot->frame - 2) result = BDI_ERR_INVALID_PARAMETER;
+  else if (pipeCount >= channelInfo.pipeDepth)          result = BDI_ERR_INVALID_PARAMETER;
+  if (result != BDI_OKAY) return result;
+
+  /* build frame */
+  slot = &pipeSlot[(pipeFirst + pipeCount) % BDI_PIPE_DEPTH];
+  slot->frame[0]    = (BYTE)(channelInfo.frameType | (commandLength>>8) | (channelInfo.frameCount<<6));
+  slot->frame[1]    = (BYTE)commandLength;
+  slot->frameLength = commandLength + 2;
+  slot->commandTime = commandTime;
+  slot->sendCount   = 0;
+  slot->rxCount     = 0;
+  memcpy(slot->frame + 2, commandData, commandLength);
+  channelInfo.frameCount++;
+  pipeCount++;
+
+  return BDI_PipeSendSlot(slot);
+} /* BDI_PipeSend */
+
+
+int BDI_PipeReceive(int answerSize, void* answerData)
+{
+  BDI_PipeSlotT*  slot;
+  BDI_PipeSlotT*  other;
+  int             rxFrameLength;
+  int             rxCount;
+  int             result;
+  int             i;
+  DWORD           answerTimeout;
+
+  if (pipeCount == 0) return BDI_ERR_INVALID_PARAMETER;
+  slot   = &pipeSlot[pipeFirst];
+  result = BDI_OKAY;
+  while ((slot->rxCount == 0) && (result == BDI_OKAY)) {
+
+    /* wait for any answer */
+    if (channelInfo.asynConnection) {
+      answerTimeout = (DWORD)(slot->frameLength + 1500);  /* total number of characters */
+      answerTimeout = answerTimeout * 10000L / channelInfo.asynBaudrate + slot->commandTime + 200L;
+      rxFrameLength = AsynWaitFrame(&channelInfo, sizeof rxFrame, rxFrame, answerTimeout);
+    } /* if */
+    else {
+      answerTimeout = NET_TRANSFER_TIMEOUT + slot->commandTime;
+      rxFrameLength = NetWaitFrame(&channelInfo, sizeof rxFrame, rxFrame, answerTimeout);
+    } /* else */
+
+    /* assign the answer to its command, repeat the command if the length is wrong */
+    if ((rxFrameLength > 2) && ((rxFrame[0] & FRAME_TYPE_MASK) == channelInfo.frameType)) {
+      rxCount = 256 * (rxFrame[0] & FRAME_LENGTH_MASK) + rxFrame[1];
+      for (i = 0; i < pipeCount; i++) {
+        other = &pipeSlot[(pipeFirst + i) % BDI_PIPE_DEPTH];
+        if (    (other->rxCount == 0)
+             && ((other->frame[0] & FRAME_COUNT_FIELD) == (rxFrame[0] & FRAME_COUNT_FIELD))
+           ) {
+          if (rxFrameLength - 2 == rxCount) {
+            memcpy(other->answer, rxFrame + 2, rxCount);
+            other->rxCount = rxCount;
+          } /* if */
+          else if (other->sendCount < 5) {
+            channelInfo.repeatCount++;
+            if (pipeCount > 1) channelInfo.pipeDepth = 1;
+            result = BDI_PipeSendSlot(other);
+          } /* else if */
+          break;
+        } /* if */
+      } /* for */
+    } /* if */
+
+    /* discard other frames, repeat the oldest command if lost */
+    else if (    (rxFrameLength <= 0)
+              || ((rxFrameLength == 3) && (rxFrame[0] == FRAME_ATT_TYPE) && (rxFrame[1] == 1))
+            ) {
+      if (slot->sendCount >= 5) break;
+      channelInfo.repeatCount++;
+      if (pipeCount > 1) channelInfo.pipeDepth = 1;
+      slot->commandTime += 500;  /* increase timeout */
+      result = BDI_PipeSendSlot(slot);
+    } /* else if */
+  } /* while */
+
+  /* the oldest command is done */
+  rxCount   = slot->rxCount;
+  pipeFirst = (pipeFirst + 1) % BDI_PIPE_DEPTH;
+  pipeCount--;
+  if (result != BDI_OKAY) {
+    return result;
+  } /* if */
+  else if (rxCount > answerSize) {
+    return BDI_ERR_ANSWER_TOO_BIG;
+  } /* else if */
+  else if (rxCount > 0) {
+    memcpy(answerData, slot->answer, rxCount);
+    return rxCount;
+  } /* else if */
+  else {
+    pipeCount = 0;
+    channelInfo.lastError = BDI_ERR_NO_RESPONSE;
+    return BDI_ERR_NO_RESPONSE;
+  } /* else */
+} /* BDI_PipeReceive */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    BDI_StreamSend:
+
+     Sends a command the BDI does not answer, e.g. a block of a fast load.
+     A lost frame is not repeated, the sender checks the result of the
+     stream with a following transaction. No commands may be in flight.
+
+     INPUT  : commandLength the length of the command block
+              commandData   the command <code,parameter>
+     OUTPUT : RETURN        error code
+
+ ****************************************************************************/
+
+int BDI_StreamSend(int commandLength, const void* commandData)
+{
+  int     result;
+
+  /* check if everthing is okay */
+  result = BDI_OKAY;
+  if (!channelInfo.connected)                           result = BDI_ERR_NOT_CONNECTED;
+  else if (channelInfo.lastError != BDI_OKAY)           result = channelInfo.lastError;
+  else if (commandLength > (int)sizeof txFrame - 2)     result = BDI_ERR_INVALID_PARAMETER;
+  else if (pipeCount != 0)                              result = BDI_ERR_INVALID_PARAMETER;
+  if (result != BDI_OKAY) return result;
+
+  /* build and send frame */
+  txFrame[0] = (BYTE)(channelInfo.frameType | (commandLength>>8) | (channelInfo.frameCount<<6));
+  txFrame[1] = (BYTE)commandLength;
+  memcpy(txFrame + 2, commandData, commandLength);
+  channelInfo.frameCount++;
+  if (channelInfo.asynConnection) {
+    return AsynSendFrame(&channelInfo, commandLength + 2, txFrame);
+  } /* if */
+  else {
+    return NetSendFrame(&channelInfo, commandLength + 2, txFrame);
+  } /* else */
+} /* BDI_StreamSend */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    BDI_WireSize:
+
+     Calculates the number of bytes a frame occupies on the current link.
+     Serial: the DLE stuffed frame including start/end sequence and BCC.
+     Network: the UDP datagram within an Ethernet frame.
+
+     INPUT  : frameCount    the frame sequence number (0..3)
+              length        the length of the command/answer block
+              data          the command/answer <code,parameter>
+     OUTPUT : RETURN        the number of bytes on the wire
+
+ ****************************************************************************/
+
+#define NET_FRAME_OVERHEAD      (14 + 20 + 8 + 4)   /* Ethernet, IP, UDP, FCS */
+#define NET_FRAME_MINIMUM       64
+
+int  BDI_WireSize(int frameCount, int length, const void* data)
+{
+  const BYTE*   dataPtr;
+  BYTE          header[2];
+  BYTE          bcc;
+  int           size;
+  int           i;
+
+  if (!channelInfo.asynConnection) {
+    size = 2 + length + NET_FRAME_OVERHEAD;
+    return (size < NET_FRAME_MINIMUM) ? NET_FRAME_MINIMUM : size;
+  } /* if */
+
+  /* start and end sequence, header and data doubled where DLE */
+  header[0] = (BYTE)(FRAME_STD_TYPE | (length >> 8) | ((frameCount & 3) << 6));
+  header[1] = (BYTE)length;
+  size = 2 + 2 + 1;
+  bcc  = 0;
+  for (i = 0; i < 2; i++) {
+    bcc  ^= header[i];
+    size += (header[i] == DLE) ? 2 : 1;
+  } /* for */
+  dataPtr = (const BYTE*)data;
+  for (i = 0; i < length; i++) {
+    bcc  ^= dataPtr[i];
+    size += (dataPtr[i] == DLE) ? 2 : 1;
+  } /* for */
+  if (bcc == DLE) size++;
+  return size;
+} /* BDI_WireSize */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    BDI_GetLink:
+
+     Returns the type of the current link.
+
+     INPUT  : -
+     OUTPUT : baudrate      the baudrate of a serial link
+              RETURN        TRUE if a serial link, FALSE if network
+
+ ****************************************************************************/
+
+BOOL BDI_GetLink(DWORD* baudrate)
+{
+  *baudrate = channelInfo.asynBaudrate;
+  return channelInfo.asynConnection;
+} /* BDI_GetLink */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    BDI_GetMicroseconds:
+
+     Returns a free running time in microseconds, used to measure the
+     link round trip time.
+
+ ****************************************************************************/
+
+DWORD BDI_GetMicroseconds(void)
+{
+  struct timeval  now;
+
+  gettimeofday(&now, NULL);
+  return (DWORD)now.tv_sec * 1000000UL + (DWORD)now.tv_usec;
+} /* BDI_GetMicroseconds */
@@ -47,6 +47,8 @@ extern "C" {
 
 #define INADDR_NONE             0xffffffff
 
+#define BDI_PIPE_DEPTH          3   /* frames in flight, limited by the frame count */
+
 /*************************************************************************
 |  TYPEDEFS
 |*************************************************************************/
@@ -77,6 +79,20 @@ int  BDI_Transaction(      int       commandLength,
                            int       answerSize,
                            void     *answerData,
                            DWORD     commandTime);
+int  BDI_Probe(      int       commandLength,
+               const void     *commandData,
+                     int       answerSize,
+                     void     *answerData,
+                     DWORD     commandTime);
+
+int   BDI_PipeDepth(void);
+int   BDI_PipeSend(int commandLength, const void* commandData, DWORD commandTime);
+int   BDI_PipeReceive(int answerSize, void* answerData);
+int   BDI_StreamSend(int commandLength, const void* commandData);
+
+int   BDI_WireSize(int frameCount, int length, const void* data);
+BOOL  BDI_GetLink(DWORD* baudrate);
+DWORD BDI_GetMicroseconds(void);
 
 
 #ifdef __cplusplus
@@ -0,0 +1,435 @@
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdidump.c
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX / UNIX
+|  TARGET HW   : PC
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  This module dumps a range of target memory into a file. The blocks are
+|  read with DUMP_SINGLE_BLOCK, or GET_BLOCK if the firmware does not
+|  know it, with up to BDI_PipeDepth() commands in flight. They are
+|  received into one of two page aligned buffers of DMP_BUFFER_SIZE. A
+|  full buffer is written while the first commands for the other buffer
+|  are in flight, so the disk write overlaps the link.
+|
+|  A binary file is written with O_DIRECT where the file system allows
+|  it, pages of all 0x00 are not written and remain holes of a sparse
+|  file. A S-Record file omits the pages of all 0x00 and all 0xFF.
+|
+|  Commands and answers (link format, Motorola byte order):
+|    DUMP_SINGLE_BLOCK   addr count            SEND_BLOCK data
+|    GET_BLOCK           addr count            SEND_BLOCK data
+|
+|*************************************************************************/
+
+/*************************************************************************
+|  INCLUDES
+|*************************************************************************/
+
+#if defined(__GLIBC__) || defined(__linux__)
+#define _GNU_SOURCE     /* O_DIRECT */
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "bdierror.h"
+#include "bdicmd.h"
+#include "bdidll.h"
+#include "bdidump.h"
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define DMP_RECORD_SIZE     32      /* data bytes of a S3 record */
+
+/*************************************************************************
+|  TYPEDEFS
+|*************************************************************************/
+
+/* the output file */
+typedef struct {
+  int           format;         /* DMP_FORMAT_xxx */
+  int           fd;             /* binary */
+  BOOL          direct;         /* written with O_DIRECT */
+  FILE*         file;           /* S-Record */
+  DWORD         addr;           /* target address of the file offset 0 */
+} DMP_SinkT;
+
+/*************************************************************************
+|  LOCALS
+|*************************************************************************/
+
+static BYTE dmpCommand[8];
+static BYTE dmpAnswer[BDI_MAX_FRAME_SIZE];
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    BDI_Append___ :
+
+    Host independent helper function to append a numeric value to a buffer.
+    The bytes will be stored in the link format order (Motorola byte order).
+
+     INPUT  : value     value
+              buffer    pointer to buffer
+     OUTPUT : RETURN    pointer to next byte after the stored value
+
+ ****************************************************************************/
+
+static BYTE* BDI_AppendByte(BYTE  value, BYTE* buffer)
+{
+  *buffer++ = value;
+  return buffer;
+} /* BDI_AppendByte */
+
+static BYTE* BDI_AppendWord(WORD value, BYTE* buffer)
+{
+  *buffer++ = (BYTE)(value>>8);
+  *buffer++ = (BYTE)value;
+  return buffer;
+} /* BDI_AppendWord */
+
+static BYTE* BDI_AppendLong(DWORD value, BYTE* buffer)
+{
+  *buffer++ = (BYTE)(value>>24);
+  *buffer++ = (BYTE)(value>>16);
+  *buffer++ = (BYTE)(value>>8);
+  *buffer++ = (BYTE)value;
+  return buffer;
+} /* BDI_AppendLong */
+
+
+/****************************************************************************
+ ****************************************************************************
+    Helper functions of the output file
+ ****************************************************************************/
+
+static int DMP_OpenSink(const char* szFileName, int format, DWORD addr, DMP_SinkT* sink)
+{
+  (void)memset(sink, 0, sizeof *sink);
+  sink->format = format;
+  sink->addr   = addr;
+  sink->fd     = -1;
+  if (format == DMP_FORMAT_SRECORD) {
+    sink->file = fopen(szFileName, "w");
+    if (sink->file == NULL) return BDI_ERR_FILE_ACCESS;
+    (void)fputs("S0030000FC\n", sink->file);
+    return BDI_OKAY;
+  } /* if */
+
+#if defined(O_DIRECT)
+  /* not every file system supports O_DIRECT */
+  sink->fd     = open(szFileName, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+  sink->direct = (sink->fd >= 0);
+#endif
+  if (sink->fd < 0) sink->fd = open(szFileName, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  return (sink->fd < 0) ? BDI_ERR_FILE_ACCESS : BDI_OKAY;
+} /* DMP_OpenSink */
+
+
+static int DMP_CloseSink(DMP_SinkT* sink, DWORD size)
+{
+  int     result;
+
+  result = BDI_OKAY;
+  if (sink->file != NULL) {
+    (void)fputs("S70500000000FA\n", sink->file);
+    if (ferror(sink->file)) result = BDI_ERR_FILE_ACCESS;
+    if (fclose(sink->file) != 0) result = BDI_ERR_FILE_ACCESS;
+  } /* if */
+  if (sink->fd >= 0) {
+    /* the holes at the end */
+    if (ftruncate(sink->fd, (off_t)size) != 0) result = BDI_ERR_FILE_ACCESS;
+    if (close(sink->fd) != 0) result = BDI_ERR_FILE_ACCESS;
+  } /* if */
+  return result;
+} /* DMP_CloseSink */
+
+
+/* a run of pages of a binary file, the last one may be partial */
+static int DMP_WriteBinary(DMP_SinkT* sink, DWORD offset, const BYTE* data, DWORD count)
+{
+  ssize_t written;
+
+  for (;;) {
+#if defined(O_DIRECT)
+    if (sink->direct && ((count % DMP_PAGE_SIZE) != 0)) {
+      sink->direct = FALSE;
+      (void)fcntl(sink->fd, F_SETFL, fcntl(sink->fd, F_GETFL) & ~O_DIRECT);
+    } /* if */
+#endif
+    written = pwrite(sink->fd, data, (size_t)count, (off_t)offset);
+    if (written == (ssize_t)count) return BDI_OKAY;
+#if defined(O_DIRECT)
+    if ((written < 0) && (errno == EINVAL) && sink->direct) {
+      sink->direct = FALSE;
+      (void)fcntl(sink->fd, F_SETFL, fcntl(sink->fd, F_GETFL) & ~O_DIRECT);
+      continue;
+    } /* if */
+#endif
+    return BDI_ERR_FILE_ACCESS;
+  } /* for */
+} /* DMP_WriteBinary */
+
+
+/* a run of pages as S3 records */
+static int DMP_WriteSRecord(DMP_SinkT* sink, DWORD offset, const BYTE* data, DWORD count)
+{
+  DWORD   addr;
+  DWORD   pos;
+  int     length;
+  int     i;
+  BYTE    checksum;
+
+  for (pos = 0; pos < count; pos += (DWORD)length) {
+    length = DMP_RECORD_SIZE;
+    if (count - pos < (DWORD)length) length = (int)(count - pos);
+    addr = sink->addr + offset + pos;
+    checksum = (BYTE)(length + 5 + (addr >> 24) + (addr >> 16) + (addr >> 8) + addr);
+    fprintf(sink->file, "S3%02X%08lX", length + 5, addr);
+    for (i = 0; i < length; i++) {
+      fprintf(sink->file, "%02X", data[pos + i]);
+      checksum = (BYTE)(checksum + data[pos + i]);
+    } /* for */
+    fprintf(sink->file, "%02X\n", (BYTE)~checksum);
+  } /* for */
+  return ferror(sink->file) ? BDI_ERR_FILE_ACCESS : BDI_OKAY;
+} /* DMP_WriteSRecord */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    DMP_WriteBuffer :
+
+    Writes a buffer, the runs of pages that are not skipped at once.
+
+     INPUT  : sink      the output file
+              offset    file offset of the buffer, a multiple of DMP_PAGE_SIZE
+              data      the buffer
+              count     bytes in the buffer
+     OUTPUT : progress  bytes written and skipped
+              RETURN    error code
+
+ ****************************************************************************/
+
+static BOOL DMP_SkipPage(const DMP_SinkT* sink, const BYTE* data, DWORD count)
+{
+  if ((data[0] != 0x00) && ((data[0] != 0xFF) || (sink->format != DMP_FORMAT_SRECORD))) return FALSE;
+  return (count < 2) || (memcmp(data, data + 1, count - 1) == 0);
+} /* DMP_SkipPage */
+
+
+static int DMP_WriteBuffer(DMP_SinkT* sink, DWORD offset, const BYTE* data, DWORD count,
+                           DMP_ProgressT* progress)
+{
+  DWORD   pos;
+  DWORD   start;
+  DWORD   length;
+  int     result;
+
+  result = BDI_OKAY;
+  start  = 0;
+  for (pos = 0; (pos <= count) && (result == BDI_OKAY); pos += length) {
+    length = DMP_PAGE_SIZE;
+    if (count - pos < length) length = count - pos;
+
+    /* a skipped page or the end finishes the run */
+    if ((pos == count) || DMP_SkipPage(sink, data + pos, length)) {
+      if (pos > start) {
+        if (sink->format == DMP_FORMAT_SRECORD) {
+          result = DMP_WriteSRecord(sink, offset + start, data + start, pos - start);
+        } /* if */
+        else {
+          result = DMP_WriteBinary(sink, offset + start, data + start, pos - start);
+        } /* else */
+        progress->written += pos - start;
+      } /* if */
+      progress->skipped += length;
+      start = pos + length;
+    } /* if */
+    if (pos == count) break;
+  } /* for */
+  return result;
+} /* DMP_WriteBuffer */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    DMP_BuildRead / DMP_SendRead / DMP_CheckAnswer :
+
+    Builds and sends the read command of a block, checks its answer in
+    dmpAnswer.
+
+ ****************************************************************************/
+
+static int DMP_BuildRead(BYTE command, DWORD addr, WORD count)
+{
+  BYTE*   cmdPtr;
+
+  cmdPtr = BDI_AppendByte(command, dmpCommand);
+  cmdPtr = BDI_AppendLong(addr, cmdPtr);
+  cmdPtr = BDI_AppendWord(count, cmdPtr);
+  return cmdPtr-dmpCommand;
+} /* DMP_BuildRead */
+
+
+static int DMP_SendRead(BYTE command, DWORD addr, WORD count)
+{
+  return BDI_PipeSend(DMP_BuildRead(command, addr, count), dmpCommand, DMP_EXEC_TIME);
+} /* DMP_SendRead */
+
+
+static int DMP_CheckAnswer(int rxCount, WORD count)
+{
+  if (rxCount < 0) return rxCount;
+  if ((rxCount == 1) && (dmpAnswer[0] == BDI_ANS_NAK)) return BDI_ERR_MEM_ACCESS;
+  if ((rxCount != count + 1) || (dmpAnswer[0] != BDI_ANS_SEND_BLOCK)) return BDI_ERR_INVALID_RESPONSE;
+  return BDI_OKAY;
+} /* DMP_CheckAnswer */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    DMP_Dump :
+
+    Dumps target memory into a file. The first block tells if the firmware
+    knows DUMP_SINGLE_BLOCK. A full buffer is written after the commands
+    for the other buffer are sent.
+
+     INPUT  : addr          first address
+              size          number of bytes
+              szFileName    the output file
+              format        DMP_FORMAT_xxx
+              progressFunc  called after every written buffer or NULL
+              context       parameter of progressFunc
+     OUTPUT : progress      the final progress
+              RETURN        error code
+
+ ****************************************************************************/
+
+int DMP_Dump(DWORD addr, DWORD size, const char* szFileName, int format,
+             DMP_ProgressFuncT progressFunc, void* context, DMP_ProgressT* progress)
+{
+  BYTE*       memory;
+  BYTE*       buffer[2];
+  BYTE        command;
+  WORD        count;
+  DWORD       sent;
+  DWORD       flushOffset;
+  DWORD       flushCount;
+  DWORD       startTime;
+  int         pending;
+  int         rxCount;
+  int         result;
+  int         closeResult;
+  DMP_SinkT   sink;
+
+  (void)memset(progress, 0, sizeof *progress);
+  progress->addr = addr;
+  progress->size = size;
+  if (BDI_PipeDepth() < 1) return BDI_ERR_NOT_CONNECTED;
+
+  /* two page aligned buffers, O_DIRECT needs them aligned */
+  memory = (BYTE*)malloc(2 * DMP_BUFFER_SIZE + DMP_PAGE_SIZE);
+  if (memory == NULL) return BDI_ERR_FILE_ACCESS;
+  buffer[0] = memory + (DMP_PAGE_SIZE - ((size_t)memory % DMP_PAGE_SIZE)) % DMP_PAGE_SIZE;
+  buffer[1] = buffer[0] + DMP_BUFFER_SIZE;
+  result = DMP_OpenSink(szFileName, format, addr, &sink);
+  if (result != BDI_OKAY) {
+    free(memory);
+    return result;
+  } /* if */
+  startTime = BDI_GetMicroseconds();
+
+  /* the first block, a firmware without DUMP_SINGLE_BLOCK ignores or rejects it */
+  command = BDI_CMD_DUMP_SINGLE_BLOCK;
+  count   = (size < BDI_MAX_BLOCK_SIZE) ? (WORD)size : BDI_MAX_BLOCK_SIZE;
+  progress->dumpBlock = TRUE;
+  if (size > 0) {
+    rxCount = BDI_Probe(DMP_BuildRead(command, addr, count), dmpCommand,
+                        sizeof dmpAnswer, dmpAnswer, DMP_EXEC_TIME);
+    result  = DMP_CheckAnswer(rxCount, count);
+    if ((result == BDI_ERR_INVALID_RESPONSE) || (result == BDI_ERR_NO_RESPONSE)) {
+      command = BDI_CMD_GET_BLOCK;
+      progress->dumpBlock = FALSE;
+      result = DMP_SendRead(command, addr, count);
+      if (result == BDI_OKAY) result = DMP_CheckAnswer(BDI_PipeReceive(sizeof dmpAnswer, dmpAnswer), count);
+    } /* if */
+  } /* if */
+  if ((size > 0) && (result == BDI_OKAY)) {
+    (void)memcpy(buffer[0], dmpAnswer + 1, count);
+    progress->read = count;
+  } /* if */
+
+  /* the rest with the pipe kept full */
+  sent       = progress->read;
+  pending     = 0;
+  flushCount  = 0;
+  flushOffset = 0;
+  for (;;) {
+    while ((result == BDI_OKAY) && (sent < size) && (pending < BDI_PipeDepth())) {
+      count = BDI_MAX_BLOCK_SIZE;
+      if (size - sent < count) count = (WORD)(size - sent);
+      result = DMP_SendRead(command, addr + sent, count);
+      if (result == BDI_OKAY) {
+        sent += count;
+        pending++;
+      } /* if */
+    } /* while */
+
+    /* a full buffer while the commands are in flight */
+    if ((flushCount == 0) && (result == BDI_OKAY)) {
+      if ((progress->read == size) || ((progress->read % DMP_BUFFER_SIZE) == 0)) {
+        flushOffset = progress->written + progress->skipped;
+        flushCount  = progress->read - flushOffset;
+      } /* if */
+      if (flushCount > 0) {
+        result = DMP_WriteBuffer(&sink, flushOffset, buffer[(flushOffset / DMP_BUFFER_SIZE) % 2],
+                                 flushCount, progress);
+        progress->elapsed = (BDI_GetMicroseconds() - startTime) / 1000UL;
+        if ((result == BDI_OKAY) && (progressFunc != NULL)) progressFunc(progress, context);
+        flushCount = 0;
+      } /* if */
+    } /* if */
+    if (pending == 0) break;
+
+    /* the oldest block */
+    rxCount = BDI_PipeReceive(sizeof dmpAnswer, dmpAnswer);
+    pending--;
+    count = BDI_MAX_BLOCK_SIZE;
+    if (size - progress->read < count) count = (WORD)(size - progress->read);
+    if (result == BDI_OKAY) result = DMP_CheckAnswer(rxCount, count);
+    if (result == BDI_OKAY) {
+      (void)memcpy(buffer[(progress->read / DMP_BUFFER_SIZE) % 2] + (progress->read % DMP_BUFFER_SIZE),
+                   dmpAnswer + 1, count);
+      progress->read += count;
+    } /* if */
+  } /* for */
+
+  closeResult = DMP_CloseSink(&sink, size);
+  if (result == BDI_OKAY) result = closeResult;
+  progress->elapsed = (BDI_GetMicroseconds() - startTime) / 1000UL;
+  free(memory);
+  return result;
+} /* DMP_Dump */
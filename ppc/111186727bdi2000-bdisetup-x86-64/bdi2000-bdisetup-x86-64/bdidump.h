@@ -0,0 +1,70 @@
+#ifndef __BDIDUMP_H__
+#define __BDIDUMP_H__
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdidump.h
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX
+|  TARGET HW   : PC
+|
+|  PROGRAMMER  : Abatron / RD
+|  CREATION    : 19.10.26
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  Dump of target memory into a file
+|
+|
+|*************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define DMP_BUFFER_SIZE         0x100000  /* one of the two buffers */
+#define DMP_PAGE_SIZE           0x1000    /* skipped if all 0x00 or all 0xFF */
+#define DMP_EXEC_TIME           1000      /* execution time of a dump command */
+
+/* file formats */
+#define DMP_FORMAT_BINARY       0         /* all 0x00 pages are holes */
+#define DMP_FORMAT_SRECORD      1         /* all 0x00 and 0xFF pages omitted */
+
+/*************************************************************************
+|  TYPEDEFS
+|*************************************************************************/
+
+typedef struct {
+  DWORD         addr;           /* the dumped range */
+  DWORD         size;
+  DWORD         read;           /* bytes read from the target */
+  DWORD         written;        /* bytes written to the file */
+  DWORD         skipped;        /* bytes of skipped pages */
+  DWORD         elapsed;        /* ms since the start */
+  BOOL          dumpBlock;      /* read with DUMP_SINGLE_BLOCK, else GET_BLOCK */
+} DMP_ProgressT;
+
+/* called after every written buffer */
+typedef void (*DMP_ProgressFuncT)(const DMP_ProgressT* progress, void* context);
+
+/*************************************************************************
+|  FUNCTIONS
+|*************************************************************************/
+
+int   DMP_Dump(DWORD addr, DWORD size, const char* szFileName, int format,
+               DMP_ProgressFuncT progressFunc, void* context, DMP_ProgressT* progress);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
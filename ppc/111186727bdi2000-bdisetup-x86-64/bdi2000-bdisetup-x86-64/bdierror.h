@@ -35,6 +35,8 @@
 #define BDI_ERR_LOGIC_DEVICE        -1304
 #define BDI_ERR_LOGIC_VERIFY        -1305
 #define BDI_ERR_LOGIC_FILE          -1306
+#define BDI_ERR_LOGIC_CHECKSUM      -1307
+#define BDI_ERR_CONFIG_SYNTAX       -1308
 
 
 #endif
@@ -0,0 +1,710 @@
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdifleet.c
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX / UNIX
+|  TARGET HW   : PC
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  This module builds the configurations of many BDIs in one pass. The
+|  inventory lists one unit per CSV line or JSON object, its values are
+|  the variables of the unit. Every ${NAME} in the configuration template
+|  is replaced with the value of the unit, the result is compiled and
+|  built as for a single configuration file. The template is read once
+|  and the register definitions are read and built once for all units
+|  referencing the same files.
+|
+|  CSV:   IP,WORKSPACE,CPUTYPE             JSON:  [ { "IP": "10.0.0.21",
+|         10.0.0.21,0x00000000,8280                   "WORKSPACE": 0,
+|         10.0.0.22,0x00004000,8260                   "CPUTYPE": "8280" } ]
+|
+|*************************************************************************/
+
+/*************************************************************************
+|  INCLUDES
+|*************************************************************************/
+
+#if defined(WIN32)
+#include <windows.h>
+#endif
+#include <stddef.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "bdierror.h"
+#include "bdicmd.h"
+#include "bdidll.h"
+#include "bdicnf.h"
+#include "bdifleet.h"
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define FLT_POOL_GROW   4096
+#define FLT_UNIT_GROW   64
+
+/* ASCII codes */
+#define HT              9
+#define CR              13
+#define LF              10
+
+/*************************************************************************
+|  LOCALS
+|*************************************************************************/
+
+
+/****************************************************************************
+ ****************************************************************************
+    Helper functions to collect the names and values of the inventory
+ ****************************************************************************/
+
+static int FLT_Error(FLT_FleetT* fleet, int line, const char* szError, const char* szToken)
+{
+  if (fleet->errorLine == 0) {
+    fleet->errorLine = line;
+    if (szToken != NULL) sprintf(fleet->szError, "%.40s %.30s", szError, szToken);
+    else                 sprintf(fleet->szError, "%.70s", szError);
+  } /* if */
+  return BDI_ERR_CONFIG_SYNTAX;
+} /* FLT_Error */
+
+
+static int FLT_AddString(FLT_FleetT* fleet, const char* szText)
+{
+  char*   newPool;
+  int     len;
+  int     offset;
+
+  len = (int)strlen(szText) + 1;
+  if (fleet->poolSize + len > fleet->poolAlloc) {
+    newPool = (char*)realloc(fleet->pool, (size_t)fleet->poolAlloc + len + FLT_POOL_GROW);
+    if (newPool == NULL) return -1;
+    fleet->pool       = newPool;
+    fleet->poolAlloc += len + FLT_POOL_GROW;
+  } /* if */
+  offset = fleet->poolSize;
+  memcpy(fleet->pool + offset, szText, (size_t)len);
+  fleet->poolSize += len;
+  return offset;
+} /* FLT_AddString */
+
+
+static BOOL FLT_SameName(const char* szName1, const char* szName2, int len2)
+{
+  int     i;
+
+  for (i = 0; i < len2; i++) {
+    if (toupper((BYTE)szName1[i]) != toupper((BYTE)szName2[i])) return FALSE;
+  } /* for */
+  return szName1[len2] == 0;
+} /* FLT_SameName */
+
+
+static int FLT_FindVar(const FLT_FleetT* fleet, const char* szName, int len)
+{
+  int     i;
+
+  for (i = 0; i < fleet->varCount; i++) {
+    if (FLT_SameName(fleet->pool + fleet->varName[i], szName, len)) return i;
+  } /* for */
+  return -1;
+} /* FLT_FindVar */
+
+
+static int FLT_AddVar(FLT_FleetT* fleet, int line, const char* szName)
+{
+  int     i;
+
+  if (szName[0] == 0) return FLT_Error(fleet, line, "missing name", NULL);
+  for (i = 0; szName[i] != 0; i++) {
+    if (!isalnum((BYTE)szName[i]) && (szName[i] != '_')) {
+      return FLT_Error(fleet, line, "invalid name", szName);
+    } /* if */
+  } /* for */
+  i = FLT_FindVar(fleet, szName, (int)strlen(szName));
+  if (i >= 0) return i;
+  if (fleet->varCount == FLT_MAX_VARS) return FLT_Error(fleet, line, "too many names", NULL);
+  fleet->varName[fleet->varCount] = FLT_AddString(fleet, szName);
+  if (fleet->varName[fleet->varCount] < 0) return BDI_ERR_FILE_ACCESS;
+  return fleet->varCount++;
+} /* FLT_AddVar */
+
+
+static FLT_UnitT* FLT_AddUnit(FLT_FleetT* fleet, int line)
+{
+  FLT_UnitT*  newUnit;
+  int         i;
+
+  if (fleet->count == fleet->alloc) {
+    newUnit = (FLT_UnitT*)realloc(fleet->unit, (fleet->alloc + FLT_UNIT_GROW) * sizeof(FLT_UnitT));
+    if (newUnit == NULL) return NULL;
+    fleet->unit   = newUnit;
+    fleet->alloc += FLT_UNIT_GROW;
+  } /* if */
+  newUnit = &fleet->unit[fleet->count++];
+  memset(newUnit, 0, sizeof *newUnit);
+  newUnit->line = line;
+  for (i = 0; i < FLT_MAX_VARS; i++) newUnit->value[i] = -1;
+  return newUnit;
+} /* FLT_AddUnit */
+
+
+static int FLT_SetValue(FLT_FleetT* fleet, FLT_UnitT* unit, int var, const char* szValue)
+{
+  unit->value[var] = FLT_AddString(fleet, szValue);
+  return (unit->value[var] < 0) ? BDI_ERR_FILE_ACCESS : BDI_OKAY;
+} /* FLT_SetValue */
+
+
+static int FLT_ReadFile(const char* szFileName, BYTE** data, int* size)
+{
+  long    length;
+  FILE*   file;
+
+  *data = NULL;
+  file = fopen(szFileName, "rb");
+  if (file == NULL) return BDI_ERR_FILE_ACCESS;
+  length = -1;
+  if (fseek(file, 0, SEEK_END) == 0) length = ftell(file);
+  if (length >= 0) {
+    rewind(file);
+    *data = (BYTE*)malloc((size_t)length + 1);
+  } /* if */
+  if ((*data == NULL) || (fread(*data, 1, (size_t)length, file) != (size_t)length)) {
+    fclose(file);
+    free(*data);
+    *data = NULL;
+    return BDI_ERR_FILE_ACCESS;
+  } /* if */
+  fclose(file);
+  *size = (int)length;
+  return BDI_OKAY;
+} /* FLT_ReadFile */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    FLT_ParseCsv :
+
+    Parses a CSV inventory. The first line holds the names, every further
+    line one unit. Values may be quoted, "" within quotes is one quote.
+    Blank lines and lines starting with # are ignored.
+
+     INPUT  : data      the file
+              size      size of the file
+     OUTPUT : fleet     the units
+              RETURN    error code
+
+ ****************************************************************************/
+
+static int FLT_ParseCsv(const BYTE* data, int size, FLT_FleetT* fleet)
+{
+  FLT_UnitT*  unit;
+  char        szValue[FLT_MAX_VALUE];
+  int         names;
+  int         field;
+  int         line;
+  int         pos;
+  int         len;
+  int         result;
+  BOOL        header;
+
+  header = TRUE;
+  names  = 0;
+  line   = 0;
+  pos    = 0;
+  while (pos < size) {
+    line++;
+    while ((pos < size) && ((data[pos] == ' ') || (data[pos] == HT))) pos++;
+    if ((pos == size) || (data[pos] == CR) || (data[pos] == LF) || (data[pos] == '#')) {
+      while ((pos < size) && (data[pos] != LF)) pos++;
+      pos++;
+      continue;
+    } /* if */
+
+    unit = NULL;
+    if (!header) {
+      unit = FLT_AddUnit(fleet, line);
+      if (unit == NULL) return BDI_ERR_FILE_ACCESS;
+    } /* if */
+    field = 0;
+    for (;;) {
+
+      /* one value, quoted or up to the next comma */
+      while ((pos < size) && ((data[pos] == ' ') || (data[pos] == HT))) pos++;
+      len = 0;
+      if ((pos < size) && (data[pos] == '"')) {
+        pos++;
+        for (;;) {
+          if ((pos == size) || (data[pos] == CR) || (data[pos] == LF)) {
+            return FLT_Error(fleet, line, "missing quote", NULL);
+          } /* if */
+          if (data[pos] == '"') {
+            if ((pos + 1 < size) && (data[pos + 1] == '"')) pos++;
+            else break;
+          } /* if */
+          if (len == FLT_MAX_VALUE - 1) return FLT_Error(fleet, line, "value too long", NULL);
+          szValue[len++] = (char)data[pos++];
+        } /* for */
+        pos++;
+        while ((pos < size) && ((data[pos] == ' ') || (data[pos] == HT))) pos++;
+      } /* if */
+      else {
+        while ((pos < size) && (data[pos] != ',') && (data[pos] != CR) && (data[pos] != LF)) {
+          if (len == FLT_MAX_VALUE - 1) return FLT_Error(fleet, line, "value too long", NULL);
+          szValue[len++] = (char)data[pos++];
+        } /* while */
+        while ((len > 0) && ((szValue[len - 1] == ' ') || (szValue[len - 1] == HT))) len--;
+      } /* else */
+      szValue[len] = 0;
+
+      /* a name of the first line or a value of the unit */
+      if (header) {
+        result = FLT_AddVar(fleet, line, szValue);
+        if (result < 0) return result;
+        if (result != field) return FLT_Error(fleet, line, "duplicate name", szValue);
+      } /* if */
+      else if (field >= names) {
+        return FLT_Error(fleet, line, "too many values", NULL);
+      } /* else if */
+      else if (len > 0) {
+        result = FLT_SetValue(fleet, unit, field, szValue);
+        if (result != BDI_OKAY) return result;
+      } /* else if */
+      field++;
+
+      if ((pos < size) && (data[pos] == ',')) {
+        pos++;
+        continue;
+      } /* if */
+      if ((pos < size) && (data[pos] != CR) && (data[pos] != LF)) {
+        return FLT_Error(fleet, line, "invalid value", szValue);
+      } /* if */
+      break;
+    } /* for */
+    if ((pos < size) && (data[pos] == CR)) pos++;
+    if ((pos < size) && (data[pos] == LF)) pos++;
+    if (header) names = fleet->varCount;
+    header = FALSE;
+  } /* while */
+
+  return BDI_OKAY;
+} /* FLT_ParseCsv */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    FLT_ParseJson :
+
+    Parses a JSON inventory, an array with one object per unit. The values
+    are strings or numbers, a number is used as written.
+
+     INPUT  : data      the file
+              size      size of the file
+     OUTPUT : fleet     the units
+              RETURN    error code
+
+ ****************************************************************************/
+
+static int FLT_SkipSpace(const BYTE* data, int size, int pos, int* line)
+{
+  while ((pos < size) && (data[pos] <= ' ')) {
+    if (data[pos] == LF) (*line)++;
+    pos++;
+  } /* while */
+  return pos;
+} /* FLT_SkipSpace */
+
+
+static int FLT_JsonValue(const BYTE* data, int size, int pos, char* szValue)
+{
+  int     len;
+  char    c;
+
+  len = 0;
+
+  /* number or other bare token */
+  if (data[pos] != '"') {
+    while (   (pos < size) && (isalnum(data[pos]) || (data[pos] == '.')
+           || (data[pos] == '-') || (data[pos] == '+'))) {
+      if (len == FLT_MAX_VALUE - 1) return -1;
+      szValue[len++] = (char)data[pos++];
+    } /* while */
+    szValue[len] = 0;
+    return (len > 0) ? pos : -1;
+  } /* if */
+
+  /* string */
+  pos++;
+  while ((pos < size) && (data[pos] != '"')) {
+    c = (char)data[pos++];
+    if ((BYTE)c < ' ') return -1;
+    if (c == '\\') {
+      if (pos == size) return -1;
+      c = (char)data[pos++];
+      if      (c == 'n') c = LF;
+      else if (c == 't') c = HT;
+      else if ((c != '"') && (c != '\\') && (c != '/')) return -1;
+    } /* if */
+    if (len == FLT_MAX_VALUE - 1) return -1;
+    szValue[len++] = c;
+  } /* while */
+  szValue[len] = 0;
+  return (pos < size) ? pos + 1 : -1;
+} /* FLT_JsonValue */
+
+
+static int FLT_ParseJson(const BYTE* data, int size, FLT_FleetT* fleet)
+{
+  FLT_UnitT*  unit;
+  char        szName[FLT_MAX_VALUE];
+  char        szValue[FLT_MAX_VALUE];
+  int         line;
+  int         pos;
+  int         var;
+  int         result;
+
+  line = 1;
+  pos = FLT_SkipSpace(data, size, 0, &line);
+  if ((pos == size) || (data[pos] != '[')) return FLT_Error(fleet, line, "missing [", NULL);
+  pos = FLT_SkipSpace(data, size, pos + 1, &line);
+  if ((pos < size) && (data[pos] == ']')) return BDI_OKAY;
+
+  for (;;) {
+    if ((pos == size) || (data[pos] != '{')) return FLT_Error(fleet, line, "missing {", NULL);
+    unit = FLT_AddUnit(fleet, line);
+    if (unit == NULL) return BDI_ERR_FILE_ACCESS;
+    pos = FLT_SkipSpace(data, size, pos + 1, &line);
+
+    /* "name": value pairs */
+    while ((pos < size) && (data[pos] != '}')) {
+      if (data[pos] != '"') return FLT_Error(fleet, line, "missing name", NULL);
+      pos = FLT_JsonValue(data, size, pos, szName);
+      if (pos < 0) return FLT_Error(fleet, line, "invalid name", NULL);
+      pos = FLT_SkipSpace(data, size, pos, &line);
+      if ((pos == size) || (data[pos] != ':')) return FLT_Error(fleet, line, "missing : after", szName);
+      pos = FLT_SkipSpace(data, size, pos + 1, &line);
+      if (pos == size) return FLT_Error(fleet, line, "missing value of", szName);
+      pos = FLT_JsonValue(data, size, pos, szValue);
+      if (pos < 0) return FLT_Error(fleet, line, "invalid value of", szName);
+      var = FLT_AddVar(fleet, line, szName);
+      if (var < 0) return var;
+      result = FLT_SetValue(fleet, unit, var, szValue);
+      if (result != BDI_OKAY) return result;
+      pos = FLT_SkipSpace(data, size, pos, &line);
+      if ((pos < size) && (data[pos] == ',')) pos = FLT_SkipSpace(data, size, pos + 1, &line);
+      else if ((pos < size) && (data[pos] != '}')) return FLT_Error(fleet, line, "missing , after", szName);
+    } /* while */
+    if (pos == size) return FLT_Error(fleet, line, "missing }", NULL);
+
+    pos = FLT_SkipSpace(data, size, pos + 1, &line);
+    if ((pos < size) && (data[pos] == ']')) break;
+    if ((pos == size) || (data[pos] != ',')) return FLT_Error(fleet, line, "missing ]", NULL);
+    pos = FLT_SkipSpace(data, size, pos + 1, &line);
+  } /* for */
+
+  return BDI_OKAY;
+} /* FLT_ParseJson */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    FLT_LoadInventory :
+
+    Reads the inventory, a JSON file starts with [, any other is CSV.
+
+     INPUT  : szFileName  the inventory file
+     OUTPUT : fleet       the units, release with FLT_Free
+              RETURN      error code
+
+ ****************************************************************************/
+
+int FLT_LoadInventory(const char* szFileName, FLT_FleetT* fleet)
+{
+  int     result;
+  int     size;
+  int     line;
+  int     pos;
+  BYTE*   data;
+
+  memset(fleet, 0, sizeof *fleet);
+  result = FLT_ReadFile(szFileName, &data, &size);
+  if (result != BDI_OKAY) return result;
+
+  line = 1;
+  pos  = FLT_SkipSpace(data, size, 0, &line);
+  if ((pos < size) && (data[pos] == '[')) {
+    result = FLT_ParseJson(data, size, fleet);
+  } /* if */
+  else {
+    result = FLT_ParseCsv(data, size, fleet);
+  } /* else */
+  free(data);
+  return result;
+} /* FLT_LoadInventory */
+
+
+void FLT_Free(FLT_FleetT* fleet)
+{
+  int     i;
+
+  for (i = 0; i < fleet->count; i++) free(fleet->unit[i].romConfig);
+  for (i = 0; i < fleet->regdefCount; i++) {
+    free(fleet->regdef[i].szKey);
+    free(fleet->regdef[i].data);
+  } /* for */
+  free(fleet->regdef);
+  free(fleet->unit);
+  free(fleet->pool);
+  memset(fleet, 0, sizeof *fleet);
+} /* FLT_Free */
+
+
+const char* FLT_GetValue(const FLT_FleetT* fleet, int unit, const char* szName)
+{
+  int     var;
+
+  var = FLT_FindVar(fleet, szName, (int)strlen(szName));
+  if ((var < 0) || (fleet->unit[unit].value[var] < 0)) return NULL;
+  return fleet->pool + fleet->unit[unit].value[var];
+} /* FLT_GetValue */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    FLT_Expand :
+
+    Replaces every ${NAME} of the template with the value of the unit.
+
+     INPUT  : fleet     the inventory
+              unit      the unit
+              data      the template
+              size      size of the template
+     OUTPUT : text      the configuration of the unit, release with free()
+              textSize  its size
+              RETURN    error code
+
+ ****************************************************************************/
+
+static int FLT_Expand(const FLT_FleetT* fleet, FLT_UnitT* unit,
+                      const BYTE* data, int size, BYTE** text, int* textSize)
+{
+  BYTE*       newText;
+  const char* szValue;
+  int         alloc;
+  int         count;
+  int         line;
+  int         pos;
+  int         end;
+  int         len;
+  int         var;
+
+  alloc = size + FLT_POOL_GROW;
+  *text = (BYTE*)malloc((size_t)alloc);
+  if (*text == NULL) return BDI_ERR_FILE_ACCESS;
+  count = 0;
+  line  = 1;
+  pos   = 0;
+  while (pos < size) {
+    szValue = NULL;
+    len     = 1;
+    if (data[pos] == LF) line++;
+    if ((data[pos] == '$') && (pos + 1 < size) && (data[pos + 1] == '{')) {
+      for (end = pos + 2; (end < size) && (data[end] != '}') && (data[end] != LF); end++);
+      if ((end == size) || (data[end] != '}')) {
+        unit->errorLine = line;
+        strcpy(unit->szError, "missing } of ${");
+        return BDI_ERR_CONFIG_SYNTAX;
+      } /* if */
+      var = FLT_FindVar(fleet, (const char*)data + pos + 2, end - pos - 2);
+      if ((var < 0) || (unit->value[var] < 0)) {
+        unit->errorLine = line;
+        sprintf(unit->szError, "undefined variable %.*s", (end - pos - 2 > 40) ? 40 : end - pos - 2,
+                (const char*)data + pos + 2);
+        return BDI_ERR_CONFIG_SYNTAX;
+      } /* if */
+      szValue = fleet->pool + unit->value[var];
+      len = (int)strlen(szValue);
+    } /* if */
+    if (count + len > alloc) {
+      newText = (BYTE*)realloc(*text, (size_t)alloc + len + FLT_POOL_GROW);
+      if (newText == NULL) return BDI_ERR_FILE_ACCESS;
+      *text  = newText;
+      alloc += len + FLT_POOL_GROW;
+    } /* if */
+    if (szValue != NULL) {
+      memcpy(*text + count, szValue, (size_t)len);
+      pos = end + 1;
+    } /* if */
+    else {
+      (*text)[count] = data[pos++];
+    } /* else */
+    count += len;
+  } /* while */
+  *textSize = count;
+  return BDI_OKAY;
+} /* FLT_Expand */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    FLT_GetRegdef :
+
+    Gets the register definitions of a unit. Units with the same register
+    definition files share one image, the files are read only once.
+
+     INPUT  : szTemplateFile  the template, $ names are relative to it
+              config          the compiled configuration of the unit
+     OUTPUT : fleet           the shared images
+              unit            the register definitions of the unit
+              RETURN          error code
+
+ ****************************************************************************/
+
+static int FLT_GetRegdef(const char* szTemplateFile, const CNF_ConfigT* config,
+                         FLT_FleetT* fleet, FLT_UnitT* unit)
+{
+  FLT_RegdefT*  newRegdef;
+  FLT_RegdefT*  regdef;
+  CNF_StreamT   stream;
+  char          szName[256];
+  char*         szKey;
+  size_t        keySize;
+  int           core;
+  int           result;
+  int           i;
+
+  /* the key is the list of the files and their cores */
+  keySize = 1;
+  for (i = 0; i < CNF_GetRegdefCount(config); i++) {
+    if (!CNF_GetRegdefName(szTemplateFile, config, i, szName, (int)sizeof szName, &core)) {
+      return BDI_ERR_FILE_ACCESS;
+    } /* if */
+    keySize += strlen(szName) + 4;
+  } /* for */
+  szKey = (char*)malloc(keySize);
+  if (szKey == NULL) return BDI_ERR_FILE_ACCESS;
+  szKey[0] = 0;
+  for (i = 0; i < CNF_GetRegdefCount(config); i++) {
+    (void)CNF_GetRegdefName(szTemplateFile, config, i, szName, (int)sizeof szName, &core);
+    sprintf(szKey + strlen(szKey), "%02x:%s\n", core, szName);
+  } /* for */
+
+  for (i = 0; i < fleet->regdefCount; i++) {
+    if (strcmp(fleet->regdef[i].szKey, szKey) == 0) {
+      free(szKey);
+      unit->romRegdef     = fleet->regdef[i].data;
+      unit->romRegdefSize = fleet->regdef[i].size;
+      return BDI_OKAY;
+    } /* if */
+  } /* for */
+
+  /* first unit with these files */
+  newRegdef = (FLT_RegdefT*)realloc(fleet->regdef, (fleet->regdefCount + 1) * sizeof(FLT_RegdefT));
+  if (newRegdef == NULL) {
+    free(szKey);
+    return BDI_ERR_FILE_ACCESS;
+  } /* if */
+  fleet->regdef = newRegdef;
+  regdef = &fleet->regdef[fleet->regdefCount];
+  regdef->szKey = szKey;
+  regdef->data  = NULL;
+  result = CNF_OpenRomRegdef(szTemplateFile, config, &stream);
+  if (result >= 0) {
+    regdef->data = (BYTE*)malloc(CNF_IMAGE_SIZE(stream.size));
+    if (regdef->data == NULL) result = BDI_ERR_FILE_ACCESS;
+  } /* if */
+  if (result >= 0) result = CNF_ReadImage(&stream, regdef->data);
+  CNF_Close(&stream);
+  if (result < 0) {
+    free(regdef->data);
+    free(szKey);
+    return result;
+  } /* if */
+  regdef->size = result;
+  fleet->regdefCount++;
+  unit->romRegdef     = regdef->data;
+  unit->romRegdefSize = regdef->size;
+  return BDI_OKAY;
+} /* FLT_GetRegdef */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    FLT_BuildFleet :
+
+    Builds the configuration and register definitions of every unit.
+    The configuration is padded with 0xFF to the next full block as it
+    is compared with and programmed into the BDI flash.
+
+     INPUT  : szTemplateFile  the configuration template
+              strip           without comments, blank lines and redundant spaces
+     OUTPUT : fleet           the images or the error of every unit
+              RETURN          number of failed units or error code
+
+ ****************************************************************************/
+
+int FLT_BuildFleet(const char* szTemplateFile, BOOL strip, FLT_FleetT* fleet)
+{
+  FLT_UnitT*  unit;
+  CNF_ConfigT config;
+  CNF_StreamT stream;
+  BYTE*       data;
+  BYTE*       text;
+  int         size;
+  int         textSize;
+  int         failed;
+  int         result;
+  int         i;
+
+  result = FLT_ReadFile(szTemplateFile, &data, &size);
+  if (result != BDI_OKAY) return result;
+
+  failed = 0;
+  for (i = 0; i < fleet->count; i++) {
+    unit = &fleet->unit[i];
+    text = NULL;
+    result = FLT_Expand(fleet, unit, data, size, &text, &textSize);
+    if (result == BDI_OKAY) {
+      result = CNF_CompileText(text, textSize, &config);
+      if (result == BDI_ERR_CONFIG_SYNTAX) {
+        unit->errorLine = config.errorLine;
+        strcpy(unit->szError, config.szError);
+      } /* if */
+      if (result == BDI_OKAY) {
+        result = CNF_OpenRomConfig(&config, strip, &stream);
+        if (result >= 0) {
+          unit->romConfigSize = result;
+          unit->romConfig = (BYTE*)malloc(CNF_IMAGE_SIZE(stream.size));
+          if (unit->romConfig == NULL) result = BDI_ERR_FILE_ACCESS;
+        } /* if */
+        if (result >= 0) result = CNF_ReadImage(&stream, unit->romConfig);
+        CNF_Close(&stream);
+        if (result >= 0) result = FLT_GetRegdef(szTemplateFile, &config, fleet, unit);
+      } /* if */
+      CNF_Free(&config);
+    } /* if */
+    free(text);
+    unit->result = result;
+    if (result != BDI_OKAY) failed++;
+  } /* for */
+
+  free(data);
+  return failed;
+} /* FLT_BuildFleet */
@@ -0,0 +1,94 @@
+#ifndef __BDIFLEET_H__
+#define __BDIFLEET_H__
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdifleet.h
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX
+|  TARGET HW   : PC
+|
+|  PROGRAMMER  : Abatron / RD
+|  CREATION    : 19.10.26
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  Configurations of many BDIs built from one template and an inventory
+|
+|
+|*************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define FLT_MAX_VARS            32     /* variables (columns) of an inventory */
+#define FLT_MAX_VALUE           256    /* characters of a value */
+
+/*************************************************************************
+|  TYPEDEFS
+|*************************************************************************/
+
+/* a unit of the inventory with its built configuration */
+typedef struct {
+  int           line;           /* line in the inventory */
+  int           value[FLT_MAX_VARS];  /* offsets into the pool, -1 if unset */
+  int           result;         /* error code of the build */
+  int           errorLine;      /* template line of the error */
+  char          szError[80];
+  BYTE*         romConfig;      /* configuration, padded with 0xFF */
+  int           romConfigSize;
+  BYTE*         romRegdef;      /* register definitions, shared between units */
+  int           romRegdefSize;
+} FLT_UnitT;
+
+/* register definitions built once for all units using the same files */
+typedef struct {
+  char*         szKey;          /* the file names and cores */
+  BYTE*         data;
+  int           size;
+} FLT_RegdefT;
+
+typedef struct {
+  char*         pool;           /* names and values, zero terminated */
+  int           poolSize;
+  int           poolAlloc;
+  int           varCount;
+  int           varName[FLT_MAX_VARS];  /* offsets into the pool */
+  FLT_UnitT*    unit;
+  int           count;
+  int           alloc;
+  FLT_RegdefT*  regdef;
+  int           regdefCount;
+  int           errorLine;      /* inventory line of the first error */
+  char          szError[80];
+} FLT_FleetT;
+
+/*************************************************************************
+|  FUNCTIONS
+|*************************************************************************/
+
+/* a CSV file with the names in the first line or a JSON array of objects */
+int   FLT_LoadInventory(const char* szFileName, FLT_FleetT* fleet);
+void  FLT_Free(FLT_FleetT* fleet);
+
+/* the value of a variable, NULL if the unit has none */
+const char* FLT_GetValue(const FLT_FleetT* fleet, int unit, const char* szName);
+
+/* expand ${NAME} of the template and compile every unit, returns failed units */
+int   FLT_BuildFleet(const char* szTemplateFile, BOOL strip, FLT_FleetT* fleet);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
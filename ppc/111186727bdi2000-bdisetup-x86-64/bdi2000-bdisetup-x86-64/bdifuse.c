@@ -0,0 +1,489 @@
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdifuse.c
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX / UNIX
+|  TARGET HW   : PC
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  This module holds the fuse map of an ispLSI CPLD packed into native
+|  words, one bit per fuse. Rows are compared a word at a time instead of
+|  character by character. The loader still transfers rows and the UES
+|  as ASCII '0'/'1', the conversion is done at the link.
+|
+|  The differences between the CPLDs (rows, bits per row, UES) are held
+|  in a geometry, one JEDEC loader and one ISP engine serve all of them.
+|  The JEDEC loader checks the fuse and the transmission checksum, so a
+|  corrupted file is rejected before the CPLD is erased.
+|
+|*************************************************************************/
+
+/*************************************************************************
+|  INCLUDES
+|*************************************************************************/
+
+#if defined(WIN32)
+#include <windows.h>
+#define MAXPATHLEN  _MAX_PATH
+#else
+#include <sys/param.h>
+#endif /* defined(WIN32) */
+#include <stddef.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "bdierror.h"
+#include "bdidll.h"
+#include "bdiimg.h"
+#include "bdiarc.h"
+#include "bdifuse.h"
+#include "bdicnf.h"
+#include "bdicache.h"
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define FUS_BIT(bit)        ((FUS_WordT)1 << ((bit) % FUS_WORD_BITS))
+
+/* JEDEC transmission control characters */
+#define FUS_STX             0x02
+#define FUS_ETX             0x03
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    FUS_Init :
+
+    Clears a fuse map.
+
+     INPUT  : geometry  the geometry of the CPLD
+     OUTPUT : map       the empty fuse map
+
+ ****************************************************************************/
+
+void FUS_Init(FUS_MapT* map, const FUS_GeometryT* geometry)
+{
+  memset(map->row, 0, sizeof map->row);
+  map->geometry = geometry;
+} /* FUS_Init */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    FUS_GetBit / FUS_SetBit :
+
+    Read / write one fuse of a packed row.
+
+ ****************************************************************************/
+
+BOOL FUS_GetBit(const FUS_WordT* bits, int bit)
+{
+  return (bits[bit / FUS_WORD_BITS] & FUS_BIT(bit)) != 0;
+} /* FUS_GetBit */
+
+
+void FUS_SetBit(FUS_WordT* bits, int bit, BOOL value)
+{
+  if (value) bits[bit / FUS_WORD_BITS] |=  FUS_BIT(bit);
+  else       bits[bit / FUS_WORD_BITS] &= ~FUS_BIT(bit);
+} /* FUS_SetBit */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    FUS_Equal :
+
+    Compares two packed rows a word at a time, the bits after count
+    are ignored.
+
+     INPUT  : bits1     the first row
+              bits2     the second row
+              count     the number of bits to compare
+     OUTPUT : RETURN    TRUE if equal
+
+ ****************************************************************************/
+
+BOOL FUS_Equal(const FUS_WordT* bits1, const FUS_WordT* bits2, int count)
+{
+  FUS_WordT diff;
+  int       words;
+  int       i;
+
+  words = count / FUS_WORD_BITS;
+  diff  = 0;
+  for (i = 0; i < words; i++) diff |= bits1[i] ^ bits2[i];
+  if ((count % FUS_WORD_BITS) != 0) {
+    diff |= (bits1[words] ^ bits2[words]) & (FUS_BIT(count) - 1);
+  } /* if */
+  return diff == 0;
+} /* FUS_Equal */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    FUS_Subset :
+
+    Checks that bits2 can be reached from bits1 by clearing bits only,
+    as programming does without a bulk erase. The bits after count are
+    ignored.
+
+     INPUT  : bits1     the bits of the device
+              bits2     the wanted bits
+              count     the number of bits to compare
+     OUTPUT : RETURN    TRUE if every bit set in bits2 is set in bits1
+
+ ****************************************************************************/
+
+BOOL FUS_Subset(const FUS_WordT* bits1, const FUS_WordT* bits2, int count)
+{
+  FUS_WordT set;
+  int       words;
+  int       i;
+
+  words = count / FUS_WORD_BITS;
+  set   = 0;
+  for (i = 0; i < words; i++) set |= bits2[i] & ~bits1[i];
+  if ((count % FUS_WORD_BITS) != 0) {
+    set |= (bits2[words] & ~bits1[words]) & (FUS_BIT(count) - 1);
+  } /* if */
+  return set == 0;
+} /* FUS_Subset */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    FUS_ToAscii / FUS_FromAscii :
+
+    Convert between a packed row and the ASCII format of the loader.
+
+     INPUT  : bits      the packed row / szAscii  the ASCII row
+              count     the number of bits
+     OUTPUT : szAscii   the zero terminated ASCII row / bits  the packed row
+              RETURN    FALSE if the ASCII row holds other characters
+
+ ****************************************************************************/
+
+void FUS_ToAscii(const FUS_WordT* bits, int count, char* szAscii)
+{
+  int   i;
+
+  for (i = 0; i < count; i++) *szAscii++ = FUS_GetBit(bits, i) ? '1' : '0';
+  *szAscii = 0;
+} /* FUS_ToAscii */
+
+
+BOOL FUS_FromAscii(const char* szAscii, int count, FUS_WordT* bits)
+{
+  int   i;
+
+  memset(bits, 0, FUS_WORDS(count) * sizeof(FUS_WordT));
+  for (i = 0; i < count; i++) {
+    if      (szAscii[i] == '1') bits[i / FUS_WORD_BITS] |= FUS_BIT(i);
+    else if (szAscii[i] != '0') return FALSE;
+  } /* for */
+  return TRUE;
+} /* FUS_FromAscii */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    FUS_BuildUES :
+
+    Builds the user electronic signature holding the logic version.
+    The text is converted MSB first, hex digits to 4 bits or characters
+    to 8 bits, missing characters are zero.
+
+     INPUT  : geometry  the geometry of the CPLD
+              version   the logic version number
+     OUTPUT : ues       the packed UES
+
+ ****************************************************************************/
+
+void FUS_BuildUES(const FUS_GeometryT* geometry, WORD version, FUS_WordT* ues)
+{
+  char  szText[32];
+  int   charBits;
+  int   value;
+  int   bit;
+  int   i;
+
+  if (geometry->uesHex) {
+    sprintf(szText, "%s%04i", geometry->szUESPrefix, version);
+    charBits = 4;
+  } /* if */
+  else {
+    sprintf(szText, "%s%c%03i", geometry->szUESPrefix, ('0' + (version / 1000)), (version % 1000));
+    charBits = 8;
+  } /* else */
+
+  memset(ues, 0, FUS_WORDS(geometry->uesBits) * sizeof(FUS_WordT));
+  for (i = 0; (i * charBits) < geometry->uesBits; i++) {
+    value = 0;
+    if ((size_t)i < strlen(szText)) {
+      if (charBits == 8) {
+        value = (unsigned char)szText[i];
+      } /* if */
+      else if (isxdigit((unsigned char)szText[i])) {
+        value = isdigit((unsigned char)szText[i]) ? (szText[i] - '0')
+                                                  : (toupper((unsigned char)szText[i]) - 'A' + 10);
+      } /* else if */
+    } /* if */
+    for (bit = 0; bit < charBits; bit++) {
+      if (value & (1 << (charBits - 1 - bit))) FUS_SetBit(ues, i * charBits + bit, TRUE);
+    } /* for */
+  } /* for */
+} /* FUS_BuildUES */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    FUS_ParseNumber :
+
+    Parses a decimal or hex number, leading white space is skipped.
+
+     INPUT  : ptr       the current position
+              end       the end of the data
+              base      10 or 16
+     OUTPUT : ptr       the position after the number
+              value     the number
+              RETURN    FALSE if there is no digit
+
+ ****************************************************************************/
+
+static BOOL FUS_ParseNumber(const BYTE** ptr, const BYTE* end, int base, DWORD* value)
+{
+  const BYTE* pos;
+  int         digit;
+
+  pos = *ptr;
+  while ((pos < end) && isspace(*pos)) pos++;
+  *ptr   = pos;
+  *value = 0;
+  while (pos < end) {
+    if      (isdigit(*pos))                  digit = *pos - '0';
+    else if ((base == 16) && isxdigit(*pos)) digit = toupper(*pos) - 'A' + 10;
+    else                                     break;
+    *value = *value * base + digit;
+    pos++;
+  } /* while */
+  if (pos == *ptr) return FALSE;
+  *ptr = pos;
+  return TRUE;
+} /* FUS_ParseNumber */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    FUS_ParseJedec :
+
+    Parses a JEDEC file (JESD3) held in memory in one pass, line lengths
+    do not matter. The fuses of the L fields are assigned by their
+    address, row = address / bits per row. Fuses not listed take the
+    default of the F field.
+
+    The transmission checksum after ETX and the fuse checksum of the
+    C field are checked if present (a transmission checksum of 0000 is
+    not checked, as allowed by JESD3). Files without STX are parsed
+    from the start, without the transmission checksum.
+
+     INPUT  : data      the file content
+              size      the file size
+              map       the fuse map with the geometry
+     OUTPUT : map       the fuse map
+              RETURN    error code
+
+ ****************************************************************************/
+
+int FUS_ParseJedec(const BYTE* data, DWORD size, FUS_MapT* map)
+{
+  const BYTE* ptr;
+  const BYTE* end;
+  const BYTE* etx;
+  DWORD       fuses;
+  DWORD       fuse;
+  DWORD       assigned;
+  DWORD       value;
+  DWORD       checksum;
+  DWORD       fuseChecksum;
+  BOOL        hasChecksum;
+  BOOL        hasDefault;
+  int         rowBits;
+  BYTE        field;
+
+  rowBits = map->geometry->rowBits;
+  fuses   = (DWORD)map->geometry->rows * rowBits;
+  FUS_Init(map, map->geometry);
+
+  /* the transmission runs from STX to ETX, without STX the whole file is parsed */
+  end = data + size;
+  ptr = (const BYTE*)memchr(data, FUS_STX, size);
+  if (ptr == NULL) {
+    ptr = data;
+    etx = (const BYTE*)memchr(ptr, FUS_ETX, size);
+    if (etx != NULL) end = etx;
+  } /* if */
+  else {
+    etx = (const BYTE*)memchr(ptr, FUS_ETX, end - ptr);
+    if (etx != NULL) {
+      checksum = 0;
+      for (end = ptr; end <= etx; end++) checksum += *end & 0x7F;
+      end = etx + 1;
+      if (   FUS_ParseNumber(&end, data + size, 16, &value)
+          && (value != 0) && (value != (checksum & 0xFFFF))) {
+        return BDI_ERR_LOGIC_CHECKSUM;
+      } /* if */
+      end = etx;
+    } /* if */
+  } /* else */
+
+  /* the design specification up to the first '*' is not used */
+  assigned    = 0;
+  hasDefault  = FALSE;
+  hasChecksum = FALSE;
+  fuseChecksum = 0;
+  ptr = (const BYTE*)memchr(ptr, '*', end - ptr);
+  while (ptr != NULL) {
+    ptr++;
+    while ((ptr < end) && isspace(*ptr)) ptr++;
+    if (ptr == end) break;
+    field = *ptr++;
+
+    /* number of fuses, must fit the device */
+    if ((field == 'Q') && (ptr < end) && (*ptr == 'F')) {
+      ptr++;
+      if (!FUS_ParseNumber(&ptr, end, 10, &value) || (value != fuses)) return BDI_ERR_LOGIC_FILE;
+    } /* if */
+
+    /* default state of fuses not listed */
+    else if (field == 'F') {
+      if (!FUS_ParseNumber(&ptr, end, 10, &value) || (value > 1)) return BDI_ERR_LOGIC_FILE;
+      hasDefault = TRUE;
+      if (value != 0) {
+        for (fuse = 0; fuse < fuses; fuse++) {
+          FUS_SetBit(map->row[fuse / rowBits], (int)(fuse % rowBits), TRUE);
+        } /* for */
+      } /* if */
+    } /* else if */
+
+    /* fuse list starting at an address */
+    else if (field == 'L') {
+      if (!FUS_ParseNumber(&ptr, end, 10, &fuse)) return BDI_ERR_LOGIC_FILE;
+      for (; (ptr < end) && (*ptr != '*'); ptr++) {
+        if ((*ptr == '0') || (*ptr == '1')) {
+          if (fuse >= fuses) return BDI_ERR_LOGIC_FILE;
+          FUS_SetBit(map->row[fuse / rowBits], (int)(fuse % rowBits), *ptr == '1');
+          fuse++;
+          assigned++;
+        } /* if */
+        else if (!isspace(*ptr)) {
+          return BDI_ERR_LOGIC_FILE;
+        } /* else if */
+      } /* for */
+    } /* else if */
+
+    /* fuse checksum */
+    else if (field == 'C') {
+      if (!FUS_ParseNumber(&ptr, end, 16, &fuseChecksum)) return BDI_ERR_LOGIC_FILE;
+      hasChecksum = TRUE;
+    } /* else if */
+
+    ptr = (const BYTE*)memchr(ptr, '*', end - ptr);
+  } /* while */
+
+  /* all fuses must be defined */
+  if ((assigned < fuses) && !hasDefault) return BDI_ERR_LOGIC_FILE;
+
+  /* the fuse checksum sums the fuses as 8 bit words, fuse 0 is the LSB */
+  if (hasChecksum) {
+    checksum = 0;
+    for (fuse = 0; fuse < fuses; fuse++) {
+      if (FUS_GetBit(map->row[fuse / rowBits], (int)(fuse % rowBits))) {
+        checksum += (DWORD)1 << (fuse % 8);
+      } /* if */
+    } /* for */
+    if (fuseChecksum != (checksum & 0xFFFF)) return BDI_ERR_LOGIC_CHECKSUM;
+  } /* if */
+
+  return BDI_OKAY;
+} /* FUS_ParseJedec */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    FUS_LoadJedec :
+
+    Loads the fuse map from a JEDEC file. A file is mapped into memory,
+    a file within an archive is decompressed into a buffer.
+
+     INPUT  : szFileName    the JEDEC file name
+              map           the fuse map with the geometry
+     OUTPUT : map           the fuse map
+              RETURN        error code
+
+ ****************************************************************************/
+
+int FUS_LoadJedec(const char* szFileName, FUS_MapT* map)
+{
+  char    szArchive[MAXPATHLEN];
+  FILE*   jedecFile;
+  BYTE*   data;
+  BYTE*   newData;
+  DWORD   size;
+  DWORD   alloc;
+  size_t  count;
+  int     result;
+
+  /* a plain file is mapped */
+  if (ARC_MemberName(szFileName, szArchive) == NULL) {
+    data = CCH_MapFile(szFileName, &size);
+    if (data == NULL) return BDI_ERR_LOGIC_FILE;
+    result = FUS_ParseJedec(data, size, map);
+    CCH_UnmapFile(data, size);
+    return result;
+  } /* if */
+
+  /* an archive member is read */
+  jedecFile = ARC_OpenFile(szFileName, "rb");
+  if (jedecFile == NULL) return BDI_ERR_LOGIC_FILE;
+  data   = NULL;
+  size   = 0;
+  alloc  = 0;
+  result = BDI_OKAY;
+  do {
+    if (size == alloc) {
+      alloc   = alloc ? (2 * alloc) : 0x10000;
+      newData = (BYTE*)realloc(data, alloc);
+      if (newData == NULL) {
+        result = BDI_ERR_LOGIC_FILE;
+        break;
+      } /* if */
+      data = newData;
+    } /* if */
+    count = fread(data + size, 1, alloc - size, jedecFile);
+    size += (DWORD)count;
+  } while (count > 0);
+  if (ferror(jedecFile)) result = BDI_ERR_LOGIC_FILE;
+  fclose(jedecFile);
+  if (result == BDI_OKAY) result = FUS_ParseJedec(data, size, map);
+  free(data);
+  return result;
+} /* FUS_LoadJedec */
@@ -0,0 +1,110 @@
+#ifndef __BDIFUSE_H__
+#define __BDIFUSE_H__
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdifuse.h
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX
+|  TARGET HW   : PC
+|
+|  PROGRAMMER  : Abatron / RD
+|  CREATION    : 19.10.26
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  Bit packed fuse maps of the ispLSI CPLDs and their geometry
+|
+|
+|*************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+/* ispLSI2096 (BDI2000) */
+#define ISP20_NBR_OF_ROWS        134
+#define ISP20_ROW_BITS           240
+#define ISP20_UES_BITS           120
+#define ISP_2096_ID              0x13
+
+/* ispLSI2064 (BDI1000) */
+#define ISP10_NBR_OF_ROWS        118
+#define ISP10_ROW_BITS           160
+#define ISP10_UES_BITS           80
+#define ISP_2064_ID              0x12
+
+/* ispLSI2032 (BDI-HS) */
+#define ISPHS_NBR_OF_ROWS        102
+#define ISPHS_ROW_BITS           80
+#define ISPHS_UES_BITS           40
+#define ISP_2032_ID              0x15
+
+/* the largest device */
+#define FUS_MAX_ROWS             ISP20_NBR_OF_ROWS
+#define FUS_MAX_ROW_BITS         ISP20_ROW_BITS
+#define FUS_MAX_UES_BITS         ISP20_UES_BITS
+
+/* fuses are packed into native words, compared a word at a time */
+#define FUS_WORD_BITS            (8 * sizeof(FUS_WordT))
+#define FUS_WORDS(bits)          (((bits) + FUS_WORD_BITS - 1) / FUS_WORD_BITS)
+#define FUS_ROW_WORDS            FUS_WORDS(FUS_MAX_ROW_BITS)
+#define FUS_UES_WORDS            FUS_WORDS(FUS_MAX_UES_BITS)
+
+/*************************************************************************
+|  TYPEDEFS
+|*************************************************************************/
+
+typedef unsigned long FUS_WordT;
+
+/* the geometry of a CPLD */
+typedef struct {
+  BYTE          deviceId;       /* the ISP device ID */
+  int           rows;           /* number of rows */
+  int           rowBits;        /* fuses per row */
+  int           uesBits;        /* bits of the user electronic signature */
+  const char*   szUESPrefix;    /* UES text before the version number */
+  BOOL          uesHex;         /* UES text is hex (4 bits per character) */
+} FUS_GeometryT;
+
+typedef FUS_WordT FUS_RowT[FUS_ROW_WORDS];
+typedef FUS_WordT FUS_UEST[FUS_UES_WORDS];
+
+/* a fuse map, bit i of a row is bit (i % FUS_WORD_BITS) of word i / FUS_WORD_BITS */
+typedef struct {
+  const FUS_GeometryT*  geometry;
+  FUS_RowT              row[FUS_MAX_ROWS];
+} FUS_MapT;
+
+/*************************************************************************
+|  FUNCTIONS
+|*************************************************************************/
+
+void  FUS_Init(FUS_MapT* map, const FUS_GeometryT* geometry);
+BOOL  FUS_GetBit(const FUS_WordT* bits, int bit);
+void  FUS_SetBit(FUS_WordT* bits, int bit, BOOL value);
+BOOL  FUS_Equal(const FUS_WordT* bits1, const FUS_WordT* bits2, int count);
+BOOL  FUS_Subset(const FUS_WordT* bits1, const FUS_WordT* bits2, int count);
+
+/* the loader transfers fuses as ASCII '0'/'1', one character per fuse */
+void  FUS_ToAscii(const FUS_WordT* bits, int count, char* szAscii);
+BOOL  FUS_FromAscii(const char* szAscii, int count, FUS_WordT* bits);
+
+void  FUS_BuildUES(const FUS_GeometryT* geometry, WORD version, FUS_WordT* ues);
+int   FUS_ParseJedec(const BYTE* data, DWORD size, FUS_MapT* map);
+int   FUS_LoadJedec(const char* szFileName, FUS_MapT* map);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,736 @@
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdiimg.c
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX / UNIX
+|  TARGET HW   : PC
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  This module loads a firmware file into a sparse memory image. The image
+|  is used to program the BDI flash and to verify the programmed data.
+|  Application files (ELF, S-Record or binary) are loaded the same way to
+|  download them into target memory.
+|  The functions of an ELF symbol table are loaded to symbolise the
+|  profile of an application.
+|
+|*************************************************************************/
+
+/*************************************************************************
+|  INCLUDES
+|*************************************************************************/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "bdierror.h"
+#include "bdidll.h"
+#include "bdiimg.h"
+#include "bdiarc.h"
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define IMG_SEGMENT_GROW    16      /* number of segments to add at once */
+#define IMG_DATA_GROW       0x4000  /* minimal data size to add at once  */
+#define IMG_READ_GROW       0x10000 /* file buffer to add at once        */
+
+/* ELF */
+#define ELF_CLASS_32        1
+#define ELF_CLASS_64        2
+#define ELF_DATA_LSB        1
+#define ELF_PT_LOAD         1
+#define ELF_SHT_SYMTAB      2
+#define ELF_STT_FUNC        2
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    IMG_Init / IMG_Free :
+
+    Initialize an empty image / release all memory used by an image.
+
+     INPUT  : image     the image
+     OUTPUT : -
+
+ ****************************************************************************/
+
+void IMG_Init(IMG_ImageT* image)
+{
+  image->count     = 0;
+  image->alloc     = 0;
+  image->lastAlloc = 0;
+  image->segment   = NULL;
+  image->entry     = 0;
+  image->hasEntry  = FALSE;
+} /* IMG_Init */
+
+
+void IMG_Free(IMG_ImageT* image)
+{
+  int i;
+
+  for (i = 0; i < image->count; i++) {
+    free(image->segment[i].data);
+  } /* for */
+  free(image->segment);
+  IMG_Init(image);
+} /* IMG_Free */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    IMG_AddData :
+
+    Adds data to the image. If the data continues the last segment, the
+    segment is extended, otherwise a new segment is started.
+
+     INPUT  : image     the image
+              addr      the address of the data
+              data      the data
+              count     number of data bytes
+     OUTPUT : RETURN    error code
+
+ ****************************************************************************/
+
+int IMG_AddData(IMG_ImageT* image, DWORD addr, const BYTE* data, DWORD count)
+{
+  IMG_SegmentT* seg;
+  IMG_SegmentT* newSegment;
+  BYTE*         newData;
+  DWORD         newAlloc;
+
+  if (count == 0) return BDI_OKAY;
+
+  /* start a new segment if not contiguous */
+  seg = NULL;
+  if (image->count > 0) {
+    seg = &image->segment[image->count - 1];
+    if ((seg->addr + seg->size) != addr) seg = NULL;
+  } /* if */
+  if (seg == NULL) {
+    if (image->count == image->alloc) {
+      newSegment = (IMG_SegmentT*)realloc(image->segment,
+                     (image->alloc + IMG_SEGMENT_GROW) * sizeof(IMG_SegmentT));
+      if (newSegment == NULL) return BDI_ERR_FIRMWARE_FILE;
+      image->segment = newSegment;
+      image->alloc  += IMG_SEGMENT_GROW;
+    } /* if */
+    seg = &image->segment[image->count++];
+    seg->addr = addr;
+    seg->size = 0;
+    seg->data = NULL;
+    image->lastAlloc = 0;
+  } /* if */
+
+  /* grow segment data */
+  if ((seg->size + count) > image->lastAlloc) {
+    newAlloc = 2 * image->lastAlloc;
+    if (newAlloc < IMG_DATA_GROW)          newAlloc = IMG_DATA_GROW;
+    if (newAlloc < (seg->size + count))    newAlloc = seg->size + count;
+    newData = (BYTE*)realloc(seg->data, newAlloc);
+    if (newData == NULL) return BDI_ERR_FIRMWARE_FILE;
+    seg->data = newData;
+    image->lastAlloc = newAlloc;
+  } /* if */
+
+  (void)memcpy(seg->data + seg->size, data, count);
+  seg->size += count;
+  return BDI_OKAY;
+} /* IMG_AddData */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    IMG_GetSize :
+
+    Returns the total number of data bytes in the image.
+
+ ****************************************************************************/
+
+DWORD IMG_GetSize(const IMG_ImageT* image)
+{
+  DWORD size;
+  int   i;
+
+  size = 0;
+  for (i = 0; i < image->count; i++) size += image->segment[i].size;
+  return size;
+} /* IMG_GetSize */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    IMG_Sort :
+
+    Sorts the segments by address and joins contiguous segments.
+    Overlapping segments are not allowed because flash cannot be
+    programmed twice.
+
+     INPUT  : image     the image
+     OUTPUT : RETURN    error code
+
+ ****************************************************************************/
+
+static int IMG_CompareSegment(const void* p1, const void* p2)
+{
+  const IMG_SegmentT* s1 = (const IMG_SegmentT*)p1;
+  const IMG_SegmentT* s2 = (const IMG_SegmentT*)p2;
+
+  if (s1->addr < s2->addr) return -1;
+  if (s1->addr > s2->addr) return  1;
+  return 0;
+} /* IMG_CompareSegment */
+
+
+int IMG_Sort(IMG_ImageT* image)
+{
+  IMG_SegmentT* seg;
+  IMG_SegmentT* next;
+  BYTE*         newData;
+  int           i;
+  int           n;
+
+  if (image->count < 2) return BDI_OKAY;
+  qsort(image->segment, image->count, sizeof(IMG_SegmentT), IMG_CompareSegment);
+
+  n = 0;
+  for (i = 1; i < image->count; i++) {
+    seg  = &image->segment[n];
+    next = &image->segment[i];
+    newData = NULL;
+    if (next->addr <= (seg->addr + seg->size)) {
+      if (next->addr == (seg->addr + seg->size)) {
+        newData = (BYTE*)realloc(seg->data, seg->size + next->size);
+      } /* if */
+      if (newData == NULL) {
+        /* keep the image consistent for IMG_Free */
+        for (; i < image->count; i++) free(image->segment[i].data);
+        image->count = n + 1;
+        return BDI_ERR_FIRMWARE_FILE;
+      } /* if */
+      (void)memcpy(newData + seg->size, next->data, next->size);
+      seg->data  = newData;
+      seg->size += next->size;
+      free(next->data);
+    } /* if */
+    else {
+      image->segment[++n] = *next;
+    } /* else */
+  } /* for */
+  image->count     = n + 1;
+  image->lastAlloc = image->segment[n].size;
+  return BDI_OKAY;
+} /* IMG_Sort */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    IMG_Read :
+
+    Copies a memory range out of a sorted image. Addresses not covered
+    by the image are filled with 0xFF (erased flash).
+
+     INPUT  : image     the sorted image
+              addr      start address
+              count     number of bytes
+     OUTPUT : data      the image data
+
+ ****************************************************************************/
+
+void IMG_Read(const IMG_ImageT* image, DWORD addr, DWORD count, BYTE* data)
+{
+  const IMG_SegmentT* seg;
+  DWORD   start;
+  DWORD   end;
+  int     i;
+
+  (void)memset(data, 0xFF, count);
+  for (i = 0; i < image->count; i++) {
+    seg = &image->segment[i];
+    if (seg->addr >= (addr + count)) break;
+    if ((seg->addr + seg->size) <= addr) continue;
+    start = (seg->addr > addr) ? seg->addr : addr;
+    end   = ((seg->addr + seg->size) < (addr + count)) ? (seg->addr + seg->size) : (addr + count);
+    (void)memcpy(data + (start - addr), seg->data + (start - seg->addr), end - start);
+  } /* for */
+} /* IMG_Read */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    DecodeSRecord:
+
+    Decode an Data S-Record (S1,S2,S3) or the start address of a
+    termination record (S7,S8,S9). Other records (S0,S5,S6) and the
+    bytes of a termination record are not data.
+
+    INPUT  : sRecord      the S-Record to decode
+    OUTPUT : addrPtr      the address for the decoded data or the start address
+             dataPtr      the data part of the record (binary)
+             RETURN       number of databytes, 0 if no data record, -1 if error
+
+ ****************************************************************************/
+
+static BYTE Hex2Bin(char highDigit, char lowDigit)
+{
+  static BYTE HexTable[] = {0,1,2,3,4,5,6,7,8,9,
+                            0,0,0,0,0,0,0,         /* :;<=>?@ */
+                            10,11,12,13,14,15};
+  return  (BYTE)(   (HexTable[highDigit - '0']<<4)
+                  + (HexTable[lowDigit  - '0']   ) );
+} /* Hex2Bin */
+
+
+static int DecodeSRecord(char* sRecord, DWORD* addrPtr, BYTE* dataPtr)
+{
+  int       count;
+  int       recLen;
+  int       addrLen;
+  int       i;
+  char      recType;
+  BYTE      checksum;
+  BYTE      nextValue;
+  DWORD     address;
+
+  if (*sRecord++ != 'S') return -1;
+  recType   = *sRecord++;
+  nextValue = Hex2Bin(*sRecord, *(sRecord+1));
+  sRecord  += 2;
+  checksum  = nextValue;
+  recLen    = nextValue;
+
+  /* extract address */
+  if      (recType == '1') addrLen = 2;
+  else if (recType == '2') addrLen = 3;
+  else if (recType == '3') addrLen = 4;
+  else if (recType == '7') addrLen = 4;
+  else if (recType == '8') addrLen = 3;
+  else if (recType == '9') addrLen = 2;
+  else                     return 0;
+  address = 0;
+  for (i=0; i<addrLen; i++) {
+    nextValue = Hex2Bin(*sRecord, *(sRecord+1));
+    sRecord  += 2;
+    checksum  = (BYTE)(checksum + nextValue);
+    address   = (address << 8) + nextValue;
+  } /* for */
+  *addrPtr = address;
+
+  /* get data */
+  count = recLen - addrLen - 1;
+  for (i=0; i<count; i++) {
+    nextValue = Hex2Bin(*sRecord, *(sRecord+1));
+    sRecord  += 2;
+    checksum  = (BYTE)(checksum + nextValue);
+    *dataPtr++ = nextValue;
+  } /* for */
+
+  /* check sum */
+  nextValue = Hex2Bin(*sRecord, *(sRecord+1));
+  checksum = (BYTE)(checksum + nextValue);
+  if      (checksum != 0xFF) return -1;
+  else if (recType > '3')    return 0;     /* termination record */
+  else                       return count;
+} /* DecodeSRecord */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    IMG_LoadSRecord :
+
+    Loads a S-Record file into an image.
+
+     INPUT  : szFileName    the S-Record file name
+     OUTPUT : image         the loaded image (must be initialized)
+              RETURN        error code
+
+ ****************************************************************************/
+
+int IMG_LoadSRecord(const char* szFileName, IMG_ImageT* image)
+{
+  int           result = BDI_OKAY;
+  FILE*         srecFile;
+  char          szLine[256];
+  int           dataCount;
+  DWORD         dataAddress;
+  BYTE          dataValues[256];
+
+  /* Open the firmware file (read only), may be within an archive */
+  srecFile = ARC_OpenFile(szFileName, "r");
+  if (srecFile == NULL) return BDI_ERR_FIRMWARE_FILE;
+
+  /* decode all data records */
+  while ((result == BDI_OKAY) && (fgets(szLine, sizeof szLine, srecFile) != NULL)) {
+    dataCount = DecodeSRecord(szLine, &dataAddress, dataValues);
+    if (dataCount > 0) {
+      result = IMG_AddData(image, dataAddress, dataValues, (DWORD)dataCount);
+    } /* if */
+    else if (dataCount < 0) {
+      result = BDI_ERR_FIRMWARE_FILE;
+    } /* else if */
+    else if ((szLine[1] >= '7') && (szLine[1] <= '9')) {
+      image->entry    = dataAddress;
+      image->hasEntry = TRUE;
+    } /* else if */
+  } /* while */
+  if (ferror(srecFile)) result = BDI_ERR_FIRMWARE_FILE;
+
+  fclose(srecFile);
+  if (result != BDI_OKAY) IMG_Free(image);
+  return result;
+} /* IMG_LoadSRecord */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    IMG_ReadFile :
+
+    Reads a whole file, the file may be within an archive.
+
+     INPUT  : szFileName    the file name
+     OUTPUT : data          the file contents, release with free
+              size          the file size
+              RETURN        error code
+
+ ****************************************************************************/
+
+static int IMG_ReadFile(const char* szFileName, BYTE** data, DWORD* size)
+{
+  FILE*   file;
+  BYTE*   newData;
+  DWORD   alloc;
+  size_t  count;
+
+  *data = NULL;
+  *size = 0;
+  file = ARC_OpenFile(szFileName, "rb");
+  if (file == NULL) return BDI_ERR_FIRMWARE_FILE;
+  alloc = 0;
+  do {
+    if (*size == alloc) {
+      newData = (BYTE*)realloc(*data, alloc + IMG_READ_GROW);
+      if (newData == NULL) break;
+      *data  = newData;
+      alloc += IMG_READ_GROW;
+    } /* if */
+    count  = fread(*data + *size, 1, alloc - *size, file);
+    *size += (DWORD)count;
+  } while (count > 0);
+  if ((*size < alloc) && !ferror(file)) {
+    fclose(file);
+    return BDI_OKAY;
+  } /* if */
+  fclose(file);
+  free(*data);
+  *data = NULL;
+  return BDI_ERR_FIRMWARE_FILE;
+} /* IMG_ReadFile */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    IMG_LoadElf :
+
+    Loads the PT_LOAD segments of an ELF file (32 or 64 bit, either byte
+    order) at their physical address. Only the bytes present in the file
+    are loaded, the rest of a segment (.bss) is left to the application.
+
+     INPUT  : data          the ELF file
+              size          the file size
+     OUTPUT : image         the loaded image (must be initialized)
+              RETURN        error code
+
+ ****************************************************************************/
+
+static unsigned long long IMG_ElfValue(const BYTE* data, int size, BOOL littleEndian)
+{
+  unsigned long long  value;
+  int                 i;
+
+  value = 0;
+  for (i = 0; i < size; i++) {
+    if (littleEndian) value |= (unsigned long long)data[i] << (8 * i);
+    else              value  = (value << 8) | data[i];
+  } /* for */
+  return value;
+} /* IMG_ElfValue */
+
+
+static int IMG_LoadElf(const BYTE* data, DWORD size, IMG_ImageT* image)
+{
+  const BYTE*         ph;
+  BOOL                lsb;
+  BOOL                is64;
+  unsigned long long  phoff;
+  unsigned long long  offset;
+  unsigned long long  fileSize;
+  DWORD               paddr;
+  int                 phentsize;
+  int                 phnum;
+  int                 result;
+  int                 i;
+
+  if ((size < 64) || ((data[4] != ELF_CLASS_32) && (data[4] != ELF_CLASS_64))) {
+    return BDI_ERR_FIRMWARE_FILE;
+  } /* if */
+  lsb  = (data[5] == ELF_DATA_LSB);
+  is64 = (data[4] == ELF_CLASS_64);
+  image->entry    = (DWORD)IMG_ElfValue(data + 24, is64 ? 8 : 4, lsb);
+  image->hasEntry = TRUE;
+  phoff     = IMG_ElfValue(data + (is64 ? 32 : 28), is64 ? 8 : 4, lsb);
+  phentsize = (int)IMG_ElfValue(data + (is64 ? 54 : 42), 2, lsb);
+  phnum     = (int)IMG_ElfValue(data + (is64 ? 56 : 44), 2, lsb);
+  if (   (phentsize < (is64 ? 56 : 32))
+      || (phoff + (unsigned long long)phnum * phentsize > size)) return BDI_ERR_FIRMWARE_FILE;
+
+  result = BDI_OKAY;
+  for (i = 0; (i < phnum) && (result == BDI_OKAY); i++) {
+    ph = data + phoff + (unsigned long long)i * phentsize;
+    if (IMG_ElfValue(ph, 4, lsb) != ELF_PT_LOAD) continue;
+    offset   = IMG_ElfValue(ph + (is64 ?  8 :  4), is64 ? 8 : 4, lsb);
+    paddr    = (DWORD)IMG_ElfValue(ph + (is64 ? 24 : 12), is64 ? 8 : 4, lsb);
+    fileSize = IMG_ElfValue(ph + (is64 ? 32 : 16), is64 ? 8 : 4, lsb);
+    if (offset + fileSize > size) result = BDI_ERR_FIRMWARE_FILE;
+    else result = IMG_AddData(image, paddr, data + offset, (DWORD)fileSize);
+  } /* for */
+  return result;
+} /* IMG_LoadElf */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    IMG_LoadFile :
+
+    Loads an application file into an image. The format is taken from the
+    contents: an ELF file starts with 0x7F 'ELF', a S-Record file with S0
+    to S9, any other file is loaded as binary at addr.
+
+     INPUT  : szFileName    the file name, may be within an archive
+              addr          the address of a binary file
+     OUTPUT : image         the loaded and sorted image (must be initialized)
+              RETURN        error code
+
+ ****************************************************************************/
+
+int IMG_LoadFile(const char* szFileName, DWORD addr, IMG_ImageT* image)
+{
+  int     result;
+  BYTE*   data;
+  DWORD   size;
+
+  result = IMG_ReadFile(szFileName, &data, &size);
+  if (result != BDI_OKAY) return result;
+  if ((size >= 4) && (memcmp(data, "\177ELF", 4) == 0)) {
+    result = IMG_LoadElf(data, size, image);
+  } /* if */
+  else if ((size >= 2) && (data[0] == 'S') && (data[1] >= '0') && (data[1] <= '9')) {
+    result = IMG_LoadSRecord(szFileName, image);
+  } /* else if */
+  else {
+    result = IMG_AddData(image, addr, data, size);
+  } /* else */
+  free(data);
+  if (result == BDI_OKAY) result = IMG_Sort(image);
+  if (result != BDI_OKAY) IMG_Free(image);
+  return result;
+} /* IMG_LoadFile */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    IMG_InitSymbols / IMG_FreeSymbols :
+
+    Initialize an empty symbol table / release all memory used by it.
+
+     INPUT  : symbols   the symbol table
+     OUTPUT : -
+
+ ****************************************************************************/
+
+void IMG_InitSymbols(IMG_SymbolsT* symbols)
+{
+  symbols->count   = 0;
+  symbols->symbol  = NULL;
+  symbols->strings = NULL;
+} /* IMG_InitSymbols */
+
+
+void IMG_FreeSymbols(IMG_SymbolsT* symbols)
+{
+  free(symbols->symbol);
+  free(symbols->strings);
+  IMG_InitSymbols(symbols);
+} /* IMG_FreeSymbols */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    IMG_LoadSymbols :
+
+    Loads the functions of the symbol table of an ELF file (32 or 64 bit,
+    either byte order). Aliases at the same address are dropped, a
+    function without size ends at the next function of its section and
+    no function overlaps the next one.
+
+     INPUT  : szFileName    the file name, may be within an archive
+     OUTPUT : symbols       the functions sorted by address (must be
+                            initialized)
+              RETURN        error code
+
+ ****************************************************************************/
+
+static int IMG_CompareSymbol(const void* p1, const void* p2)
+{
+  const IMG_SymbolT* s1 = (const IMG_SymbolT*)p1;
+  const IMG_SymbolT* s2 = (const IMG_SymbolT*)p2;
+
+  if (s1->addr < s2->addr) return -1;
+  if (s1->addr > s2->addr) return  1;
+  return strcmp(s1->name, s2->name);
+} /* IMG_CompareSymbol */
+
+
+int IMG_LoadSymbols(const char* szFileName, IMG_SymbolsT* symbols)
+{
+  BYTE*               data;
+  DWORD               size;
+  const BYTE*         sh;
+  const BYTE*         sym;
+  IMG_SymbolT*        s;
+  BOOL                lsb;
+  BOOL                is64;
+  unsigned long long  shoff;
+  unsigned long long  symOffset;
+  unsigned long long  symSize;
+  unsigned long long  strOffset;
+  unsigned long long  strSize;
+  unsigned long long  shstrOffset;
+  unsigned long long  shstrSize;
+  unsigned long long  nameOffset;
+  int                 shentsize;
+  int                 shnum;
+  int                 shstrndx;
+  int                 symentsize;
+  int                 shndx;
+  int                 count;
+  int                 i;
+  int                 n;
+
+  if (IMG_ReadFile(szFileName, &data, &size) != BDI_OKAY) return BDI_ERR_FIRMWARE_FILE;
+  if (   (size < 64) || (memcmp(data, "\177ELF", 4) != 0)
+      || ((data[4] != ELF_CLASS_32) && (data[4] != ELF_CLASS_64))) {
+    free(data);
+    return BDI_ERR_FIRMWARE_FILE;
+  } /* if */
+  lsb  = (data[5] == ELF_DATA_LSB);
+  is64 = (data[4] == ELF_CLASS_64);
+  shoff     = IMG_ElfValue(data + (is64 ? 40 : 32), is64 ? 8 : 4, lsb);
+  shentsize = (int)IMG_ElfValue(data + (is64 ? 58 : 46), 2, lsb);
+  shnum     = (int)IMG_ElfValue(data + (is64 ? 60 : 48), 2, lsb);
+  shstrndx  = (int)IMG_ElfValue(data + (is64 ? 62 : 50), 2, lsb);
+  symentsize = is64 ? 24 : 16;
+  if (   (shentsize < (is64 ? 64 : 40)) || (shstrndx >= shnum)
+      || (shoff + (unsigned long long)shnum * shentsize > size)) {
+    free(data);
+    return BDI_ERR_FIRMWARE_FILE;
+  } /* if */
+
+  /* the symbol table, its string table and the section names */
+  sh = NULL;
+  for (i = 0; (i < shnum) && (sh == NULL); i++) {
+    if (IMG_ElfValue(data + shoff + (unsigned long long)i * shentsize + 4, 4, lsb) == ELF_SHT_SYMTAB) {
+      sh = data + shoff + (unsigned long long)i * shentsize;
+    } /* if */
+  } /* for */
+  if (sh == NULL) {
+    free(data);
+    return BDI_ERR_FIRMWARE_FILE;
+  } /* if */
+  symOffset = IMG_ElfValue(sh + (is64 ? 24 : 16), is64 ? 8 : 4, lsb);
+  symSize   = IMG_ElfValue(sh + (is64 ? 32 : 20), is64 ? 8 : 4, lsb);
+  n         = (int)IMG_ElfValue(sh + (is64 ? 40 : 24), 4, lsb);
+  if (n >= shnum) n = 0;
+  sh = data + shoff + (unsigned long long)n * shentsize;
+  strOffset = IMG_ElfValue(sh + (is64 ? 24 : 16), is64 ? 8 : 4, lsb);
+  strSize   = IMG_ElfValue(sh + (is64 ? 32 : 20), is64 ? 8 : 4, lsb);
+  sh = data + shoff + (unsigned long long)shstrndx * shentsize;
+  shstrOffset = IMG_ElfValue(sh + (is64 ? 24 : 16), is64 ? 8 : 4, lsb);
+  shstrSize   = IMG_ElfValue(sh + (is64 ? 32 : 20), is64 ? 8 : 4, lsb);
+  if (   (symOffset + symSize > size) || (strOffset + strSize > size)
+      || (shstrOffset + shstrSize > size)) {
+    free(data);
+    return BDI_ERR_FIRMWARE_FILE;
+  } /* if */
+
+  /* both string tables are kept, terminated in case the file is not */
+  count = (int)(symSize / symentsize);
+  symbols->symbol  = (IMG_SymbolT*)malloc((size_t)(count + 1) * sizeof(IMG_SymbolT));
+  symbols->strings = (char*)malloc((size_t)(strSize + shstrSize + 2));
+  if ((symbols->symbol == NULL) || (symbols->strings == NULL)) {
+    free(data);
+    IMG_FreeSymbols(symbols);
+    return BDI_ERR_FILE_ACCESS;
+  } /* if */
+  (void)memcpy(symbols->strings, data + strOffset, (size_t)strSize);
+  symbols->strings[strSize] = 0;
+  (void)memcpy(symbols->strings + strSize + 1, data + shstrOffset, (size_t)shstrSize);
+  symbols->strings[strSize + 1 + shstrSize] = 0;
+
+  /* the defined functions */
+  for (i = 0; i < count; i++) {
+    sym   = data + symOffset + (unsigned long long)i * symentsize;
+    shndx = (int)IMG_ElfValue(sym + (is64 ? 6 : 14), 2, lsb);
+    if (   ((sym[is64 ? 4 : 12] & 0x0F) != ELF_STT_FUNC)
+        || (shndx == 0) || (shndx >= shnum)) continue;
+    s = &symbols->symbol[symbols->count];
+    nameOffset = IMG_ElfValue(sym, 4, lsb);
+    s->name    = symbols->strings + ((nameOffset < strSize) ? nameOffset : strSize);
+    s->addr    = (DWORD)IMG_ElfValue(sym + (is64 ?  8 : 4), is64 ? 8 : 4, lsb);
+    s->size    = (DWORD)IMG_ElfValue(sym + (is64 ? 16 : 8), is64 ? 8 : 4, lsb);
+    nameOffset = IMG_ElfValue(data + shoff + (unsigned long long)shndx * shentsize, 4, lsb);
+    s->section = symbols->strings + strSize + 1 + ((nameOffset < shstrSize) ? nameOffset : shstrSize);
+    if (s->name[0] != 0) symbols->count++;
+  } /* for */
+  free(data);
+  if (symbols->count == 0) return BDI_OKAY;
+
+  /* sorted without aliases */
+  qsort(symbols->symbol, symbols->count, sizeof(IMG_SymbolT), IMG_CompareSymbol);
+  n = 0;
+  for (i = 1; i < symbols->count; i++) {
+    if (symbols->symbol[i].addr != symbols->symbol[n].addr) symbols->symbol[++n] = symbols->symbol[i];
+    else if (symbols->symbol[n].size == 0) symbols->symbol[n].size = symbols->symbol[i].size;
+  } /* for */
+  symbols->count = n + 1;
+  for (i = 0; i < symbols->count; i++) {
+    s = &symbols->symbol[i];
+    if (s->size == 0) {
+      if ((i + 1 < symbols->count) && (strcmp(s[1].section, s->section) == 0)) s->size = s[1].addr - s->addr;
+      else s->size = 4;
+    } /* if */
+    if ((i + 1 < symbols->count) && (s->addr + s->size > s[1].addr)) s->size = s[1].addr - s->addr;
+  } /* for */
+  return BDI_OKAY;
+} /* IMG_LoadSymbols */
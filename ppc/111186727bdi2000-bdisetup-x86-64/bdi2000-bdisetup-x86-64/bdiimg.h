@@ -0,0 +1,94 @@
+#ifndef __BDIIMG_H__
+#define __BDIIMG_H__
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdiimg.h
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX
+|  TARGET HW   : PC
+|
+|  PROGRAMMER  : Abatron / RD
+|  CREATION    : 19.10.26
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  Helper functions to load a firmware or application file into a memory image
+|
+|
+|*************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+/*************************************************************************
+|  TYPEDEFS
+|*************************************************************************/
+
+/* a contiguous block of data */
+typedef struct {
+  DWORD   addr;
+  DWORD   size;
+  BYTE*   data;
+} IMG_SegmentT;
+
+/* a sparse memory image, segments are stored in file order until sorted */
+typedef struct {
+  int             count;
+  int             alloc;
+  DWORD           lastAlloc;      /* allocated data size of last segment */
+  IMG_SegmentT*   segment;
+  DWORD           entry;          /* start address of an application */
+  BOOL            hasEntry;       /* the file holds the start address */
+} IMG_ImageT;
+
+/* a function of an application */
+typedef struct {
+  DWORD   addr;
+  DWORD   size;
+  char*   name;
+  char*   section;        /* name of the section holding the function */
+} IMG_SymbolT;
+
+/* the functions of an ELF symbol table, sorted by address */
+typedef struct {
+  int             count;
+  IMG_SymbolT*    symbol;
+  char*           strings;        /* the names of the functions and sections */
+} IMG_SymbolsT;
+
+/*************************************************************************
+|  FUNCTIONS
+|*************************************************************************/
+
+void  IMG_Init(IMG_ImageT* image);
+void  IMG_Free(IMG_ImageT* image);
+int   IMG_AddData(IMG_ImageT* image, DWORD addr, const BYTE* data, DWORD count);
+DWORD IMG_GetSize(const IMG_ImageT* image);
+int   IMG_Sort(IMG_ImageT* image);
+void  IMG_Read(const IMG_ImageT* image, DWORD addr, DWORD count, BYTE* data);
+int   IMG_LoadSRecord(const char* szFileName, IMG_ImageT* image);
+
+/* an ELF, S-Record or binary file, a binary file is loaded at addr */
+int   IMG_LoadFile(const char* szFileName, DWORD addr, IMG_ImageT* image);
+
+/* the functions of an ELF file */
+void  IMG_InitSymbols(IMG_SymbolsT* symbols);
+void  IMG_FreeSymbols(IMG_SymbolsT* symbols);
+int   IMG_LoadSymbols(const char* szFileName, IMG_SymbolsT* symbols);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
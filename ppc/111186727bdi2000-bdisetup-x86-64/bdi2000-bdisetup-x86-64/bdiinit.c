@@ -0,0 +1,675 @@
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdiinit.c
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX / UNIX
+|  TARGET HW   : PC
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  This module analyses the [INIT] part of a compiled configuration, the
+|  list the BDI executes on every target reset. It sums up the delays and
+|  finds repeated and overwritten writes and adjacent writes that can be
+|  done with one wider write.
+|
+|  Writes are only compared within a run of consecutive entries of the
+|  same kind. Any other entry ends the run, nothing is ever moved across
+|  a DELAY, SUPM, WUPM, read or register write. A write to a device
+|  register may have a side effect (e.g. the SDRAM refresh command), so
+|  the rewrite removes or merges memory writes only within the ranges
+|  declared as plain memory. TSZ ranges limit the merged access size.
+|  Consecutive delays are always combined, overwritten WGPR removed.
+|
+|*************************************************************************/
+
+/*************************************************************************
+|  INCLUDES
+|*************************************************************************/
+
+#if defined(WIN32)
+#include <windows.h>
+#endif
+#include <stddef.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "bdierror.h"
+#include "bdidll.h"
+#include "bdicnf.h"
+#include "bdiinit.h"
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define INI_MAX_DELAY   30000   /* maximal value of one DELAY */
+#define INI_FIND_GROW   64
+
+/* runs of consecutive entries */
+#define RUN_NONE        0
+#define RUN_MEMORY      1       /* WMn */
+#define RUN_REGISTER    2       /* WGPR, WSPR, WSR and WREG */
+#define RUN_DELAY       3
+
+/* ASCII codes */
+#define CR              13
+#define LF              10
+
+/*************************************************************************
+|  TYPEDEFS
+|*************************************************************************/
+
+/* an entry of a run */
+typedef struct {
+  int                 entry;
+  int                 core;
+  DWORD               addr;
+  int                 size;
+  unsigned long long  value;
+  BOOL                plain;    /* within plain memory */
+  BOOL                removed;  /* removed by the rewrite */
+  int                 head;     /* finding of its repetitions, -1 if none */
+} INI_WriteT;
+
+/* a write while merging */
+typedef struct {
+  DWORD               addr;
+  int                 size;
+  unsigned long long  value;
+  int                 core;
+  BOOL                plain;
+  int                 count;
+  int                 member[INI_MAX_MERGE];
+} INI_ItemT;
+
+
+/****************************************************************************
+ ****************************************************************************
+    Helper functions
+ ****************************************************************************/
+
+static int INI_AddFinding(INI_ReportT* report, int kind, int entry)
+{
+  INI_FindingT* newFinding;
+
+  if (report->count == report->alloc) {
+    newFinding = (INI_FindingT*)realloc(report->finding,
+                                        (report->alloc + INI_FIND_GROW) * sizeof(INI_FindingT));
+    if (newFinding == NULL) return -1;
+    report->finding = newFinding;
+    report->alloc  += INI_FIND_GROW;
+  } /* if */
+  newFinding = &report->finding[report->count];
+  memset(newFinding, 0, sizeof *newFinding);
+  newFinding->kind      = kind;
+  newFinding->entry     = entry;
+  newFinding->other     = -1;
+  newFinding->count     = 1;
+  newFinding->member[0] = entry;
+  return report->count++;
+} /* INI_AddFinding */
+
+
+/* the first write is repeated or overwritten by the second, returns the
+   finding of the repetitions of the second write */
+static int INI_AddRewrite(INI_ReportT* report, INI_WriteT* first, INI_WriteT* second,
+                          BOOL repeated, BOOL apply)
+{
+  INI_FindingT* finding;
+  int           index;
+
+  index = first->head;
+  if (   !repeated || (index < 0)
+      || (report->finding[index].count == INI_MAX_MERGE)) {
+    index = INI_AddFinding(report, repeated ? INI_FIND_REPEATED : INI_FIND_OVERWRITTEN, first->entry);
+    if (index < 0) return -2;
+  } /* if */
+  finding = &report->finding[index];
+  finding->other = second->entry;
+  finding->apply = apply;
+  if (repeated) finding->member[finding->count++] = second->entry;
+  first->removed = apply;
+  return repeated ? index : -1;
+} /* INI_AddRewrite */
+
+
+static BOOL INI_GetWrite(const CNF_ConfigT* config, int entry, INI_WriteT* write)
+{
+  const CNF_EntryT*   e;
+  unsigned long long  addr;
+
+  e = &config->entry[entry];
+  memset(write, 0, sizeof *write);
+  write->entry = entry;
+  write->core  = e->core;
+  write->head  = -1;
+  switch (e->keyword) {
+    case CNF_KEY_WM8:  write->size = 1; break;
+    case CNF_KEY_WM16: write->size = 2; break;
+    case CNF_KEY_WM32: write->size = 4; break;
+    case CNF_KEY_WM64: write->size = 8; break;
+    default:           return FALSE;
+  } /* switch */
+  if (   (e->argCount != 2)
+      || !CNF_GetNumber(config, e, 0, &addr)
+      || !CNF_GetNumber(config, e, 1, &write->value)) return FALSE;
+  write->addr = (DWORD)addr;
+  return TRUE;
+} /* INI_GetWrite */
+
+
+static BOOL INI_IsPlain(const INI_RangeT* memory, int ranges, DWORD addr, int size)
+{
+  int     i;
+
+  for (i = 0; i < ranges; i++) {
+    if ((addr >= memory[i].start) && (addr + (DWORD)size - 1 <= memory[i].end)) return TRUE;
+  } /* for */
+  return FALSE;
+} /* INI_IsPlain */
+
+
+/* the widest access allowed by the TSZ ranges */
+static int INI_MaxAccess(const CNF_ConfigT* config, DWORD addr, int size)
+{
+  const CNF_EntryT*   e;
+  unsigned long long  start;
+  unsigned long long  end;
+  int                 maxAccess;
+  int                 limit;
+  int                 tsz;
+  int                 i;
+
+  maxAccess = INI_MAX_ACCESS;
+  limit     = 8;
+  for (i = 0; i < config->count; i++) {
+    e = &config->entry[i];
+    if      (e->keyword == CNF_KEY_TSZ1) tsz = 1;
+    else if (e->keyword == CNF_KEY_TSZ2) tsz = 2;
+    else if (e->keyword == CNF_KEY_TSZ4) tsz = 4;
+    else if (e->keyword == CNF_KEY_TSZ8) tsz = 8;
+    else continue;
+    if (   (e->part != CNF_PART_INIT)
+        || !CNF_GetNumber(config, e, 0, &start)
+        || !CNF_GetNumber(config, e, 1, &end)) continue;
+    if ((addr > end) || (addr + (DWORD)size - 1 < start)) continue;
+    if (tsz < limit) limit = tsz;
+    if ((tsz == 8) && (addr >= start) && (addr + (DWORD)size - 1 <= end)) maxAccess = 8;
+  } /* for */
+  return (limit < maxAccess) ? limit : maxAccess;
+} /* INI_MaxAccess */
+
+
+static int INI_GetRunType(int keyword)
+{
+  switch (keyword) {
+    case CNF_KEY_WM8:
+    case CNF_KEY_WM16:
+    case CNF_KEY_WM32:
+    case CNF_KEY_WM64:  return RUN_MEMORY;
+    case CNF_KEY_WGPR:
+    case CNF_KEY_WSPR:
+    case CNF_KEY_WSR:
+    case CNF_KEY_WREG:  return RUN_REGISTER;
+    case CNF_KEY_DELAY: return RUN_DELAY;
+    default:            return RUN_NONE;
+  } /* switch */
+} /* INI_GetRunType */
+
+
+/* same register or value, numbers compared by value, names ignoring case */
+static BOOL INI_SameArg(const CNF_ConfigT* config, const CNF_EntryT* e1, const CNF_EntryT* e2, int index)
+{
+  unsigned long long  value1;
+  unsigned long long  value2;
+  const char*         szArg1;
+  const char*         szArg2;
+  int                 i;
+
+  if (   CNF_GetNumber(config, e1, index, &value1)
+      && CNF_GetNumber(config, e2, index, &value2)) return value1 == value2;
+  if (e1->arg[index].len != e2->arg[index].len) return FALSE;
+  szArg1 = CNF_GetText(config, e1) + e1->arg[index].pos;
+  szArg2 = CNF_GetText(config, e2) + e2->arg[index].pos;
+  for (i = 0; i < e1->arg[index].len; i++) {
+    if (toupper((BYTE)szArg1[i]) != toupper((BYTE)szArg2[i])) return FALSE;
+  } /* for */
+  return TRUE;
+} /* INI_SameArg */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    INI_MemoryRun :
+
+    Finds the repeated, overwritten and mergeable writes of a run of
+    consecutive memory writes. A write is overwritten if the next write
+    touching one of its bytes writes all of them.
+
+     INPUT  : config    the compiled configuration
+              write     the writes of the run
+              count     number of writes
+              item      space for the merge of count writes
+     OUTPUT : report    the findings
+              RETURN    error code
+
+ ****************************************************************************/
+
+static int INI_MemoryRun(const CNF_ConfigT* config, INI_WriteT* write, int count,
+                         INI_ItemT* item, INI_ReportT* report)
+{
+  INI_WriteT*   w1;
+  INI_WriteT*   w2;
+  INI_ItemT*    low;
+  INI_ItemT*    high;
+  INI_ItemT     merged;
+  INI_FindingT* finding;
+  BOOL          changed;
+  int           items;
+  int           index;
+  int           size;
+  int           i;
+  int           j;
+
+  /* repeated and overwritten writes */
+  for (i = 0; i < count; i++) {
+    w1 = &write[i];
+    w2 = NULL;
+    for (j = i + 1; j < count; j++) {
+      w2 = &write[j];
+      if ((w2->addr < w1->addr + w1->size) && (w1->addr < w2->addr + w2->size)) break;
+    } /* for */
+    if ((j == count) || (w2->core != w1->core)) continue;
+    if ((w2->addr > w1->addr) || (w2->addr + w2->size < w1->addr + w1->size)) continue;
+    index = INI_AddRewrite(report, w1, w2,
+                           (w2->addr == w1->addr) && (w2->size == w1->size) && (w2->value == w1->value),
+                           w1->plain);
+    if (index < -1) return BDI_ERR_FILE_ACCESS;
+    w2->head = index;
+  } /* for */
+
+  /* merge adjacent writes of the same size into aligned wider writes */
+  items = 0;
+  for (i = 0; i < count; i++) {
+    if (write[i].removed) continue;
+    item[items].addr      = write[i].addr;
+    item[items].size      = write[i].size;
+    item[items].value     = write[i].value;
+    item[items].core      = write[i].core;
+    item[items].plain     = write[i].plain;
+    item[items].count     = 1;
+    item[items].member[0] = write[i].entry;
+    items++;
+  } /* for */
+  do {
+    changed = FALSE;
+    for (i = 0; i + 1 < items; i++) {
+      if (item[i].addr < item[i + 1].addr) {
+        low  = &item[i];
+        high = &item[i + 1];
+      } /* if */
+      else {
+        low  = &item[i + 1];
+        high = &item[i];
+      } /* else */
+      size = 2 * low->size;
+      if (   (low->size != high->size) || (low->core != high->core) || (low->plain != high->plain)
+          || (high->addr != low->addr + (DWORD)low->size) || ((low->addr % (DWORD)size) != 0)
+          || (low->count + high->count > INI_MAX_MERGE)
+          || (size > INI_MaxAccess(config, low->addr, size))) continue;
+      merged.addr  = low->addr;
+      merged.size  = size;
+      merged.core  = low->core;
+      merged.plain = low->plain;
+      if (report->littleEndian) merged.value = (high->value << (4 * size)) | low->value;
+      else                      merged.value = (low->value << (4 * size)) | high->value;
+      merged.count = item[i].count + item[i + 1].count;
+      memcpy(merged.member, item[i].member, item[i].count * sizeof(int));
+      memcpy(merged.member + item[i].count, item[i + 1].member, item[i + 1].count * sizeof(int));
+      item[i] = merged;
+      items--;
+      for (j = i + 1; j < items; j++) item[j] = item[j + 1];
+      changed = TRUE;
+    } /* for */
+  } while (changed);
+
+  for (i = 0; i < items; i++) {
+    if (item[i].count == 1) continue;
+    index = INI_AddFinding(report, INI_FIND_MERGEABLE, item[i].member[0]);
+    if (index < 0) return BDI_ERR_FILE_ACCESS;
+    finding = &report->finding[index];
+    finding->count = item[i].count;
+    memcpy(finding->member, item[i].member, item[i].count * sizeof(int));
+    finding->other = item[i].member[item[i].count - 1];
+    finding->size  = item[i].size;
+    finding->addr  = item[i].addr;
+    finding->value = item[i].value;
+    finding->apply = item[i].plain;
+  } /* for */
+  return BDI_OKAY;
+} /* INI_MemoryRun */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    INI_RegisterRun / INI_DelayRun :
+
+    Finds the repeated and overwritten register writes of a run, only
+    general purpose registers are removed by the rewrite. Consecutive
+    delays are combined into one.
+
+     INPUT  : config    the compiled configuration
+              write     the entries of the run
+              count     number of entries
+     OUTPUT : report    the findings
+              RETURN    error code
+
+ ****************************************************************************/
+
+static int INI_RegisterRun(const CNF_ConfigT* config, INI_WriteT* write, int count,
+                           INI_ReportT* report)
+{
+  const CNF_EntryT* e1;
+  const CNF_EntryT* e2;
+  int               index;
+  int               i;
+  int               j;
+
+  for (i = 0; i < count; i++) {
+    e1 = &config->entry[write[i].entry];
+    if (e1->argCount != 2) continue;
+    e2 = NULL;
+    for (j = i + 1; j < count; j++) {
+      e2 = &config->entry[write[j].entry];
+      if (   (e2->keyword == e1->keyword) && (e2->core == e1->core)
+          && (e2->argCount == 2) && INI_SameArg(config, e1, e2, 0)) break;
+    } /* for */
+    if (j == count) continue;
+    index = INI_AddRewrite(report, &write[i], &write[j], INI_SameArg(config, e1, e2, 1),
+                           e1->keyword == CNF_KEY_WGPR);
+    if (index < -1) return BDI_ERR_FILE_ACCESS;
+    write[j].head = index;
+  } /* for */
+  return BDI_OKAY;
+} /* INI_RegisterRun */
+
+
+static int INI_DelayRun(const CNF_ConfigT* config, INI_WriteT* write, int count,
+                        INI_ReportT* report)
+{
+  INI_FindingT*       finding;
+  unsigned long long  delay;
+  unsigned long long  total;
+  int                 first;
+  int                 index;
+  int                 i;
+  int                 j;
+
+  first = 0;
+  total = 0;
+  for (i = 0; i <= count; i++) {
+    delay = INI_MAX_DELAY;
+    if (i < count) (void)CNF_GetNumber(config, &config->entry[write[i].entry], 0, &delay);
+    if (   (i < count) && (i - first < INI_MAX_MERGE)
+        && (write[i].core == write[first].core) && (total + delay <= INI_MAX_DELAY)) {
+      total += delay;
+      continue;
+    } /* if */
+
+    /* the delays from first combined into one */
+    if (i - first > 1) {
+      index = INI_AddFinding(report, INI_FIND_DELAYS, write[first].entry);
+      if (index < 0) return BDI_ERR_FILE_ACCESS;
+      finding = &report->finding[index];
+      for (j = first; j < i; j++) finding->member[j - first] = write[j].entry;
+      finding->count = i - first;
+      finding->other = write[i - 1].entry;
+      finding->value = total;
+      finding->apply = TRUE;
+    } /* if */
+    first = i;
+    total = delay;
+  } /* for */
+  return BDI_OKAY;
+} /* INI_DelayRun */
+
+
+static int INI_CompareFinding(const void* p1, const void* p2)
+{
+  const INI_FindingT* f1 = (const INI_FindingT*)p1;
+  const INI_FindingT* f2 = (const INI_FindingT*)p2;
+
+  if (f1->entry < f2->entry) return -1;
+  if (f1->entry > f2->entry) return  1;
+  return f1->kind - f2->kind;
+} /* INI_CompareFinding */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    INI_Analyse :
+
+    Analyses the [INIT] part of a compiled configuration.
+
+     INPUT  : config    the compiled configuration
+              memory    the plain memory ranges
+              ranges    number of ranges
+     OUTPUT : report    the statistics and findings, release with INI_Free
+              RETURN    error code
+
+ ****************************************************************************/
+
+int INI_Analyse(const CNF_ConfigT* config, const INI_RangeT* memory, int ranges,
+                INI_ReportT* report)
+{
+  const CNF_EntryT*   e;
+  INI_WriteT*         write;
+  INI_ItemT*          item;
+  INI_FindingT*       finding;
+  unsigned long long  delay;
+  char                szEndian[8];
+  int                 result;
+  int                 runType;
+  int                 type;
+  int                 count;
+  int                 i;
+  int                 j;
+
+  memset(report, 0, sizeof *report);
+  report->change = (int*)calloc((size_t)config->count + 1, sizeof(int));
+  write = (INI_WriteT*)malloc(((size_t)config->count + 1) * sizeof(INI_WriteT));
+  item  = (INI_ItemT*)malloc(((size_t)config->count + 1) * sizeof(INI_ItemT));
+  if ((report->change == NULL) || (write == NULL) || (item == NULL)) {
+    free(write);
+    free(item);
+    INI_Free(report);
+    return BDI_ERR_FILE_ACCESS;
+  } /* if */
+
+  /* byte order of the target, merged values depend on it */
+  for (i = 0; i < config->count; i++) {
+    e = &config->entry[i];
+    if ((e->part != CNF_PART_TARGET) || (e->keyword != CNF_KEY_NONE) || (e->argCount < 1)) continue;
+    for (j = 0; j < 7; j++) szEndian[j] = (char)toupper((BYTE)CNF_GetText(config, e)[j]);
+    if (   (strncmp(szEndian, "ENDIAN ", 7) == 0)
+        && CNF_GetString(config, e, 0, szEndian, (int)sizeof szEndian)) {
+      report->littleEndian = (toupper((BYTE)szEndian[0]) == 'L');
+    } /* if */
+  } /* for */
+
+  /* the runs of consecutive entries of the same kind, TSZ and MMAP only
+     declare ranges and do not end a run */
+  result  = BDI_OKAY;
+  runType = RUN_NONE;
+  count   = 0;
+  for (i = 0; (i <= config->count) && (result == BDI_OKAY); i++) {
+    type = RUN_NONE;
+    if (i < config->count) {
+      e = &config->entry[i];
+      if ((e->part == CNF_PART_INIT) && (e->keyword != CNF_KEY_PART)) {
+        if (   (e->keyword == CNF_KEY_TSZ1) || (e->keyword == CNF_KEY_TSZ2) || (e->keyword == CNF_KEY_TSZ4)
+            || (e->keyword == CNF_KEY_TSZ8) || (e->keyword == CNF_KEY_MMAP)) continue;
+        report->entries++;
+        type = INI_GetRunType(e->keyword);
+        if (type == RUN_MEMORY)   report->memWrites++;
+        if (type == RUN_REGISTER) report->regWrites++;
+        if (   (e->keyword == CNF_KEY_RM8) || (e->keyword == CNF_KEY_RM16)
+            || (e->keyword == CNF_KEY_RM32) || (e->keyword == CNF_KEY_RM64)) report->memReads++;
+        if ((type == RUN_DELAY) && CNF_GetNumber(config, e, 0, &delay)) {
+          report->delays++;
+          report->delayTime += (DWORD)delay;
+        } /* if */
+        if ((type == RUN_MEMORY) && !INI_GetWrite(config, i, &write[count])) type = RUN_NONE;
+      } /* if */
+      else if (e->keyword == CNF_KEY_PART) {
+        continue;
+      } /* else if */
+    } /* if */
+
+    /* the run ends */
+    if ((type != runType) && (count > 0)) {
+      if (runType == RUN_MEMORY)   result = INI_MemoryRun(config, write, count, item, report);
+      if (runType == RUN_REGISTER) result = INI_RegisterRun(config, write, count, report);
+      if (runType == RUN_DELAY)    result = INI_DelayRun(config, write, count, report);
+      if (type == RUN_MEMORY) write[0] = write[count];
+      count = 0;
+    } /* if */
+    runType = type;
+    if (type == RUN_NONE) continue;
+    if (type == RUN_MEMORY) {
+      write[count].plain = INI_IsPlain(memory, ranges, write[count].addr, write[count].size);
+    } /* if */
+    else {
+      memset(&write[count], 0, sizeof write[count]);
+      write[count].entry = i;
+      write[count].core  = config->entry[i].core;
+      write[count].head  = -1;
+    } /* else */
+    count++;
+  } /* for */
+  free(write);
+  free(item);
+  if (result != BDI_OKAY) {
+    INI_Free(report);
+    return result;
+  } /* if */
+
+  /* the changes of the rewrite */
+  if (report->count > 1) {
+    qsort(report->finding, report->count, sizeof(INI_FindingT), INI_CompareFinding);
+  } /* if */
+  for (i = 0; i < report->count; i++) {
+    finding = &report->finding[i];
+    if (!finding->apply) continue;
+    switch (finding->kind) {
+      case INI_FIND_REPEATED:
+        for (j = 0; j < finding->count - 1; j++) report->change[finding->member[j]] = -1;
+        break;
+      case INI_FIND_OVERWRITTEN:
+        report->change[finding->entry] = -1;
+        break;
+      default:
+        report->change[finding->member[0]] = i + 1;
+        for (j = 1; j < finding->count; j++) report->change[finding->member[j]] = -1;
+        break;
+    } /* switch */
+  } /* for */
+  return BDI_OKAY;
+} /* INI_Analyse */
+
+
+void INI_Free(INI_ReportT* report)
+{
+  free(report->change);
+  free(report->finding);
+  memset(report, 0, sizeof *report);
+} /* INI_Free */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    INI_Rewrite :
+
+    Rewrites the configuration file with the findings to apply. The file
+    keeps its lines, a removed entry is commented out and a replaced
+    entry is followed by the original line as comment.
+
+     INPUT  : config    the compiled configuration
+              report    the analysis of the configuration
+     OUTPUT : text      the rewritten file, release with free()
+              textSize  its size
+              RETURN    error code
+
+ ****************************************************************************/
+
+int INI_Rewrite(const CNF_ConfigT* config, const INI_ReportT* report,
+                BYTE** text, int* textSize)
+{
+  const INI_FindingT* finding;
+  const CNF_EntryT*   e;
+  const BYTE*         source;
+  char                szLine[80];
+  int                 lineLength;
+  int                 lineEnd;
+  int                 change;
+  int                 count;
+  int                 line;
+  int                 pos;
+  int                 i;
+
+  /* at most one comment character and one replacement per line */
+  *text = (BYTE*)malloc((size_t)config->sourceSize + (size_t)config->count * (sizeof szLine + 1) + 1);
+  if (*text == NULL) return BDI_ERR_FILE_ACCESS;
+  source = config->source;
+  count  = 0;
+  line   = 0;
+  pos    = 0;
+  i      = 0;
+  while (pos < config->sourceSize) {
+    line++;
+    for (lineEnd = pos; (lineEnd < config->sourceSize) && (source[lineEnd] != LF); lineEnd++);
+    lineLength = lineEnd - pos;
+    if ((lineLength > 0) && (source[lineEnd - 1] == CR)) lineLength--;
+    while ((i < config->count) && (config->entry[i].line < line)) i++;
+    change = ((i < config->count) && (config->entry[i].line == line)) ? report->change[i] : 0;
+
+    if (change < 0) {
+      (*text)[count++] = ';';
+    } /* if */
+    else if (change > 0) {
+      finding = &report->finding[change - 1];
+      e = &config->entry[i];
+      szLine[0] = 0;
+      if (e->core >= 0) sprintf(szLine, "#%i ", e->core);
+      if (finding->kind == INI_FIND_DELAYS) {
+        sprintf(szLine + strlen(szLine), "DELAY\t\t\t\t%lu", (unsigned long)finding->value);
+      } /* if */
+      else {
+        sprintf(szLine + strlen(szLine), "WM%i\t\t0x%08lx\t\t0x%0*llx",
+                8 * finding->size, (unsigned long)finding->addr, 2 * finding->size, finding->value);
+      } /* else */
+      strcat(szLine, "\t;");
+      memcpy(*text + count, szLine, strlen(szLine));
+      count += (int)strlen(szLine);
+    } /* else if */
+    memcpy(*text + count, source + pos, (size_t)lineLength);
+    count += lineLength;
+    if (lineLength < lineEnd - pos) (*text)[count++] = CR;
+    if (lineEnd < config->sourceSize) (*text)[count++] = LF;
+    pos = lineEnd + 1;
+  } /* while */
+  *textSize = count;
+  return BDI_OKAY;
+} /* INI_Rewrite */
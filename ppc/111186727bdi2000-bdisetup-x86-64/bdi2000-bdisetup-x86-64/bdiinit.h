@@ -0,0 +1,96 @@
+#ifndef __BDIINIT_H__
+#define __BDIINIT_H__
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdiinit.h
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX
+|  TARGET HW   : PC
+|
+|  PROGRAMMER  : Abatron / RD
+|  CREATION    : 19.10.26
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  Analysis and optimization of the [INIT] part of a configuration
+|
+|
+|*************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define INI_MAX_RANGES          8      /* plain memory ranges */
+#define INI_MAX_MERGE           8      /* writes merged into one */
+#define INI_MAX_ACCESS          4      /* widest merged write without TSZ8 */
+
+/* findings */
+#define INI_FIND_REPEATED       1      /* the same write again */
+#define INI_FIND_OVERWRITTEN    2      /* written again before it is used */
+#define INI_FIND_MERGEABLE      3      /* adjacent writes, one wider write */
+#define INI_FIND_DELAYS         4      /* consecutive delays, one delay */
+
+/*************************************************************************
+|  TYPEDEFS
+|*************************************************************************/
+
+/* memory without side effects, writes may be removed or merged */
+typedef struct {
+  DWORD         start;
+  DWORD         end;            /* last address */
+} INI_RangeT;
+
+typedef struct {
+  int           kind;           /* INI_FIND_xxx */
+  int           entry;          /* the entry found */
+  int           other;          /* the overwriting entry or the last repetition */
+  int           count;          /* entries merged or repeated */
+  int           member[INI_MAX_MERGE];  /* the merged entries, first is kept */
+  int           size;           /* merged write: access size */
+  DWORD         addr;
+  unsigned long long value;     /* merged write or delay value */
+  BOOL          apply;          /* done by the rewrite */
+} INI_FindingT;
+
+typedef struct {
+  int           entries;        /* entries of [INIT] */
+  int           memWrites;
+  int           memReads;
+  int           regWrites;
+  int           delays;
+  DWORD         delayTime;      /* ms */
+  BOOL          littleEndian;
+  int*          change;         /* per entry: 0 kept, -1 removed, n replaced by finding n-1 */
+  INI_FindingT* finding;
+  int           count;
+  int           alloc;
+} INI_ReportT;
+
+/*************************************************************************
+|  FUNCTIONS
+|*************************************************************************/
+
+int   INI_Analyse(const CNF_ConfigT* config, const INI_RangeT* memory, int ranges,
+                  INI_ReportT* report);
+void  INI_Free(INI_ReportT* report);
+
+/* the configuration file with the findings to apply rewritten */
+int   INI_Rewrite(const CNF_ConfigT* config, const INI_ReportT* report,
+                  BYTE** text, int* textSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,284 @@
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdijrn.c
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX / UNIX
+|  TARGET HW   : PC
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  This module keeps a journal of a firmware update for every BDI, named
+|  after its serial number. The journal records the hash of the update
+|  plan, every erased sector and the number of acknowledged program
+|  blocks. If the connection is lost, a rerun with the same firmware
+|  continues where the update stopped instead of starting again.
+|
+|  Format (text, lines are appended as the update progresses):
+|    BDIJRN <format> <plan hash>
+|    E <sector address>
+|    P <number of programmed blocks>
+|  An incomplete last line is ignored. The journal is removed when the
+|  update is done.
+|
+|*************************************************************************/
+
+/*************************************************************************
+|  INCLUDES
+|*************************************************************************/
+
+#if defined(WIN32)
+#include <windows.h>
+#define MAXPATHLEN  _MAX_PATH
+#else
+#include <sys/param.h>
+#endif /* defined(WIN32) */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "bdierror.h"
+#include "bdidll.h"
+#include "bdijrn.h"
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define JRN_FORMAT          1
+#define JRN_MAX_SERIAL      16      /* characters of the serial used */
+
+/*************************************************************************
+|  LOCALS
+|*************************************************************************/
+
+static char jrnDir[MAXPATHLEN] = "";     /* empty if journal is disabled */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    JRN_SetDirectory :
+
+    Sets the directory for the journal files, the directory is created
+    if it does not exist.
+
+     INPUT  : szDir     the journal directory, NULL or empty to disable
+     OUTPUT : -
+
+ ****************************************************************************/
+
+void JRN_SetDirectory(const char* szDir)
+{
+  jrnDir[0] = 0;
+  if ((szDir == NULL) || (*szDir == 0)) return;
+  if (strlen(szDir) >= (sizeof jrnDir - 32)) return;
+#if defined(WIN32)
+  (void)CreateDirectory(szDir, NULL);
+#else
+  (void)mkdir(szDir, 0777);
+#endif
+  strcpy(jrnDir, szDir);
+} /* JRN_SetDirectory */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    JRN_Load :
+
+    Loads the state of a journal written for the same plan.
+
+ ****************************************************************************/
+
+static BOOL JRN_Load(JRN_JournalT* journal, unsigned long long hash)
+{
+  FILE*               file;
+  char                szLine[64];
+  unsigned int        format;
+  unsigned long long  savedHash;
+  unsigned long       addr;
+  int                 blocks;
+  BOOL                valid;
+
+  file = fopen(journal->szFileName, "r");
+  if (file == NULL) return FALSE;
+  valid = (   (fgets(szLine, sizeof szLine, file) != NULL)
+           && (sscanf(szLine, "BDIJRN %u %llx", &format, &savedHash) == 2)
+           && (format == JRN_FORMAT) && (savedHash == hash));
+
+  /* a line without newline was interrupted while written */
+  while (valid && (fgets(szLine, sizeof szLine, file) != NULL)) {
+    if (strchr(szLine, '\n') == NULL) break;
+    if (sscanf(szLine, "E %lx", &addr) == 1) {
+      if (!JRN_IsErased(journal, addr) && (journal->eraseCount < JRN_MAX_ERASED)) {
+        journal->erase[journal->eraseCount++] = addr;
+      } /* if */
+    } /* if */
+    else if ((sscanf(szLine, "P %i", &blocks) == 1) && (blocks > journal->blocks)) {
+      journal->blocks = blocks;
+    } /* else if */
+  } /* while */
+  fclose(file);
+  if (!valid) {
+    journal->eraseCount = 0;
+    journal->blocks     = 0;
+  } /* if */
+  return valid;
+} /* JRN_Load */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    JRN_Open :
+
+    Opens the journal of a BDI. If the journal was written for the same
+    plan, its state is loaded, otherwise a new journal is started.
+
+     INPUT  : szSerial  the serial number of the BDI
+              hash      the hash of the update plan
+     OUTPUT : journal   the journal and its state
+              RETURN    TRUE if a previous state was loaded
+
+ ****************************************************************************/
+
+BOOL JRN_Open(JRN_JournalT* journal, const char* szSerial, unsigned long long hash)
+{
+  char  szSerialName[JRN_MAX_SERIAL + 1];
+  int   i;
+  BOOL  resume;
+
+  journal->file       = NULL;
+  journal->szFileName = NULL;
+  journal->eraseCount = 0;
+  journal->blocks     = 0;
+  if (jrnDir[0] == 0) return FALSE;
+
+  /* use only plain characters of the serial number as file name */
+  for (i = 0; (i < JRN_MAX_SERIAL) && (szSerial[i] != 0); i++) {
+    szSerialName[i] = isalnum((unsigned char)szSerial[i]) ? szSerial[i] : '_';
+  } /* for */
+  szSerialName[i] = 0;
+  journal->szFileName = (char*)malloc(strlen(jrnDir) + JRN_MAX_SERIAL + 8);
+  if (journal->szFileName == NULL) return FALSE;
+  sprintf(journal->szFileName, "%s/%s.jrn", jrnDir, szSerialName);
+
+  resume = JRN_Load(journal, hash);
+  if (resume) {
+    journal->file = fopen(journal->szFileName, "a");
+  } /* if */
+  else {
+    journal->file = fopen(journal->szFileName, "w");
+    if (journal->file != NULL) {
+      fprintf(journal->file, "BDIJRN %u %016llx\n", JRN_FORMAT, hash);
+      fflush(journal->file);
+    } /* if */
+  } /* else */
+  return resume && (journal->file != NULL);
+} /* JRN_Open */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    JRN_Reset :
+
+    Forgets the state of the journal, the update starts again.
+
+ ****************************************************************************/
+
+void JRN_Reset(JRN_JournalT* journal)
+{
+  char  szLine[64];
+
+  journal->eraseCount = 0;
+  journal->blocks     = 0;
+  if (journal->file == NULL) return;
+
+  /* keep the header line */
+  fclose(journal->file);
+  journal->file = fopen(journal->szFileName, "r");
+  if (journal->file == NULL) return;
+  if (fgets(szLine, sizeof szLine, journal->file) == NULL) szLine[0] = 0;
+  fclose(journal->file);
+  journal->file = fopen(journal->szFileName, "w");
+  if (journal->file == NULL) return;
+  fputs(szLine, journal->file);
+  fflush(journal->file);
+} /* JRN_Reset */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    JRN_IsErased / JRN_Erased / JRN_Programmed :
+
+    Query / record the progress of the update. Every record is flushed,
+    so it survives when the connection is lost.
+
+ ****************************************************************************/
+
+BOOL JRN_IsErased(const JRN_JournalT* journal, DWORD addr)
+{
+  int   i;
+
+  for (i = 0; i < journal->eraseCount; i++) {
+    if (journal->erase[i] == addr) return TRUE;
+  } /* for */
+  return FALSE;
+} /* JRN_IsErased */
+
+
+void JRN_Erased(JRN_JournalT* journal, DWORD addr)
+{
+  if (!JRN_IsErased(journal, addr) && (journal->eraseCount < JRN_MAX_ERASED)) {
+    journal->erase[journal->eraseCount++] = addr;
+  } /* if */
+  if (journal->file == NULL) return;
+  fprintf(journal->file, "E %08lx\n", addr);
+  fflush(journal->file);
+} /* JRN_Erased */
+
+
+void JRN_Programmed(JRN_JournalT* journal, int blocks)
+{
+  journal->blocks = blocks;
+  if (journal->file == NULL) return;
+  fprintf(journal->file, "P %i\n", blocks);
+  fflush(journal->file);
+} /* JRN_Programmed */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    JRN_Close :
+
+    Closes the journal, the journal of a finished update is removed.
+
+     INPUT  : journal   the journal
+              done      TRUE if the update is done
+     OUTPUT : -
+
+ ****************************************************************************/
+
+void JRN_Close(JRN_JournalT* journal, BOOL done)
+{
+  if (journal->file != NULL) {
+    fclose(journal->file);
+    if (done) (void)remove(journal->szFileName);
+  } /* if */
+  free(journal->szFileName);
+  journal->file       = NULL;
+  journal->szFileName = NULL;
+} /* JRN_Close */
@@ -0,0 +1,65 @@
+#ifndef __BDIJRN_H__
+#define __BDIJRN_H__
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdijrn.h
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX
+|  TARGET HW   : PC
+|
+|  PROGRAMMER  : Abatron / RD
+|  CREATION    : 19.10.26
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  Checkpoint journal of a firmware update, per BDI serial number
+|
+|
+|*************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define JRN_MAX_ERASED  64      /* erased sectors recorded */
+
+/*************************************************************************
+|  TYPEDEFS
+|*************************************************************************/
+
+typedef struct {
+  FILE*   file;                   /* NULL if the journal is disabled */
+  char*   szFileName;
+  int     eraseCount;             /* sectors erased */
+  DWORD   erase[JRN_MAX_ERASED];
+  int     blocks;                 /* program blocks acknowledged */
+} JRN_JournalT;
+
+/*************************************************************************
+|  FUNCTIONS
+|*************************************************************************/
+
+/* the journal is disabled until a directory is set */
+void  JRN_SetDirectory(const char* szDir);
+BOOL  JRN_Open(JRN_JournalT* journal, const char* szSerial, unsigned long long hash);
+void  JRN_Reset(JRN_JournalT* journal);
+BOOL  JRN_IsErased(const JRN_JournalT* journal, DWORD addr);
+void  JRN_Erased(JRN_JournalT* journal, DWORD addr);
+void  JRN_Programmed(JRN_JournalT* journal, int blocks);
+void  JRN_Close(JRN_JournalT* journal, BOOL done);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,327 @@
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdiload.c
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX / UNIX
+|  TARGET HW   : PC
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  This module downloads an application image into target memory through
+|  the BDI firmware. Every segment is loaded in chunks of LDR_CHUNK_SIZE.
+|  With fast load the blocks of a chunk are streamed back to back, the
+|  BDI does not answer them. The checksum of the target memory then shows
+|  if the chunk arrived, else the chunk is loaded again with single
+|  blocks. A firmware without fast load gets single blocks only, with up
+|  to BDI_PipeDepth() of them in flight.
+|
+|  Commands and answers (link format, Motorola byte order):
+|    LOAD_INIT           addr size             ACK, fast load available
+|    LOAD_BLOCK          addr count data       (no answer)
+|    FETCH_XSUM          addr size             SEND_LONG sum of the bytes
+|    LOAD_SINGLE_BLOCK   addr count data       ACK
+|    SET_PC              pc                    ACK
+|
+|*************************************************************************/
+
+/*************************************************************************
+|  INCLUDES
+|*************************************************************************/
+
+#if defined(WIN32)
+#include <windows.h>
+#endif
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "bdierror.h"
+#include "bdicmd.h"
+#include "bdidll.h"
+#include "bdiimg.h"
+#include "bdiload.h"
+
+/*************************************************************************
+|  LOCALS
+|*************************************************************************/
+
+static BYTE ldrCommand[BDI_MAX_BLOCK_SIZE + 8];
+static BYTE ldrAnswer[BDI_MAX_FRAME_SIZE];
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    BDI_Append___ :
+
+    Host independent helper function to append a numeric value to a buffer.
+    The bytes will be stored in the link format order (Motorola byte order).
+
+     INPUT  : value     value
+              buffer    pointer to buffer
+     OUTPUT : RETURN    pointer to next byte after the stored value
+
+ ****************************************************************************/
+
+static BYTE* BDI_AppendByte(BYTE  value, BYTE* buffer)
+{
+  *buffer++ = value;
+  return buffer;
+} /* BDI_AppendByte */
+
+static BYTE* BDI_AppendWord(WORD value, BYTE* buffer)
+{
+  *buffer++ = (BYTE)(value>>8);
+  *buffer++ = (BYTE)value;
+  return buffer;
+} /* BDI_AppendWord */
+
+static BYTE* BDI_AppendLong(DWORD value, BYTE* buffer)
+{
+  *buffer++ = (BYTE)(value>>24);
+  *buffer++ = (BYTE)(value>>16);
+  *buffer++ = (BYTE)(value>>8);
+  *buffer++ = (BYTE)value;
+  return buffer;
+} /* BDI_AppendLong */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    LDR_Command :
+
+    Executes a command answered with ACK.
+
+     INPUT  : length    length of the command in ldrCommand
+              time      execution time
+     OUTPUT : RETURN    error code, BDI_ERR_INVALID_RESPONSE if not ACK
+
+ ****************************************************************************/
+
+static int LDR_Command(int length, DWORD time)
+{
+  int     rxCount;
+
+  rxCount = BDI_Transaction(length, ldrCommand, sizeof ldrAnswer, ldrAnswer, time);
+  if (rxCount < 0) return rxCount;
+  if ((rxCount != 1) || (ldrAnswer[0] != BDI_ANS_ACK)) return BDI_ERR_INVALID_RESPONSE;
+  return BDI_OKAY;
+} /* LDR_Command */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    LDR_LoadBlocks :
+
+    Loads a range with LOAD_SINGLE_BLOCK, up to BDI_PipeDepth() blocks
+    are in flight. After an error only the pipe is emptied.
+
+     INPUT  : addr        first address
+              count       number of bytes
+              data        the data
+     OUTPUT : statistics  commands counted
+              RETURN      error code
+
+ ****************************************************************************/
+
+static int LDR_LoadBlocks(DWORD addr, DWORD count, const BYTE* data, LDR_StatisticsT* statistics)
+{
+  BYTE*   cmdPtr;
+  WORD    blockCount;
+  DWORD   sent;
+  int     pending;
+  int     result;
+  int     rxCount;
+
+  if (BDI_PipeDepth() < 1) return BDI_ERR_NOT_CONNECTED;
+  result  = BDI_OKAY;
+  sent    = 0;
+  pending = 0;
+  for (;;) {
+
+    /* send blocks while the pipe is not full */
+    while ((result == BDI_OKAY) && (sent < count) && (pending < BDI_PipeDepth())) {
+      blockCount = BDI_MAX_BLOCK_SIZE;
+      if (count - sent < blockCount) blockCount = (WORD)(count - sent);
+      cmdPtr = BDI_AppendByte(BDI_CMD_LOAD_SINGLE_BLOCK, ldrCommand);
+      cmdPtr = BDI_AppendLong(addr + sent, cmdPtr);
+      cmdPtr = BDI_AppendWord(blockCount, cmdPtr);
+      (void)memcpy(cmdPtr, data + sent, blockCount);
+      cmdPtr += blockCount;
+      result = BDI_PipeSend(cmdPtr-ldrCommand, ldrCommand, LDR_EXEC_TIME);
+      if (result == BDI_OKAY) {
+        statistics->commands++;
+        sent += blockCount;
+        pending++;
+      } /* if */
+    } /* while */
+    if (pending == 0) break;
+
+    /* the answer of the oldest block */
+    rxCount = BDI_PipeReceive(sizeof ldrAnswer, ldrAnswer);
+    pending--;
+    if (result == BDI_OKAY) {
+      if (rxCount < 0) result = rxCount;
+      else if ((rxCount == 1) && (ldrAnswer[0] == BDI_ANS_NAK)) result = BDI_ERR_MEM_ACCESS;
+      else if ((rxCount != 1) || (ldrAnswer[0] != BDI_ANS_ACK)) result = BDI_ERR_INVALID_RESPONSE;
+    } /* if */
+  } /* for */
+  return result;
+} /* LDR_LoadBlocks */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    LDR_StreamChunk :
+
+    Streams a chunk with fast load and checks the checksum of the loaded
+    target memory.
+
+     INPUT  : addr        first address
+              count       number of bytes, up to LDR_CHUNK_SIZE
+              data        the data
+     OUTPUT : statistics  fast load available
+              loaded      the checksum of the target memory matches
+              RETURN      error code
+
+ ****************************************************************************/
+
+static int LDR_StreamChunk(DWORD addr, DWORD count, const BYTE* data,
+                           LDR_StatisticsT* statistics, BOOL* loaded)
+{
+  BYTE*   cmdPtr;
+  WORD    blockCount;
+  DWORD   sent;
+  DWORD   sum;
+  DWORD   i;
+  int     rxCount;
+  int     result;
+
+  *loaded = FALSE;
+
+  /* start the fast load, a firmware without it ignores or does not acknowledge it */
+  cmdPtr = BDI_AppendByte(BDI_CMD_LOAD_INIT, ldrCommand);
+  cmdPtr = BDI_AppendLong(addr, cmdPtr);
+  cmdPtr = BDI_AppendLong(count, cmdPtr);
+  statistics->commands++;
+  rxCount = BDI_Probe(cmdPtr-ldrCommand, ldrCommand, sizeof ldrAnswer, ldrAnswer, LDR_EXEC_TIME);
+  if (   (rxCount == BDI_ERR_NO_RESPONSE)
+      || ((rxCount >= 0) && ((rxCount != 1) || (ldrAnswer[0] != BDI_ANS_ACK)))) {
+    statistics->fastLoad = FALSE;
+    return BDI_OKAY;
+  } /* if */
+  if (rxCount < 0) return rxCount;
+  result = BDI_OKAY;
+
+  /* the blocks back to back */
+  for (sent = 0; (sent < count) && (result == BDI_OKAY); sent += blockCount) {
+    blockCount = BDI_MAX_BLOCK_SIZE;
+    if (count - sent < blockCount) blockCount = (WORD)(count - sent);
+    cmdPtr = BDI_AppendByte(BDI_CMD_LOAD_BLOCK, ldrCommand);
+    cmdPtr = BDI_AppendLong(addr + sent, cmdPtr);
+    cmdPtr = BDI_AppendWord(blockCount, cmdPtr);
+    (void)memcpy(cmdPtr, data + sent, blockCount);
+    cmdPtr += blockCount;
+    result = BDI_StreamSend(cmdPtr-ldrCommand, ldrCommand);
+    statistics->commands++;
+  } /* for */
+  if (result != BDI_OKAY) return result;
+  statistics->chunks++;
+
+  /* the checksum of the target memory */
+  cmdPtr = BDI_AppendByte(BDI_CMD_FETCH_XSUM, ldrCommand);
+  cmdPtr = BDI_AppendLong(addr, cmdPtr);
+  cmdPtr = BDI_AppendLong(count, cmdPtr);
+  statistics->commands++;
+  rxCount = BDI_Transaction(cmdPtr-ldrCommand, ldrCommand, sizeof ldrAnswer, ldrAnswer, LDR_EXEC_TIME);
+  if (rxCount < 0) return rxCount;
+  if ((rxCount != 5) || (ldrAnswer[0] != BDI_ANS_SEND_LONG)) return BDI_ERR_INVALID_RESPONSE;
+  sum = 0;
+  for (i = 0; i < count; i++) sum += data[i];
+  *loaded = (   ((DWORD)ldrAnswer[1] << 24) + ((DWORD)ldrAnswer[2] << 16)
+              + ((DWORD)ldrAnswer[3] <<  8) +  (DWORD)ldrAnswer[4]) == (sum & 0xFFFFFFFFUL);
+  return BDI_OKAY;
+} /* LDR_StreamChunk */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    LDR_SetPC :
+
+    Sets the program counter of the target.
+
+     INPUT  : pc        the new program counter
+     OUTPUT : RETURN    error code
+
+ ****************************************************************************/
+
+int LDR_SetPC(DWORD pc)
+{
+  BYTE*   cmdPtr;
+
+  cmdPtr = BDI_AppendByte(BDI_CMD_SET_PC, ldrCommand);
+  cmdPtr = BDI_AppendLong(pc, cmdPtr);
+  return LDR_Command(cmdPtr-ldrCommand, LDR_EXEC_TIME);
+} /* LDR_SetPC */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    LDR_LoadImage :
+
+    Loads all segments of an image into target memory. Fast load is tried
+    with the first chunk, a chunk that does not arrive completely is
+    loaded again with single blocks.
+
+     INPUT  : image       the sorted image
+              setPC       set the PC to the entry of the image if it has one
+     OUTPUT : statistics  what was loaded how
+              RETURN      error code
+
+ ****************************************************************************/
+
+int LDR_LoadImage(const IMG_ImageT* image, BOOL setPC, LDR_StatisticsT* statistics)
+{
+  const IMG_SegmentT* seg;
+  DWORD               done;
+  DWORD               count;
+  BOOL                loaded;
+  int                 result;
+  int                 i;
+
+  (void)memset(statistics, 0, sizeof *statistics);
+  statistics->fastLoad = TRUE;
+  result = BDI_OKAY;
+  for (i = 0; (i < image->count) && (result == BDI_OKAY); i++) {
+    seg = &image->segment[i];
+    for (done = 0; (done < seg->size) && (result == BDI_OKAY); done += count) {
+      count = LDR_CHUNK_SIZE;
+      if (seg->size - done < count) count = seg->size - done;
+      loaded = FALSE;
+      if (statistics->fastLoad) {
+        result = LDR_StreamChunk(seg->addr + done, count, seg->data + done, statistics, &loaded);
+        if (loaded) statistics->fastBytes += count;
+        else if ((result == BDI_OKAY) && statistics->fastLoad) statistics->repeated++;
+      } /* if */
+      if ((result == BDI_OKAY) && !loaded) {
+        result = LDR_LoadBlocks(seg->addr + done, count, seg->data + done, statistics);
+      } /* if */
+      if (result == BDI_OKAY) statistics->bytes += count;
+    } /* for */
+  } /* for */
+
+  if ((result == BDI_OKAY) && setPC && image->hasEntry) result = LDR_SetPC(image->entry);
+  return result;
+} /* LDR_LoadImage */
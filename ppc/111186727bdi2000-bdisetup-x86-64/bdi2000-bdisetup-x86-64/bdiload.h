@@ -0,0 +1,62 @@
+#ifndef __BDILOAD_H__
+#define __BDILOAD_H__
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdiload.h
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX
+|  TARGET HW   : PC
+|
+|  PROGRAMMER  : Abatron / RD
+|  CREATION    : 19.10.26
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  Download of application images into target memory
+|
+|
+|*************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define LDR_CHUNK_SIZE          0x10000 /* bytes streamed before a check */
+#define LDR_EXEC_TIME           1000    /* execution time of a load command */
+
+/*************************************************************************
+|  TYPEDEFS
+|*************************************************************************/
+
+typedef struct {
+  DWORD         bytes;          /* bytes loaded */
+  DWORD         fastBytes;      /* bytes loaded with the fast load stream */
+  DWORD         commands;       /* commands and stream frames sent */
+  int           chunks;         /* chunks streamed */
+  int           repeated;       /* chunks loaded again with single blocks */
+  BOOL          fastLoad;       /* the firmware supports fast load */
+} LDR_StatisticsT;
+
+/*************************************************************************
+|  FUNCTIONS
+|*************************************************************************/
+
+/* all segments of a sorted image, the PC is set to its entry if it has one */
+int   LDR_LoadImage(const IMG_ImageT* image, BOOL setPC, LDR_StatisticsT* statistics);
+int   LDR_SetPC(DWORD pc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
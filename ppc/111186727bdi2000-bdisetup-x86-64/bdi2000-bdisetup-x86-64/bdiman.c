@@ -0,0 +1,553 @@
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdiman.c
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX / UNIX
+|  TARGET HW   : PC
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  This module builds a manifest of the firmware/logic files in a release
+|  directory. Files are named NAME.xyz where the extension is the version
+|  (e.g. B20PPCGD.105 = V1.05). The manifest is a hash table of the upper
+|  case names, each with its versions sorted newest first, so finding the
+|  newest file is a single hash probe.
+|
+|  If the cache is enabled, the manifest is saved in the cache directory
+|  and reused as long as the modification time of the release directory
+|  does not change. If it changed, the directory is read again but the
+|  file information of known files is taken from the old manifest.
+|
+|  The release may also be a zip or tar archive, then the manifest lists
+|  the files within the archive (in any sub directory). Such a manifest
+|  is built from the archive index and not saved.
+|
+|*************************************************************************/
+
+/*************************************************************************
+|  INCLUDES
+|*************************************************************************/
+
+#if defined(WIN32)
+#include <windows.h>
+#include <process.h>
+#include <io.h>
+#define MAXPATHLEN  _MAX_PATH
+#define getpid      _getpid
+#else
+#include <sys/param.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif /* defined(WIN32) */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "bdierror.h"
+#include "bdidll.h"
+#include "bdiimg.h"
+#include "bdifuse.h"
+#include "bdicnf.h"
+#include "bdicache.h"
+#include "bdiarc.h"
+#include "bdiman.h"
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define MAN_FORMAT          1
+#define MAN_INITIAL_SIZE    64      /* initial number of hash table slots */
+#define MAN_FILE_GROW       4       /* number of versions to add at once  */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MAN_Extension2Version :
+
+    Converts a version extension into a number
+
+     INPUT:  szExt      version as extension (e.g. .102)
+     OUTPUT: return     version as number, 0 if not a version
+
+ ****************************************************************************/
+
+static WORD MAN_Extension2Version(const char* szExt)
+{
+  WORD  version;
+  int   i;
+
+  if (strlen(szExt) != 4) return 0;
+  version = 0;
+  for (i=1; i<4; i++) {
+    if ((szExt[i] < '0') || (szExt[i] > '9')) return 0;
+    version *= 10;
+    version += (WORD)(szExt[i] - '0');
+  } /* for */
+  return version;
+} /* MAN_Extension2Version */
+
+
+static char* MAN_StrDup(const char* szText, size_t length)
+{
+  char* szCopy;
+
+  szCopy = (char*)malloc(length + 1);
+  if (szCopy != NULL) {
+    (void)memcpy(szCopy, szText, length);
+    szCopy[length] = 0;
+  } /* if */
+  return szCopy;
+} /* MAN_StrDup */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MAN_Probe :
+
+    Returns the slot of a name, either the used slot or the free slot
+    where the name has to be inserted.
+
+     INPUT  : manifest  the manifest
+              szKey     the upper case name
+              keyLen    length of the name
+     OUTPUT : RETURN    the slot
+
+ ****************************************************************************/
+
+static MAN_EntryT* MAN_Probe(const MAN_ManifestT* manifest, const char* szKey, size_t keyLen)
+{
+  MAN_EntryT*   entry;
+  int           slot;
+
+  slot = (int)CCH_Hash(CCH_HASH_INIT, (const BYTE*)szKey, keyLen) & (manifest->size - 1);
+  for (;;) {
+    entry = &manifest->entry[slot];
+    if (entry->szKey == NULL) return entry;
+    if ((strlen(entry->szKey) == keyLen) && (memcmp(entry->szKey, szKey, keyLen) == 0)) return entry;
+    slot = (slot + 1) & (manifest->size - 1);
+  } /* for */
+} /* MAN_Probe */
+
+
+static void MAN_Init(MAN_ManifestT* manifest)
+{
+  manifest->szDir = NULL;
+  manifest->separator = '/';
+  manifest->size  = 0;
+  manifest->count = 0;
+  manifest->entry = NULL;
+} /* MAN_Init */
+
+
+static int MAN_Resize(MAN_ManifestT* manifest, int size)
+{
+  MAN_EntryT*   oldEntry;
+  MAN_EntryT*   entry;
+  int           oldSize;
+  int           i;
+
+  oldEntry = manifest->entry;
+  oldSize  = manifest->size;
+  manifest->entry = (MAN_EntryT*)calloc(size, sizeof(MAN_EntryT));
+  if (manifest->entry == NULL) {
+    manifest->entry = oldEntry;
+    return BDI_ERR_FILE_ACCESS;
+  } /* if */
+  manifest->size = size;
+  for (i = 0; i < oldSize; i++) {
+    if (oldEntry[i].szKey != NULL) {
+      entry  = MAN_Probe(manifest, oldEntry[i].szKey, strlen(oldEntry[i].szKey));
+      *entry = oldEntry[i];
+    } /* if */
+  } /* for */
+  free(oldEntry);
+  return BDI_OKAY;
+} /* MAN_Resize */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MAN_AddFile :
+
+    Adds a file to the manifest, files without a version are ignored.
+    The name is looked up without the path within an archive.
+
+     INPUT  : manifest    the manifest
+              szFileName  the name of the file within the directory/archive
+              size        the file size
+              mtime       the modification time of the file
+     OUTPUT : RETURN      error code
+
+ ****************************************************************************/
+
+static int MAN_AddFile(MAN_ManifestT* manifest, const char* szFileName, DWORD size, DWORD mtime)
+{
+  MAN_EntryT*   entry;
+  MAN_FileT*    newFile;
+  const char*   szBaseName;
+  char*         szKey;
+  size_t        keyLen;
+  size_t        i;
+  WORD          version;
+  int           pos;
+
+  szBaseName = strrchr(szFileName, '/');
+  szBaseName = (szBaseName != NULL) ? szBaseName + 1 : szFileName;
+  keyLen = strlen(szBaseName);
+  if (keyLen <= 4) return BDI_OKAY;
+  keyLen -= 4;
+  version = MAN_Extension2Version(szBaseName + keyLen);
+  if (version == 0) return BDI_OKAY;
+
+  /* keep the table at most half full */
+  if ((2 * (manifest->count + 1)) > manifest->size) {
+    if (MAN_Resize(manifest, manifest->size ? 2 * manifest->size : MAN_INITIAL_SIZE) != BDI_OKAY) {
+      return BDI_ERR_FILE_ACCESS;
+    } /* if */
+  } /* if */
+
+  szKey = MAN_StrDup(szBaseName, keyLen);
+  if (szKey == NULL) return BDI_ERR_FILE_ACCESS;
+  for (i = 0; i < keyLen; i++) szKey[i] = (char)toupper((unsigned char)szKey[i]);
+  entry = MAN_Probe(manifest, szKey, keyLen);
+  if (entry->szKey == NULL) {
+    entry->szKey = szKey;
+    manifest->count++;
+  } /* if */
+  else {
+    free(szKey);
+  } /* else */
+
+  /* insert sorted, newest first */
+  if (entry->count == entry->alloc) {
+    newFile = (MAN_FileT*)realloc(entry->file, (entry->alloc + MAN_FILE_GROW) * sizeof(MAN_FileT));
+    if (newFile == NULL) return BDI_ERR_FILE_ACCESS;
+    entry->file   = newFile;
+    entry->alloc += MAN_FILE_GROW;
+  } /* if */
+  for (pos = entry->count; (pos > 0) && (entry->file[pos - 1].version < version); pos--) {
+    entry->file[pos] = entry->file[pos - 1];
+  } /* for */
+  entry->file[pos].version    = version;
+  entry->file[pos].size       = size;
+  entry->file[pos].mtime      = mtime;
+  entry->file[pos].szFileName = MAN_StrDup(szFileName, strlen(szFileName));
+  entry->count++;
+  if (entry->file[pos].szFileName == NULL) return BDI_ERR_FILE_ACCESS;
+  return BDI_OKAY;
+} /* MAN_AddFile */
+
+
+static const MAN_FileT* MAN_FindFile(const MAN_ManifestT* manifest, const char* szFileName)
+{
+  const MAN_EntryT* entry;
+  char              szKey[MAXPATHLEN];
+  size_t            keyLen;
+  size_t            i;
+  int               pos;
+
+  keyLen = strlen(szFileName);
+  if ((manifest->size == 0) || (keyLen <= 4) || (keyLen >= sizeof szKey)) return NULL;
+  keyLen -= 4;
+  for (i = 0; i < keyLen; i++) szKey[i] = (char)toupper((unsigned char)szFileName[i]);
+  entry = MAN_Probe(manifest, szKey, keyLen);
+  if (entry->szKey == NULL) return NULL;
+  for (pos = 0; pos < entry->count; pos++) {
+    if (strcmp(entry->file[pos].szFileName, szFileName) == 0) return &entry->file[pos];
+  } /* for */
+  return NULL;
+} /* MAN_FindFile */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MAN_Scan :
+
+    Reads the directory into the manifest. The file information is taken
+    from the previous manifest where possible.
+
+     INPUT  : szDir     the directory
+              previous  the previous manifest (may be empty)
+     OUTPUT : manifest  the new manifest
+              RETURN    error code
+
+ ****************************************************************************/
+
+#if defined(WIN32)
+
+static int MAN_Scan(const char* szDir, const MAN_ManifestT* previous, MAN_ManifestT* manifest)
+{
+  char                  szPattern[MAXPATHLEN];
+  struct _finddata_t    fileInfo;
+  intptr_t              hFile;
+  int                   result;
+
+  (void)previous;
+  sprintf(szPattern, "%s/*.*", szDir);
+  hFile = _findfirst(szPattern, &fileInfo);
+  if (hFile == -1L) return BDI_OKAY;
+  result = BDI_OKAY;
+  do {
+    result = MAN_AddFile(manifest, fileInfo.name, (DWORD)fileInfo.size, (DWORD)fileInfo.time_write);
+  } while ((result == BDI_OKAY) && (_findnext(hFile, &fileInfo) == 0));
+  _findclose(hFile);
+  return result;
+} /* MAN_Scan */
+
+#else
+
+static int MAN_Scan(const char* szDir, const MAN_ManifestT* previous, MAN_ManifestT* manifest)
+{
+  DIR*              dp;
+  struct dirent*    d;
+  struct stat       st;
+  const MAN_FileT*  known;
+  char              szFullName[MAXPATHLEN];
+  size_t            nameLen;
+  int               result;
+
+  dp = opendir(szDir);
+  if (dp == NULL) return BDI_OKAY;
+  result = BDI_OKAY;
+  while ((result == BDI_OKAY) && ((d = readdir(dp)) != NULL)) {
+    nameLen = strlen(d->d_name);
+    if ((nameLen <= 4) || (MAN_Extension2Version(d->d_name + nameLen - 4) == 0)) continue;
+    known = MAN_FindFile(previous, d->d_name);
+    if (known != NULL) {
+      result = MAN_AddFile(manifest, d->d_name, known->size, known->mtime);
+    } /* if */
+    else {
+      sprintf(szFullName, "%.*s/%s", MAXPATHLEN - 64, szDir, d->d_name);
+      if (stat(szFullName, &st) != 0) continue;
+      result = MAN_AddFile(manifest, d->d_name, (DWORD)st.st_size, (DWORD)st.st_mtime);
+    } /* else */
+  } /* while */
+  closedir(dp);
+  return result;
+} /* MAN_Scan */
+
+#endif /* defined(WIN32) */
+
+
+static int MAN_ScanArchive(const char* szArchive, MAN_ManifestT* manifest)
+{
+  const ARC_ArchiveT*   archive;
+  int                   result;
+  int                   i;
+
+  result = ARC_Open(szArchive, &archive);
+  for (i = 0; (result == BDI_OKAY) && (i < archive->count); i++) {
+    result = MAN_AddFile(manifest, archive->member[i].szName,
+                         archive->member[i].size, archive->mtime);
+  } /* for */
+  return result;
+} /* MAN_ScanArchive */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MAN_Load / MAN_Save :
+
+    Load / save the manifest from / to the cache directory.
+    Format (text):
+      BDIMAN <format> <directory mtime> <build time>
+      <version> <size> <mtime> <file name>
+      ...
+
+ ****************************************************************************/
+
+static void MAN_FileName(const char* szDir, char* szManName)
+{
+  char  szFullName[MAXPATHLEN];
+
+  szManName[0] = 0;
+  if (CCH_GetDirectory() == NULL) return;
+#if defined(WIN32)
+  if (_fullpath(szFullName, szDir, MAXPATHLEN) == NULL) return;
+#else
+  if (realpath(szDir, szFullName) == NULL) return;
+#endif
+  sprintf(szManName, "%s/%016llx.man", CCH_GetDirectory(),
+          CCH_Hash(CCH_HASH_INIT, (const BYTE*)szFullName, strlen(szFullName)));
+} /* MAN_FileName */
+
+
+static BOOL MAN_Load(const char* szManName, MAN_ManifestT* manifest, DWORD* dirTime, DWORD* buildTime)
+{
+  FILE*         file;
+  char          szLine[MAXPATHLEN + 64];
+  char          szFileName[MAXPATHLEN];
+  unsigned int  format;
+  unsigned int  version;
+  unsigned long size;
+  unsigned long mtime;
+  BOOL          valid;
+
+  file = fopen(szManName, "r");
+  if (file == NULL) return FALSE;
+  valid = (   (fgets(szLine, sizeof szLine, file) != NULL)
+           && (sscanf(szLine, "BDIMAN %u %lu %lu", &format, &mtime, &size) == 3)
+           && (format == MAN_FORMAT));
+  *dirTime   = mtime;
+  *buildTime = size;
+  while (valid && (fgets(szLine, sizeof szLine, file) != NULL)) {
+    valid = (   (sscanf(szLine, "%u %lu %lu %[^\n]", &version, &size, &mtime, szFileName) == 4)
+             && (MAN_AddFile(manifest, szFileName, size, mtime) == BDI_OKAY));
+  } /* while */
+  fclose(file);
+  return valid;
+} /* MAN_Load */
+
+
+static void MAN_Save(const char* szManName, const MAN_ManifestT* manifest, DWORD dirTime, DWORD buildTime)
+{
+  char              szTempName[MAXPATHLEN + 32];
+  FILE*             file;
+  const MAN_EntryT* entry;
+  int               i;
+  int               pos;
+  BOOL              okay;
+
+  sprintf(szTempName, "%s.%ld.tmp", szManName, (long)getpid());
+  file = fopen(szTempName, "w");
+  if (file == NULL) return;
+  okay = (fprintf(file, "BDIMAN %u %lu %lu\n", MAN_FORMAT, dirTime, buildTime) > 0);
+  for (i = 0; okay && (i < manifest->size); i++) {
+    entry = &manifest->entry[i];
+    for (pos = 0; okay && (pos < entry->count); pos++) {
+      okay = (fprintf(file, "%u %lu %lu %s\n", entry->file[pos].version, entry->file[pos].size,
+                      entry->file[pos].mtime, entry->file[pos].szFileName) > 0);
+    } /* for */
+  } /* for */
+  if (fclose(file) != 0) okay = FALSE;
+#if defined(WIN32)
+  if (okay) (void)remove(szManName);
+#endif
+  if (!okay || (rename(szTempName, szManName) != 0)) (void)remove(szTempName);
+} /* MAN_Save */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MAN_Open / MAN_Close :
+
+    Builds the manifest of a directory / releases the manifest.
+    A saved manifest is used if the directory did not change since it was
+    built. A directory changed in the same second the manifest was built
+    is always read again.
+
+     INPUT  : szDir     the release directory or archive
+     OUTPUT : manifest  the manifest
+              RETURN    error code
+
+ ****************************************************************************/
+
+int MAN_Open(const char* szDir, MAN_ManifestT* manifest)
+{
+  MAN_ManifestT previous;
+  char          szManName[MAXPATHLEN + 32];
+  struct stat   st;
+  DWORD         dirTime;
+  DWORD         savedDirTime;
+  DWORD         buildTime;
+  int           result;
+
+  MAN_Init(manifest);
+  MAN_Init(&previous);
+  manifest->szDir = MAN_StrDup(szDir, strlen(szDir));
+  if (manifest->szDir == NULL) return BDI_ERR_FILE_ACCESS;
+  if (ARC_IsArchive(szDir)) {
+    manifest->separator = ARC_SEPARATOR;
+    return MAN_ScanArchive(szDir, manifest);
+  } /* if */
+  if (stat(szDir, &st) != 0) return BDI_OKAY;
+  dirTime = (DWORD)st.st_mtime;
+
+  /* try the saved manifest */
+  MAN_FileName(szDir, szManName);
+  if ((szManName[0] != 0) && MAN_Load(szManName, &previous, &savedDirTime, &buildTime)) {
+    if ((savedDirTime == dirTime) && (dirTime < buildTime)) {
+      previous.szDir = manifest->szDir;
+      *manifest = previous;
+      return BDI_OKAY;
+    } /* if */
+  } /* if */
+
+  /* read the directory and save the new manifest */
+  buildTime = (DWORD)time(NULL);
+  result = MAN_Scan(szDir, &previous, manifest);
+  MAN_Close(&previous);
+  if ((result == BDI_OKAY) && (szManName[0] != 0)) {
+    MAN_Save(szManName, manifest, dirTime, buildTime);
+  } /* if */
+  return result;
+} /* MAN_Open */
+
+
+void MAN_Close(MAN_ManifestT* manifest)
+{
+  int   i;
+  int   pos;
+
+  for (i = 0; i < manifest->size; i++) {
+    for (pos = 0; pos < manifest->entry[i].count; pos++) {
+      free(manifest->entry[i].file[pos].szFileName);
+    } /* for */
+    free(manifest->entry[i].file);
+    free(manifest->entry[i].szKey);
+  } /* for */
+  free(manifest->entry);
+  free(manifest->szDir);
+  MAN_Init(manifest);
+} /* MAN_Close */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MAN_GetNewest :
+
+    Searches for the newest file.
+    The extension is the version (e.g. *.120 = V1.20 )
+
+     INPUT:  manifest   the manifest of the firmware directory or archive
+             szName     the name of the file (e.g. b20copgd)
+     OUTPUT: szNewName  the full name incl. path of the found file
+             RETURN     the newest version or 0 if not found
+
+ ****************************************************************************/
+
+WORD MAN_GetNewest(const MAN_ManifestT* manifest, const char* szName, char* szNewName)
+{
+  const MAN_EntryT* entry;
+  char              szKey[MAXPATHLEN];
+  size_t            keyLen;
+  size_t            i;
+
+  keyLen = strlen(szName);
+  if ((manifest->size == 0) || (keyLen >= sizeof szKey)) return 0;
+  for (i = 0; i < keyLen; i++) szKey[i] = (char)toupper((unsigned char)szName[i]);
+  entry = MAN_Probe(manifest, szKey, keyLen);
+  if ((entry->szKey == NULL) || (entry->count == 0)) return 0;
+
+  sprintf(szNewName, "%s%c%s", manifest->szDir, manifest->separator, entry->file[0].szFileName);
+  return entry->file[0].version;
+} /* MAN_GetNewest */
@@ -0,0 +1,71 @@
+#ifndef __BDIMAN_H__
+#define __BDIMAN_H__
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdiman.h
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX
+|  TARGET HW   : PC
+|
+|  PROGRAMMER  : Abatron / RD
+|  CREATION    : 19.10.26
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  Manifest of the firmware/logic files in a release directory
+|
+|
+|*************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*************************************************************************
+|  TYPEDEFS
+|*************************************************************************/
+
+/* one version of a file */
+typedef struct {
+  WORD    version;
+  DWORD   size;
+  DWORD   mtime;
+  char*   szFileName;     /* name within the directory/archive */
+} MAN_FileT;
+
+/* all versions of a file name, newest first */
+typedef struct {
+  char*       szKey;      /* upper case name without extension, NULL if free */
+  int         count;
+  int         alloc;
+  MAN_FileT*  file;
+} MAN_EntryT;
+
+/* the manifest, a hash table of names */
+typedef struct {
+  char*       szDir;
+  char        separator;  /* between directory and file name */
+  int         size;       /* number of slots, power of two */
+  int         count;      /* number of used slots */
+  MAN_EntryT* entry;
+} MAN_ManifestT;
+
+/*************************************************************************
+|  FUNCTIONS
+|*************************************************************************/
+
+int   MAN_Open(const char* szDir, MAN_ManifestT* manifest);
+void  MAN_Close(MAN_ManifestT* manifest);
+WORD  MAN_GetNewest(const MAN_ManifestT* manifest, const char* szName, char* szNewName);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
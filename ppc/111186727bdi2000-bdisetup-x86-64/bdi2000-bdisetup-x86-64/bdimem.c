@@ -0,0 +1,930 @@
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdimem.c
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX / UNIX
+|  TARGET HW   : PC
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  This module reads and writes target memory through the BDI firmware
+|  in debug mode. An access of any address and length is split into
+|  maximal blocks (GET_BLOCK, SET_BLOCK), up to BDI_PipeDepth() commands
+|  are in flight. Memory declared with TSZ1, TSZ2 or TSZ4 in [INIT] is
+|  accessed with single FETCH/SET commands of that size only, a block
+|  ends where such a range starts. A read of part of such an access
+|  fetches the whole access, a write must cover whole accesses.
+|
+|  Commands and answers (link format, Motorola byte order):
+|    SET_MEM_SPACE   space                 ACK
+|    FETCH_xxx       addr                  SEND_xxx value
+|    SET_xxx         addr value            ACK
+|    GET_BLOCK       addr count            SEND_BLOCK data
+|    SET_BLOCK       addr count data       ACK
+|  The value of FETCH and SET is in the byte order of the target, the
+|  data of a block in address order. NAK reports a failed access.
+|
+|  While the target is halted its memory can be held by an optional page
+|  cache. A page of MEM_PAGE_SIZE bytes is read with one GET_BLOCK, up to
+|  MEM_FILL_PAGES missing pages with one pipelined transfer. Writes go
+|  through to the target and update the cached pages. Pages holding a
+|  TSZ range or an uncacheable range (e.g. the internal memory map at the
+|  IMMR) are always accessed on the target. START, SINGLE_STEP and the
+|  resets invalidate the cache, as does selecting another memory space.
+|
+|*************************************************************************/
+
+/*************************************************************************
+|  INCLUDES
+|*************************************************************************/
+
+#if defined(WIN32)
+#include <windows.h>
+#endif
+#include <stddef.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "bdierror.h"
+#include "bdicmd.h"
+#include "bdidll.h"
+#include "bdicnf.h"
+#include "bdimem.h"
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define MEM_ACCESS_BLOCK    0       /* piece done with a block command */
+
+/*************************************************************************
+|  TYPEDEFS
+|*************************************************************************/
+
+/* one command of an access */
+typedef struct {
+  DWORD         addr;           /* address of the command */
+  DWORD         offset;         /* position within the data of the access */
+  int           length;         /* bytes of the data */
+  int           size;           /* access size, MEM_ACCESS_BLOCK for a block */
+  int           skip;           /* bytes of the access before the data */
+} MEM_PieceT;
+
+/*************************************************************************
+|  LOCALS
+|*************************************************************************/
+
+static BYTE memCommand[BDI_MAX_BLOCK_SIZE + 8];
+static BYTE memAnswer[BDI_MAX_FRAME_SIZE];
+static BYTE memFill[MEM_FILL_PAGES * MEM_PAGE_SIZE];
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    BDI_Append___ :
+
+    Host independent helper function to append a numeric value to a buffer.
+    The bytes will be stored in the link format order (Motorola byte order).
+
+     INPUT  : value     value
+              buffer    pointer to buffer
+     OUTPUT : RETURN    pointer to next byte after the stored value
+
+ ****************************************************************************/
+
+static BYTE* BDI_AppendByte(BYTE  value, BYTE* buffer)
+{
+  *buffer++ = value;
+  return buffer;
+} /* BDI_AppendByte */
+
+static BYTE* BDI_AppendWord(WORD value, BYTE* buffer)
+{
+  *buffer++ = (BYTE)(value>>8);
+  *buffer++ = (BYTE)value;
+  return buffer;
+} /* BDI_AppendWord */
+
+static BYTE* BDI_AppendLong(DWORD value, BYTE* buffer)
+{
+  *buffer++ = (BYTE)(value>>24);
+  *buffer++ = (BYTE)(value>>16);
+  *buffer++ = (BYTE)(value>>8);
+  *buffer++ = (BYTE)value;
+  return buffer;
+} /* BDI_AppendLong */
+
+
+/****************************************************************************
+ ****************************************************************************
+    Helper functions to convert between the bytes in memory and the value
+    of a FETCH or SET command
+ ****************************************************************************/
+
+static DWORD MEM_GetValue(const MEM_SessionT* session, const BYTE* bytes, int size)
+{
+  DWORD   value;
+  int     i;
+
+  value = 0;
+  for (i = 0; i < size; i++) {
+    if (session->littleEndian) value |= (DWORD)bytes[i] << (8 * i);
+    else                       value  = (value << 8) | bytes[i];
+  } /* for */
+  return value;
+} /* MEM_GetValue */
+
+
+static void MEM_PutValue(const MEM_SessionT* session, DWORD value, int size, BYTE* bytes)
+{
+  int     i;
+
+  for (i = 0; i < size; i++) {
+    if (session->littleEndian) bytes[i]            = (BYTE)(value >> (8 * i));
+    else                       bytes[size - 1 - i] = (BYTE)(value >> (8 * i));
+  } /* for */
+} /* MEM_PutValue */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MEM_Init :
+
+    Initializes a session without access size ranges for a big endian
+    target and the default memory space.
+
+     OUTPUT : session   the session
+
+ ****************************************************************************/
+
+void MEM_Init(MEM_SessionT* session)
+{
+  (void)memset(session, 0, sizeof *session);
+  session->space = -1;
+} /* MEM_Init */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MEM_AddRange :
+
+    Declares memory that is accessed with one access size only.
+
+     INPUT  : start     first address
+              end       last address
+              size      access size 1, 2 or 4
+     OUTPUT : session   the session
+              RETURN    error code
+
+ ****************************************************************************/
+
+int MEM_AddRange(MEM_SessionT* session, DWORD start, DWORD end, int size)
+{
+  MEM_RangeT* range;
+
+  if (   (session->ranges == MEM_MAX_RANGES)
+      || (end < start)
+      || ((size != 1) && (size != 2) && (size != 4))) return BDI_ERR_INVALID_PARAMETER;
+  range = &session->range[session->ranges++];
+  range->start = start;
+  range->end   = end;
+  range->size  = size;
+  return BDI_OKAY;
+} /* MEM_AddRange */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MEM_SetConfig :
+
+    Takes the access size ranges and the byte order of the target from a
+    configuration. TSZ8 memory is accessed with blocks.
+
+     INPUT  : config    the compiled configuration
+     OUTPUT : session   the session
+              RETURN    error code
+
+ ****************************************************************************/
+
+int MEM_SetConfig(MEM_SessionT* session, const CNF_ConfigT* config)
+{
+  const CNF_EntryT*   e;
+  unsigned long long  start;
+  unsigned long long  end;
+  unsigned long long  spr;
+  unsigned long long  immr;
+  char                szEndian[8];
+  int                 result;
+  int                 size;
+  int                 i;
+  int                 j;
+
+  result = BDI_OKAY;
+  for (i = 0; (i < config->count) && (result == BDI_OKAY); i++) {
+    e = &config->entry[i];
+
+    /* byte order of the target */
+    if ((e->part == CNF_PART_TARGET) && (e->keyword == CNF_KEY_NONE) && (e->argCount >= 1)) {
+      for (j = 0; j < 7; j++) szEndian[j] = (char)toupper((BYTE)CNF_GetText(config, e)[j]);
+      if (   (strncmp(szEndian, "ENDIAN ", 7) == 0)
+          && CNF_GetString(config, e, 0, szEndian, (int)sizeof szEndian)) {
+        session->littleEndian = (toupper((BYTE)szEndian[0]) == 'L');
+      } /* if */
+      continue;
+    } /* if */
+
+    /* the internal memory map is not cached */
+    if (   (e->part == CNF_PART_INIT) && (e->keyword == CNF_KEY_WSPR)
+        && CNF_GetNumber(config, e, 0, &spr) && (spr == 638)
+        && CNF_GetNumber(config, e, 1, &immr)) {
+      immr &= 0xFFFF0000UL;
+      result = MEM_AddUncached(session, (DWORD)immr, (DWORD)immr + MEM_IMMR_SIZE - 1);
+      continue;
+    } /* if */
+
+    if      (e->keyword == CNF_KEY_TSZ1) size = 1;
+    else if (e->keyword == CNF_KEY_TSZ2) size = 2;
+    else if (e->keyword == CNF_KEY_TSZ4) size = 4;
+    else continue;
+    if (   (e->part == CNF_PART_INIT)
+        && CNF_GetNumber(config, e, 0, &start)
+        && CNF_GetNumber(config, e, 1, &end)) {
+      result = MEM_AddRange(session, (DWORD)start, (DWORD)end, size);
+    } /* if */
+  } /* for */
+  return result;
+} /* MEM_SetConfig */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MEM_SetSpace :
+
+    Selects the memory space of the following accesses.
+
+     INPUT  : space     the target specific memory space
+     OUTPUT : session   the session
+              RETURN    error code
+
+ ****************************************************************************/
+
+int MEM_SetSpace(MEM_SessionT* session, BYTE space)
+{
+  BYTE*   cmdPtr;
+  int     rxCount;
+
+  cmdPtr = BDI_AppendByte(BDI_CMD_SET_MEM_SPACE, memCommand);
+  cmdPtr = BDI_AppendByte(space, cmdPtr);
+  rxCount = BDI_Transaction(cmdPtr-memCommand, memCommand, sizeof memAnswer, memAnswer, MEM_EXEC_TIME);
+  if (rxCount < 0) return rxCount;
+  if ((rxCount != 1) || (memAnswer[0] != BDI_ANS_ACK)) return BDI_ERR_INVALID_RESPONSE;
+  if (session->space != space) MEM_Invalidate(session);
+  session->space = space;
+  return BDI_OKAY;
+} /* MEM_SetSpace */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MEM_NextPiece :
+
+    Finds the next command of an access. Within a range of one access size
+    this is a single access, else a block up to the next such range.
+
+     INPUT  : session   the session
+              addr      the address of the piece
+              count     bytes left in the access
+              write     the access is a write
+     OUTPUT : piece     the command, offset not set
+              RETURN    error code
+
+ ****************************************************************************/
+
+static int MEM_NextPiece(const MEM_SessionT* session, DWORD addr, DWORD count, BOOL write,
+                         MEM_PieceT* piece)
+{
+  const MEM_RangeT* range;
+  DWORD             length;
+  int               i;
+
+  /* the smallest access size of the ranges holding addr */
+  piece->size = MEM_ACCESS_BLOCK;
+  for (i = 0; i < session->ranges; i++) {
+    range = &session->range[i];
+    if (   (addr >= range->start) && (addr <= range->end)
+        && ((piece->size == MEM_ACCESS_BLOCK) || (range->size < piece->size))) {
+      piece->size = range->size;
+    } /* if */
+  } /* for */
+
+  /* a single access */
+  if (piece->size != MEM_ACCESS_BLOCK) {
+    piece->skip   = (int)(addr & (DWORD)(piece->size - 1));
+    piece->addr   = addr - (DWORD)piece->skip;
+    piece->length = piece->size - piece->skip;
+    if ((DWORD)piece->length > count) piece->length = (int)count;
+    if (write && (piece->length != piece->size)) return BDI_ERR_INVALID_PARAMETER;
+    return BDI_OKAY;
+  } /* if */
+
+  /* a block up to the next range */
+  length = BDI_MAX_BLOCK_SIZE;
+  if (count < length) length = count;
+  for (i = 0; i < session->ranges; i++) {
+    range = &session->range[i];
+    if ((range->start > addr) && (range->start - addr < length)) length = range->start - addr;
+  } /* for */
+  piece->addr   = addr;
+  piece->length = (int)length;
+  piece->skip   = 0;
+  return BDI_OKAY;
+} /* MEM_NextPiece */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MEM_SendPiece :
+
+    Sends the command of a piece into the pipe.
+
+     INPUT  : session   the session
+              piece     the command
+              data      the data to write, NULL for a read
+     OUTPUT : RETURN    error code
+
+ ****************************************************************************/
+
+static int MEM_SendPiece(MEM_SessionT* session, const MEM_PieceT* piece, const BYTE* data)
+{
+  static const BYTE fetch[5] = {0, BDI_CMD_FETCH_BYTE, BDI_CMD_FETCH_WORD, 0, BDI_CMD_FETCH_LONG};
+  static const BYTE set[5]   = {0, BDI_CMD_SET_BYTE,   BDI_CMD_SET_WORD,   0, BDI_CMD_SET_LONG};
+  BYTE*   cmdPtr;
+  DWORD   value;
+
+  if (piece->size == MEM_ACCESS_BLOCK) {
+    cmdPtr = BDI_AppendByte((data == NULL) ? BDI_CMD_GET_BLOCK : BDI_CMD_SET_BLOCK, memCommand);
+    cmdPtr = BDI_AppendLong(piece->addr, cmdPtr);
+    cmdPtr = BDI_AppendWord((WORD)piece->length, cmdPtr);
+    if (data != NULL) {
+      (void)memcpy(cmdPtr, data + piece->offset, (size_t)piece->length);
+      cmdPtr += piece->length;
+    } /* if */
+  } /* if */
+  else if (data == NULL) {
+    cmdPtr = BDI_AppendByte(fetch[piece->size], memCommand);
+    cmdPtr = BDI_AppendLong(piece->addr, cmdPtr);
+  } /* else if */
+  else {
+    value  = MEM_GetValue(session, data + piece->offset, piece->size);
+    cmdPtr = BDI_AppendByte(set[piece->size], memCommand);
+    cmdPtr = BDI_AppendLong(piece->addr, cmdPtr);
+    if      (piece->size == 1) cmdPtr = BDI_AppendByte((BYTE)value, cmdPtr);
+    else if (piece->size == 2) cmdPtr = BDI_AppendWord((WORD)value, cmdPtr);
+    else                       cmdPtr = BDI_AppendLong(value, cmdPtr);
+  } /* else */
+  session->commands++;
+  return BDI_PipeSend(cmdPtr-memCommand, memCommand, MEM_EXEC_TIME);
+} /* MEM_SendPiece */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MEM_CheckAnswer :
+
+    Checks the answer of a piece, the data of a read is stored.
+
+     INPUT  : session   the session
+              piece     the command
+              rxCount   size of the answer in memAnswer or error code
+     OUTPUT : data      the read data, NULL for a write
+              RETURN    error code
+
+ ****************************************************************************/
+
+static int MEM_CheckAnswer(const MEM_SessionT* session, const MEM_PieceT* piece, int rxCount,
+                           BYTE* data)
+{
+  static const BYTE send[5] = {0, BDI_ANS_SEND_BYTE, BDI_ANS_SEND_WORD, 0, BDI_ANS_SEND_LONG};
+  BYTE    unit[4];
+  DWORD   value;
+  int     i;
+
+  if (rxCount < 0) return rxCount;
+  if ((rxCount >= 1) && (memAnswer[0] == BDI_ANS_NAK)) return BDI_ERR_MEM_ACCESS;
+
+  /* a write is acknowledged */
+  if (data == NULL) {
+    if ((rxCount != 1) || (memAnswer[0] != BDI_ANS_ACK)) return BDI_ERR_INVALID_RESPONSE;
+    return BDI_OKAY;
+  } /* if */
+
+  /* a block is sent in address order */
+  if (piece->size == MEM_ACCESS_BLOCK) {
+    if ((rxCount != piece->length + 1) || (memAnswer[0] != BDI_ANS_SEND_BLOCK)) {
+      return BDI_ERR_INVALID_RESPONSE;
+    } /* if */
+    (void)memcpy(data + piece->offset, memAnswer + 1, (size_t)piece->length);
+    return BDI_OKAY;
+  } /* if */
+
+  /* a value in the byte order of the target */
+  if ((rxCount != piece->size + 1) || (memAnswer[0] != send[piece->size])) {
+    return BDI_ERR_INVALID_RESPONSE;
+  } /* if */
+  value = 0;
+  for (i = 1; i <= piece->size; i++) value = (value << 8) | memAnswer[i];
+  MEM_PutValue(session, value, piece->size, unit);
+  (void)memcpy(data + piece->offset, unit + piece->skip, (size_t)piece->length);
+  return BDI_OKAY;
+} /* MEM_CheckAnswer */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MEM_Transfer :
+
+    Reads or writes a memory range with up to BDI_PipeDepth() commands in
+    flight. The answers arrive in the order of the commands. After an
+    error no more commands are sent, only the pipe is emptied.
+
+     INPUT  : session   the session
+              addr      first address
+              count     number of bytes
+              readData  buffer for the read data, NULL for a write
+              writeData the data to write, NULL for a read
+     OUTPUT : RETURN    error code
+
+ ****************************************************************************/
+
+static int MEM_Transfer(MEM_SessionT* session, DWORD addr, DWORD count,
+                        BYTE* readData, const BYTE* writeData)
+{
+  MEM_PieceT  pending[BDI_PIPE_DEPTH];
+  MEM_PieceT* piece;
+  DWORD       sent;
+  int         first;
+  int         pendingCount;
+  int         result;
+  int         rxCount;
+
+  if (BDI_PipeDepth() < 1) return BDI_ERR_NOT_CONNECTED;
+
+  /* a write covering part of a single access is not started at all */
+  result = BDI_OKAY;
+  sent   = 0;
+  while ((writeData != NULL) && (result == BDI_OKAY) && (sent < count)) {
+    result = MEM_NextPiece(session, addr + sent, count - sent, TRUE, &pending[0]);
+    sent  += (DWORD)pending[0].length;
+  } /* while */
+  if (result != BDI_OKAY) return result;
+
+  sent         = 0;
+  first        = 0;
+  pendingCount = 0;
+  for (;;) {
+
+    /* send commands while the pipe is not full */
+    while ((result == BDI_OKAY) && (sent < count) && (pendingCount < BDI_PipeDepth())) {
+      piece  = &pending[(first + pendingCount) % BDI_PIPE_DEPTH];
+      result = MEM_NextPiece(session, addr + sent, count - sent, writeData != NULL, piece);
+      if (result == BDI_OKAY) {
+        piece->offset = sent;
+        result = MEM_SendPiece(session, piece, writeData);
+      } /* if */
+      if (result == BDI_OKAY) {
+        sent += (DWORD)piece->length;
+        pendingCount++;
+      } /* if */
+    } /* while */
+    if (pendingCount == 0) break;
+
+    /* the answer of the oldest command */
+    rxCount = BDI_PipeReceive(sizeof memAnswer, memAnswer);
+    piece   = &pending[first];
+    first   = (first + 1) % BDI_PIPE_DEPTH;
+    pendingCount--;
+    if (result == BDI_OKAY) result = MEM_CheckAnswer(session, piece, rxCount, readData);
+  } /* for */
+  return result;
+} /* MEM_Transfer */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MEM_EnableCache / MEM_DisableCache :
+
+    Allocates or frees the page cache of a session.
+
+     INPUT  : pages     number of pages in the cache
+     OUTPUT : session   the session
+              RETURN    error code
+
+ ****************************************************************************/
+
+int MEM_EnableCache(MEM_SessionT* session, int pages)
+{
+  MEM_DisableCache(session);
+  if (pages < 1) return BDI_ERR_INVALID_PARAMETER;
+  session->page = (MEM_PageT*)calloc((size_t)pages, sizeof(MEM_PageT));
+  if (session->page == NULL) return BDI_ERR_FILE_ACCESS;
+  session->pages = pages;
+  return BDI_OKAY;
+} /* MEM_EnableCache */
+
+
+void MEM_DisableCache(MEM_SessionT* session)
+{
+  free(session->page);
+  session->page  = NULL;
+  session->pages = 0;
+} /* MEM_DisableCache */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MEM_AddUncached :
+
+    Declares memory that is always accessed on the target, e.g. the
+    registers of peripherals.
+
+     INPUT  : start     first address
+              end       last address
+     OUTPUT : session   the session
+              RETURN    error code
+
+ ****************************************************************************/
+
+int MEM_AddUncached(MEM_SessionT* session, DWORD start, DWORD end)
+{
+  MEM_RangeT* range;
+
+  if ((session->uncachedCount == MEM_MAX_UNCACHED) || (end < start)) return BDI_ERR_INVALID_PARAMETER;
+  range = &session->uncached[session->uncachedCount++];
+  range->start = start;
+  range->end   = end;
+  range->size  = 0;
+  MEM_Invalidate(session);
+  return BDI_OKAY;
+} /* MEM_AddUncached */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MEM_Invalidate :
+
+    Drops all pages of the cache.
+
+     OUTPUT : session   the session
+
+ ****************************************************************************/
+
+void MEM_Invalidate(MEM_SessionT* session)
+{
+  int     i;
+
+  for (i = 0; i < session->pages; i++) session->page[i].valid = FALSE;
+} /* MEM_Invalidate */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MEM_RunControl :
+
+    Lets the target run, step or reset. Its memory may change afterwards,
+    the cache is invalidated even if the command fails.
+
+     INPUT  : session   the session
+              command   BDI_CMD_START, SINGLE_STEP, RESET or RESET_TARGET
+     OUTPUT : RETURN    error code
+
+ ****************************************************************************/
+
+int MEM_RunControl(MEM_SessionT* session, BYTE command)
+{
+  BYTE*   cmdPtr;
+  int     rxCount;
+
+  if (   (command != BDI_CMD_START) && (command != BDI_CMD_SINGLE_STEP)
+      && (command != BDI_CMD_RESET) && (command != BDI_CMD_RESET_TARGET)) {
+    return BDI_ERR_INVALID_PARAMETER;
+  } /* if */
+  MEM_Invalidate(session);
+  cmdPtr = BDI_AppendByte(command, memCommand);
+  rxCount = BDI_Transaction(cmdPtr-memCommand, memCommand, sizeof memAnswer, memAnswer, MEM_EXEC_TIME);
+  if (rxCount < 0) return rxCount;
+  if ((rxCount != 1) || (memAnswer[0] != BDI_ANS_ACK)) return BDI_ERR_INVALID_RESPONSE;
+  return BDI_OKAY;
+} /* MEM_RunControl */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MEM_Cacheable :
+
+    Checks if a page may be cached, it must not hold any part of a TSZ
+    range or an uncacheable range.
+
+     INPUT  : session   the session
+              addr      first address of the page
+     OUTPUT : RETURN    TRUE if the page may be cached
+
+ ****************************************************************************/
+
+static BOOL MEM_Cacheable(const MEM_SessionT* session, DWORD addr)
+{
+  const MEM_RangeT* range;
+  DWORD             last;
+  int               i;
+
+  last = addr + MEM_PAGE_SIZE - 1;
+  for (i = 0; i < session->ranges; i++) {
+    range = &session->range[i];
+    if ((range->start <= last) && (range->end >= addr)) return FALSE;
+  } /* for */
+  for (i = 0; i < session->uncachedCount; i++) {
+    range = &session->uncached[i];
+    if ((range->start <= last) && (range->end >= addr)) return FALSE;
+  } /* for */
+  return TRUE;
+} /* MEM_Cacheable */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MEM_FindPage :
+
+    Looks up a page in the cache.
+
+     INPUT  : session   the session
+              addr      first address of the page
+     OUTPUT : RETURN    the cached page, NULL if not cached
+
+ ****************************************************************************/
+
+static MEM_PageT* MEM_FindPage(MEM_SessionT* session, DWORD addr)
+{
+  int     i;
+
+  for (i = 0; i < session->pages; i++) {
+    if (session->page[i].valid && (session->page[i].addr == addr)) return &session->page[i];
+  } /* for */
+  return NULL;
+} /* MEM_FindPage */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MEM_FillPages :
+
+    Reads the missing cacheable pages starting with addr into the cache.
+    The least recently used pages are replaced.
+
+     INPUT  : session   the session
+              addr      first address of the first page, not cached
+              wanted    number of pages needed from addr on
+     OUTPUT : RETURN    error code
+
+ ****************************************************************************/
+
+static int MEM_FillPages(MEM_SessionT* session, DWORD addr, DWORD wanted)
+{
+  MEM_PageT*  page;
+  DWORD       count;
+  DWORD       n;
+  int         result;
+  int         i;
+
+  /* the run of missing pages */
+  count = 1;
+  while (   (count < wanted) && (count < MEM_FILL_PAGES) && (count < (DWORD)session->pages)
+         && MEM_Cacheable(session, addr + count * MEM_PAGE_SIZE)
+         && (MEM_FindPage(session, addr + count * MEM_PAGE_SIZE) == NULL)) {
+    count++;
+  } /* while */
+  result = MEM_Transfer(session, addr, count * MEM_PAGE_SIZE, memFill, NULL);
+  if (result != BDI_OKAY) return result;
+
+  /* replace the least recently used pages */
+  for (n = 0; n < count; n++) {
+    page = &session->page[0];
+    for (i = 1; (i < session->pages) && page->valid; i++) {
+      if (!session->page[i].valid || (session->page[i].used < page->used)) page = &session->page[i];
+    } /* for */
+    page->addr  = addr + n * MEM_PAGE_SIZE;
+    page->valid = TRUE;
+    page->used  = ++session->clock;
+    (void)memcpy(page->data, memFill + n * MEM_PAGE_SIZE, MEM_PAGE_SIZE);
+    session->misses++;
+  } /* for */
+  return BDI_OKAY;
+} /* MEM_FillPages */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MEM_UpdatePages :
+
+    Keeps the cached pages coherent with a write to the target. After a
+    failed write the content of the target is not known, the pages are
+    dropped.
+
+     INPUT  : session   the session
+              addr      first address written
+              count     number of bytes
+              data      the written data, NULL to drop the pages
+
+ ****************************************************************************/
+
+static void MEM_UpdatePages(MEM_SessionT* session, DWORD addr, DWORD count, const BYTE* data)
+{
+  MEM_PageT*  page;
+  DWORD       first;
+  DWORD       last;
+  int         i;
+
+  for (i = 0; i < session->pages; i++) {
+    page = &session->page[i];
+    if (!page->valid || (page->addr > addr + count - 1) || (page->addr + MEM_PAGE_SIZE <= addr)) continue;
+    if (data == NULL) {
+      page->valid = FALSE;
+      continue;
+    } /* if */
+    first = (page->addr > addr) ? page->addr : addr;
+    last  = page->addr + MEM_PAGE_SIZE - 1;
+    if (addr + count - 1 < last) last = addr + count - 1;
+    (void)memcpy(page->data + (first - page->addr), data + (first - addr), (size_t)(last - first + 1));
+  } /* for */
+} /* MEM_UpdatePages */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MEM_Read / MEM_Write :
+
+    Reads or writes target memory of any address and length. With the
+    cache enabled a read is served page by page, consecutive uncacheable
+    pages are read with one transfer. A page that cannot be read as a
+    whole is read as requested.
+
+     INPUT  : session   the session
+              addr      first address
+              count     number of bytes
+              data      the data to write
+     OUTPUT : data      the read data
+              RETURN    error code
+
+ ****************************************************************************/
+
+int MEM_Read(MEM_SessionT* session, DWORD addr, DWORD count, BYTE* data)
+{
+  MEM_PageT*  page;
+  DWORD       done;
+  DWORD       base;
+  DWORD       skip;
+  DWORD       length;
+  int         result;
+
+  if (session->page == NULL) return MEM_Transfer(session, addr, count, data, NULL);
+
+  result = BDI_OKAY;
+  for (done = 0; (done < count) && (result == BDI_OKAY); done += length) {
+    base   = (addr + done) & ~(DWORD)(MEM_PAGE_SIZE - 1);
+    skip   = addr + done - base;
+    length = MEM_PAGE_SIZE - skip;
+    if (count - done < length) length = count - done;
+
+    /* uncacheable pages directly */
+    if (!MEM_Cacheable(session, base)) {
+      while (   (done + length < count)
+             && !MEM_Cacheable(session, base + skip + length)) {
+        length += MEM_PAGE_SIZE;
+        if (count - done < length) length = count - done;
+      } /* while */
+      result = MEM_Transfer(session, addr + done, length, data + done, NULL);
+      continue;
+    } /* if */
+
+    page = MEM_FindPage(session, base);
+    if (page != NULL) session->hits++;
+    else {
+      result = MEM_FillPages(session, base, (skip + count - done + MEM_PAGE_SIZE - 1) / MEM_PAGE_SIZE);
+      if (result == BDI_ERR_MEM_ACCESS) {
+        result = MEM_Transfer(session, addr + done, length, data + done, NULL);
+        continue;
+      } /* if */
+      page = MEM_FindPage(session, base);
+    } /* else */
+    if (result == BDI_OKAY) {
+      page->used = ++session->clock;
+      (void)memcpy(data + done, page->data + skip, (size_t)length);
+    } /* if */
+  } /* for */
+  return result;
+} /* MEM_Read */
+
+
+int MEM_Write(MEM_SessionT* session, DWORD addr, DWORD count, const BYTE* data)
+{
+  int     result;
+
+  result = MEM_Transfer(session, addr, count, NULL, data);
+  if ((count > 0) && (result != BDI_ERR_INVALID_PARAMETER)) {
+    MEM_UpdatePages(session, addr, count, (result == BDI_OKAY) ? data : NULL);
+  } /* if */
+  return result;
+} /* MEM_Write */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    MEM_ReadValue / MEM_WriteValue :
+
+    Reads or writes one value with a single access, e.g. a register of
+    a peripheral. A value in cacheable memory is read from the cache.
+
+     INPUT  : session   the session
+              addr      address, aligned to size
+              size      access size 1, 2 or 4
+              value     the value to write
+     OUTPUT : value     the read value
+              RETURN    error code
+
+ ****************************************************************************/
+
+int MEM_ReadValue(MEM_SessionT* session, DWORD addr, int size, DWORD* value)
+{
+  MEM_PieceT  piece;
+  BYTE        unit[4];
+  int         rxCount;
+  int         result;
+
+  if (((size != 1) && (size != 2) && (size != 4)) || ((addr & (DWORD)(size - 1)) != 0)) {
+    return BDI_ERR_INVALID_PARAMETER;
+  } /* if */
+  if ((session->page != NULL) && MEM_Cacheable(session, addr & ~(DWORD)(MEM_PAGE_SIZE - 1))) {
+    result = MEM_Read(session, addr, (DWORD)size, unit);
+  } /* if */
+  else {
+    piece.addr   = addr;
+    piece.offset = 0;
+    piece.length = size;
+    piece.size   = size;
+    piece.skip   = 0;
+    result = MEM_SendPiece(session, &piece, NULL);
+    if (result != BDI_OKAY) return result;
+    rxCount = BDI_PipeReceive(sizeof memAnswer, memAnswer);
+    result  = MEM_CheckAnswer(session, &piece, rxCount, unit);
+  } /* else */
+  if (result == BDI_OKAY) *value = MEM_GetValue(session, unit, size);
+  return result;
+} /* MEM_ReadValue */
+
+
+int MEM_WriteValue(MEM_SessionT* session, DWORD addr, int size, DWORD value)
+{
+  MEM_PieceT  piece;
+  BYTE        unit[4];
+  int         result;
+
+  if (((size != 1) && (size != 2) && (size != 4)) || ((addr & (DWORD)(size - 1)) != 0)) {
+    return BDI_ERR_INVALID_PARAMETER;
+  } /* if */
+  piece.addr   = addr;
+  piece.offset = 0;
+  piece.length = size;
+  piece.size   = size;
+  piece.skip   = 0;
+  MEM_PutValue(session, value, size, unit);
+  result = MEM_SendPiece(session, &piece, unit);
+  if (result != BDI_OKAY) return result;
+  result = MEM_CheckAnswer(session, &piece, BDI_PipeReceive(sizeof memAnswer, memAnswer), NULL);
+  MEM_UpdatePages(session, addr, (DWORD)size, (result == BDI_OKAY) ? unit : NULL);
+  return result;
+} /* MEM_WriteValue */
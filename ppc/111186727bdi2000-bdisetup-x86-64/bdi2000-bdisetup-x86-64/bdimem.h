@@ -0,0 +1,109 @@
+#ifndef __BDIMEM_H__
+#define __BDIMEM_H__
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdimem.h
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX
+|  TARGET HW   : PC
+|
+|  PROGRAMMER  : Abatron / RD
+|  CREATION    : 19.10.26
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  Target memory access through the BDI firmware in debug mode
+|
+|
+|*************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define MEM_MAX_RANGES          32     /* access size ranges of a session */
+#define MEM_EXEC_TIME           1000   /* execution time of a memory command */
+#define MEM_MAX_UNCACHED        8      /* uncacheable ranges of a session */
+#define MEM_PAGE_SIZE           BDI_MAX_BLOCK_SIZE  /* cache page, read with one GET_BLOCK */
+#define MEM_FILL_PAGES          16     /* cache pages read with one pipelined transfer */
+#define MEM_IMMR_SIZE           0x100000 /* internal memory map at the IMMR of [INIT] */
+
+/*************************************************************************
+|  TYPEDEFS
+|*************************************************************************/
+
+/* memory accessed with one access size only (TSZ1, TSZ2 and TSZ4) */
+typedef struct {
+  DWORD         start;
+  DWORD         end;            /* last address */
+  int           size;           /* 1, 2 or 4 */
+} MEM_RangeT;
+
+/* a page of target memory held by the host */
+typedef struct {
+  DWORD         addr;           /* first address, aligned to MEM_PAGE_SIZE */
+  BOOL          valid;
+  DWORD         used;           /* cache clock of the last use */
+  BYTE          data[MEM_PAGE_SIZE];
+} MEM_PageT;
+
+typedef struct {
+  MEM_RangeT    range[MEM_MAX_RANGES];
+  int           ranges;
+  BOOL          littleEndian;   /* byte order of the FETCH and SET values */
+  int           space;          /* selected memory space, -1 if default */
+  DWORD         commands;       /* memory commands sent */
+  MEM_RangeT    uncached[MEM_MAX_UNCACHED]; /* bypass the cache, size not used */
+  int           uncachedCount;
+  MEM_PageT*    page;           /* the page cache, NULL if disabled */
+  int           pages;
+  DWORD         clock;          /* incremented with every use of a page */
+  DWORD         hits;           /* pages found in the cache */
+  DWORD         misses;         /* pages read from the target */
+} MEM_SessionT;
+
+/*************************************************************************
+|  FUNCTIONS
+|*************************************************************************/
+
+void  MEM_Init(MEM_SessionT* session);
+int   MEM_AddRange(MEM_SessionT* session, DWORD start, DWORD end, int size);
+
+/* the TSZ ranges and the IMMR of [INIT] and the ENDIAN of [TARGET] */
+int   MEM_SetConfig(MEM_SessionT* session, const CNF_ConfigT* config);
+int   MEM_SetSpace(MEM_SessionT* session, BYTE space);
+
+/* any address and length, split into maximal blocks and pipelined */
+int   MEM_Read(MEM_SessionT* session, DWORD addr, DWORD count, BYTE* data);
+int   MEM_Write(MEM_SessionT* session, DWORD addr, DWORD count, const BYTE* data);
+
+/* one access of 1, 2 or 4 bytes */
+int   MEM_ReadValue(MEM_SessionT* session, DWORD addr, int size, DWORD* value);
+int   MEM_WriteValue(MEM_SessionT* session, DWORD addr, int size, DWORD value);
+
+/* page cache, valid while the target is halted. Memory changed other
+   than through the session (LDR_LoadImage, flash programming) needs
+   MEM_Invalidate. TSZ ranges are never cached. */
+int   MEM_EnableCache(MEM_SessionT* session, int pages);
+void  MEM_DisableCache(MEM_SessionT* session);
+int   MEM_AddUncached(MEM_SessionT* session, DWORD start, DWORD end);
+void  MEM_Invalidate(MEM_SessionT* session);
+
+/* START, SINGLE_STEP, RESET or RESET_TARGET, invalidates the cache */
+int   MEM_RunControl(MEM_SessionT* session, BYTE command);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
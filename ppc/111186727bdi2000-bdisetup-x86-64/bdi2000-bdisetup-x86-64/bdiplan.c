@@ -0,0 +1,428 @@
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdiplan.c
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX / UNIX
+|  TARGET HW   : PC
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  This module collects the transactions of an update without executing
+|  them. For every transaction the bytes on the wire are calculated (DLE
+|  stuffing on serial links, Ethernet/IP/UDP headers on the network) and
+|  the duration is estimated from the measured round trip time of the
+|  link, the transfer time and the typical execution time on the BDI.
+|  The plan is written as JSON, a saved plan can be read back to execute
+|  it later.
+|
+|  The estimate assumes that no frame has to be repeated.
+|
+|*************************************************************************/
+
+/*************************************************************************
+|  INCLUDES
+|*************************************************************************/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "bdierror.h"
+#include "bdicmd.h"
+#include "bdidll.h"
+#include "bdiplan.h"
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define PLN_STEP_GROW       256     /* number of steps to add at once */
+#define PLN_MAX_OPS         16      /* different operations in the summary */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    PLN_Init / PLN_Free :
+
+    Initialize / release a plan.
+
+ ****************************************************************************/
+
+void PLN_Init(PLN_PlanT* plan)
+{
+  plan->asyn     = FALSE;
+  plan->baudrate = 0;
+  plan->latency  = 0;
+  plan->count    = 0;
+  plan->alloc    = 0;
+  plan->step     = NULL;
+} /* PLN_Init */
+
+
+void PLN_Free(PLN_PlanT* plan)
+{
+  free(plan->step);
+  PLN_Init(plan);
+} /* PLN_Free */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    PLN_TransferTime :
+
+    Calculates the time to transfer a number of bytes over the link.
+
+     INPUT  : plan      the plan with the link parameters
+              bytes     number of bytes on the wire
+     OUTPUT : RETURN    transfer time in us
+
+ ****************************************************************************/
+
+static DWORD PLN_TransferTime(const PLN_PlanT* plan, DWORD bytes)
+{
+  if (plan->asyn) {
+    if (plan->baudrate == 0) return 0;
+    return (DWORD)((bytes * 10.0 * 1000000.0) / plan->baudrate);   /* 8N1 */
+  } /* if */
+  return (DWORD)((bytes * 8.0 * 1000000.0) / PLN_NET_BITRATE);
+} /* PLN_TransferTime */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    PLN_MeasureLink :
+
+    Measures the round trip time of the current link with a short
+    command and stores the latency (round trip time minus transfer time).
+
+     INPUT  : plan          the plan
+              cmdLength     length of the command
+              cmd           a command without side effects
+     OUTPUT : RETURN        error code
+
+ ****************************************************************************/
+
+int PLN_MeasureLink(PLN_PlanT* plan, int cmdLength, const BYTE* cmd)
+{
+  BYTE  answer[BDI_MAX_FRAME_SIZE];
+  DWORD start;
+  DWORD total;
+  DWORD transfer;
+  int   rxCount;
+  int   i;
+
+  plan->asyn = BDI_GetLink(&plan->baudrate);
+  total   = 0;
+  rxCount = 0;
+  for (i = 0; i < PLN_RTT_SAMPLES; i++) {
+    start   = BDI_GetMicroseconds();
+    rxCount = BDI_Transaction(cmdLength, cmd, sizeof answer, answer, 1000);
+    total  += BDI_GetMicroseconds() - start;
+    if (rxCount < 0) return rxCount;
+  } /* for */
+
+  total   /= PLN_RTT_SAMPLES;
+  transfer = PLN_TransferTime(plan, (DWORD)(BDI_WireSize(0, cmdLength, cmd)
+                                            + BDI_WireSize(0, rxCount, answer)));
+  plan->latency = (total > transfer) ? (total - transfer) : 0;
+  return BDI_OKAY;
+} /* PLN_MeasureLink */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    PLN_Add :
+
+    Appends a transaction to the plan.
+
+     INPUT  : plan          the plan
+              szOp          the operation (static string)
+              addr          address or row number
+              count         number of data bytes
+              cmdLength     length of the command
+              cmd           the command <code,parameter>
+              ansLength     length of the expected answer
+              ans           the expected answer <code,parameter>
+              execTime      the execution time on the BDI in us
+     OUTPUT : RETURN        error code
+
+ ****************************************************************************/
+
+int PLN_Add(PLN_PlanT*  plan,
+            const char* szOp,
+            DWORD       addr,
+            DWORD       count,
+            int         cmdLength,
+            const BYTE* cmd,
+            int         ansLength,
+            const BYTE* ans,
+            DWORD       execTime)
+{
+  PLN_StepT*  newStep;
+  PLN_StepT*  step;
+
+  if (plan->count == plan->alloc) {
+    newStep = (PLN_StepT*)realloc(plan->step, (plan->alloc + PLN_STEP_GROW) * sizeof(PLN_StepT));
+    if (newStep == NULL) return BDI_ERR_FILE_ACCESS;
+    plan->step   = newStep;
+    plan->alloc += PLN_STEP_GROW;
+  } /* if */
+  step = &plan->step[plan->count];
+  step->szOp     = szOp;
+  step->addr     = addr;
+  step->count    = count;
+  step->txBytes  = (DWORD)BDI_WireSize(plan->count, cmdLength, cmd);
+  step->rxBytes  = (DWORD)BDI_WireSize(plan->count, ansLength, ans);
+  step->execTime = execTime;
+  plan->count++;
+  return BDI_OKAY;
+} /* PLN_Add */
+
+
+DWORD PLN_StepTime(const PLN_PlanT* plan, const PLN_StepT* step)
+{
+  return plan->latency + PLN_TransferTime(plan, step->txBytes + step->rxBytes) + step->execTime;
+} /* PLN_StepTime */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    PLN_WriteString :
+
+    Writes a JSON string member, the value is escaped.
+
+     INPUT  : file      the output file
+              szKey     the member name
+              szValue   the value
+     OUTPUT : -
+
+ ****************************************************************************/
+
+void PLN_WriteString(FILE* file, const char* szKey, const char* szValue)
+{
+  fprintf(file, "  \"%s\": \"", szKey);
+  for (; *szValue != 0; szValue++) {
+    if      ((*szValue == '"') || (*szValue == '\\')) fprintf(file, "\\%c", *szValue);
+    else if ((unsigned char)*szValue < 0x20)           fprintf(file, "\\u%04x", (unsigned char)*szValue);
+    else                                              fputc(*szValue, file);
+  } /* for */
+  fprintf(file, "\",\n");
+} /* PLN_WriteString */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    PLN_WriteSteps :
+
+    Writes the link parameters, the transactions, a summary per operation
+    and the totals as JSON members (the last members of the plan object).
+
+     INPUT  : file      the output file
+              plan      the plan
+     OUTPUT : -
+
+ ****************************************************************************/
+
+void PLN_WriteSteps(FILE* file, const PLN_PlanT* plan)
+{
+  const PLN_StepT*  step;
+  const char*       szOp[PLN_MAX_OPS];
+  DWORD             opCount[PLN_MAX_OPS];
+  double            opTime[PLN_MAX_OPS];
+  int               ops;
+  int               op;
+  int               i;
+  DWORD             stepTime;
+  DWORD             dataBytes;
+  double            txBytes;
+  double            rxBytes;
+  double            totalTime;
+
+  fprintf(file, "  \"link\": { \"type\": \"%s\", \"baudrate\": %lu, \"latency_us\": %lu },\n",
+          plan->asyn ? "serial" : "network", plan->asyn ? plan->baudrate : 0UL, plan->latency);
+
+  /* transactions */
+  ops       = 0;
+  dataBytes = 0;
+  txBytes   = 0;
+  rxBytes   = 0;
+  totalTime = 0;
+  fprintf(file, "  \"steps\": [\n");
+  for (i = 0; i < plan->count; i++) {
+    step     = &plan->step[i];
+    stepTime = PLN_StepTime(plan, step);
+    fprintf(file, "    { \"op\": \"%s\", \"addr\": \"0x%08lx\", \"bytes\": %lu, "
+                  "\"wire_tx\": %lu, \"wire_rx\": %lu, \"us\": %lu }%s\n",
+            step->szOp, step->addr, step->count, step->txBytes, step->rxBytes,
+            stepTime, (i + 1 < plan->count) ? "," : "");
+    dataBytes += step->count;
+    txBytes   += step->txBytes;
+    rxBytes   += step->rxBytes;
+    totalTime += stepTime;
+
+    /* operations are static strings */
+    for (op = 0; (op < ops) && (szOp[op] != step->szOp); op++);
+    if (op == ops) {
+      if (ops == PLN_MAX_OPS) continue;
+      szOp[op]    = step->szOp;
+      opCount[op] = 0;
+      opTime[op]  = 0;
+      ops++;
+    } /* if */
+    opCount[op]++;
+    opTime[op] += stepTime;
+  } /* for */
+  fprintf(file, "  ],\n");
+
+  /* summary */
+  fprintf(file, "  \"summary\": [\n");
+  for (op = 0; op < ops; op++) {
+    fprintf(file, "    { \"op\": \"%s\", \"count\": %lu, \"ms\": %.0f }%s\n",
+            szOp[op], opCount[op], opTime[op] / 1000.0, (op + 1 < ops) ? "," : "");
+  } /* for */
+  fprintf(file, "  ],\n");
+  fprintf(file, "  \"totals\": { \"transactions\": %i, \"data_bytes\": %lu, "
+                "\"wire_tx\": %.0f, \"wire_rx\": %.0f, \"estimated_ms\": %.0f }\n",
+          plan->count, dataBytes, txBytes, rxBytes, totalTime / 1000.0);
+} /* PLN_WriteSteps */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    PLN_Load :
+
+    Loads a saved plan into memory.
+
+     INPUT  : szFileName    the plan file
+     OUTPUT : RETURN        the zero terminated plan (free after use)
+                            or NULL if error
+
+ ****************************************************************************/
+
+char* PLN_Load(const char* szFileName)
+{
+  FILE*   file;
+  char*   szPlan;
+  long    size;
+
+  file = fopen(szFileName, "rb");
+  if (file == NULL) return NULL;
+  szPlan = NULL;
+  if ((fseek(file, 0, SEEK_END) == 0) && ((size = ftell(file)) > 0)) {
+    rewind(file);
+    szPlan = (char*)malloc((size_t)size + 1);
+    if ((szPlan != NULL) && (fread(szPlan, 1, (size_t)size, file) != (size_t)size)) {
+      free(szPlan);
+      szPlan = NULL;
+    } /* if */
+    if (szPlan != NULL) szPlan[size] = 0;
+  } /* if */
+  fclose(file);
+  return szPlan;
+} /* PLN_Load */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    PLN_GetString / PLN_GetNumber :
+
+    Get the value of a member of a saved plan. The first member with the
+    name is used, plans written by PLN_WriteString never contain an
+    unescaped quote within a value.
+
+     INPUT  : szPlan    the plan
+              szKey     the member name
+              size      the size of the string buffer
+     OUTPUT : szValue   the string value
+              value     the numeric value, true = 1 and false = 0
+              RETURN    TRUE if found
+
+ ****************************************************************************/
+
+static const char* PLN_FindValue(const char* szPlan, const char* szKey)
+{
+  const char*   szPos;
+  size_t        keyLen;
+
+  keyLen = strlen(szKey);
+  for (szPos = strchr(szPlan, '"'); szPos != NULL; szPos = strchr(szPos + 1, '"')) {
+    if (   ((szPos == szPlan) || (szPos[-1] != '\\'))
+        && (strncmp(szPos + 1, szKey, keyLen) == 0) && (szPos[keyLen + 1] == '"')) {
+      szPos += keyLen + 2;
+      while (isspace((unsigned char)*szPos)) szPos++;
+      if (*szPos != ':') continue;
+      szPos++;
+      while (isspace((unsigned char)*szPos)) szPos++;
+      return szPos;
+    } /* if */
+  } /* for */
+  return NULL;
+} /* PLN_FindValue */
+
+
+BOOL PLN_GetString(const char* szPlan, const char* szKey, char* szValue, size_t size)
+{
+  const char*   szPos;
+  unsigned int  code;
+  size_t        length;
+
+  szPos = PLN_FindValue(szPlan, szKey);
+  if ((szPos == NULL) || (*szPos != '"')) return FALSE;
+  szPos++;
+  length = 0;
+  while ((*szPos != '"') && (*szPos != 0)) {
+    if (length + 1 >= size) return FALSE;
+    if (*szPos == '\\') {
+      szPos++;
+      if (*szPos == 'u') {
+        if (sscanf(szPos + 1, "%4x", &code) != 1) return FALSE;
+        szValue[length++] = (char)code;
+        szPos += 5;
+        continue;
+      } /* if */
+      else if (*szPos == 'n') szValue[length++] = '\n';
+      else if (*szPos == 't') szValue[length++] = '\t';
+      else if (*szPos != 0)   szValue[length++] = *szPos;
+      else                    return FALSE;
+    } /* if */
+    else {
+      szValue[length++] = *szPos;
+    } /* else */
+    szPos++;
+  } /* while */
+  szValue[length] = 0;
+  return (*szPos == '"');
+} /* PLN_GetString */
+
+
+BOOL PLN_GetNumber(const char* szPlan, const char* szKey, unsigned long* value)
+{
+  const char*   szPos;
+  char*         szEnd;
+
+  szPos = PLN_FindValue(szPlan, szKey);
+  if (szPos == NULL) return FALSE;
+  if (strncmp(szPos, "true",  4) == 0) *value = 1;
+  else if (strncmp(szPos, "false", 5) == 0) *value = 0;
+  else {
+    *value = strtoul(szPos, &szEnd, 0);
+    if (szEnd == szPos) return FALSE;
+  } /* else */
+  return TRUE;
+} /* PLN_GetNumber */
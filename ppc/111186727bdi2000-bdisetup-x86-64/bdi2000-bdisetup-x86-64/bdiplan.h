@@ -0,0 +1,102 @@
+#ifndef __BDIPLAN_H__
+#define __BDIPLAN_H__
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdiplan.h
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX
+|  TARGET HW   : PC
+|
+|  PROGRAMMER  : Abatron / RD
+|  CREATION    : 19.10.26
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  Dry run plan of an update: transactions, wire bytes and duration
+|
+|
+|*************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define PLN_FORMAT              1
+
+/* typical execution times on the BDI in us, used for the estimate */
+#define PLN_TIME_ERASE          150000L /* sector erase, fixed part       */
+#define PLN_TIME_ERASE_KB       9000L   /* sector erase, per KB of sector */
+#define PLN_TIME_PROGRAM_KB     8000L   /* flash program, per KB          */
+#define PLN_TIME_READ           500L    /* memory read                    */
+#define PLN_TIME_ISP            1000L   /* ISP mode, device ID, UES read  */
+#define PLN_TIME_ISP_ERASE      200000L /* CPLD bulk erase                */
+#define PLN_TIME_ISP_PROGRAM    80000L  /* CPLD row or UES program        */
+#define PLN_TIME_ISP_READ       5000L   /* CPLD row read                  */
+
+#define PLN_NET_BITRATE         10000000L /* BDI Ethernet, bit/s */
+#define PLN_RTT_SAMPLES         8
+
+/*************************************************************************
+|  TYPEDEFS
+|*************************************************************************/
+
+/* one transaction */
+typedef struct {
+  const char* szOp;       /* operation, e.g. "erase" */
+  DWORD       addr;       /* address or row number */
+  DWORD       count;      /* number of data bytes */
+  DWORD       txBytes;    /* command bytes on the wire */
+  DWORD       rxBytes;    /* answer bytes on the wire */
+  DWORD       execTime;   /* execution time on the BDI in us */
+} PLN_StepT;
+
+/* the plan, all transactions in execution order */
+typedef struct {
+  BOOL        asyn;       /* serial link */
+  DWORD       baudrate;   /* baudrate of a serial link */
+  DWORD       latency;    /* measured round trip time without transfer, us */
+  int         count;
+  int         alloc;
+  PLN_StepT*  step;
+} PLN_PlanT;
+
+/*************************************************************************
+|  FUNCTIONS
+|*************************************************************************/
+
+void  PLN_Init(PLN_PlanT* plan);
+void  PLN_Free(PLN_PlanT* plan);
+int   PLN_MeasureLink(PLN_PlanT* plan, int cmdLength, const BYTE* cmd);
+int   PLN_Add(PLN_PlanT*  plan,
+              const char* szOp,
+              DWORD       addr,
+              DWORD       count,
+              int         cmdLength,
+              const BYTE* cmd,
+              int         ansLength,
+              const BYTE* ans,
+              DWORD       execTime);
+DWORD PLN_StepTime(const PLN_PlanT* plan, const PLN_StepT* step);
+void  PLN_WriteString(FILE* file, const char* szKey, const char* szValue);
+void  PLN_WriteSteps(FILE* file, const PLN_PlanT* plan);
+
+/* read back a saved plan */
+char* PLN_Load(const char* szFileName);
+BOOL  PLN_GetString(const char* szPlan, const char* szKey, char* szValue, size_t size);
+BOOL  PLN_GetNumber(const char* szPlan, const char* szKey, unsigned long* value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -31,12 +31,17 @@
 |  different parameters. The first parameter always selects the task
 |  to execute:
 |
-|  bdisetup { -v | -e | -u | -c } [additional parameters]
+|  bdisetup { -v | -e | -u | -c | -x | -r | -l | -w | -y } [additional parameters]
 |
 |       -v      Read version
 |       -e      Erase firmware and logic
 |       -u      Update firmware and/or logic
 |       -c      Store network configuration
+|       -x      Execute an update plan
+|       -r      Analyse the [INIT] part of a configuration file
+|       -l      Read back the configuration stored in the BDI flash
+|       -w      Read or write target memory
+|       -y      Profile the running target with bdiSpy
 |
 |  There are two common additional parameters which define the serial port
 |  and the serial baudrate:
@@ -50,6 +55,19 @@
 |       -tT     Target type, replace T with CPU32,PPC400,PPC600,PPC700,MPC800,
 |                 ARM,TRICORE,MCF,HC12,MCORE,MIPS,MIPS64,XSCALE
 |       -dD     Replace D with the directory with the firmware/logic files
+|               or with a zip/tar release archive (read without extracting)
+|       -kK     Replace K with a cache directory for parsed firmware/logic
+|               files and the manifest of the firmware directory, speeds up
+|               updating many BDIs from the same files
+|       -jJ     Replace J with a journal directory. The progress of a firmware
+|               update is recorded per BDI serial number, an interrupted
+|               update continues where it stopped when run again
+|       -n      Do not read back and verify the programmed flash
+|       --plan[=F]  Do not update, write the plan of the update as JSON to
+|               file F or to stdout: every erase, program, ISP and verify
+|               transaction with its bytes on the wire and the estimated
+|               duration (measured link round trip time, transfer time and
+|               typical flash/CPLD timing, no retransmissions)
 |
 |  Additional parameters for network configuration (-c):
 |
@@ -58,7 +76,84 @@
 |       -mM     Replace M with the subnet mask.
 |               A subnet mask of 255.255.255.255 disables the gateway function
 |       -gG     Replace G with the default gateway IP address
-|       -fF     Replace F with the path and name of the configuration file
+|       -fF     Replace F with the path and name of the configuration file.
+|               The file is compiled and checked before the flash is erased
+|       -kK     Replace K with a cache directory for the built configuration
+|               and register definitions, rebuilt only if a file changed
+|       -n      Do not read back and verify the programmed flash
+|       --strip Program the configuration without comments, blank lines
+|               and redundant white space
+|       --plan[=F]  Do not program, write the plan as for -u
+|       --fleet=F   Configure many BDIs, F is an inventory (CSV with the
+|               names in the first line or a JSON array of objects) with
+|               one unit per line/object. Every ${NAME} in the file of -f
+|               is replaced with the value of the unit. All configurations
+|               are built and checked first, then the BDIs are programmed
+|               one after the other. The unit values PORT, SN (the serial
+|               number of the BDI), IP, HOST, MASK, GATEWAY and FILE
+|               replace -p, -i, -h, -m, -g and the file name stored in
+|               the BDI, NAME names the unit in messages
+|       --check Only build and check the configurations of --fleet
+|
+|  Additional parameters for executing a plan (-x):
+|
+|       --plan=F    Replace F with the plan written by -u/-c --plan=F. The
+|               files of the plan must be unchanged and the BDI of the same
+|               type. Without -p/-b the port and baudrate of the plan are used.
+|
+|  Additional parameters for analysing a configuration (-r):
+|
+|       -fF     Replace F with the path and name of the configuration file.
+|               The total delay time, repeated and overwritten writes and
+|               adjacent writes that can be merged into wider ones are
+|               reported. Nothing is moved across DELAY, SUPM, WUPM, reads
+|               and register writes.
+|       --memory=S,E  Replace S and E with the first and last address of
+|               plain memory (RAM without side effects). Only writes within
+|               these ranges are removed or merged by --optimize, a write
+|               to a device register may be a command.
+|       --optimize=O  Write the configuration with the removable writes
+|               commented out and merged writes and delays to file O
+|
+|  Additional parameters for reading back the configuration (-l):
+|
+|       -fF     Replace F with the file to write the configuration to. The
+|               register definitions are written into the same directory
+|               under the names of the [REGS] part. Without -f only the
+|               sizes and names are listed. The configuration and register
+|               definitions are read up to their first erased (0xFF) byte.
+|
+|  Additional parameters for target memory access (-w), the BDI runs the
+|  firmware and the target is in debug mode:
+|
+|       -fF     Replace F with the configuration file of the target. Memory
+|               declared with TSZ1, TSZ2 or TSZ4 in [INIT] is accessed with
+|               that size only, the byte order is taken from ENDIAN.
+|       --space=S   Replace S with the target specific memory space
+|       --read=A,N  Read N bytes at address A and list them in hex
+|       --write=A,D Write the bytes D (hex, e.g. 0102A0FF) at address A
+|               Any address and length is split into blocks of up to 1024
+|               bytes with several commands in flight.
+|       --load=L[,A] Download the application file L (ELF, S-Record or
+|               binary, a binary file is loaded at address A) and set the
+|               PC to its entry point. With fast load the blocks are
+|               streamed without answers and checked by a checksum.
+|       --dump=A,N,O Dump N bytes at address A into the file O. Pages of
+|               all 0x00 remain holes of a sparse binary file, the file is
+|               written with O_DIRECT where possible while the next blocks
+|               are read. One dot is shown per MB.
+|       --srec  Dump as S-Record file without the pages of all 0x00/0xFF
+|
+|  Additional parameters for profiling (-y), the BDI runs the firmware and
+|  the target runs the application:
+|
+|       --elf=E Replace E with the ELF file of the application. Every
+|               function of its symbol table is counted as one range, more
+|               than 128 functions are counted in groups by turns.
+|       --time=T    Profile for T seconds (default 10)
+|       --interval=I Poll the counters every I ms (default 100)
+|       --folded=O  Write folded stacks (section;function samples) for
+|               flame graph tools to file O. The flat profile is listed.
 |
 |  All parameters have default values. See function main(). You may adjust
 |  this default values for your convenience.
@@ -76,13 +171,36 @@
 |  -h151.120.25.115 \
 |  -fE:\cygnus\root\usr\demo\mpc8260\ppc750.cnf
 |
+|  bdisetup -c -flab.cfg \               Configure the BDIs of a lab from
+|  --fleet=lab.csv                      one template.
+|
+|  bdisetup -r -fmpc8280.cfg \           Analyse the [INIT] part, optimize
+|  --memory=0x00100000,0x03ffffff \      the writes to the SDRAM above 1MB
+|  --optimize=fast.cfg
+|
+|  bdisetup -l -p151.120.25.101 \       Read back the configuration of a
+|  -fdeployed/bdi.cfg                   BDI to compare it with the original.
+|
+|  bdisetup -w -p151.120.25.101 \       Read 256 bytes of target memory,
+|  -fmpc8280.cfg --read=0x1000,256      the TSZ ranges of the file apply.
+|
+|  bdisetup -w -p151.120.25.101 \       Download an application into the
+|  --load=vxWorks.elf                   target SDRAM and set the PC.
+|
+|  bdisetup -w -p151.120.25.101 \       Post-mortem dump of 64MB SDRAM.
+|  --dump=0x0,0x4000000,sdram.bin
+|
+|  bdisetup -y -p151.120.25.101 \       Profile the firmware for 30 s and
+|  --elf=fw.elf --time=30 \             draw a flame graph of it.
+|  --folded=fw.folded
+|
 |
 |  Build the setup utility:
 |  =======================
 |
 |  To build the setup utility use GCC as follows:
 |
-|  gcc bdisetup.c bdidll.c -o bdisetup
+|  gcc bdisetup.c bdidll.c bdicnf.c bdicrc.c bdiimg.c bdifuse.c bdicache.c bdiman.c bdiarc.c bdijrn.c bdiplan.c bdifleet.c bdiinit.c bdimem.c bdiload.c bdidump.c bdispy.c -lz -o bdisetup
 |
 |*************************************************************************/
 
@@ -109,6 +227,20 @@
 #include "bdicmd.h"
 #include "bdidll.h"
 #include "bdicnf.h"
+#include "bdiimg.h"
+#include "bdicrc.h"
+#include "bdifuse.h"
+#include "bdicache.h"
+#include "bdiarc.h"
+#include "bdiman.h"
+#include "bdijrn.h"
+#include "bdiplan.h"
+#include "bdifleet.h"
+#include "bdiinit.h"
+#include "bdimem.h"
+#include "bdiload.h"
+#include "bdidump.h"
+#include "bdispy.h"
 
 /*************************************************************************
 |  DEFINES
@@ -119,22 +251,23 @@
 #endif
 
 #define BDI_DEFAULT_EXEC_TIME    500 /* default BDI command execution time */
+#define BDI_ERASE_TIMEOUT      10000 /* maximal time to erase a sector */
+#define BDI_ERASE_POLL_TIME       25 /* delay between erase state polls */
+
+#define BDI_ERASE_STATE_DONE       0 /* no erase running, last erase okay */
+#define BDI_ERASE_STATE_BUSY       1 /* erase running */
 #define BDI_MAX_LOGIC_VERSION    999 /* the maximal logic version */
 #define BDI_MAX_FW_VERSION       255 /* the maximal firmware version */
 
-#define ISP20_NBR_OF_ROWS        134
-#define ISP20_ROW_BITS           240
-#define ISP20_UES_BITS           120
-#define ISP20_UES_CHARS          15
+#define BDI_MAX_SECTOR_GROUPS    4   /* sector groups in a flash layout */
+#define BDI_MAX_PLAN_SECTORS     64  /* sectors erased by a firmware update */
+#define BDI_NETWORK_CONFIG_SIZE  104 /* network configuration data */
 
-#define ISP10_NBR_OF_ROWS        118
-#define ISP10_ROW_BITS           160
-#define ISP10_UES_BITS           80
-#define ISP10_UES_CHARS          10
 
-#define ISPHS_NBR_OF_ROWS        102
-#define ISPHS_ROW_BITS           80
-#define ISPHS_UES_BITS           40
+/* configuration parts that differ from the BDI flash */
+#define BDI_CHANGED_NETWORK     0x01
+#define BDI_CHANGED_CONFIG      0x02
+#define BDI_CHANGED_REGDEF      0x04
 
 /* Firmware update mode */
 #define BDI_UPDATE_AUTO         0   /* update firmware/logic only if needed */
@@ -142,6 +275,11 @@
 #define BDI_UPDATE_LOGIC        2   /* update logic in any case */
 #define BDI_UPDATE_ALL          3   /* update firmware and logic in any case */
 
+/* CPLD content compared with the JEDEC file */
+#define ISP_MATCH_NONE          0   /* rows differ, full update */
+#define ISP_MATCH_ROWS          1   /* rows equal, the UES differs in bits to clear */
+#define ISP_MATCH_ALL           2   /* rows and UES equal, no update */
+
 
 /*************************************************************************
 |  MACROS
@@ -166,6 +304,108 @@ typedef struct {
   char    sn[8+1];
 } BDI_VersionT;
 
+typedef int (*BDI_ProgramFlashT)(DWORD addr, WORD count, BYTE *block, DWORD *errorAddr);
+
+typedef int (*BDI_CheckFirmwareT)(DWORD firmwareAddr);
+
+typedef BOOL (*BDI_IdleT)(void* context);
+
+/* called for every block read back in address order, FALSE stops reading */
+typedef BOOL (*BDI_BlockFuncT)(DWORD addr, const BYTE* data, WORD count, void* context);
+
+typedef struct {
+  WORD          bdi;            /* the BDI type */
+  const char*   fileName;       /* the JEDEC file to load */
+  BOOL          done;           /* loaded or failed */
+} BDI_PrefetchT;
+
+/* one command of the pipelined CPLD sequence */
+typedef struct {
+  BYTE    command;        /* BDI_LDR_ISP_PROGRAM/READ_LINE or _UES */
+  int     row;            /* the row, 0 for the UES */
+  int     depends;        /* command answered before this one is sent, -1 if none */
+} ISP_OperationT;
+
+/* timing of the rows, the time between two answers */
+typedef struct {
+  int     count;
+  DWORD   total;          /* us */
+  DWORD   max;            /* us */
+  int     maxRow;
+} ISP_TimingT;
+
+typedef struct {
+  DWORD   addr;           /* address of first sector */
+  DWORD   size;           /* size of one sector */
+  int     count;          /* number of sectors, 0 terminates a list */
+} BDI_SectorsT;
+
+typedef struct {
+  DWORD               firmwareAddr;   /* firmware base, holds the start trigger */
+  DWORD               firmwareEnd;    /* address after the firmware region */
+  DWORD               bdmConfigAddr;  /* invalidated by a firmware update, 0 if none */
+  DWORD               networkAddr;    /* network configuration, 0 if none */
+  DWORD               configAddr;     /* configuration, 0 if none */
+  DWORD               regdefAddr;     /* register definitions, 0 if none */
+  BDI_ProgramFlashT   programFlash;   /* the BDI specific program function */
+  WORD                maxBlock;       /* maximal program block size */
+  WORD                align;          /* required program block size alignment */
+  BOOL                verifyFirmware; /* firmware flash can be read back */
+  BDI_CheckFirmwareT  checkFirmware;  /* check firmware before start, or NULL */
+  BDI_SectorsT        sector[BDI_MAX_SECTOR_GROUPS];    /* flash sector map */
+  BDI_SectorsT        eraseAll[BDI_MAX_SECTOR_GROUPS];  /* sectors erased by -e */
+} BDI_LayoutT;
+
+typedef struct {
+  DWORD   addr;
+  WORD    count;
+} BDI_BlockT;
+
+typedef struct {
+  int           eraseCount;                       /* sectors to erase */
+  DWORD         erase[BDI_MAX_PLAN_SECTORS];      /* sorted sector addresses */
+  int           blockCount;                       /* blocks to program */
+  int           blockAlloc;
+  BDI_BlockT*   block;
+} BDI_PlanT;
+
+typedef struct {
+  DWORD         badBytes;       /* number of bytes not matching */
+  int           ranges;         /* number of bad address ranges */
+  BOOL          inRange;        /* current range is open */
+  DWORD         rangeStart;     /* first address of current range */
+  DWORD         rangeEnd;       /* address after current range */
+  DWORD         addr;           /* start address of the verified data */
+  const BYTE*   data;           /* the expected data, NULL for a stream */
+  CNF_StreamT*  stream;         /* the expected image */
+  int           result;         /* error reading the stream */
+} BDI_VerifyT;
+
+/* compare of the BDI flash with data to program */
+typedef struct {
+  DWORD         addr;           /* start address of the compared data */
+  const BYTE*   data;           /* the data to program, NULL for a stream */
+  CNF_StreamT*  stream;         /* the image to program */
+  int           result;         /* error reading the stream */
+  BOOL          equal;
+} BDI_CompareT;
+
+/* text region of the BDI flash read up to its first 0xFF */
+typedef struct {
+  DWORD   addr;           /* start address of the region */
+  BYTE*   data;           /* the read blocks */
+  DWORD*  count;          /* number of bytes before the first 0xFF */
+} BDI_TextT;
+
+/* the configuration and register definitions to program */
+typedef struct {
+  CNF_ConfigT   config;         /* the compiled file, source of the images */
+  BYTE*         cacheEntry;     /* the mapped cache entry, source if not NULL */
+  DWORD         cacheSize;
+  CNF_StreamT   romConfig;
+  CNF_StreamT   romRegdef;
+} BDI_ConfigImagesT;
+
 
 /*************************************************************************
 |  LOCALS
@@ -452,8 +692,29 @@ static const BDI_SetupInfoT B30_SetupInfo[] =
 
 static BYTE     cmdBuffer[BDI_MAX_FRAME_SIZE];
 static BYTE     ansBuffer[BDI_MAX_FRAME_SIZE];
+static BYTE     blockBuffer[BDI_MAX_BLOCK_SIZE];  /* the block to program or compare */
+
+/* CPLD geometry, indexed by the BDI type */
+static const FUS_GeometryT ISP_Geometry[BDI_TYPE_LAST + 1] = {
+/* HS */ { ISP_2032_ID, ISPHS_NBR_OF_ROWS, ISPHS_ROW_BITS, ISPHS_UES_BITS, "B3201E", TRUE  },
+/* 20 */ { ISP_2096_ID, ISP20_NBR_OF_ROWS, ISP20_ROW_BITS, ISP20_UES_BITS, "B6001E", FALSE },
+/* 21 */ { ISP_2096_ID, ISP20_NBR_OF_ROWS, ISP20_ROW_BITS, ISP20_UES_BITS, "B6001E", FALSE },
+/* 10 */ { ISP_2064_ID, ISP10_NBR_OF_ROWS, ISP10_ROW_BITS, ISP10_UES_BITS, "B1001E", FALSE },
+/* 30 */ { 0,           0,                 0,              0,              "",       FALSE },
+};
 
-static char aszFuseMap[ISP20_NBR_OF_ROWS][ISP20_ROW_BITS + 1];
+static FUS_MapT fuseMap;
+static char szFuseMapFile[MAXPATHLEN] = "";   /* file loaded into fuseMap */
+
+static BOOL verifyFlash = TRUE;   /* read back and compare programmed flash */
+static BOOL stripConfig = FALSE;  /* program the configuration without comments */
+static int  asyncErase = -1;      /* loader erases in background, -1 unknown */
+
+static BOOL planMode = FALSE;     /* write the plan instead of updating */
+static char szPlanFile[MAXPATHLEN] = "";  /* the plan file, empty for stdout */
+static FILE* planStdout = NULL;   /* standard output kept for the plan */
+static int  planBdi = -1;         /* BDI type of the executed plan, -1 if none */
+static char szPlanSerial[8+1] = "";
 
 
 /****************************************************************************
@@ -572,264 +833,240 @@ static void BDI_Version2String(WORD version, char* szVersion)
 
 /****************************************************************************
  ****************************************************************************
+                Firmware programming functions
+ ****************************************************************************
+ ****************************************************************************/
 
-    BDI_Extension2Version :
+/****************************************************************************
+ ****************************************************************************
 
-    Converts a version extension into a number
+ Read a block from the BDI memory (via loader command)
+ BDI_ReadMemoryBlock leaves the data in the answer buffer, valid until
+ the next transaction.
 
-     INPUT:  version         version as extension (e.g. .102)
-     OUTPUT: return          version as number
+  INPUT:  addr            address of the memory block
+          count           number of bytes to read (up to 1024)
+  OUTPUT: block           the read data block
+          return          error code
 
  ****************************************************************************/
 
-static WORD BDI_Extension2Version(char* szExt)
+static int BDI_ReadMemoryBlock(DWORD addr, WORD count, const BYTE** block)
 {
-  WORD  version;
-  int   i;
+  BYTE *cmdPtr;
+  int   rxCount;
+  BYTE  answer;
 
-  if (strlen(szExt) != 4) return 0;
-  version = 0;
-  for (i=1; i<4; i++) {
-    if ((szExt[i] < '0') || (szExt[i] > '9')) return 0;
-    version *= 10;
-    version += (WORD)(szExt[i] - '0');
-  } /* for */
-  return version;
-} /* BDI_Extension2Version */
+  /* prepare command */
+  cmdPtr = BDI_AppendByte(BDI_LDR_READ_MEMORY, cmdBuffer);
+  cmdPtr = BDI_AppendLong(addr,  cmdPtr);
+  cmdPtr = BDI_AppendWord(count, cmdPtr);
 
+  /* BDI transaction */
+  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 1000);
+  if (rxCount < 0) return rxCount;
 
-/****************************************************************************
- ****************************************************************************
+  /* analyse response */
+  (void)BDI_ExtractByte(&answer, ansBuffer);
+  if ((rxCount != (int)(count+7)) || (answer != BDI_LDR_READ_MEMORY))
+    return BDI_ERR_INVALID_RESPONSE;
 
-    BDI_GetNewest :
+  *block = ansBuffer + 7; /* skip answer, address and count */
+  return BDI_OKAY;
+} /* BDI_ReadMemoryBlock */
 
-    Searches for the newest file.
-    The extension is the version (e.g. *.120 = V1.20 )
 
-     INPUT:  szPath     the path to the firmware files
-             szName     the name of the file (e.g. b20copgd)
-     OUTPUT: szNewName  the full name incl. path of the found file
-             RETURN     the newest version or 0 if not found
+static int BDI_ReadMemory(DWORD addr, WORD count, BYTE *block)
+{
+  int         result;
+  const BYTE* readData;
 
- ****************************************************************************/
+  result = BDI_ReadMemoryBlock(addr, count, &readData);
+  if (result == BDI_OKAY) (void)memcpy(block, readData, count);
+  return result;
+} /* BDI_ReadMemory */
 
-#if defined(WIN32)
 
-static WORD BDI_GetNewest(const char* szPath, const char* szName, char* szNewName)
-{
-  char                  szFullName[_MAX_PATH];
-  char                  szDrive[_MAX_DRIVE];
-  char                  szDir[_MAX_DIR];
-  char                  szDummy[_MAX_FNAME];
-  char                  szExt[_MAX_EXT];
-  struct _finddata_t    fileInfo;
-  intptr_t              hFile;
-  WORD                  version;
-  WORD                  nextVersion;
-
-  /* build full file name */
-  strcpy(szFullName, szPath);
-  strcat(szFullName, "/dummy.xxx");
-  _splitpath_s(szFullName,
-               szDrive, sizeof szDrive,
-               szDir,   sizeof szDir,
-               szDummy, sizeof szDummy,
-               szExt,   sizeof szExt);
-  _makepath_s(szFullName, sizeof szFullName, szDrive, szDir, szName, "???");
-
-  /* find first file */
-  version = 0;
-  hFile   = _findfirst(szFullName, &fileInfo );
-  if (hFile == -1L) return 0;
-  do {
-    _splitpath_s(fileInfo.name,
-                 szDrive, sizeof szDrive,
-                 szDir,   sizeof szDir,
-                 szDummy, sizeof szDummy,
-                 szExt,   sizeof szExt);
-    nextVersion = BDI_Extension2Version(szExt);
-    if (nextVersion > version) {
-      version = nextVersion;
-      strcpy(szFullName, szPath);
-      strcat(szFullName, "/");
-      strcat(szFullName, fileInfo.name);
-    } /* if */
-  } while (_findnext(hFile, &fileInfo ) == 0);
-  _findclose(hFile);
-  strcpy(szNewName, szFullName);
-  printf("Full file name: %s\n", szNewName);
-  return version;
-} /* BDI_GetNewest */
+/****************************************************************************
+ ****************************************************************************
 
-#else /* defined(WIN32) */
+ Read a range of the BDI memory in maximal blocks (via loader command)
+ Up to BDI_PipeDepth() blocks are requested ahead. Every block is passed
+ to blockFunc in address order, once it returns FALSE or after an error
+ no more blocks are requested and the pipe is only emptied.
 
-static WORD BDI_GetNewest(const char* szPath, const char* szName, char* szNewName)
-{
-  WORD           version;
-  WORD           tmp;
-  DIR           *dp;
-  struct dirent *d;
-  size_t         nameLen;
+  INPUT:  addr            start address
+          size            number of bytes to read
+          blockFunc       called for every block, the data is valid until
+                          the next transaction
+          context         passed to blockFunc
+  OUTPUT: return          error code
 
-  /* open the firmware directory */
-  dp = opendir(szPath);
-  if (dp == NULL) return 0;
+ ****************************************************************************/
 
-  /* search for newest */
-  version = 0;
-  nameLen = strlen(szName);
-  while ((d = readdir(dp))) {
-    if (    (strncasecmp(d->d_name, szName, nameLen) == 0)
-         && (strlen(d->d_name) == (nameLen + 4))
-        ) {
-      tmp = BDI_Extension2Version(&d->d_name[nameLen]);
-      if (tmp > version) {
-        version = tmp;
-        strcpy(szNewName, szPath);
-        strcat(szNewName, "/");
-        strcat(szNewName, d->d_name);
-      } /* if */
-    } /* if */
-  } /* while */
+static int BDI_ReadMemoryPipe(DWORD addr, DWORD size, BDI_BlockFuncT blockFunc, void* context)
+{
+  BYTE  cmd[7];
+  WORD  readCount;
+  DWORD sent;
+  DWORD done;
+  BOOL  more;
+  int   pending;
+  int   result;
+  int   rxCount;
 
-  closedir(dp);
-  return version;
-} /* BDI_GetNewest */
+  result  = BDI_OKAY;
+  more    = TRUE;
+  sent    = 0;
+  done    = 0;
+  pending = 0;
+  for (;;) {
+
+    /* request blocks while the pipe is not full */
+    while ((result == BDI_OKAY) && more && (sent < size) && (pending < BDI_PipeDepth())) {
+      readCount = BDI_MAX_BLOCK_SIZE;
+      if (size - sent < readCount) readCount = (WORD)(size - sent);
+      (void)BDI_AppendWord(readCount, BDI_AppendLong(addr + sent, BDI_AppendByte(BDI_LDR_READ_MEMORY, cmd)));
+      result = BDI_PipeSend(sizeof cmd, cmd, 1000);
+      if (result == BDI_OKAY) {
+        sent += readCount;
+        pending++;
+      } /* if */
+    } /* while */
+    if (pending == 0) break;
 
-#endif /* defined(WIN32) */
+    /* receive the oldest block */
+    rxCount = BDI_PipeReceive(sizeof ansBuffer, ansBuffer);
+    pending--;
+    readCount = BDI_MAX_BLOCK_SIZE;
+    if (size - done < readCount) readCount = (WORD)(size - done);
+    if (result == BDI_OKAY) {
+      if (rxCount < 0) result = rxCount;
+      else if ((rxCount != (int)(readCount + 7)) || (ansBuffer[0] != BDI_LDR_READ_MEMORY)) {
+        result = BDI_ERR_INVALID_RESPONSE;
+      } /* else if */
+    } /* if */
+    if ((result == BDI_OKAY) && more) more = blockFunc(addr + done, ansBuffer + 7, readCount, context);
+    done += readCount;
+  } /* for */
+  return result;
+} /* BDI_ReadMemoryPipe */
 
-/****************************************************************************
- ****************************************************************************
-                Firmware programming functions
- ****************************************************************************
- ****************************************************************************/
 
 /****************************************************************************
  ****************************************************************************
 
-    DecodeSRecord:
-
-    Decode an Data S-Record (S1,S2,S3).
+ Erase a flash sector in BDI-HS memory (via loader command)
+ The transaction blocks until the sector is erased.
 
-    INPUT  : sRecord      the S-Record to decode
-    OUTPUT : addrPtr      the address for the decoded data
-             dataPtr      the data part of the record (binary)
-             RETURN       number of databytes, 0 if no data record, -1 if error
+  INPUT:  addr            an address within the sector
+  OUTPUT: return          error code
 
  ****************************************************************************/
 
-static BYTE Hex2Bin(char highDigit, char lowDigit)
+static int BDI_EraseSectorBlocking(DWORD addr)
 {
-  static BYTE HexTable[] = {0,1,2,3,4,5,6,7,8,9,
-                            0,0,0,0,0,0,0,         /* :;<=>?@ */
-                            10,11,12,13,14,15};
-  return  (BYTE)(   (HexTable[highDigit - '0']<<4)
-                  + (HexTable[lowDigit  - '0']   ) );
-} /* Hex2Bin */
+  BYTE     *cmdPtr;
+  BYTE     *ansPtr;
+  int       rxCount;
+  BYTE      answer;
+  BYTE      error;
 
+  /* prepare command */
+  cmdPtr = BDI_AppendByte(BDI_LDR_ERASE_FLASH, cmdBuffer);
+  cmdPtr = BDI_AppendLong(addr,  cmdPtr);
 
-static int DecodeSRecord(char* sRecord, DWORD* addrPtr, BYTE* dataPtr)
-{
-  int       count;
-  int       recLen;
-  int       addrLen;
-  int       i;
-  char      recType;
-  BYTE      checksum;
-  BYTE      nextValue;
-  DWORD     address;
+  /* BDI transaction */
+  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 10000);
+  if (rxCount < 0) return rxCount;
 
-  if (*sRecord++ != 'S') return -1;
-  recType   = *sRecord++;
-  nextValue = Hex2Bin(*sRecord, *(sRecord+1));
-  sRecord  += 2;
-  checksum  = nextValue;
-  recLen    = nextValue;
+  /* analyse response */
+  ansPtr = BDI_ExtractByte(&answer, ansBuffer);
+  if ((rxCount != 2) || (answer != BDI_LDR_ERASE_FLASH))
+    return BDI_ERR_INVALID_RESPONSE;
 
-  /* extract address */
-  if      (recType == '1') addrLen = 2;
-  else if (recType == '2') addrLen = 3;
-  else if (recType == '3') addrLen = 4;
-  else                     return 0;
-  address = 0;
-  for (i=0; i<addrLen; i++) {
-    nextValue = Hex2Bin(*sRecord, *(sRecord+1));
-    sRecord  += 2;
-    checksum  = (BYTE)(checksum + nextValue);
-    address   = (address << 8) + nextValue;
-  } /* for */
-  *addrPtr = address;
-
-  /* get data */
-  count = recLen - addrLen - 1;
-  for (i=0; i<count; i++) {
-    nextValue = Hex2Bin(*sRecord, *(sRecord+1));
-    sRecord  += 2;
-    checksum  = (BYTE)(checksum + nextValue);
-    *dataPtr++ = nextValue;
-  } /* for */
+  ansPtr = BDI_ExtractByte(&error,    ansPtr);
+  if (error != 0) return BDI_ERR_FLASH_ERASE;
 
-  /* check sum */
-  nextValue = Hex2Bin(*sRecord, *(sRecord+1));
-  checksum = (BYTE)(checksum + nextValue);
-  if (checksum != 0xFF) return -1;
-  else                  return count;
-} /* DecodeSRecord */
+  return BDI_OKAY;
+} /* BDI_EraseSectorBlocking */
 
 
 /****************************************************************************
  ****************************************************************************
 
- Read a block from the BDI memory (via loader command)
+ Read the state of a started erase (via erase state command)
 
-  INPUT:  addr            address of the memory block
-          count           number of bytes to read (up to 1024)
-  OUTPUT: block           the read data block
-          return          error code
+  INPUT:  probe           TRUE to check if the command is supported, a
+                          missing answer does not stop the connection
+  OUTPUT: state           the erase state BDI_ERASE_STATE_xxx
+          return          error code, BDI_ERR_INVALID_RESPONSE or
+                          BDI_ERR_NO_RESPONSE if the command is not
+                          supported
 
  ****************************************************************************/
 
-static int BDI_ReadMemory(DWORD addr, WORD count, BYTE *block)
+static int BDI_GetEraseState(BOOL probe, BYTE* state)
 {
-  BYTE *cmdPtr;
-  BYTE *ansPtr;
-  int   rxCount;
-  BYTE  answer;
-  int   i;
-
-  /* prepare command */
-  cmdPtr = BDI_AppendByte(BDI_LDR_READ_MEMORY, cmdBuffer);
-  cmdPtr = BDI_AppendLong(addr,  cmdPtr);
-  cmdPtr = BDI_AppendWord(count, cmdPtr);
+  BYTE     *cmdPtr;
+  BYTE     *ansPtr;
+  int       rxCount;
+  BYTE      answer;
 
-  /* BDI transaction */
-  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 1000);
+  cmdPtr  = BDI_AppendByte(BDI_PRO_GET_ERASE_STATE, cmdBuffer);
+  if (probe) {
+    rxCount = BDI_Probe(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer,
+                        BDI_DEFAULT_EXEC_TIME);
+  } /* if */
+  else {
+    rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer,
+                              BDI_DEFAULT_EXEC_TIME);
+  } /* else */
   if (rxCount < 0) return rxCount;
 
-  /* analyse response */
   ansPtr = BDI_ExtractByte(&answer, ansBuffer);
-  if ((rxCount != (int)(count+7)) || (answer != BDI_LDR_READ_MEMORY))
+  if ((rxCount != 2) || (answer != BDI_PRO_GET_ERASE_STATE))
     return BDI_ERR_INVALID_RESPONSE;
+  (void)BDI_ExtractByte(state, ansPtr);
+  return BDI_OKAY;
+} /* BDI_GetEraseState */
 
-  /* copy response data */
-  ansPtr += 6; /* skip address and count */
-  for (i=0; i<count; i++) *block++ = *ansPtr++;
 
-  return BDI_OKAY;
-} /* BDI_ReadMemory */
+/****************************************************************************
+ ****************************************************************************
+
+ Check once per connection if the loader erases in the background.
+ Loaders without the start/state commands either answer them as not
+ implemented or ignore them, then the blocking erase command is used.
+
+  INPUT:  -
+  OUTPUT: return          TRUE if the start/state commands are supported
+
+ ****************************************************************************/
+
+static BOOL BDI_AsyncErase(void)
+{
+  BYTE      state;
+
+  if (asyncErase < 0) {
+    asyncErase = (   (BDI_GetEraseState(TRUE, &state) == BDI_OKAY)
+                  && (state == BDI_ERASE_STATE_DONE)) ? 1 : 0;
+  } /* if */
+  return asyncErase > 0;
+} /* BDI_AsyncErase */
 
 
 /****************************************************************************
  ****************************************************************************
 
- Erase a flash sector in BDI-HS memory (via loader command)
+ Start erasing a flash sector (via start erase command)
 
   INPUT:  addr            an address within the sector
   OUTPUT: return          error code
 
  ****************************************************************************/
 
-static int BDI_EraseSector(DWORD addr)
+static int BDI_StartErase(DWORD addr)
 {
   BYTE     *cmdPtr;
   BYTE     *ansPtr;
@@ -837,23 +1074,81 @@ static int BDI_EraseSector(DWORD addr)
   BYTE      answer;
   BYTE      error;
 
-  /* prepare command */
-  cmdPtr = BDI_AppendByte(BDI_LDR_ERASE_FLASH, cmdBuffer);
-  cmdPtr = BDI_AppendLong(addr,  cmdPtr);
-
-  /* BDI transaction */
-  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 10000);
+  cmdPtr  = BDI_AppendByte(BDI_PRO_START_ERASE, cmdBuffer);
+  cmdPtr  = BDI_AppendLong(addr, cmdPtr);
+  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer,
+                            BDI_DEFAULT_EXEC_TIME);
   if (rxCount < 0) return rxCount;
 
-  /* analyse response */
   ansPtr = BDI_ExtractByte(&answer, ansBuffer);
-  if ((rxCount != 2) || (answer != BDI_LDR_ERASE_FLASH))
+  if ((rxCount != 2) || (answer != BDI_PRO_START_ERASE))
     return BDI_ERR_INVALID_RESPONSE;
-
-  ansPtr = BDI_ExtractByte(&error,    ansPtr);
+  (void)BDI_ExtractByte(&error, ansPtr);
   if (error != 0) return BDI_ERR_FLASH_ERASE;
-
   return BDI_OKAY;
+} /* BDI_StartErase */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ Wait until a started erase is done
+ The state is polled with short transactions. Between the polls the
+ idle function may do host work, the BDI erases in the meantime.
+
+  INPUT:  idle            host work while waiting or NULL, returns FALSE
+                          when there is no more work to do
+          context         parameter of the idle function
+  OUTPUT: return          error code
+
+ ****************************************************************************/
+
+static int BDI_WaitErase(BDI_IdleT idle, void* context)
+{
+  int       result;
+  int       polls;
+  BYTE      state;
+
+  for (polls = 0; polls < (BDI_ERASE_TIMEOUT / BDI_ERASE_POLL_TIME); polls++) {
+    if ((idle == NULL) || !idle(context)) {
+      idle = NULL;
+      BDI_DoDelay(BDI_ERASE_POLL_TIME);
+    } /* if */
+    result = BDI_GetEraseState(FALSE, &state);
+    if (result != BDI_OKAY) return result;
+    if (state == BDI_ERASE_STATE_DONE) return BDI_OKAY;
+    if (state != BDI_ERASE_STATE_BUSY) return BDI_ERR_FLASH_ERASE;
+  } /* for */
+  return BDI_ERR_FLASH_ERASE;
+} /* BDI_WaitErase */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ Erase a flash sector, in the background if the loader supports it
+
+  INPUT:  addr            an address within the sector
+          idle            host work while the sector is erased or NULL
+          context         parameter of the idle function
+  OUTPUT: return          error code
+
+ ****************************************************************************/
+
+static int BDI_EraseSectorIdle(DWORD addr, BDI_IdleT idle, void* context)
+{
+  int       result;
+
+  if (!BDI_AsyncErase()) return BDI_EraseSectorBlocking(addr);
+  result = BDI_StartErase(addr);
+  if (result == BDI_OKAY) result = BDI_WaitErase(idle, context);
+  return result;
+} /* BDI_EraseSectorIdle */
+
+
+static int BDI_EraseSector(DWORD addr)
+{
+  return BDI_EraseSectorIdle(addr, NULL, NULL);
 } /* BDI_EraseSector */
 
 
@@ -957,1307 +1252,2387 @@ static int B30_ProgramFlash(DWORD  addr,
 
 /****************************************************************************
  ****************************************************************************
- Update firmware
- The Loader must be activ and waiting for a command
 
-  INPUT:  fileName    the S-Record file name
-  OUTPUT: return      error code
+ Verify a memory range in the BDI flash memory (via loader command)
+ The flash is read back in maximal blocks with several reads in flight
+ and compared with the expected data. Differing bytes are collected into
+ address ranges and reported.
+
+  INPUT:  addr            start address
+          count           number of bytes to verify
+          data            the expected data
+  INOUT:  state           the verify state (bad ranges found so far)
+  OUTPUT: return          error code of the read operations
 
  ****************************************************************************/
 
-#define BHS_CONFIG_ADDR            0x084000L
+#define BDI_MAX_VERIFY_RANGES   16  /* number of reported error ranges */
 
-static int BHS_UpdateFirmware(const char* fileName)
+static void BDI_VerifyReport(BDI_VerifyT* state)
 {
-  int           result = BDI_OKAY;
-  FILE*         srecFile;
-  char          szLine[256];
-  int           dataCount;
-  DWORD         dataAddress;
-  BYTE          dataValues[256];
-  DWORD         errorAddr;
+  if (state->inRange) {
+    state->ranges++;
+    if (state->ranges <= BDI_MAX_VERIFY_RANGES) {
+      printf("\nVerify error at 0x%08lx - 0x%08lx",
+             state->rangeStart, state->rangeEnd - 1);
+    } /* if */
+    else if (state->ranges == (BDI_MAX_VERIFY_RANGES + 1)) {
+      printf("\nmore verify errors ...");
+    } /* else if */
+    state->inRange = FALSE;
+  } /* if */
+} /* BDI_VerifyReport */
 
-  /* Open the firmware file (read only) */
-  srecFile = fopen(fileName,"r");
-  if (srecFile == NULL) return BDI_ERR_FIRMWARE_FILE;
 
-  /* erase flash */
-  if (result == BDI_OKAY) result = BDI_EraseSector(BHS_CONFIG_ADDR);
-  if (result == BDI_OKAY) result = BDI_EraseSector(0x0A0000);
-  if (result == BDI_OKAY) result = BDI_EraseSector(0x0C0000);
-  if (result == BDI_OKAY) result = BDI_EraseSector(0x0E0000);
-  if (result != BDI_OKAY) {
-    fclose(srecFile);
-    return result;
-  } /* if */
+static BOOL BDI_VerifyBlock(DWORD addr, const BYTE* readData, WORD readCount, void* context)
+{
+  BDI_VerifyT*  state = (BDI_VerifyT*)context;
+  const BYTE*   data;
+  int           count;
+  WORD          i;
 
-  /* / program firmware */
-  while (result == BDI_OKAY) {
-    if (fgets(szLine, sizeof szLine, srecFile) != NULL) {
-      dataCount = DecodeSRecord(szLine, &dataAddress, dataValues);
-      if (dataCount > 0) {
-        result = BHS_ProgramFlash(dataAddress, (WORD)dataCount, dataValues, &errorAddr);
-      } /* if */
-      else if (dataCount < 0) {
-        result = BDI_ERR_FIRMWARE_FILE;
-      } /* else */
+  if (state->stream == NULL) data = state->data + (addr - state->addr);
+  else {
+    count = CNF_ReadBlock(state->stream, blockBuffer);
+    if (count < 0) {
+      state->result = count;
+      return FALSE;
     } /* if */
-    else break;
-  } /* while */
+    data = blockBuffer;
+  } /* else */
 
-  /* program firmware trigger */
-  if (result == BDI_OKAY) {
-    dataValues[0] = 0xAA;
-    dataValues[1] = 0x55;
-    dataValues[2] = 0x55;
-    dataValues[3] = 0xAA;
-    result = BHS_ProgramFlash(0x0A0000, 4, dataValues, &errorAddr);
+  /* compare, collect bad ranges only if there is a difference */
+  if (memcmp(readData, data, readCount) != 0) {
+    for (i = 0; i < readCount; i++) {
+      if (readData[i] != data[i]) {
+        if (!state->inRange || (state->rangeEnd != (addr + i))) {
+          BDI_VerifyReport(state);
+          state->inRange    = TRUE;
+          state->rangeStart = addr + i;
+        } /* if */
+        state->rangeEnd = addr + i + 1;
+        state->badBytes++;
+      } /* if */
+    } /* for */
   } /* if */
+  putchar('.');
+  fflush(stdout);
+  return TRUE;
+} /* BDI_VerifyBlock */
 
-  fclose(srecFile);
-  return result;
-} /* BHS_UpdateFirmware */
 
+static int BDI_VerifyFlash(DWORD addr, DWORD count, const BYTE* data, BDI_VerifyT* state)
+{
+  state->addr = addr;
+  state->data = data;
+  return BDI_ReadMemoryPipe(addr, count, BDI_VerifyBlock, state);
+} /* BDI_VerifyFlash */
 
-#define B20_FIRMWARE_ADDR         0x01040000L /* base address of firmware */
 
-static int B20_UpdateFirmware(const char* fileName)
+static int BDI_VerifyDone(BDI_VerifyT* state, int result)
 {
-  int           result = BDI_OKAY;
-  FILE*         srecFile;
-  char          szLine[256];
-  int           dataCount;
-  DWORD         dataAddress;
-  BYTE          dataValues[256];
-  DWORD         errorAddr;
-
-  int           sendCount;
-  DWORD         nextAddr;
-  DWORD         baseAddr;
-  BYTE          sendData[BDI_MAX_BLOCK_SIZE];
+  BDI_VerifyReport(state);
+  if ((result == BDI_OKAY) && (state->badBytes != 0)) {
+    printf("\n%lu bytes in %i ranges differ\n", state->badBytes, state->ranges);
+    result = BDI_ERR_FLASH_VERIFY;
+  } /* if */
+  return result;
+} /* BDI_VerifyDone */
 
-  /* Open the firmware file (read only) */
-  srecFile = fopen(fileName, "r");
-  if (srecFile == NULL) return BDI_ERR_FIRMWARE_FILE;
 
-  /* erase flash */
-  nextAddr = 0;
-  baseAddr = 0;
-  printf("Erasing firmware flash ....\n");
-  if (result == BDI_OKAY) result = BDI_EraseSector(B20_FIRMWARE_ADDR);
-  if (result == BDI_OKAY) result = BDI_EraseSector(B20_FIRMWARE_ADDR + 0x40000);
-  if (result == BDI_OKAY) result = BDI_EraseSector(B20_FIRMWARE_ADDR + 0x80000);
-  if (result != BDI_OKAY) {
-    fclose(srecFile);
-    printf("Erasing firmware flash failed\n");
-    return result;
-  } /* if */
-  printf("Erasing firmware flash passed\n");
-
-  /* program firmware */
-  printf("Programming firmware flash ....\n");
-  sendCount = 0;
-  while (result == BDI_OKAY) {
-    if (fgets(szLine, sizeof szLine, srecFile) != NULL) {
-      dataCount = DecodeSRecord(szLine, &dataAddress, dataValues);
-      if (dataCount > 0) {
-        if (sendCount == 0) {
-          nextAddr = dataAddress;
-          baseAddr = dataAddress;
-        } /* if */
-        else if ((nextAddr != dataAddress) || ((sendCount + dataCount) > BDI_MAX_BLOCK_SIZE)) {
-          /* make multiple of 4 */
-          while ((sendCount & 3) != 0) {
-            sendData[sendCount] = 0xFF;
-            sendCount++;
-          } /* while */
-          result = B20_ProgramFlash(baseAddr, (WORD)sendCount, sendData, &errorAddr);
-          nextAddr  = dataAddress;
-          baseAddr  = dataAddress;
-          sendCount = 0;
-          putchar('.');
-          fflush(stdout);
-        } /* else if */
-        /* copy new data to send buffer */
-        (void)memcpy(&sendData[sendCount], dataValues, dataCount);
-        sendCount += dataCount;
-        nextAddr  += dataCount;
-      } /* if */
-      else if (dataCount < 0) {
-        result = BDI_ERR_FIRMWARE_FILE;
-      } /* else if */
-    } /* if */
+static int BDI_VerifyImage(const IMG_ImageT* image)
+{
+  int           result;
+  int           seg;
+  BDI_VerifyT   state;
 
-    /* send last block */
-    else {
-      if (sendCount > 0) {
-        /* make multiple of 4 */
-        while ((sendCount & 3) != 0) {
-          sendData[sendCount] = 0xFF;
-          sendCount++;
-        } /* while */
-        result = B20_ProgramFlash(baseAddr, (WORD)sendCount, sendData, &errorAddr);
-      } /* if */
-      break;
-    } /* else */
-  } /* while */
+  (void)memset(&state, 0, sizeof state);
+  result = BDI_OKAY;
+  for (seg = 0; (seg < image->count) && (result == BDI_OKAY); seg++) {
+    result = BDI_VerifyFlash(image->segment[seg].addr,
+                             image->segment[seg].size,
+                             image->segment[seg].data,
+                             &state);
+  } /* for */
+  return BDI_VerifyDone(&state, result);
+} /* BDI_VerifyImage */
 
-  /* program firmware trigger */
-  if (result == BDI_OKAY) {
-    dataValues[0] = 0xAA;
-    dataValues[1] = 0x55;
-    dataValues[2] = 0x55;
-    dataValues[3] = 0xAA;
-    result = B20_ProgramFlash(B20_FIRMWARE_ADDR, 4, dataValues, &errorAddr);
-  } /* if */
 
-  if (result == BDI_OKAY) {
-    printf("\nProgramming firmware flash passed\n");
-  } /* if */
-  else {
-    printf("\nProgramming firmware flash failed\n");
-  } /* else */
+/****************************************************************************
+ ****************************************************************************
 
-  fclose(srecFile);
-  return result;
-} /* B20_UpdateFirmware */
+ Compare the BDI flash with data to program, several blocks are read
+ ahead and reading stops at the first block that differs
 
+  INPUT:  addr            start address
+          count           number of bytes to compare
+          data            the data to program
+  OUTPUT: equal           TRUE if the flash already holds the data
+          return          error code of the read operations
 
-#define B10_FIRMWARE_ADDR         0x0A0000L /* base address of firmware */
-#define B10_CONFIG_ADDR           0x086000L /* base address of BDM configuration */
+ ****************************************************************************/
 
-static int B10_UpdateFirmware(const char* fileName)
+static BOOL BDI_CompareBlock(DWORD addr, const BYTE* readData, WORD readCount, void* context)
 {
-  int           result = BDI_OKAY;
-  FILE*         srecFile;
-  char          szLine[256];
-  int           dataCount;
-  DWORD         dataAddress;
-  BYTE          dataValues[256];
-  DWORD         errorAddr;
-
-  int           sendCount;
-  DWORD         nextAddr;
-  DWORD         baseAddr;
-  BYTE          sendData[BDI_MAX_BLOCK_SIZE];
+  BDI_CompareT* compare = (BDI_CompareT*)context;
+  int           count;
 
-  /* Open the firmware file (read only) */
-  srecFile = fopen(fileName,"r");
-  if (srecFile == NULL) return BDI_ERR_FIRMWARE_FILE;
-
-  /* erase flash */
-  nextAddr = 0;
-  baseAddr = 0;
-  printf("Erasing firmware flash ....\n");
-  if (result == BDI_OKAY) result = BDI_EraseSector(B10_CONFIG_ADDR);
-  if (result == BDI_OKAY) result = BDI_EraseSector(B10_FIRMWARE_ADDR);
-  if (result == BDI_OKAY) result = BDI_EraseSector(B10_FIRMWARE_ADDR + 0x20000);
-  if (result == BDI_OKAY) result = BDI_EraseSector(B10_FIRMWARE_ADDR + 0x40000);
-  if (result != BDI_OKAY) {
-    fclose(srecFile);
-    printf("Erasing firmware flash failed\n");
-    return result;
+  if (compare->data != NULL) {
+    compare->equal = (memcmp(readData, compare->data + (addr - compare->addr), readCount) == 0);
   } /* if */
-  printf("Erasing firmware flash passed\n");
+  else {
+    count = CNF_ReadBlock(compare->stream, blockBuffer);
+    if (count < 0) compare->result = count;
+    compare->equal = (count >= 0) && (memcmp(readData, blockBuffer, readCount) == 0);
+  } /* else */
+  return compare->equal;
+} /* BDI_CompareBlock */
 
-  printf("Programming firmware flash ....\n");
-  sendCount = 0;
-  while (result == BDI_OKAY) {
-    if (fgets(szLine, sizeof szLine, srecFile) != NULL) {
-      dataCount = DecodeSRecord(szLine, &dataAddress, dataValues);
-      if (dataCount > 0) {
-        if (sendCount == 0) {
-          nextAddr = dataAddress;
-          baseAddr = dataAddress;
-        } /* if */
-        else if ((nextAddr != dataAddress) || ((sendCount + dataCount) > BDI_MAX_BLOCK_SIZE)) {
-          /* make multiple of 4 */
-          while ((sendCount & 3) != 0) {
-            sendData[sendCount] = 0xFF;
-            sendCount++;
-          } /* while */
-          result = B10_ProgramFlash(baseAddr, (WORD)sendCount, sendData, &errorAddr);
-          nextAddr  = dataAddress;
-          baseAddr  = dataAddress;
-          sendCount = 0;
-          putchar('.');
-          fflush(stdout);
-        } /* else if */
-        /* copy new data to send buffer */
-        (void)memcpy(&sendData[sendCount], dataValues, dataCount);
-        sendCount += dataCount;
-        nextAddr  += dataCount;
-      } /* if */
-      else if (dataCount < 0) {
-        result = BDI_ERR_FIRMWARE_FILE;
-      } /* else if */
-    } /* if */
 
-    /* send last block */
-    else {
-      if (sendCount > 0) {
-        /* make multiple of 4 */
-        while ((sendCount & 3) != 0) {
-          sendData[sendCount] = 0xFF;
-          sendCount++;
-        } /* while */
-        result = B10_ProgramFlash(baseAddr, (WORD)sendCount, sendData, &errorAddr);
-      } /* if */
-      break;
-    } /* else */
-  } /* while */
+static int BDI_CompareFlash(DWORD addr, DWORD count, const BYTE* data, BOOL* equal)
+{
+  int           result;
+  BDI_CompareT  compare;
+
+  compare.addr   = addr;
+  compare.data   = data;
+  compare.stream = NULL;
+  compare.result = BDI_OKAY;
+  compare.equal  = TRUE;
+  result = BDI_ReadMemoryPipe(addr, count, BDI_CompareBlock, &compare);
+  *equal = compare.equal;
+  return result;
+} /* BDI_CompareFlash */
 
-  /* program firmware trigger */
-  if (result == BDI_OKAY) {
-    dataValues[0] = 0xAA;
-    dataValues[1] = 0x55;
-    dataValues[2] = 0x55;
-    dataValues[3] = 0xAA;
-    result = B10_ProgramFlash(B10_FIRMWARE_ADDR, 4, dataValues, &errorAddr);
-  } /* if */
 
-  if (result == BDI_OKAY) {
-    printf("\nProgramming firmware flash passed\n");
-  } /* if */
-  else {
-    printf("\nProgramming firmware flash failed\n");
-  } /* else */
+/****************************************************************************
+ ****************************************************************************
 
-  fclose(srecFile);
-  return result;
-} /* B10_UpdateFirmware */
+ Check the BDI3000 firmware header
+ The copy descriptor at the firmware base must describe a plausible copy
+ from flash to RAM, otherwise the loader would start garbage.
 
+  INPUT:  firmwareAddr  the firmware base address
+  OUTPUT: return        error code
 
-#define B30_FIRMWARE_ADDR         0x00100000L /* base address of firmware */
+ ****************************************************************************/
 
-static int B30_UpdateFirmware(const char* fileName)
+static int B30_CheckFirmware(DWORD firmwareAddr)
 {
   int           result;
-  int	        sector;
-  DWORD	        address;
-  FILE*         srecFile;
-  char          szLine[256];
-  int           dataCount;
-  DWORD         dataAddress;
-  BYTE          dataValues[256];
-  DWORD         errorAddr;
+  BYTE          dataValues[8 * 4];
   DWORD         copySrc;
   DWORD         copyDest;
   DWORD         copyCount;
   DWORD         copyType;
 
-  int           sendCount;
-  DWORD         nextAddr;
-  DWORD         baseAddr;
-  BYTE          sendData[BDI_MAX_BLOCK_SIZE];
-
-  /* Open the firmware file (read only) */
-  result = BDI_OKAY;
-  srecFile = fopen(fileName, "r");
-  if (srecFile == NULL) return BDI_ERR_FIRMWARE_FILE;
-
-  /* erase flash */
-  nextAddr = 0;
-  baseAddr = 0;
-  printf("Erasing firmware flash ....\n");
-  address = B30_FIRMWARE_ADDR;
-  for (sector = 0; sector < 16; sector++) {
-    if (result == BDI_OKAY) result = BDI_EraseSector(address);
-    address += 0x10000;
-  } /* for */
-  if (result != BDI_OKAY) {
-    fclose(srecFile);
-    printf("Erasing firmware flash failed\n");
-    return result;
+  result = BDI_ReadMemory(firmwareAddr, 8 * 4, dataValues);
+  if (result != BDI_OKAY) return result;
+  (void)BDI_ExtractLong(&copySrc,   (dataValues +  4));
+  (void)BDI_ExtractLong(&copyDest,  (dataValues +  8));
+  (void)BDI_ExtractLong(&copyCount, (dataValues + 12));
+  (void)BDI_ExtractLong(&copyType,  (dataValues + 24));
+  copyCount *= 4;
+  if (    (copySrc  < 0x00100000) || ((copySrc  + copyCount) > 0x00400000)
+       || (copyDest < 0x40000000) || ((copyDest + copyCount) > 0x41000000)
+       || ((copyType & 0xffff) != 1)
+     ) {
+    printf("\nInvalid Firmware File!\n");
+    return BDI_ERR_FIRMWARE_FILE;
   } /* if */
-  printf("Erasing firmware flash passed\n");
+  return BDI_OKAY;
+} /* B30_CheckFirmware */
 
-  /* program firmware */
-  printf("Programming firmware flash ....\n");
-  sendCount = 0;
-  while (result == BDI_OKAY) {
-    if (fgets(szLine, sizeof szLine, srecFile) != NULL) {
-      dataCount = DecodeSRecord(szLine, &dataAddress, dataValues);
-      if (dataCount > 0) {
-        if (sendCount == 0) {
-          nextAddr = dataAddress;
-          baseAddr = dataAddress;
-        } /* if */
-        else if ((nextAddr != dataAddress) || ((sendCount + dataCount) > BDI_MAX_BLOCK_SIZE)) {
-          /* make multiple of 4 */
-          while ((sendCount & 3) != 0) {
-            sendData[sendCount] = 0xFF;
-            sendCount++;
-          } /* while */
-          result = B30_ProgramFlash(baseAddr, (WORD)sendCount, sendData, &errorAddr);
-          nextAddr  = dataAddress;
-          baseAddr  = dataAddress;
-          sendCount = 0;
-          putchar('.');
-          fflush(stdout);
-        } /* else if */
-        /* copy new data to send buffer */
-        (void)memcpy(&sendData[sendCount], dataValues, dataCount);
-        sendCount += dataCount;
-        nextAddr  += dataCount;
-      } /* if */
-      else if (dataCount < 0) {
-        result = BDI_ERR_FIRMWARE_FILE;
-      } /* else if */
-    } /* if */
 
-    /* send last block */
-    else {
-      if (sendCount > 0) {
-        /* make multiple of 4 */
-        while ((sendCount & 3) != 0) {
-          sendData[sendCount] = 0xFF;
-          sendCount++;
-        } /* while */
-        result = B30_ProgramFlash(baseAddr, (WORD)sendCount, sendData, &errorAddr);
-      } /* if */
-      break;
-    } /* else */
-  } /* while */
+/****************************************************************************
+ ****************************************************************************
+ Flash layout of the different BDI types, indexed by BDI type.
+ The sector map only needs to cover the sectors used by this utility.
 
-  /* check if plausible firmware header */
-  if (result == BDI_OKAY) {
-    (void)BDI_ReadMemory(B30_FIRMWARE_ADDR, 8 * 4, dataValues);
-    (void)BDI_ExtractLong(&copySrc,   (dataValues +  4));
-    (void)BDI_ExtractLong(&copyDest,  (dataValues +  8));
-    (void)BDI_ExtractLong(&copyCount, (dataValues + 12));
-    (void)BDI_ExtractLong(&copyType,  (dataValues + 24));
-    copyCount *= 4;
-    if (    (copySrc  < 0x00100000) || ((copySrc  + copyCount) > 0x00400000)
-         || (copyDest < 0x40000000) || ((copyDest + copyCount) > 0x41000000)
-         || ((copyType & 0xffff) != 1)
-       ) {
-      printf("\nInvalid Firmware File!\n");
-      fclose(srecFile);
-      return BDI_ERR_FIRMWARE_FILE;
-    } /* if */
-  } /* if */
+ ****************************************************************************/
 
-  /* program firmware trigger */
-  if (result == BDI_OKAY) {
-    dataValues[0] = 0xAA;
-    dataValues[1] = 0x55;
-    dataValues[2] = 0x55;
-    dataValues[3] = 0xAA;
-    result = B30_ProgramFlash(B30_FIRMWARE_ADDR, 4, dataValues, &errorAddr);
-  } /* if */
+static const BDI_LayoutT BDI_Layout[BDI_TYPE_LAST + 1] =
+{
+  /* BDI_TYPE_HS, the program command counts words, a block is not larger
+     than the data of one S-record (255 - 2 address - 1 checksum bytes),
+     the most the loader was ever sent */
+  { 0x0A0000L, 0x100000L, 0x084000L,
+    0, 0, 0,
+    BHS_ProgramFlash, 252, 2, FALSE, NULL,
+    { { 0x084000L, 0x02000L, 2 }, { 0x088000L, 0x18000L, 1 }, { 0x0A0000L, 0x20000L, 3 } },
+    { { 0x0A0000L, 0x20000L, 1 } } },
+
+  /* BDI_TYPE_20, the configuration shares the last firmware sector */
+  { 0x01040000L, 0x01100000L, 0x010C0000L,
+    0x01008000L, 0x010C0000L, 0x010D0000L,
+    B20_ProgramFlash, BDI_MAX_BLOCK_SIZE, 4, TRUE, NULL,
+    { { 0x01008000L, 0x04000L, 2 }, { 0x01010000L, 0x30000L, 1 }, { 0x01040000L, 0x40000L, 3 } },
+    { { 0x01008000L, 0x04000L, 2 }, { 0x01010000L, 0x30000L, 1 }, { 0x01040000L, 0x40000L, 3 } } },
+
+  /* BDI_TYPE_21, same as BDI2000 */
+  { 0x01040000L, 0x01100000L, 0x010C0000L,
+    0x01008000L, 0x010C0000L, 0x010D0000L,
+    B20_ProgramFlash, BDI_MAX_BLOCK_SIZE, 4, TRUE, NULL,
+    { { 0x01008000L, 0x04000L, 2 }, { 0x01010000L, 0x30000L, 1 }, { 0x01040000L, 0x40000L, 3 } },
+    { { 0x01008000L, 0x04000L, 2 }, { 0x01010000L, 0x30000L, 1 }, { 0x01040000L, 0x40000L, 3 } } },
+
+  /* BDI_TYPE_10 */
+  { 0x0A0000L, 0x100000L, 0x086000L,
+    0x084000L, 0, 0,
+    B10_ProgramFlash, BDI_MAX_BLOCK_SIZE, 4, TRUE, NULL,
+    { { 0x084000L, 0x02000L, 2 }, { 0x088000L, 0x18000L, 1 }, { 0x0A0000L, 0x20000L, 3 } },
+    { { 0x084000L, 0x02000L, 2 }, { 0x088000L, 0x18000L, 1 }, { 0x0A0000L, 0x20000L, 3 } } },
+
+  /* BDI_TYPE_30, boot and loader sectors are not erased */
+  { 0x00100000L, 0x00200000L, 0,
+    0x00006000L, 0x00200000L, 0x00210000L,
+    B30_ProgramFlash, BDI_MAX_BLOCK_SIZE, 4, TRUE, B30_CheckFirmware,
+    { { 0x00000000L, 0x02000L, 8 }, { 0x00010000L, 0x10000L, 63 } },
+    { { 0x00002000L, 0x02000L, 7 }, { 0x00030000L, 0x10000L, 13 }, { 0x00100000L, 0x10000L, 48 } } },
+};
 
-  if (result == BDI_OKAY) {
-    printf("\nProgramming firmware flash passed\n");
-  } /* if */
-  else {
-    printf("\nProgramming firmware flash failed\n");
-  } /* else */
 
-  fclose(srecFile);
-  return result;
-} /* B30_UpdateFirmware */
+static const BDI_LayoutT* BDI_GetLayout(WORD bdi)
+{
+  if (bdi > BDI_TYPE_LAST) return NULL;
+  return &BDI_Layout[bdi];
+} /* BDI_GetLayout */
 
 
 /****************************************************************************
  ****************************************************************************
-                Logic programming functions
- ****************************************************************************
+
+ Find the flash sector containing an address
+
+  INPUT:  layout          the flash layout
+          addr            an address within the sector
+  OUTPUT: sectorAddr      the start address of the sector
+          sectorSize      the size of the sector
+          return          TRUE if the address is within a known sector
+
  ****************************************************************************/
 
-#define ISP_2096_ID     0x13
-#define ISP_2032_ID     0x15
-#define ISP_2064_ID     0x12
+static BOOL BDI_FindSector(const BDI_LayoutT* layout,
+                           DWORD              addr,
+                           DWORD*             sectorAddr,
+                           DWORD*             sectorSize)
+{
+  const BDI_SectorsT* group;
+  int   i;
+
+  for (i = 0; i < BDI_MAX_SECTOR_GROUPS; i++) {
+    group = &layout->sector[i];
+    if (group->count == 0) break;
+    if ((addr >= group->addr) && (addr < (group->addr + group->count * group->size))) {
+      *sectorAddr = group->addr + ((addr - group->addr) / group->size) * group->size;
+      *sectorSize = group->size;
+      return TRUE;
+    } /* if */
+  } /* for */
+  return FALSE;
+} /* BDI_FindSector */
+
 
 /****************************************************************************
  ****************************************************************************
 
- ispLSI: Enable / Disable ISP Mode
+ Erase a list of sector groups, one dot per sector
 
-  INPUT:  -
-  OUTPUT: -
-          return          error code
+  INPUT:  group           the sector groups, terminated by a zero count
+  OUTPUT: return          error code
 
  ****************************************************************************/
 
-static int ISP_Enable()
+static int BDI_EraseSectors(const BDI_SectorsT* group)
 {
-  BYTE     *cmdPtr;
-  int       rxCount;
+  int   result;
+  int   i;
+  int   sector;
 
-  /* prepare command */
-  cmdPtr = BDI_AppendByte(BDI_LDR_ISP_ENABLE, cmdBuffer);
-  cmdPtr = BDI_AppendByte(1, cmdPtr);
+  result = BDI_OKAY;
+  for (i = 0; (i < BDI_MAX_SECTOR_GROUPS) && (group[i].count > 0); i++) {
+    for (sector = 0; (sector < group[i].count) && (result == BDI_OKAY); sector++) {
+      result = BDI_EraseSector(group[i].addr + sector * group[i].size);
+      putchar('.');
+      fflush(stdout);
+    } /* for */
+  } /* for */
+  printf("\n");
+  return result;
+} /* BDI_EraseSectors */
 
-  /* BDI transaction */
-  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 100);
-  if (rxCount < 0) return rxCount;
 
-  return BDI_OKAY;
-} /* ISP_Enable */
+/****************************************************************************
+ ****************************************************************************
 
-static int ISP_Disable()
+ Plan a firmware update
+ The image is split into program blocks. Segments separated by a small gap
+ are joined into one block, the gap is filled with 0xFF which leaves the
+ erased flash unchanged. Every block but the last of a run uses the
+ maximal block size, so the number of program commands is minimal.
+ Only sectors touched by a block are erased, in addition to the sector
+ holding the firmware start trigger and the BDM configuration sector.
+
+  INPUT:  layout          the flash layout
+          image           the firmware image, will be sorted
+  OUTPUT: plan            the erase set and program schedule
+          return          error code
+
+ ****************************************************************************/
+
+#define BDI_PLAN_MAX_GAP        32  /* join segments up to this distance */
+#define BDI_PLAN_BLOCK_GROW     256 /* number of blocks to add at once   */
+
+static void BDI_PlanInit(BDI_PlanT* plan)
 {
-  BYTE     *cmdPtr;
-  int       rxCount;
+  plan->eraseCount = 0;
+  plan->blockCount = 0;
+  plan->blockAlloc = 0;
+  plan->block      = NULL;
+} /* BDI_PlanInit */
 
-  /* prepare command */
-  cmdPtr = BDI_AppendByte(BDI_LDR_ISP_ENABLE, cmdBuffer);
-  cmdPtr = BDI_AppendByte(0, cmdPtr);
 
-  /* BDI transaction */
-  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 100);
-  if (rxCount < 0) return rxCount;
+static void BDI_PlanFree(BDI_PlanT* plan)
+{
+  free(plan->block);
+  BDI_PlanInit(plan);
+} /* BDI_PlanFree */
 
-  return BDI_OKAY;
-} /* ISP_Disable */
 
+static int BDI_PlanErase(BDI_PlanT* plan, const BDI_LayoutT* layout, DWORD addr, DWORD count)
+{
+  DWORD sectorAddr;
+  DWORD sectorSize;
+  DWORD end;
+  int   i;
 
-/****************************************************************************
- ****************************************************************************
+  end = addr + count;
+  while (addr < end) {
+    if (!BDI_FindSector(layout, addr, &sectorAddr, &sectorSize)) return BDI_ERR_FIRMWARE_FILE;
+
+    /* insert sorted, ignore duplicates */
+    for (i = plan->eraseCount; (i > 0) && (plan->erase[i - 1] > sectorAddr); i--);
+    if ((i == 0) || (plan->erase[i - 1] != sectorAddr)) {
+      if (plan->eraseCount == BDI_MAX_PLAN_SECTORS) return BDI_ERR_FIRMWARE_FILE;
+      (void)memmove(&plan->erase[i + 1], &plan->erase[i],
+                    (plan->eraseCount - i) * sizeof(DWORD));
+      plan->erase[i] = sectorAddr;
+      plan->eraseCount++;
+    } /* if */
+    addr = sectorAddr + sectorSize;
+  } /* while */
+  return BDI_OKAY;
+} /* BDI_PlanErase */
 
- ispLSI: Get Device ID
 
-  INPUT:  -
-  OUTPUT: deviceId        the ID of the ispLSI Device
-          return          error code
+static int BDI_PlanBlock(BDI_PlanT* plan, const BDI_LayoutT* layout, DWORD addr, DWORD end)
+{
+  BDI_BlockT* newBlock;
+  DWORD       count;
+
+  /* pad to the required alignment and check the firmware region */
+  count = end - addr;
+  count = ((count + layout->align - 1) / layout->align) * layout->align;
+  if ((addr < layout->firmwareAddr) || ((addr + count) > layout->firmwareEnd)) {
+    printf("Firmware data at 0x%08lx outside of firmware flash\n", addr);
+    return BDI_ERR_FIRMWARE_FILE;
+  } /* if */
 
- ****************************************************************************/
+  if (plan->blockCount == plan->blockAlloc) {
+    newBlock = (BDI_BlockT*)realloc(plan->block,
+                 (plan->blockAlloc + BDI_PLAN_BLOCK_GROW) * sizeof(BDI_BlockT));
+    if (newBlock == NULL) return BDI_ERR_FIRMWARE_FILE;
+    plan->block       = newBlock;
+    plan->blockAlloc += BDI_PLAN_BLOCK_GROW;
+  } /* if */
+  plan->block[plan->blockCount].addr  = addr;
+  plan->block[plan->blockCount].count = (WORD)count;
+  plan->blockCount++;
+  return BDI_PlanErase(plan, layout, addr, count);
+} /* BDI_PlanBlock */
 
-static int  ISP_GetDeviceId(BYTE *deviceId)
+
+static int BDI_PlanFirmware(const BDI_LayoutT* layout, IMG_ImageT* image, BDI_PlanT* plan)
 {
-  BYTE     *cmdPtr;
-  BYTE     *ansPtr;
-  int       rxCount;
+  int                 result;
+  int                 seg;
+  BOOL                open;
+  DWORD               blockAddr;
+  DWORD               blockEnd;
+  DWORD               segEnd;
+  const IMG_SegmentT* segment;
+
+  BDI_PlanInit(plan);
+  result = IMG_Sort(image);
+  if (result != BDI_OKAY) return result;
 
-  /* prepare command */
-  cmdPtr = BDI_AppendByte(BDI_LDR_ISP_READ_ID, cmdBuffer);
+  /* the trigger and the BDM configuration are always erased */
+  result = BDI_PlanErase(plan, layout, layout->firmwareAddr, 1);
+  if ((result == BDI_OKAY) && (layout->bdmConfigAddr != 0)) {
+    result = BDI_PlanErase(plan, layout, layout->bdmConfigAddr, 1);
+  } /* if */
 
-  /* BDI transaction */
-  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 100);
-  if (rxCount < 0) return rxCount;
+  open      = FALSE;
+  blockAddr = 0;
+  blockEnd  = 0;
+  for (seg = 0; (seg < image->count) && (result == BDI_OKAY); seg++) {
+    segment = &image->segment[seg];
+    segEnd  = segment->addr + segment->size;
+
+    /* continue the open block if the gap is small enough */
+    if (   open
+        && ((segment->addr - blockEnd) <= BDI_PLAN_MAX_GAP)
+        && (segment->addr < (blockAddr + layout->maxBlock))) {
+      blockEnd = segment->addr;
+    } /* if */
+    else {
+      if (open) result = BDI_PlanBlock(plan, layout, blockAddr, blockEnd);
+      blockAddr = segment->addr;
+      open      = TRUE;
+    } /* else */
 
-  /* analyse response */
-  ansPtr = BDI_ExtractByte(deviceId, ansBuffer+1);
+    /* fill maximal blocks */
+    while ((result == BDI_OKAY) && ((segEnd - blockAddr) > layout->maxBlock)) {
+      result    = BDI_PlanBlock(plan, layout, blockAddr, blockAddr + layout->maxBlock);
+      blockAddr = blockAddr + layout->maxBlock;
+    } /* while */
+    blockEnd = segEnd;
+  } /* for */
+  if (open && (result == BDI_OKAY)) result = BDI_PlanBlock(plan, layout, blockAddr, blockEnd);
 
-  return BDI_OKAY;
-} /* ISP_GetDeviceId */
+  if (result != BDI_OKAY) BDI_PlanFree(plan);
+  return result;
+} /* BDI_PlanFirmware */
 
 
 /****************************************************************************
  ****************************************************************************
 
- ispLSI: Read cell array line
+ Program the blocks of a plan into the BDI flash memory (via loader command)
+ Programming starts after the blocks already recorded in the journal,
+ every acknowledged block is recorded.
 
-  INPUT:  nLine           the number of the line to program
-  OUTPUT: szProgData      the data of the line (ASCII) loaded at program level
-          szErasedData    the data of the line (ASCII) loaded at erased level
-          return          error code
+  INPUT:  layout          the flash layout
+          image           the sorted image to program
+          plan            the program schedule
+          journal         the update journal
+  OUTPUT: return          error code
 
  ****************************************************************************/
 
-static int ISP_ReadArrayLine(int      nLine,
-                             char*    szProgData,
-                             char*    szErasedData)
+static int BDI_ProgramPlan(const BDI_LayoutT* layout,
+                           const IMG_ImageT*  image,
+                           const BDI_PlanT*   plan,
+                           JRN_JournalT*      journal)
 {
-  BYTE     *cmdPtr;
-  BYTE     *ansPtr;
-  BYTE      answer;
-  int       rxCount;
-  int       lineLength;
-  int       i;
-  char*     putPtr;
+  int           result;
+  int           i;
+  DWORD         errorAddr;
 
-  /* prepare command */
-  cmdPtr = BDI_AppendByte(BDI_LDR_ISP_READ_LINE, cmdBuffer);
-  cmdPtr = BDI_AppendByte((BYTE)nLine, cmdPtr);
+  result = BDI_OKAY;
+  for (i = journal->blocks; (i < plan->blockCount) && (result == BDI_OKAY); i++) {
+    IMG_Read(image, plan->block[i].addr, plan->block[i].count, blockBuffer);
+    result = layout->programFlash(plan->block[i].addr, plan->block[i].count, blockBuffer, &errorAddr);
+    if (result == BDI_OKAY) JRN_Programmed(journal, i + 1);
+    putchar('.');
+    fflush(stdout);
+  } /* for */
 
-  /* BDI transaction */
-  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 100);
-  if (rxCount < 0) return rxCount;
+  return result;
+} /* BDI_ProgramPlan */
 
-  /* analyse response */
-  ansPtr = BDI_ExtractByte(&answer, ansBuffer);
-  if (answer != BDI_LDR_ISP_READ_LINE) return BDI_ERR_INVALID_RESPONSE;
-  lineLength = (rxCount - 1) / 2;
 
-  /* copy prog data */
-  putPtr = szProgData;
-  for (i = 0; i < lineLength; i++) *putPtr++ = (char)(*ansPtr++);
-  *putPtr = 0;
+/****************************************************************************
+ ****************************************************************************
 
-  /* copy erased data */
-  putPtr = szErasedData;
-  for (i = 0; i < lineLength; i++) *putPtr++ = (char)(*ansPtr++);
-  *putPtr = 0;
+ Hash a plan and the data it programs, identifies the update in the journal
 
-  return BDI_OKAY;
-} /* ISP_ReadArrayLine */
+  INPUT:  image           the sorted image
+          plan            the plan
+  OUTPUT: return          the hash
+
+ ****************************************************************************/
+
+static unsigned long long BDI_HashPlan(const IMG_ImageT* image, const BDI_PlanT* plan)
+{
+  unsigned long long  hash;
+  BYTE                number[4];
+  int                 i;
+
+  hash = CCH_Hash(CCH_HASH_INIT, (const BYTE*)plan->erase, plan->eraseCount * sizeof(DWORD));
+  for (i = 0; i < plan->blockCount; i++) {
+    (void)BDI_AppendLong(plan->block[i].addr, number);
+    hash = CCH_Hash(hash, number, 4);
+  } /* for */
+  for (i = 0; i < image->count; i++) {
+    (void)BDI_AppendLong(image->segment[i].addr, number);
+    hash = CCH_Hash(hash, number, 4);
+    hash = CCH_Hash(hash, image->segment[i].data, image->segment[i].size);
+  } /* for */
+  return hash;
+} /* BDI_HashPlan */
 
 
 /****************************************************************************
  ****************************************************************************
 
- ispLSI: Program cell array line
+ Check where an interrupted update can continue
+ Only the last block recorded in the journal is read back, the blocks
+ before were acknowledged. The next block may have been programmed while
+ the connection was lost, it must be either erased or already hold its
+ data. Otherwise the update has to start again.
 
-  INPUT:  nLine           the number of the line to read
-          szLineData      the data of the line (ASCII)
-  OUTPUT: -
-          return          error code
+  INPUT:  image           the sorted image
+          plan            the plan
+          journal         the journal of the interrupted update
+  OUTPUT: journal         number of programmed blocks corrected
+          return          TRUE if the update can continue
 
  ****************************************************************************/
 
-static int ISP_ProgramArrayLine(int nLine, const char* szLineData)
+static BOOL BDI_ResumePlan(const IMG_ImageT* image, const BDI_PlanT* plan, JRN_JournalT* journal)
 {
-  BYTE     *cmdPtr;
-  int       rxCount;
+  const BDI_BlockT* block;
+  const BYTE*       readData;
+  WORD              i;
+  int               sector;
+
+  /* all sectors must be erased before programming starts */
+  for (sector = 0; sector < plan->eraseCount; sector++) {
+    if (!JRN_IsErased(journal, plan->erase[sector])) return (journal->blocks == 0);
+  } /* for */
+  if (journal->blocks > plan->blockCount) return FALSE;
+
+  /* the last acknowledged block */
+  if (journal->blocks > 0) {
+    block = &plan->block[journal->blocks - 1];
+    IMG_Read(image, block->addr, block->count, blockBuffer);
+    if (BDI_ReadMemoryBlock(block->addr, block->count, &readData) != BDI_OKAY) return FALSE;
+    if (memcmp(blockBuffer, readData, block->count) != 0) return FALSE;
+  } /* if */
 
-  /* prepare command */
-  cmdPtr = BDI_AppendByte(BDI_LDR_ISP_PROGRAM_LINE, cmdBuffer);
-  cmdPtr = BDI_AppendByte((BYTE)nLine, cmdPtr);
-  while (*szLineData != 0) {
-    cmdPtr = BDI_AppendByte((BYTE)(*szLineData++), cmdPtr);
-  } /* while */
-
-  /* BDI transaction */
-  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 300);
-  if (rxCount < 0) return rxCount;
-
-  return BDI_OKAY;
-} /* ISP_ProgramArrayLine */
+  /* the block in progress when the connection was lost */
+  if (journal->blocks < plan->blockCount) {
+    block = &plan->block[journal->blocks];
+    IMG_Read(image, block->addr, block->count, blockBuffer);
+    if (BDI_ReadMemoryBlock(block->addr, block->count, &readData) != BDI_OKAY) return FALSE;
+    if (memcmp(blockBuffer, readData, block->count) == 0) {
+      journal->blocks++;
+    } /* if */
+    else {
+      for (i = 0; i < block->count; i++) {
+        if (readData[i] != 0xFF) return FALSE;
+      } /* for */
+    } /* else */
+  } /* if */
+  return TRUE;
+} /* BDI_ResumePlan */
 
 
 /****************************************************************************
  ****************************************************************************
+ Load a firmware file, parsed images are taken from the cache if possible
 
- ispLSI: Read UES
+  INPUT:  fileName    the S-Record file name
+  OUTPUT: image       the firmware image
+          return      error code
 
-  INPUT:  -
-  OUTPUT: szUES           User Electronic Signature
-          return          error code
+ ****************************************************************************/
+
+static int BDI_LoadFirmware(const char* fileName, IMG_ImageT* image)
+{
+  int   result;
+
+  IMG_Init(image);
+  if (CCH_LoadImage(fileName, image)) return BDI_OKAY;
+  result = IMG_LoadSRecord(fileName, image);
+  if (result == BDI_OKAY) CCH_StoreImage(fileName, image);
+  return result;
+} /* BDI_LoadFirmware */
+
+
+/****************************************************************************
+ ****************************************************************************
+ Update firmware
+ The Loader must be activ and waiting for a command.
+ The progress is recorded in the journal of the BDI. An interrupted update
+ of the same firmware continues where it stopped, the start trigger is
+ only written when all blocks are programmed.
+
+  INPUT:  layout      the flash layout of the connected BDI
+          fileName    the S-Record file name
+          szSerial    the serial number of the BDI
+          idle        host work while the flash is erased or NULL
+          context     parameter of the idle function
+  OUTPUT: return      error code
 
  ****************************************************************************/
 
-static int ISP_ReadUES(char* szUES)
+static int BDI_UpdateFirmware(const BDI_LayoutT* layout,
+                              const char*        fileName,
+                              const char*        szSerial,
+                              BDI_IdleT          idle,
+                              void*              context)
 {
-  BYTE     *cmdPtr;
-  BYTE     *ansPtr;
-  BYTE      answer;
-  int       rxCount;
-  int       uesLength;
-  int       i;
-  char*     putPtr;
+  int           result;
+  int           i;
+  int           eraseCount;
+  IMG_ImageT    image;
+  BDI_PlanT     plan;
+  JRN_JournalT  journal;
+  BYTE          dataValues[4];
+  DWORD         errorAddr;
 
-  /* prepare command */
-  cmdPtr = BDI_AppendByte(BDI_LDR_ISP_READ_UES, cmdBuffer);
+  /* load the firmware file and plan the update */
+  result = BDI_LoadFirmware(fileName, &image);
+  if (result != BDI_OKAY) return result;
+  result = BDI_PlanFirmware(layout, &image, &plan);
+  if (result != BDI_OKAY) {
+    IMG_Free(&image);
+    return result;
+  } /* if */
 
-  /* BDI transaction */
-  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 100);
-  if (rxCount < 0) return rxCount;
+  /* continue an interrupted update if the flash can be read back */
+  if (JRN_Open(&journal, szSerial, BDI_HashPlan(&image, &plan))) {
+    if (layout->verifyFirmware && BDI_ResumePlan(&image, &plan, &journal)) {
+      if (journal.blocks > 0) {
+        printf("Resuming firmware update at block %i of %i\n", journal.blocks + 1, plan.blockCount);
+      } /* if */
+    } /* if */
+    else {
+      JRN_Reset(&journal);
+    } /* else */
+  } /* if */
 
-  /* analyse response */
-  ansPtr = BDI_ExtractByte(&answer, ansBuffer);
-  if (answer != BDI_LDR_ISP_READ_UES) return BDI_ERR_INVALID_RESPONSE;
-  uesLength = rxCount - 1;
+  /* erase flash */
+  eraseCount = 0;
+  for (i = 0; i < plan.eraseCount; i++) {
+    if (!JRN_IsErased(&journal, plan.erase[i])) eraseCount++;
+  } /* for */
+  printf("Erasing firmware flash (%i sectors) ....\n", eraseCount);
+  for (i = 0; (i < plan.eraseCount) && (result == BDI_OKAY); i++) {
+    if (JRN_IsErased(&journal, plan.erase[i])) continue;
+    result = BDI_EraseSectorIdle(plan.erase[i], idle, context);
+    if (result == BDI_OKAY) JRN_Erased(&journal, plan.erase[i]);
+  } /* for */
+  if (result != BDI_OKAY) {
+    JRN_Close(&journal, FALSE);
+    BDI_PlanFree(&plan);
+    IMG_Free(&image);
+    printf("Erasing firmware flash failed\n");
+    return result;
+  } /* if */
+  printf("Erasing firmware flash passed\n");
 
-  /* copy UES */
-  putPtr = szUES;
-  for (i = 0; i < uesLength; i++) *putPtr++ = (char)(*ansPtr++);
-  *putPtr = 0;
+  /* program firmware */
+  printf("Programming firmware flash ....\n");
+  result = BDI_ProgramPlan(layout, &image, &plan, &journal);
 
-  return BDI_OKAY;
-} /* ISP_ReadUES */
+  /* verify firmware before it is marked as valid */
+  if ((result == BDI_OKAY) && verifyFlash && layout->verifyFirmware) {
+    printf("\nVerifying firmware flash ....\n");
+    result = BDI_VerifyImage(&image);
+  } /* if */
+
+  /* check if plausible firmware */
+  if ((result == BDI_OKAY) && (layout->checkFirmware != NULL)) {
+    result = layout->checkFirmware(layout->firmwareAddr);
+  } /* if */
+
+  /* program firmware trigger */
+  if (result == BDI_OKAY) {
+    dataValues[0] = 0xAA;
+    dataValues[1] = 0x55;
+    dataValues[2] = 0x55;
+    dataValues[3] = 0xAA;
+    result = layout->programFlash(layout->firmwareAddr, 4, dataValues, &errorAddr);
+  } /* if */
+
+  if (result == BDI_OKAY) {
+    printf("\nProgramming firmware flash passed\n");
+  } /* if */
+  else {
+    printf("\nProgramming firmware flash failed\n");
+  } /* else */
+
+  JRN_Close(&journal, result == BDI_OKAY);
+  BDI_PlanFree(&plan);
+  IMG_Free(&image);
+  return result;
+} /* BDI_UpdateFirmware */
 
 
 /****************************************************************************
  ****************************************************************************
 
- ispLSI: Program UES
+ Build the network configuration data of a BDI
 
-  INPUT:  csUES           User Electronic Signature
-  OUTPUT: -
-          return          error code
+  INPUT:  version           the versions of the connected BDI
+          szHostIP          the IP address of the host
+          szBdiIP           the IP address of the BDI
+          szSubnetMask      the subnet mask
+          szDefaultGateway  the default gateway
+          szSetupFileName   the name of the setup file on the host
+  OUTPUT: configData        the network configuration data
 
  ****************************************************************************/
 
-static int ISP_ProgramUES(const char* szUES)
+static void BDI_BuildNetworkConfig(const BDI_VersionT* version,
+                                   const char*         szHostIP,
+                                   const char*         szBdiIP,
+                                   const char*         szSubnetMask,
+                                   const char*         szDefaultGateway,
+                                   const char*         szSetupFileName,
+                                   BYTE*               configData)
 {
-  BYTE     *cmdPtr;
-  int       rxCount;
+  BYTE*         configPtr;
+  size_t        nameLength;
+  size_t        i;
 
-  /* prepare command */
-  cmdPtr = BDI_AppendByte(BDI_LDR_ISP_PROGRAM_UES, cmdBuffer);
-  while (*szUES != 0) {
-    cmdPtr = BDI_AppendByte((BYTE)(*szUES++), cmdPtr);
-  } /* while */
+  /* the rest after the file name is zero, not what was on the stack */
+  (void)memset(configData, 0, BDI_NETWORK_CONFIG_SIZE);
+  configPtr = configData;
+  *configPtr++ = 0x00;
+  *configPtr++ = 0x0C;
+  *configPtr++ = 0x01;
+  *configPtr++ = (BYTE)((version->sn[0]-'0') * 16 + (version->sn[1]-'0'));
+  *configPtr++ = (BYTE)((version->sn[2]-'0') * 16 + (version->sn[3]-'0'));
+  *configPtr++ = (BYTE)((version->sn[4]-'0') * 16 + (version->sn[5]-'0'));
 
-  /* BDI transaction */
-  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 300);
-  if (rxCount < 0) return rxCount;
+  /* gap */
+  *configPtr++ = 0xFF;
+  *configPtr++ = 0xFF;
 
-  return BDI_OKAY;
-} /* ISP_ProgramUES */
+  /* IP addresses */
+  configPtr  = BDI_AppendLong(BDI_IPAddrMotorola(szBdiIP), configPtr);
+  configPtr  = BDI_AppendLong(BDI_IPAddrMotorola(szSubnetMask), configPtr);
+  configPtr  = BDI_AppendLong(BDI_IPAddrMotorola(szDefaultGateway), configPtr);
+
+  /* Host IP and Configuration File, the name fills the rest */
+  configPtr = BDI_AppendLong(BDI_IPAddrMotorola(szHostIP), configPtr);
+  nameLength = strlen(szSetupFileName);
+  if (nameLength > 79) nameLength = 79;
+  for (i=0; i<nameLength; i++) {
+    configPtr = BDI_AppendByte((BYTE)szSetupFileName[i], configPtr);
+  } /* for */
+  (void)BDI_AppendByte(0x00, configPtr);  /* terminating zero */
+} /* BDI_BuildNetworkConfig */
 
 
 /****************************************************************************
  ****************************************************************************
 
- ispLSI: Erase the chip
+ Open the configuration and register definitions stored in the BDI flash.
+ The images are produced block by block while they are compared and
+ programmed, from the compiled configuration and the register definition
+ files, from the mapped cache entry or from the images of a fleet unit.
 
-  INPUT:  -
-  OUTPUT: -
-          return          error code
+  INPUT:  szSetupFileName   the configuration file
+          unit              the unit of a fleet, NULL if none
+  OUTPUT: images            the opened images, closed by
+                            BDI_CloseConfigImages also on error
+          return            error code
 
  ****************************************************************************/
 
-static int ISP_Erase(void)
+static int BDI_OpenConfigImages(const char*        szSetupFileName,
+                                const FLT_UnitT*   unit,
+                                BDI_ConfigImagesT* images)
 {
-  BYTE     *cmdPtr;
-  int       rxCount;
-
-  /* prepare command */
-  cmdPtr = BDI_AppendByte(BDI_LDR_ISP_ERASE, cmdBuffer);
+  int         result;
+  const BYTE* romConfig;
+  const BYTE* romRegdef;
+  int         romConfigSize;
+  int         romRegdefSize;
+
+  (void)memset(images, 0, sizeof *images);
+
+  /* unchanged configuration and register definition files */
+  if (unit == NULL) {
+    images->cacheEntry = CCH_MapConfig(szSetupFileName, (DWORD)stripConfig, &images->cacheSize,
+                                       &romConfig, &romConfigSize, &romRegdef, &romRegdefSize);
+    if (images->cacheEntry != NULL) printf("Configuration loaded from cache\n");
+  } /* if */
+  else {
+    romConfig     = unit->romConfig;
+    romConfigSize = unit->romConfigSize;
+    romRegdef     = unit->romRegdef;
+    romRegdefSize = unit->romRegdefSize;
+  } /* else */
+  if ((unit != NULL) || (images->cacheEntry != NULL)) {
+    result = CNF_OpenData(romConfig, romConfigSize, &images->romConfig);
+    if (result >= 0) result = CNF_OpenData(romRegdef, romRegdefSize, &images->romRegdef);
+    return (result < 0) ? result : BDI_OKAY;
+  } /* if */
 
-  /* BDI transaction */
-  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 600);
-  if (rxCount < 0) return rxCount;
+  /* compile and check the configuration file */
+  result = CNF_Compile(szSetupFileName, &images->config);
+  if (result == BDI_ERR_CONFIG_SYNTAX) {
+    printf("### %s line %i: %s\n", szSetupFileName, images->config.errorLine, images->config.szError);
+  } /* if */
+  if (result == BDI_OKAY) result = CNF_OpenRomConfig(&images->config, stripConfig, &images->romConfig);
+  if (result >= 0) result = CNF_OpenRomRegdef(szSetupFileName, &images->config, &images->romRegdef);
+  if (result < 0) return result;
+  if (stripConfig) {
+    printf("Configuration stripped from %i to %lu bytes\n",
+           images->config.sourceSize, images->romConfig.size);
+  } /* if */
 
+  /* cache the images with the register definition files they depend on */
+  if (CCH_GetDirectory() != NULL) {
+    CCH_StoreConfig(szSetupFileName, (DWORD)stripConfig, &images->romConfig, &images->romRegdef);
+  } /* if */
   return BDI_OKAY;
-} /* ISP_Erase */
+} /* BDI_OpenConfigImages */
+
+
+static void BDI_CloseConfigImages(BDI_ConfigImagesT* images)
+{
+  CNF_Close(&images->romConfig);
+  CNF_Close(&images->romRegdef);
+  CNF_Free(&images->config);
+  if (images->cacheEntry != NULL) CCH_UnmapFile(images->cacheEntry, images->cacheSize);
+  images->cacheEntry = NULL;
+} /* BDI_CloseConfigImages */
 
 
 /****************************************************************************
  ****************************************************************************
 
- Conversion Ascii/Hex to UES
+ Compare an image with the BDI flash including the block after its end,
+ the BDI reads it up to the first 0xFF. Reading stops at the first block
+ that differs.
+
+  INPUT:  addr            flash address of the image
+          stream          the image
+  OUTPUT: equal           TRUE if the flash already holds the image
+          return          error code
 
  ****************************************************************************/
 
-/* 10 hex digits to 40 bit UES */
-static void ISPHS_Hex2UES(const char* szHex, char* szUES)
+static int BDI_CompareStream(DWORD addr, CNF_StreamT* stream, BOOL* equal)
 {
-  int   i;
-  char  c;
-
-  *szUES = 0;
-  for (i = 0; i < 10; i++) {
-    c = toupper(szHex[i]);
-    switch (c) {
-      case '0': strcat(szUES, "0000"); break;
-      case '1': strcat(szUES, "0001"); break;
-      case '2': strcat(szUES, "0010"); break;
-      case '3': strcat(szUES, "0011"); break;
-      case '4': strcat(szUES, "0100"); break;
-      case '5': strcat(szUES, "0101"); break;
-      case '6': strcat(szUES, "0110"); break;
-      case '7': strcat(szUES, "0111"); break;
-      case '8': strcat(szUES, "1000"); break;
-      case '9': strcat(szUES, "1001"); break;
-      case 'A': strcat(szUES, "1010"); break;
-      case 'B': strcat(szUES, "1011"); break;
-      case 'C': strcat(szUES, "1100"); break;
-      case 'D': strcat(szUES, "1101"); break;
-      case 'E': strcat(szUES, "1110"); break;
-      case 'F': strcat(szUES, "1111"); break;
-      default : strcat(szUES, "0000");
-    } /* switch */
-  } /* for */
-} /* ISPHS_Hex2UES */
+  int           result;
+  BDI_CompareT  compare;
+
+  CNF_Rewind(stream);
+  compare.addr   = addr;
+  compare.data   = NULL;
+  compare.stream = stream;
+  compare.result = BDI_OKAY;
+  compare.equal  = TRUE;
+  result = BDI_ReadMemoryPipe(addr, CNF_IMAGE_SIZE(stream->size), BDI_CompareBlock, &compare);
+  if (result == BDI_OKAY) result = compare.result;
+  *equal = compare.equal;
+  return result;
+} /* BDI_CompareStream */
 
 
-/* Ascii string  to 120 bit UES */
-static void ISP20_Ascii2UES(const char* szAscii, char* szUES)
-{
-  int       i,j;
-  int       ch;
+/****************************************************************************
+ ****************************************************************************
 
-  for (i = 0; i < ISP20_UES_CHARS; i++) {
-    if (strlen(szAscii) <= (size_t)i) ch = 0;
-    else                              ch = szAscii[i];
-    for (j = 0; j < 8; j++) {
-      *szUES++ = (ch & 0x80) ? '1' : '0';
-      ch <<= 1;
-    } /* for */
-  } /* for */
-  *szUES = 0;
-} /* ISP20_Ascii2UES */
+ Program an image into erased flash in whole blocks and verify it
+
+  INPUT:  layout          the flash layout
+          addr            flash address of the image
+          stream          the image
+  OUTPUT: return          error code
 
+ ****************************************************************************/
 
-/* Ascii string  to 80 bit UES */
-static void ISP10_Ascii2UES(const char* szAscii, char* szUES)
+static int BDI_ProgramStream(const BDI_LayoutT* layout, DWORD addr, CNF_StreamT* stream)
 {
-  int       i,j;
-  int       ch;
+  int           result;
+  int           count;
+  DWORD         offset;
+  DWORD         errorAddr;
+  BDI_VerifyT   state;
 
-  for (i = 0; i < ISP10_UES_CHARS; i++) {
-    if (strlen(szAscii) <= (size_t)i) ch = 0;
-    else                              ch = szAscii[i];
-    for (j = 0; j < 8; j++) {
-      *szUES++ = (ch & 0x80) ? '1' : '0';
-      ch <<= 1;
-    } /* for */
+  result = BDI_OKAY;
+  CNF_Rewind(stream);
+  for (offset = 0; (offset < stream->size) && (result == BDI_OKAY); offset += BDI_MAX_BLOCK_SIZE) {
+    count = CNF_ReadBlock(stream, blockBuffer);
+    if (count < 0) result = count;
+    else           result = layout->programFlash(addr + offset, BDI_MAX_BLOCK_SIZE, blockBuffer, &errorAddr);
   } /* for */
-  *szUES = 0;
-} /* ISP10_Ascii2UES */
+  if ((result != BDI_OKAY) || !verifyFlash) return result;
+
+  /* read back, the image is produced again */
+  (void)memset(&state, 0, sizeof state);
+  CNF_Rewind(stream);
+  state.addr   = addr;
+  state.stream = stream;
+  result = BDI_ReadMemoryPipe(addr, (stream->size + BDI_MAX_BLOCK_SIZE - 1) / BDI_MAX_BLOCK_SIZE * BDI_MAX_BLOCK_SIZE,
+                              BDI_VerifyBlock, &state);
+  if (result == BDI_OKAY) result = state.result;
+  return BDI_VerifyDone(&state, result);
+} /* BDI_ProgramStream */
 
 
 /****************************************************************************
  ****************************************************************************
 
-    ISP_LoadFuseMap:
-
-     Loads the Fuse Map from the two JEDEC Files into the ROW data array
+ Find the parts of the configuration that differ from the BDI flash.
+ Parts sharing a flash sector are rewritten together.
 
-     INPUT  : pszJedecFile      jedec file name for EPLD
-     OUTPUT : RETURN            error code
+  INPUT:  layout            the flash layout
+          configData        the network configuration data
+          images            the configuration and register definitions,
+                            NULL if not stored in flash
+  OUTPUT: changed           BDI_CHANGED_xxx of the parts to rewrite
+          return            error code
 
  ****************************************************************************/
 
-static int ISPHS_LoadFuseMap(const char* pszJedecFile)
+static int BDI_FindConfigChanges(const BDI_LayoutT* layout,
+                                 const BYTE*        configData,
+                                 BDI_ConfigImagesT* images,
+                                 int*               changed)
 {
-  FILE* jedecFile;
-  char  sLine[101];
-  char* fuseBit;
-  char* szRow;
-  int   row;
-  int   part;
+  int       result;
+  BOOL      equal;
+  DWORD     configSector;
+  DWORD     regdefSector;
+  DWORD     sectorSize;
+
+  *changed = 0;
+  result = BDI_CompareFlash(layout->networkAddr, BDI_NETWORK_CONFIG_SIZE, configData, &equal);
+  if ((result == BDI_OKAY) && !equal) *changed |= BDI_CHANGED_NETWORK;
+  if ((result != BDI_OKAY) || (images == NULL)) return result;
+
+  if (   !BDI_FindSector(layout, layout->configAddr, &configSector, &sectorSize)
+      || !BDI_FindSector(layout, layout->regdefAddr, &regdefSector, &sectorSize)) {
+    return BDI_ERR_INVALID_PARAMETER;
+  } /* if */
+  result = BDI_CompareStream(layout->configAddr, &images->romConfig, &equal);
+  if ((result == BDI_OKAY) && !equal) *changed |= BDI_CHANGED_CONFIG;
+  if (result == BDI_OKAY) {
+    result = BDI_CompareStream(layout->regdefAddr, &images->romRegdef, &equal);
+  } /* if */
+  if ((result == BDI_OKAY) && !equal) *changed |= BDI_CHANGED_REGDEF;
+  if ((configSector == regdefSector) && ((*changed & (BDI_CHANGED_CONFIG | BDI_CHANGED_REGDEF)) != 0)) {
+    *changed |= BDI_CHANGED_CONFIG | BDI_CHANGED_REGDEF;
+  } /* if */
+  return result;
+} /* BDI_FindConfigChanges */
+
 
-  /* open Jedec files */
-  jedecFile = fopen(pszJedecFile, "rt");
-  if (jedecFile == NULL) {
-    return BDI_ERR_LOGIC_FILE;
+static void BDI_PrintConfigChanges(int changed, BOOL withConfig)
+{
+  if ((changed & BDI_CHANGED_NETWORK) == 0) printf("Network configuration unchanged\n");
+  if (withConfig) {
+    if ((changed & BDI_CHANGED_CONFIG) == 0) printf("Configuration unchanged\n");
+    if ((changed & BDI_CHANGED_REGDEF) == 0) printf("Register definitions unchanged\n");
   } /* if */
+} /* BDI_PrintConfigChanges */
 
-  /* find start of fuse map */
-  do {
-    if (fgets(sLine, sizeof sLine - 1, jedecFile) == NULL) {
-      fclose(jedecFile);
-      return BDI_ERR_LOGIC_FILE;
-    }
-  } while (strncmp(sLine,"*L00000", 7));
-
-  /* read fuse map */
-  for (row = 0; row < ISPHS_NBR_OF_ROWS; row++) {
-    szRow = aszFuseMap[row];
-    for (part = 0; part < 2; part++) {
-      fgets(sLine, sizeof sLine - 1, jedecFile);
-      fuseBit = sLine;
-      if (fuseBit) {
-        while (*fuseBit == '0' || *fuseBit == '1') {
-          *szRow++ = *fuseBit++;
-        } /* while */
-      } /* if */
-    } /* for */
-    szRow = 0;
-    if (strlen(aszFuseMap[row]) != ISPHS_ROW_BITS) {
-      fclose(jedecFile);
-      return BDI_ERR_LOGIC_FILE;
-    } /* if */
-  } /* for */
 
-  fclose(jedecFile);
-  return BDI_OKAY;
-} /* ISPHS_LoadFuseMap */
+/****************************************************************************
+ ****************************************************************************
+                Logic programming functions
+ ****************************************************************************
+ ****************************************************************************/
+
+/****************************************************************************
+ ****************************************************************************
+
+ ispLSI: Enable / Disable ISP Mode
+
+  INPUT:  -
+  OUTPUT: -
+          return          error code
 
+ ****************************************************************************/
 
-static int ISP20_LoadFuseMap(const char* pszJedecFile)
+static int ISP_Enable()
 {
-  FILE* jedecFile;
-  char  sLine[101];
-  char* fuseBit;
-  char* szRow;
-  int   row;
-  int   part;
+  BYTE     *cmdPtr;
+  int       rxCount;
 
-  /* open Jedec files */
-  jedecFile = fopen(pszJedecFile, "rt");
-  if (jedecFile == NULL) {
-    return BDI_ERR_LOGIC_FILE;
-  } /* if */
+  /* prepare command */
+  cmdPtr = BDI_AppendByte(BDI_LDR_ISP_ENABLE, cmdBuffer);
+  cmdPtr = BDI_AppendByte(1, cmdPtr);
 
-  /* find start of fuse map */
-  do {
-    if (fgets(sLine, sizeof sLine - 1, jedecFile) == NULL) {
-      fclose(jedecFile);
-      return BDI_ERR_LOGIC_FILE;
-    }
-  } while (strncmp(sLine,"*L00000", 7));
-
-  /* read fuse map */
-  for (row = 0; row < ISP20_NBR_OF_ROWS; row++) {
-    szRow = aszFuseMap[row];
-    for (part = 0; part < 4; part++) {
-      fgets(sLine, sizeof sLine - 1, jedecFile);
-      fuseBit = sLine;
-      if (fuseBit) {
-        while (*fuseBit == '0' || *fuseBit == '1') {
-          *szRow++ = *fuseBit++;
-        } /* while */
-      } /* if */
-    } /* for */
-    szRow = 0;
-    if (strlen(aszFuseMap[row]) != ISP20_ROW_BITS) {
-      fclose(jedecFile);
-      return BDI_ERR_LOGIC_FILE;
-    } /* if */
-  } /* for */
+  /* BDI transaction */
+  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 100);
+  if (rxCount < 0) return rxCount;
 
-  fclose(jedecFile);
   return BDI_OKAY;
-} /* ISP20_LoadFuseMap */
-
+} /* ISP_Enable */
 
-static int ISP10_LoadFuseMap(const char* pszJedecFile)
+static int ISP_Disable()
 {
-  FILE* jedecFile;
-  char  sLine[81];
-  char* fuseBit;
-  char* szRow;
-  int   row;
-  int   part;
+  BYTE     *cmdPtr;
+  int       rxCount;
 
-  /* open Jedec files */
-  jedecFile = fopen(pszJedecFile, "rt");
-  if (jedecFile == NULL) {
-    return BDI_ERR_LOGIC_FILE;
-  } /* if */
+  /* prepare command */
+  cmdPtr = BDI_AppendByte(BDI_LDR_ISP_ENABLE, cmdBuffer);
+  cmdPtr = BDI_AppendByte(0, cmdPtr);
 
-  /* find start of fuse map */
-  do {
-    if (fgets(sLine, sizeof sLine - 1, jedecFile) == NULL) {
-      fclose(jedecFile);
-      return BDI_ERR_LOGIC_FILE;
-    }
-  } while (strncmp(sLine,"*L00000", 7));
-
-  /* read fuse map */
-  for (row = 0; row < ISP10_NBR_OF_ROWS; row++) {
-    szRow = aszFuseMap[row];
-    for (part = 0; part < 4; part++) {
-      fgets(sLine, sizeof sLine - 1, jedecFile);
-      fuseBit = sLine;
-      if (fuseBit) {
-        while (*fuseBit == '0' || *fuseBit == '1') {
-          *szRow++ = *fuseBit++;
-        } /* while */
-      } /* if */
-    } /* for */
-    szRow = 0;
-    if (strlen(aszFuseMap[row]) != ISP10_ROW_BITS) {
-      fclose(jedecFile);
-      return BDI_ERR_LOGIC_FILE;
-    } /* if */
-  } /* for */
+  /* BDI transaction */
+  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 100);
+  if (rxCount < 0) return rxCount;
 
-  fclose(jedecFile);
   return BDI_OKAY;
-} /* ISP10_LoadFuseMap */
+} /* ISP_Disable */
 
 
 /****************************************************************************
  ****************************************************************************
 
- Update logic
- The Loader must be activ and waiting for a command
+ ispLSI: Get Device ID
 
-  INPUT:  version     the version number
-          fileName    the JEDEC file name
-  OUTPUT: return      error code
+  INPUT:  -
+  OUTPUT: deviceId        the ID of the ispLSI Device
+          return          error code
 
  ****************************************************************************/
 
-static int BHS_UpdateLogic(WORD version, const char* fileName)
+static int  ISP_GetDeviceId(BYTE *deviceId)
 {
-  int   result;
-  char  szVersion[10 + 1];
-  char  szUES[ISPHS_UES_BITS + 1];
-  int   row;
-  char  szRowProg[ISPHS_ROW_BITS + 1];
-  char  szRowErase[ISPHS_ROW_BITS + 1];
-  char  szDeviceUES[ISPHS_UES_BITS + 1];
+  BYTE     *cmdPtr;
+  BYTE     *ansPtr;
+  int       rxCount;
 
-  /* build UES string */
-  sprintf(szVersion, "B3201E%04i", version);
-  ISPHS_Hex2UES(szVersion, szUES);
+  /* prepare command */
+  cmdPtr = BDI_AppendByte(BDI_LDR_ISP_READ_ID, cmdBuffer);
 
-  /* load fuse map */
-  result = ISPHS_LoadFuseMap(fileName);
+  /* BDI transaction */
+  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 100);
+  if (rxCount < 0) return rxCount;
 
-  /* enable ISP mode */
-  if (result == BDI_OKAY) {
-    result = ISP_Enable();
-  } /* if */
-
-  /* program fuse map */
-  if (result == BDI_OKAY) {
-    for (row = 0; row < ISPHS_NBR_OF_ROWS; row++) {
-      result = ISP_ProgramArrayLine(row, aszFuseMap[row]);
-      if (result != BDI_OKAY) break;
-    } /* for */
-  } /* if */
+  /* analyse response */
+  ansPtr = BDI_ExtractByte(deviceId, ansBuffer+1);
 
-  /* program UES */
-  if (result == BDI_OKAY) {
-    result = ISP_ProgramUES(szUES);
-  } /* if */
+  return BDI_OKAY;
+} /* ISP_GetDeviceId */
 
-  /* verify fuse map */
-  if (result == BDI_OKAY) {
-    for (row = 0; row < ISPHS_NBR_OF_ROWS; row++) {
-      result = ISP_ReadArrayLine(row, szRowProg, szRowErase);
-      if (result != BDI_OKAY) break;
-      if (    (strcmp(aszFuseMap[row], szRowProg) != 0)
-           || (strcmp(aszFuseMap[row], szRowErase) != 0)
-           ) {
-        result = BDI_ERR_LOGIC_VERIFY;
-        break;
-      } /* if */
-    } /* for */
-  } /* if */
 
-  /* verify UES */
-  if (result == BDI_OKAY) {
-    result = ISP_ReadUES(szDeviceUES);
-    if (strcmp(szDeviceUES, szUES) != 0) result = BDI_ERR_LOGIC_VERIFY;
-  } /* if */
+/****************************************************************************
+ ****************************************************************************
 
-  /* disable ISP mode */
-  if (result == BDI_OKAY) result = ISP_Disable();
-  else                    (void)ISP_Disable();
+ ispLSI: Read cell array line
+ The command is prepared in cmdBuffer, the answer analysed in ansBuffer.
 
-  return result;
-} /* BHS_UpdateLogic */
+  INPUT:  nLine           the number of the line to read
+          bits            the number of bits per line
+          rxCount         the length of the answer
+  OUTPUT: progData        the packed data of the line loaded at program level
+          erasedData      the packed data of the line loaded at erased level
+          return          error code / end of the command
 
+ ****************************************************************************/
 
-static int B20_UpdateLogic(WORD version, const char* fileName)
+static BYTE* ISP_PrepareReadLine(int nLine)
 {
-  int   result;
-  char  szVersion[10 + 1];
-  char  szUES[ISP20_UES_BITS + 1];
-  int   row;
-  char  szRowProg[ISP20_ROW_BITS + 1];
-  char  szRowErase[ISP20_ROW_BITS + 1];
-  char  szDeviceUES[ISP20_UES_BITS + 1];
+  BYTE     *cmdPtr;
 
-  /* build UES string */
-  sprintf(szVersion, "B6001E%c%03i", ('0' + (version / 1000)), (version % 1000));
-  ISP20_Ascii2UES(szVersion, szUES);
+  cmdPtr = BDI_AppendByte(BDI_LDR_ISP_READ_LINE, cmdBuffer);
+  cmdPtr = BDI_AppendByte((BYTE)nLine, cmdPtr);
+  return cmdPtr;
+} /* ISP_PrepareReadLine */
 
-  /* load fuse map */
-  result = ISP20_LoadFuseMap(fileName);
 
-  /* enable ISP mode */
-  if (result == BDI_OKAY) {
-    result = ISP_Enable();
-  } /* if */
+static int ISP_AnalyseReadLine(int rxCount, int bits, FUS_WordT* progData, FUS_WordT* erasedData)
+{
+  BYTE      answer;
 
-  /* program fuse map */
-  if (result == BDI_OKAY) {
-    for (row = 0; row < ISP20_NBR_OF_ROWS; row++) {
-      result = ISP_ProgramArrayLine(row, aszFuseMap[row]);
-      if (result != BDI_OKAY) break;
-      putchar('.');
-      fflush(stdout);
-    } /* for */
+  /* the line is read back in ASCII */
+  (void)BDI_ExtractByte(&answer, ansBuffer);
+  if (answer != BDI_LDR_ISP_READ_LINE) return BDI_ERR_INVALID_RESPONSE;
+  if (rxCount != 1 + 2 * bits) return BDI_ERR_LOGIC_VERIFY;
+  if (   !FUS_FromAscii((const char*)ansBuffer + 1, bits, progData)
+      || !FUS_FromAscii((const char*)ansBuffer + 1 + bits, bits, erasedData)) {
+    return BDI_ERR_LOGIC_VERIFY;
   } /* if */
+  return BDI_OKAY;
+} /* ISP_AnalyseReadLine */
 
-  /* program UES */
-  if (result == BDI_OKAY) {
-    result = ISP_ProgramUES(szUES);
-  } /* if */
 
-  /* verify fuse map */
-  if (result == BDI_OKAY) {
-    for (row = 0; row < ISP20_NBR_OF_ROWS; row++) {
-      result = ISP_ReadArrayLine(row, szRowProg, szRowErase);
-      if (result != BDI_OKAY) break;
-      if (    (strcmp(aszFuseMap[row], szRowProg) != 0)
-           || (strcmp(aszFuseMap[row], szRowErase) != 0)
-           ) {
-        result = BDI_ERR_LOGIC_VERIFY;
-        break;
-      } /* if */
-      putchar('.');
-      fflush(stdout);
-    } /* for */
-  } /* if */
+static int ISP_ReadArrayLine(int        nLine,
+                             int        bits,
+                             FUS_WordT* progData,
+                             FUS_WordT* erasedData)
+{
+  BYTE     *cmdPtr;
+  int       rxCount;
 
-  /* verify UES */
-  if (result == BDI_OKAY) {
-    result = ISP_ReadUES(szDeviceUES);
-    if (strcmp(szDeviceUES, szUES) != 0) result = BDI_ERR_LOGIC_VERIFY;
-  } /* if */
+  /* prepare command */
+  cmdPtr = ISP_PrepareReadLine(nLine);
 
-  /* disable ISP mode */
-  if (result == BDI_OKAY) result = ISP_Disable();
-  else                    (void)ISP_Disable();
+  /* BDI transaction */
+  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 100);
+  if (rxCount < 0) return rxCount;
 
-  if (result == BDI_OKAY) {
-    printf("\nProgramming CPLD passed\n");
-  } /* if */
-  else {
-    printf("\nProgramming CPLD failed\n");
-  } /* else */
+  /* analyse response */
+  return ISP_AnalyseReadLine(rxCount, bits, progData, erasedData);
+} /* ISP_ReadArrayLine */
 
-  return result;
-} /* B20_UpdateLogic */
 
+/****************************************************************************
+ ****************************************************************************
+
+ ispLSI: Program cell array line
+ The command is prepared in cmdBuffer, the line is transferred in ASCII.
+
+  INPUT:  nLine           the number of the line to program
+          bits            the number of bits per line
+          lineData        the packed data of the line
+  OUTPUT: return          the end of the command
+
+ ****************************************************************************/
 
-static int B10_UpdateLogic(WORD version, const char* fileName)
+static BYTE* ISP_PrepareProgramLine(int nLine, int bits, const FUS_WordT* lineData)
 {
-  int   result;
-  char  szVersion[10 + 1];
-  char  szUES[ISP10_UES_BITS + 1];
-  int   row;
-  char  szRowProg[ISP10_ROW_BITS + 1];
-  char  szRowErase[ISP10_ROW_BITS + 1];
-  char  szDeviceUES[ISP10_UES_BITS + 1];
+  BYTE     *cmdPtr;
 
-  /* build UES string */
-  sprintf(szVersion, "B1001E%c%03i", ('0' + (version / 1000)), (version % 1000));
-  ISP10_Ascii2UES(szVersion, szUES);
+  cmdPtr = BDI_AppendByte(BDI_LDR_ISP_PROGRAM_LINE, cmdBuffer);
+  cmdPtr = BDI_AppendByte((BYTE)nLine, cmdPtr);
+  FUS_ToAscii(lineData, bits, (char*)cmdPtr);
+  return cmdPtr + bits;
+} /* ISP_PrepareProgramLine */
 
-  /* load fuse map */
-  result = ISP10_LoadFuseMap(fileName);
 
-  /* enable ISP mode */
-  if (result == BDI_OKAY) {
-    result = ISP_Enable();
-  } /* if */
+/****************************************************************************
+ ****************************************************************************
 
-  /* program fuse map */
-  if (result == BDI_OKAY) {
-    for (row = 0; row < ISP10_NBR_OF_ROWS; row++) {
-      result = ISP_ProgramArrayLine(row, aszFuseMap[row]);
-      if (result != BDI_OKAY) break;
-      putchar('.');
-      fflush(stdout);
-    } /* for */
-  } /* if */
+ ispLSI: Read UES
+ The command is prepared in cmdBuffer, the answer analysed in ansBuffer.
 
-  /* program UES */
-  if (result == BDI_OKAY) {
-    result = ISP_ProgramUES(szUES);
-  } /* if */
+  INPUT:  bits            the number of UES bits
+          rxCount         the length of the answer
+  OUTPUT: ues             the packed User Electronic Signature
+          return          error code / end of the command
 
-  /* verify fuse map */
-  if (result == BDI_OKAY) {
-    for (row = 0; row < ISP10_NBR_OF_ROWS; row++) {
-      result = ISP_ReadArrayLine(row, szRowProg, szRowErase);
-      if (result != BDI_OKAY) break;
-      if (    (strcmp(aszFuseMap[row], szRowProg) != 0)
-           || (strcmp(aszFuseMap[row], szRowErase) != 0)
-           ) {
-        result = BDI_ERR_LOGIC_VERIFY;
-        break;
-      } /* if */
-      putchar('.');
-      fflush(stdout);
-    } /* for */
-  } /* if */
+ ****************************************************************************/
 
-  /* verify UES */
-  if (result == BDI_OKAY) {
-    result = ISP_ReadUES(szDeviceUES);
-    if (strcmp(szDeviceUES, szUES) != 0) result = BDI_ERR_LOGIC_VERIFY;
-  } /* if */
+static BYTE* ISP_PrepareReadUES(void)
+{
+  return BDI_AppendByte(BDI_LDR_ISP_READ_UES, cmdBuffer);
+} /* ISP_PrepareReadUES */
 
-  /* disable ISP mode */
-  if (result == BDI_OKAY) result = ISP_Disable();
-  else                    (void)ISP_Disable();
 
-  if (result == BDI_OKAY) {
-    printf("\nProgramming CPLD passed\n");
-  } /* if */
-  else {
-    printf("\nProgramming CPLD failed\n");
-  } /* else */
+static int ISP_AnalyseReadUES(int rxCount, int bits, FUS_WordT* ues)
+{
+  BYTE      answer;
 
-  return result;
-} /* B10_UpdateLogic */
+  (void)BDI_ExtractByte(&answer, ansBuffer);
+  if (answer != BDI_LDR_ISP_READ_UES) return BDI_ERR_INVALID_RESPONSE;
+  if (rxCount != 1 + bits) return BDI_ERR_LOGIC_VERIFY;
+  if (!FUS_FromAscii((const char*)ansBuffer + 1, bits, ues)) return BDI_ERR_LOGIC_VERIFY;
+  return BDI_OKAY;
+} /* ISP_AnalyseReadUES */
 
 
-/****************************************************************************
- ****************************************************************************
-                helper functions
- ****************************************************************************
- ****************************************************************************/
+static int ISP_ReadUES(int bits, FUS_WordT* ues)
+{
+  BYTE     *cmdPtr;
+  int       rxCount;
+
+  /* prepare command */
+  cmdPtr = ISP_PrepareReadUES();
+
+  /* BDI transaction */
+  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 100);
+  if (rxCount < 0) return rxCount;
+
+  /* analyse response */
+  return ISP_AnalyseReadUES(rxCount, bits, ues);
+} /* ISP_ReadUES */
+
 
 /****************************************************************************
  ****************************************************************************
 
-    B30_VerifyLoaderCode :
-
-    Check if illegal data is stored in the flash
+ ispLSI: Program UES
+ The command is prepared in cmdBuffer, the UES is transferred in ASCII.
 
-    INPUT:  -
-    OUTPUT: return        error code
+  INPUT:  bits            the number of UES bits
+          ues             the packed User Electronic Signature
+  OUTPUT: return          error code / end of the command
 
  ****************************************************************************/
 
-static WORD AccumulateCRC(WORD count, BYTE* data, WORD crc)
-{
-  static  WORD  crcLockupTable[256] =
-              { 0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
-                0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
-                0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
-                0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
-                0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
-                0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
-                0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
-                0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
-                0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
-                0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
-                0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
-                0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
-                0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
-                0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
-                0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
-                0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
-                0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
-                0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
-                0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
-                0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
-                0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
-                0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
-                0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
-                0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
-                0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
-                0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
-                0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
-                0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
-                0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
-                0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
-                0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
-                0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040 };
-  WORD  result;
-  WORD  w;
+static BYTE* ISP_PrepareProgramUES(int bits, const FUS_WordT* ues)
+{
+  BYTE     *cmdPtr;
 
-  while (count--) {
-    result = (crc >> 8);
-    w = ((crc ^ *data++) & 0xFF);
-    crc = (result ^ crcLockupTable[w]);
-  } /* while */
-  return crc;
-} /* AccumulateCRC */
+  cmdPtr = BDI_AppendByte(BDI_LDR_ISP_PROGRAM_UES, cmdBuffer);
+  FUS_ToAscii(ues, bits, (char*)cmdPtr);
+  return cmdPtr + bits;
+} /* ISP_PrepareProgramUES */
 
-static BOOL AllErased(WORD count, const BYTE* data)
-{
-  while (count--) {
-    if (*data != 0xFF) return FALSE;
-    data++;
-  } /* while */
-  return TRUE;
-} /* AllErased */
 
-static int B30_VerifyLoaderCode(void)
+static int ISP_ProgramUES(int bits, const FUS_WordT* ues)
 {
-  DWORD addr;
-  WORD  crc;
-  BYTE  data[BDI_MAX_BLOCK_SIZE];
-
-  /* check unused part of boot sector */
-  addr = 0x00000510;
-  while (addr < 0x2000) {
-    (void)BDI_ReadMemory(addr, sizeof data, data);
-    if (!AllErased(BDI_MAX_BLOCK_SIZE, data)) return BDI_ERR_VERIFY;
-    addr += BDI_MAX_BLOCK_SIZE;
-  } /* while */
+  BYTE     *cmdPtr;
+  int       rxCount;
 
-  /* check unused part of loader sector */
-  (void)BDI_ReadMemory(0x10000, sizeof data, data);
-  (void)BDI_ExtractLong(&addr, (data + 12));
-  addr = 0x10040 + (4 * addr);
-  while (addr < 0x30000) {
-    (void)BDI_ReadMemory(addr, sizeof data, data);
-    if (!AllErased(BDI_MAX_BLOCK_SIZE, data)) return BDI_ERR_VERIFY;
-    addr += BDI_MAX_BLOCK_SIZE;
-  } /* while */
+  /* prepare command */
+  cmdPtr = ISP_PrepareProgramUES(bits, ues);
 
-  /* calculate crc16 over boot/loader sectors */
-  crc  = 0;
-  addr = 0x00000000;
-  while (addr < 0x30000) {
-    (void)BDI_ReadMemory(addr, sizeof data, data);
-    if (addr == 0x00000000) {
-      (void)memset(data + 0x20, 0, 8); /* serial number */
-    } /* if */
-    crc = AccumulateCRC(sizeof data, data, crc);
-    addr += BDI_MAX_BLOCK_SIZE;
-  } /* while */
-  printf("CRC over boot/loader sectors is %i\n", crc);
+  /* BDI transaction */
+  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 300);
+  if (rxCount < 0) return rxCount;
 
   return BDI_OKAY;
-} /* B30_VerifyLoaderCode */
-
+} /* ISP_ProgramUES */
 
-/****************************************************************************
- ****************************************************************************
-                main functions
- ****************************************************************************
- ****************************************************************************/
 
 /****************************************************************************
  ****************************************************************************
 
-  BDI_ExitLoader :
-
-  Transfer the exit loader command
+ ispLSI: Erase the chip
 
   INPUT:  -
-  OUTPUT: return        error code
+  OUTPUT: -
+          return          error code
 
  ****************************************************************************/
 
-
-static int BDI_ExitLoader()
+static int ISP_Erase(void)
 {
   BYTE     *cmdPtr;
   int       rxCount;
 
   /* prepare command */
-  cmdPtr = BDI_AppendByte(BDI_LDR_EXIT_LOADER, cmdBuffer);
+  cmdPtr = BDI_AppendByte(BDI_LDR_ISP_ERASE, cmdBuffer);
 
   /* BDI transaction */
-  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 200);
+  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 600);
   if (rxCount < 0) return rxCount;
 
   return BDI_OKAY;
-} /* BDI_ExitLoader */
+} /* ISP_Erase */
 
 
 /****************************************************************************
  ****************************************************************************
 
-    BDI_ConnectLoader :
+    ISP_GetGeometry:
 
-    Connects to the Loader an get the current versions
+     Returns the geometry of the CPLD of a BDI
 
-     INPUT  : szPort          the communication port (e.g. "/dev/tty1")
-     OUTPUT : bdiType         the BDI type
-              loaderVersion   the current loader version
-              firmwareVersion the current firmware version
-              logicVersion    the current logic version
-              RETURN          0 if okay or a negativ number if error
+     INPUT  : bdi               the BDI type
+     OUTPUT : RETURN            the geometry, NULL if no CPLD update
 
  ****************************************************************************/
 
-static int BDI_ConnectLoader(const char* szPort, DWORD baudrate, BDI_VersionT *pVersion)
+static const FUS_GeometryT* ISP_GetGeometry(WORD bdi)
+{
+  if (bdi > BDI_TYPE_LAST) return NULL;
+  if (ISP_Geometry[bdi].rows == 0) return NULL;
+  return &ISP_Geometry[bdi];
+} /* ISP_GetGeometry */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    ISP_LoadFuseMap:
+
+     Loads the fuse map, parsed fuse maps are taken from the cache if possible.
+     A fuse map already loaded (e.g. while the firmware flash was erased)
+     is not loaded again.
+
+     INPUT  : geometry          the geometry of the CPLD
+              pszJedecFile      jedec file name for EPLD
+     OUTPUT : RETURN            error code
+
+ ****************************************************************************/
+
+static int ISP_LoadFuseMap(const FUS_GeometryT* geometry, const char* pszJedecFile)
 {
-  BYTE *cmdPtr;
-  BYTE *ansPtr;
-  int   rxCount;
-  BYTE  answer;
   int   result;
-  int   i;
 
-  /* connect to BDI */
+  if (   (fuseMap.geometry == geometry)
+      && (strcmp(szFuseMapFile, pszJedecFile) == 0)) return BDI_OKAY;
+  szFuseMapFile[0] = 0;
   result = BDI_OKAY;
-  for (i = 0; i < 3; i++) {
-    result = BDI_Open(szPort, baudrate);
-    if ((result == BDI_OKAY) || (result == BDI_ASYN_SETUP)) break;
-  } /* for */
-  if (result != BDI_OKAY) return result;
+  FUS_Init(&fuseMap, geometry);
+  if (!CCH_LoadFuseMap(pszJedecFile, &fuseMap)) {
+    result = FUS_LoadJedec(pszJedecFile, &fuseMap);
+    if (result == BDI_OKAY) {
+      CCH_StoreFuseMap(pszJedecFile, &fuseMap);
+    } /* if */
+  } /* if */
+  if ((result == BDI_OKAY) && (strlen(pszJedecFile) < sizeof szFuseMapFile)) {
+    strcpy(szFuseMapFile, pszJedecFile);
+  } /* if */
+  return result;
+} /* ISP_LoadFuseMap */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ Program and verify the fuse map and the UES as one pipelined sequence.
+ Every row is read back while the following rows are programmed, a row
+ is only read after its program command is answered. The number of
+ commands in flight is given by the link (BDI_PipeDepth).
+ ISP mode must be enabled.
+
+  INPUT:  geometry    the geometry of the CPLD
+          ues         the packed UES
+  OUTPUT: program     the timing of the row program commands
+          verify      the timing of the row read commands
+          return      error code
+
+ ****************************************************************************/
+
+static int ISP_ProgramSequence(const FUS_GeometryT* geometry,
+                               const FUS_WordT*     ues,
+                               ISP_TimingT*         program,
+                               ISP_TimingT*         verify)
+{
+  static ISP_OperationT operation[2 * FUS_MAX_ROWS + 2];
+  ISP_OperationT* op;
+  ISP_TimingT*    timing;
+  BYTE*           cmdPtr;
+  int             programIndex[FUS_MAX_ROWS];
+  int             count;
+  int             sent;
+  int             done;
+  int             lag;
+  int             row;
+  int             result;
+  int             rxCount;
+  DWORD           lastTime;
+  DWORD           now;
+  FUS_RowT        rowProg;
+  FUS_RowT        rowErase;
+  FUS_UEST        deviceUES;
+
+  /* the read of a row follows its program command by the pipe depth */
+  count = 0;
+  lag   = BDI_PipeDepth();
+  for (row = 0; row < geometry->rows + lag; row++) {
+    if (row < geometry->rows) {
+      programIndex[row]        = count;
+      operation[count].command = BDI_LDR_ISP_PROGRAM_LINE;
+      operation[count].row     = row;
+      operation[count].depends = -1;
+      count++;
+    } /* if */
+    if (row >= lag) {
+      operation[count].command = BDI_LDR_ISP_READ_LINE;
+      operation[count].row     = row - lag;
+      operation[count].depends = programIndex[row - lag];
+      count++;
+    } /* if */
+  } /* for */
+  operation[count].command = BDI_LDR_ISP_PROGRAM_UES;
+  operation[count].row     = 0;
+  operation[count].depends = -1;
+  count++;
+  operation[count].command = BDI_LDR_ISP_READ_UES;
+  operation[count].row     = 0;
+  operation[count].depends = count - 1;
+  count++;
+
+  memset(program, 0, sizeof(ISP_TimingT));
+  memset(verify, 0, sizeof(ISP_TimingT));
+  result   = BDI_OKAY;
+  sent     = 0;
+  done     = 0;
+  lastTime = BDI_GetMicroseconds();
+  while (done < count) {
+
+    /* send while the pipe is not full */
+    while (    (result == BDI_OKAY)
+            && (sent < count)
+            && ((sent - done) < BDI_PipeDepth())
+            && (operation[sent].depends < done)
+          ) {
+      op = &operation[sent];
+      if      (op->command == BDI_LDR_ISP_PROGRAM_LINE) cmdPtr = ISP_PrepareProgramLine(op->row, geometry->rowBits, fuseMap.row[op->row]);
+      else if (op->command == BDI_LDR_ISP_READ_LINE)    cmdPtr = ISP_PrepareReadLine(op->row);
+      else if (op->command == BDI_LDR_ISP_PROGRAM_UES)  cmdPtr = ISP_PrepareProgramUES(geometry->uesBits, ues);
+      else                                              cmdPtr = ISP_PrepareReadUES();
+      result = BDI_PipeSend(cmdPtr-cmdBuffer, cmdBuffer,
+                            (op->command == BDI_LDR_ISP_READ_LINE) ? 100 : 300);
+      if (result == BDI_OKAY) sent++;
+    } /* while */
+    if (done == sent) break;
+
+    /* receive the oldest answer, after an error only the pipe is emptied */
+    rxCount = BDI_PipeReceive(sizeof ansBuffer, ansBuffer);
+    op      = &operation[done++];
+    if (result != BDI_OKAY) continue;
+    if (rxCount < 0) {
+      result = rxCount;
+      continue;
+    } /* if */
+    if (op->command == BDI_LDR_ISP_READ_LINE) {
+      result = ISP_AnalyseReadLine(rxCount, geometry->rowBits, rowProg, rowErase);
+      if (    (result == BDI_OKAY)
+           && (    !FUS_Equal(fuseMap.row[op->row], rowProg, geometry->rowBits)
+                || !FUS_Equal(fuseMap.row[op->row], rowErase, geometry->rowBits))
+         ) {
+        result = BDI_ERR_LOGIC_VERIFY;
+      } /* if */
+    } /* if */
+    else if (op->command == BDI_LDR_ISP_READ_UES) {
+      result = ISP_AnalyseReadUES(rxCount, geometry->uesBits, deviceUES);
+      if ((result == BDI_OKAY) && !FUS_Equal(deviceUES, ues, geometry->uesBits)) {
+        result = BDI_ERR_LOGIC_VERIFY;
+      } /* if */
+    } /* else if */
+    if (result != BDI_OKAY) {
+      if ((op->command == BDI_LDR_ISP_PROGRAM_UES) || (op->command == BDI_LDR_ISP_READ_UES)) {
+        printf("\nUES failed (%i)", result);
+      } /* if */
+      else {
+        printf("\nRow %i failed (%i)", op->row, result);
+      } /* else */
+      continue;
+    } /* if */
+
+    /* row timing */
+    now = BDI_GetMicroseconds();
+    timing = NULL;
+    if      (op->command == BDI_LDR_ISP_PROGRAM_LINE) timing = program;
+    else if (op->command == BDI_LDR_ISP_READ_LINE)    timing = verify;
+    if (timing != NULL) {
+      timing->count++;
+      timing->total += now - lastTime;
+      if ((now - lastTime) > timing->max) {
+        timing->max    = now - lastTime;
+        timing->maxRow = op->row;
+      } /* if */
+      putchar('.');
+      fflush(stdout);
+    } /* if */
+    lastTime = now;
+  } /* while */
+
+  return result;
+} /* ISP_ProgramSequence */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ Report the row timing of a CPLD update
+
+  INPUT:  szName      the kind of commands
+          timing      the timing
+  OUTPUT: -
+
+ ****************************************************************************/
+
+static void ISP_PrintTiming(const char* szName, const ISP_TimingT* timing)
+{
+  DWORD   average;
+
+  if (timing->count == 0) return;
+  average = timing->total / timing->count;
+  printf("Row %s: %i rows, %lu.%03lu ms per row, max %lu.%03lu ms (row %i)\n",
+         szName, timing->count,
+         average / 1000, average % 1000,
+         timing->max / 1000, timing->max % 1000, timing->maxRow);
+} /* ISP_PrintTiming */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ Update logic
+ The Loader must be activ and waiting for a command
+
+  INPUT:  geometry    the geometry of the CPLD
+          version     the version number
+          fileName    the JEDEC file name
+  OUTPUT: return      error code
+
+ ****************************************************************************/
+
+static int ISP_UpdateLogic(const FUS_GeometryT* geometry, WORD version, const char* fileName)
+{
+  int         result;
+  FUS_UEST    ues;
+  ISP_TimingT program;
+  ISP_TimingT verify;
+
+  /* build UES */
+  FUS_BuildUES(geometry, version, ues);
+
+  /* load fuse map */
+  result = ISP_LoadFuseMap(geometry, fileName);
+
+  /* enable ISP mode */
+  if (result == BDI_OKAY) {
+    result = ISP_Enable();
+  } /* if */
+
+  /* program and verify fuse map and UES */
+  if (result == BDI_OKAY) {
+    result = ISP_ProgramSequence(geometry, ues, &program, &verify);
+  } /* if */
+
+  /* disable ISP mode */
+  if (result == BDI_OKAY) result = ISP_Disable();
+  else                    (void)ISP_Disable();
+
+  if (result == BDI_OKAY) {
+    printf("\nProgramming CPLD passed\n");
+    ISP_PrintTiming("program", &program);
+    ISP_PrintTiming("verify", &verify);
+  } /* if */
+  else {
+    printf("\nProgramming CPLD failed\n");
+  } /* else */
+
+  return result;
+} /* ISP_UpdateLogic */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ Compare the CPLD with the JEDEC file
+ The rows are read until the first difference, the UES only if all rows
+ are equal. A device that cannot be read is treated as different. A UES
+ that needs a cleared bit set again can only be changed with a bulk
+ erase, the device is then treated as different too.
+ The Loader must be activ and waiting for a command
+
+  INPUT:  geometry    the geometry of the CPLD
+          version     the version number
+          fileName    the JEDEC file name
+  OUTPUT: match       ISP_MATCH_NONE, ISP_MATCH_ROWS or ISP_MATCH_ALL
+          return      error code
+
+ ****************************************************************************/
+
+static int ISP_CheckLogic(const FUS_GeometryT* geometry,
+                          WORD                 version,
+                          const char*          fileName,
+                          int*                 match)
+{
+  int       result;
+  int       row;
+  BOOL      equal;
+  BYTE      deviceId;
+  FUS_UEST  ues;
+  FUS_UEST  deviceUES;
+  FUS_RowT  rowProg;
+  FUS_RowT  rowErase;
+
+  *match = ISP_MATCH_NONE;
+  FUS_BuildUES(geometry, version, ues);
+
+  /* load fuse map */
+  result = ISP_LoadFuseMap(geometry, fileName);
+  if (result != BDI_OKAY) return result;
+
+  /* enable ISP mode, the device must be the expected one */
+  result = ISP_Enable();
+  if (result == BDI_OKAY) result = ISP_GetDeviceId(&deviceId);
+  equal = (result == BDI_OKAY) && (deviceId == geometry->deviceId);
+
+  /* compare rows */
+  for (row = 0; equal && (row < geometry->rows); row++) {
+    result = ISP_ReadArrayLine(row, geometry->rowBits, rowProg, rowErase);
+    equal  = (    (result == BDI_OKAY)
+               && FUS_Equal(fuseMap.row[row], rowProg, geometry->rowBits)
+               && FUS_Equal(fuseMap.row[row], rowErase, geometry->rowBits));
+  } /* for */
+  if (result == BDI_ERR_LOGIC_VERIFY) result = BDI_OKAY;
+
+  /* compare UES */
+  if (equal) {
+    *match = ISP_MATCH_ROWS;
+    result = ISP_ReadUES(geometry->uesBits, deviceUES);
+    if (result == BDI_ERR_LOGIC_VERIFY) result = BDI_OKAY;
+    else if ((result == BDI_OKAY) && FUS_Equal(deviceUES, ues, geometry->uesBits)) {
+      *match = ISP_MATCH_ALL;
+    } /* else if */
+    else if ((result == BDI_OKAY) && !FUS_Subset(deviceUES, ues, geometry->uesBits)) {
+      *match = ISP_MATCH_NONE;
+    } /* else if */
+  } /* if */
+
+  /* disable ISP mode */
+  if (result == BDI_OKAY) result = ISP_Disable();
+  else                    (void)ISP_Disable();
+  return result;
+} /* ISP_CheckLogic */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ Update only the UES of a CPLD whose rows are already up to date
+ The Loader must be activ and waiting for a command
+
+  INPUT:  geometry    the geometry of the CPLD
+          version     the version number
+  OUTPUT: return      error code
+
+ ****************************************************************************/
+
+static int ISP_UpdateUES(const FUS_GeometryT* geometry, WORD version)
+{
+  int       result;
+  FUS_UEST  ues;
+  FUS_UEST  deviceUES;
+
+  FUS_BuildUES(geometry, version, ues);
+  result = ISP_Enable();
+  if (result == BDI_OKAY) result = ISP_ProgramUES(geometry->uesBits, ues);
+  if (result == BDI_OKAY) {
+    result = ISP_ReadUES(geometry->uesBits, deviceUES);
+    if ((result == BDI_OKAY) && !FUS_Equal(deviceUES, ues, geometry->uesBits)) {
+      result = BDI_ERR_LOGIC_VERIFY;
+    } /* if */
+  } /* if */
+  if (result == BDI_OKAY) result = ISP_Disable();
+  else                    (void)ISP_Disable();
+
+  if (result == BDI_OKAY) {
+    printf("Programming CPLD UES passed\n");
+  } /* if */
+  else {
+    printf("Programming CPLD UES failed\n");
+  } /* else */
+
+  return result;
+} /* ISP_UpdateUES */
+
+
+/****************************************************************************
+ ****************************************************************************
+                Update planning functions
+ ****************************************************************************
+ ****************************************************************************/
+
+/****************************************************************************
+ ****************************************************************************
+
+ Schedule the loader commands of an update (dry run)
+ The commands and the expected answers are built exactly as the update
+ functions above build them, but they are only added to the plan.
+
+  INPUT:  plan            the plan
+          ...             the command parameters
+  OUTPUT: return          error code
+
+ ****************************************************************************/
+
+static int BDI_ScheduleErase(PLN_PlanT* plan, const BDI_LayoutT* layout, DWORD addr)
+{
+  int   result;
+  BYTE  cmd[5];
+  BYTE  ans[2];
+  DWORD sectorAddr;
+  DWORD sectorSize;
+  DWORD eraseTime;
+  DWORD pollTime;
+
+  if (!BDI_FindSector(layout, addr, &sectorAddr, &sectorSize)) sectorSize = 0;
+  eraseTime = PLN_TIME_ERASE + (sectorSize / 1024) * PLN_TIME_ERASE_KB;
+  if (!BDI_AsyncErase()) {
+    (void)BDI_AppendLong(addr, BDI_AppendByte(BDI_LDR_ERASE_FLASH, cmd));
+    (void)BDI_AppendByte(0, BDI_AppendByte(BDI_LDR_ERASE_FLASH, ans));
+    return PLN_Add(plan, "erase", addr, 0, sizeof cmd, cmd, sizeof ans, ans, eraseTime);
+  } /* if */
+
+  /* start the erase and poll its state until done */
+  (void)BDI_AppendLong(addr, BDI_AppendByte(BDI_PRO_START_ERASE, cmd));
+  (void)BDI_AppendByte(0, BDI_AppendByte(BDI_PRO_START_ERASE, ans));
+  result   = PLN_Add(plan, "erase_start", addr, 0, sizeof cmd, cmd, sizeof ans, ans, 0);
+  pollTime = 1000L * BDI_ERASE_POLL_TIME;
+  cmd[0]   = BDI_PRO_GET_ERASE_STATE;
+  ans[0]   = BDI_PRO_GET_ERASE_STATE;
+  ans[1]   = BDI_ERASE_STATE_BUSY;
+  do {
+    if (eraseTime <= pollTime + plan->latency) ans[1] = BDI_ERASE_STATE_DONE;
+    if (result == BDI_OKAY) result = PLN_Add(plan, "erase_poll", addr, 0, 1, cmd, sizeof ans, ans, pollTime);
+    eraseTime -= (eraseTime < pollTime + plan->latency) ? eraseTime : (pollTime + plan->latency);
+  } while ((eraseTime > 0) && (result == BDI_OKAY));
+  return result;
+} /* BDI_ScheduleErase */
+
+
+static int BDI_ScheduleProgram(PLN_PlanT*         plan,
+                               const char*        szOp,
+                               const BDI_LayoutT* layout,
+                               DWORD              addr,
+                               WORD               count,
+                               const BYTE*        data)
+{
+  BYTE  ans[6];
+  BYTE* cmdPtr;
+
+  /* the BDI-HS counts words */
+  cmdPtr = BDI_AppendByte(BDI_LDR_PROGRAM_FLASH, cmdBuffer);
+  cmdPtr = BDI_AppendLong(addr, cmdPtr);
+  cmdPtr = BDI_AppendWord((layout->programFlash == BHS_ProgramFlash) ? (WORD)(count / 2) : count, cmdPtr);
+  (void)memcpy(cmdPtr, data, count);
+  (void)memset(ans, 0, sizeof ans);
+  ans[0] = BDI_LDR_PROGRAM_FLASH;
+  return PLN_Add(plan, szOp, addr, count, 7 + count, cmdBuffer, sizeof ans, ans,
+                 (count * PLN_TIME_PROGRAM_KB) / 1024);
+} /* BDI_ScheduleProgram */
+
+
+static int BDI_ScheduleRead(PLN_PlanT*  plan,
+                            const char* szOp,
+                            DWORD       addr,
+                            DWORD       count,
+                            const BYTE* data)
+{
+  int   result;
+  WORD  readCount;
+  BYTE  cmd[7];
+
+  /* read in maximal blocks, the answer holds the expected data */
+  result = BDI_OKAY;
+  while ((count > 0) && (result == BDI_OKAY)) {
+    readCount = BDI_MAX_BLOCK_SIZE;
+    if (count < readCount) readCount = (WORD)count;
+    (void)BDI_AppendWord(readCount, BDI_AppendLong(addr, BDI_AppendByte(BDI_LDR_READ_MEMORY, cmd)));
+    (void)memcpy(ansBuffer, cmd, sizeof cmd);
+    (void)memcpy(ansBuffer + 7, data, readCount);
+    result = PLN_Add(plan, szOp, addr, readCount, sizeof cmd, cmd, 7 + readCount, ansBuffer, PLN_TIME_READ);
+    addr  += readCount;
+    data  += readCount;
+    count -= readCount;
+  } /* while */
+  return result;
+} /* BDI_ScheduleRead */
+
+
+/* an image in whole blocks, programmed or read up to size */
+static int BDI_ScheduleStream(PLN_PlanT*         plan,
+                              const char*        szOp,
+                              const BDI_LayoutT* layout,
+                              DWORD              addr,
+                              CNF_StreamT*       stream,
+                              DWORD              size)
+{
+  int     result;
+  int     count;
+  DWORD   offset;
+
+  result = BDI_OKAY;
+  CNF_Rewind(stream);
+  for (offset = 0; (offset < size) && (result == BDI_OKAY); offset += BDI_MAX_BLOCK_SIZE) {
+    count = CNF_ReadBlock(stream, blockBuffer);
+    if (count < 0) {
+      result = count;
+    } /* if */
+    else if (strcmp(szOp, "program") == 0) {
+      result = BDI_ScheduleProgram(plan, szOp, layout, addr + offset, BDI_MAX_BLOCK_SIZE, blockBuffer);
+    } /* else if */
+    else {
+      result = BDI_ScheduleRead(plan, szOp, addr + offset, BDI_MAX_BLOCK_SIZE, blockBuffer);
+    } /* else */
+  } /* for */
+  return result;
+} /* BDI_ScheduleStream */
+
+
+static int BDI_ScheduleIsp(PLN_PlanT*  plan,
+                           const char* szOp,
+                           BYTE        command,
+                           int         param,
+                           const char* szData,
+                           int         ansData,
+                           DWORD       execTime)
+{
+  BYTE  cmd[2 + 2 * FUS_MAX_ROW_BITS];
+  BYTE  ans[1 + 2 * FUS_MAX_ROW_BITS];
+  int   cmdLength;
+  int   i;
+
+  /* command, optional parameter byte and ASCII bits */
+  cmdLength = 0;
+  cmd[cmdLength++] = command;
+  if (param >= 0) cmd[cmdLength++] = (BYTE)param;
+  while ((szData != NULL) && (*szData != 0)) cmd[cmdLength++] = (BYTE)(*szData++);
+
+  /* answer code and ASCII bits read back */
+  ans[0] = command;
+  for (i = 1; i <= ansData; i++) ans[i] = '0';
+  return PLN_Add(plan, szOp, (param >= 0) ? (DWORD)param : 0, (DWORD)(cmdLength - 1 + ansData),
+                 cmdLength, cmd, 1 + ansData, ans, execTime);
+} /* BDI_ScheduleIsp */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ Schedule a firmware update, see BDI_UpdateFirmware
+
+  INPUT:  plan            the plan
+          layout          the flash layout of the connected BDI
+          fileName        the S-Record file name
+  OUTPUT: return          error code
+
+ ****************************************************************************/
+
+static int BDI_ScheduleFirmware(PLN_PlanT* plan, const BDI_LayoutT* layout, const char* fileName)
+{
+  int           result;
+  int           i;
+  IMG_ImageT    image;
+  BDI_PlanT     flashPlan;
+
+  result = BDI_LoadFirmware(fileName, &image);
+  if (result != BDI_OKAY) return result;
+  result = BDI_PlanFirmware(layout, &image, &flashPlan);
+  if (result != BDI_OKAY) {
+    IMG_Free(&image);
+    return result;
+  } /* if */
+
+  for (i = 0; (i < flashPlan.eraseCount) && (result == BDI_OKAY); i++) {
+    result = BDI_ScheduleErase(plan, layout, flashPlan.erase[i]);
+  } /* for */
+  for (i = 0; (i < flashPlan.blockCount) && (result == BDI_OKAY); i++) {
+    IMG_Read(&image, flashPlan.block[i].addr, flashPlan.block[i].count, blockBuffer);
+    result = BDI_ScheduleProgram(plan, "program", layout,
+                                 flashPlan.block[i].addr, flashPlan.block[i].count, blockBuffer);
+  } /* for */
+  if (verifyFlash && layout->verifyFirmware) {
+    for (i = 0; (i < image.count) && (result == BDI_OKAY); i++) {
+      result = BDI_ScheduleRead(plan, "verify", image.segment[i].addr,
+                                image.segment[i].size, image.segment[i].data);
+    } /* for */
+  } /* if */
+  if ((result == BDI_OKAY) && (layout->checkFirmware != NULL)) {
+    IMG_Read(&image, layout->firmwareAddr, 8 * 4, blockBuffer);
+    result = BDI_ScheduleRead(plan, "check", layout->firmwareAddr, 8 * 4, blockBuffer);
+  } /* if */
+  if (result == BDI_OKAY) {
+    blockBuffer[0] = 0xAA;
+    blockBuffer[1] = 0x55;
+    blockBuffer[2] = 0x55;
+    blockBuffer[3] = 0xAA;
+    result = BDI_ScheduleProgram(plan, "trigger", layout, layout->firmwareAddr, 4, blockBuffer);
+  } /* if */
+
+  BDI_PlanFree(&flashPlan);
+  IMG_Free(&image);
+  return result;
+} /* BDI_ScheduleFirmware */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ Schedule the CPLD check, erase and update, see BDI_ProgramFirmwareLogic
+ and ISP_UpdateLogic. The check is planned as if the CPLD differs from
+ the JEDEC file, an equal CPLD is skipped when the plan is executed.
+
+  INPUT:  plan            the plan
+          bdi             the BDI type
+          version         the logic version number
+          fileName        the JEDEC file name
+  OUTPUT: return          error code
+
+ ****************************************************************************/
+
+static int BDI_ScheduleLogicCheck(PLN_PlanT* plan, WORD bdi)
+{
+  int   result;
+
+  /* a CPLD to update differs usually in the first row */
+  result = BDI_ScheduleIsp(plan, "isp_enable", BDI_LDR_ISP_ENABLE, 1, NULL, 0, PLN_TIME_ISP);
+  if (result == BDI_OKAY) {
+    result = BDI_ScheduleIsp(plan, "isp_read_id", BDI_LDR_ISP_READ_ID, -1, NULL, 1, PLN_TIME_ISP);
+  } /* if */
+  if ((result == BDI_OKAY) && (ISP_GetGeometry(bdi) != NULL)) {
+    result = BDI_ScheduleIsp(plan, "isp_check_row", BDI_LDR_ISP_READ_LINE, 0,
+                             NULL, 2 * ISP_GetGeometry(bdi)->rowBits, PLN_TIME_ISP_READ);
+  } /* if */
+  if (result == BDI_OKAY) {
+    result = BDI_ScheduleIsp(plan, "isp_disable", BDI_LDR_ISP_ENABLE, 0, NULL, 0, PLN_TIME_ISP);
+  } /* if */
+  return result;
+} /* BDI_ScheduleLogicCheck */
+
+
+static int BDI_ScheduleLogicErase(PLN_PlanT* plan)
+{
+  int   result;
+
+  result = BDI_ScheduleIsp(plan, "isp_enable", BDI_LDR_ISP_ENABLE, 1, NULL, 0, PLN_TIME_ISP);
+  if (result == BDI_OKAY) {
+    result = BDI_ScheduleIsp(plan, "isp_read_id", BDI_LDR_ISP_READ_ID, -1, NULL, 1, PLN_TIME_ISP);
+  } /* if */
+  if (result == BDI_OKAY) {
+    result = BDI_ScheduleIsp(plan, "isp_erase", BDI_LDR_ISP_ERASE, -1, NULL, 0, PLN_TIME_ISP_ERASE);
+  } /* if */
+  if (result == BDI_OKAY) {
+    result = BDI_ScheduleIsp(plan, "isp_disable", BDI_LDR_ISP_ENABLE, 0, NULL, 0, PLN_TIME_ISP);
+  } /* if */
+  return result;
+} /* BDI_ScheduleLogicErase */
+
+
+static int BDI_ScheduleLogic(PLN_PlanT* plan, WORD bdi, WORD version, const char* fileName)
+{
+  const FUS_GeometryT*  geometry;
+  int                   result;
+  int                   row;
+  int                   lag;
+  FUS_UEST              ues;
+  char                  szUES[FUS_MAX_UES_BITS + 1];
+  char                  szRow[FUS_MAX_ROW_BITS + 1];
+
+  /* build UES and load fuse map */
+  geometry = ISP_GetGeometry(bdi);
+  if (geometry == NULL) return BDI_ERR_LOGIC_DEVICE;
+  FUS_BuildUES(geometry, version, ues);
+  FUS_ToAscii(ues, geometry->uesBits, szUES);
+  result = ISP_LoadFuseMap(geometry, fileName);
+
+  if (result == BDI_OKAY) {
+    result = BDI_ScheduleIsp(plan, "isp_enable", BDI_LDR_ISP_ENABLE, 1, NULL, 0, PLN_TIME_ISP);
+  } /* if */
+  /* same order as ISP_ProgramSequence */
+  lag = BDI_PipeDepth();
+  for (row = 0; (row < geometry->rows + lag) && (result == BDI_OKAY); row++) {
+    if (row < geometry->rows) {
+      FUS_ToAscii(fuseMap.row[row], geometry->rowBits, szRow);
+      result = BDI_ScheduleIsp(plan, "isp_program_row", BDI_LDR_ISP_PROGRAM_LINE, row,
+                               szRow, 0, PLN_TIME_ISP_PROGRAM);
+    } /* if */
+    if ((row >= lag) && (result == BDI_OKAY)) {
+      result = BDI_ScheduleIsp(plan, "isp_verify_row", BDI_LDR_ISP_READ_LINE, row - lag,
+                               NULL, 2 * geometry->rowBits, PLN_TIME_ISP_READ);
+    } /* if */
+  } /* for */
+  if (result == BDI_OKAY) {
+    result = BDI_ScheduleIsp(plan, "isp_program_ues", BDI_LDR_ISP_PROGRAM_UES, -1,
+                             szUES, 0, PLN_TIME_ISP_PROGRAM);
+  } /* if */
+  if (result == BDI_OKAY) {
+    result = BDI_ScheduleIsp(plan, "isp_verify_ues", BDI_LDR_ISP_READ_UES, -1,
+                             NULL, geometry->uesBits, PLN_TIME_ISP);
+  } /* if */
+  if (result == BDI_OKAY) {
+    result = BDI_ScheduleIsp(plan, "isp_disable", BDI_LDR_ISP_ENABLE, 0, NULL, 0, PLN_TIME_ISP);
+  } /* if */
+  return result;
+} /* BDI_ScheduleLogic */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ Keep standard output for a plan
+ A plan written to standard output would be mixed with the progress
+ messages, so the messages are moved to standard error.
+
+  INPUT:  -
+  OUTPUT: -
+
+ ****************************************************************************/
+
+static void BDI_PlanToStdout(void)
+{
+  int   fd;
+
+  fflush(stdout);
+  fd = dup(fileno(stdout));
+  if (fd < 0) return;
+  planStdout = fdopen(fd, "w");
+  (void)dup2(fileno(stderr), fileno(stdout));
+} /* BDI_PlanToStdout */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ Open the plan output and measure the link
+
+  INPUT:  plan            the plan
+  OUTPUT: return          the output file or NULL if error
+
+ ****************************************************************************/
+
+static FILE* BDI_OpenPlan(PLN_PlanT* plan)
+{
+  BYTE  cmd[1];
+
+  PLN_Init(plan);
+  cmd[0] = BDI_LDR_READ_VERSION;
+  if (PLN_MeasureLink(plan, sizeof cmd, cmd) != BDI_OKAY) return NULL;
+  if (szPlanFile[0] != 0) return fopen(szPlanFile, "w");
+  return planStdout;
+} /* BDI_OpenPlan */
+
+
+static int BDI_ClosePlan(FILE* file, const PLN_PlanT* plan, int result)
+{
+  if (result == BDI_OKAY) {
+    PLN_WriteSteps(file, plan);
+    fprintf(file, "}\n");
+  } /* if */
+  if ((fclose(file) != 0) && (result == BDI_OKAY)) result = BDI_ERR_FILE_ACCESS;
+  if ((result != BDI_OKAY) && (szPlanFile[0] != 0)) (void)remove(szPlanFile);
+  return result;
+} /* BDI_ClosePlan */
+
+
+static void BDI_WritePlanHeader(FILE*               file,
+                                const char*         szCommand,
+                                const char*         szPort,
+                                DWORD               baudrate,
+                                const BDI_VersionT* version)
+{
+  fprintf(file, "{\n");
+  fprintf(file, "  \"format\": %u,\n", PLN_FORMAT);
+  PLN_WriteString(file, "command", szCommand);
+  PLN_WriteString(file, "port", szPort);
+  fprintf(file, "  \"baudrate\": %lu,\n", baudrate);
+  fprintf(file, "  \"bdi\": %u,\n", version->bdi);
+  PLN_WriteString(file, "serial", version->sn);
+  fprintf(file, "  \"verify\": %s,\n", verifyFlash ? "true" : "false");
+} /* BDI_WritePlanHeader */
+
+
+static void BDI_WritePlanFile(FILE* file, const char* szKey, const char* szFileName)
+{
+  unsigned long long  hash;
+  char                szHashKey[32];
+  char                szHash[16 + 1];
+
+  PLN_WriteString(file, szKey, szFileName);
+  if (!CCH_HashFile(szFileName, &hash)) return;
+  sprintf(szHashKey, "%s_hash", szKey);
+  sprintf(szHash, "%016llx", hash);
+  PLN_WriteString(file, szHashKey, szHash);
+} /* BDI_WritePlanFile */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ Write the plan of a firmware/logic update
+ The decisions which parts to update are already taken, the plan
+ records them together with the selected files.
+
+  INPUT:  szPort          the communication port
+          baudrate        the baudrate for the port
+          version         the versions of the connected BDI
+          szFirmwareName  the firmware file
+          szLogicName     the JEDEC file
+          logicVersion    the logic version number to program
+          updateFirmware  TRUE to update the firmware
+          updateLogic     TRUE to update the logic
+  OUTPUT: return          error code
+
+ ****************************************************************************/
+
+static int BDI_PlanFirmwareLogic(const char*         szPort,
+                                 DWORD               baudrate,
+                                 const BDI_VersionT* version,
+                                 const char*         szFirmwareName,
+                                 const char*         szLogicName,
+                                 WORD                logicVersion,
+                                 BOOL                updateFirmware,
+                                 BOOL                updateLogic)
+{
+  int       result;
+  PLN_PlanT plan;
+  FILE*     file;
+
+  file = BDI_OpenPlan(&plan);
+  if (file == NULL) return BDI_ERR_FILE_ACCESS;
+
+  BDI_WritePlanHeader(file, "update", szPort, baudrate, version);
+  fprintf(file, "  \"update_firmware\": %s,\n", updateFirmware ? "true" : "false");
+  if (updateFirmware) BDI_WritePlanFile(file, "firmware", szFirmwareName);
+  fprintf(file, "  \"update_logic\": %s,\n", updateLogic ? "true" : "false");
+  if (updateLogic) {
+    BDI_WritePlanFile(file, "logic", szLogicName);
+    fprintf(file, "  \"logic_version\": %u,\n", logicVersion);
+  } /* if */
+
+  /* same order as the update */
+  result = BDI_OKAY;
+  if (updateLogic) result = BDI_ScheduleLogicCheck(&plan, version->bdi);
+  if (updateLogic && (result == BDI_OKAY)) result = BDI_ScheduleLogicErase(&plan);
+  if (updateFirmware && (result == BDI_OKAY)) {
+    result = BDI_ScheduleFirmware(&plan, BDI_GetLayout(version->bdi), szFirmwareName);
+  } /* if */
+  if (updateLogic && (result == BDI_OKAY)) {
+    result = BDI_ScheduleLogic(&plan, version->bdi, logicVersion, szLogicName);
+  } /* if */
+
+  result = BDI_ClosePlan(file, &plan, result);
+  if (result == BDI_OKAY) {
+    printf("Plan with %i transactions written\n", plan.count);
+  } /* if */
+  PLN_Free(&plan);
+  return result;
+} /* BDI_PlanFirmwareLogic */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ Write the plan of a network configuration, see BDI_UpdateConfig
+
+  INPUT:  szPort          the communication port
+          baudrate        the baudrate for the port
+          version         the versions of the connected BDI
+          layout          the flash layout of the connected BDI
+          ...             the configuration parameters
+  OUTPUT: return          error code
+
+ ****************************************************************************/
+
+static int BDI_PlanConfig(const char*         szPort,
+                          DWORD               baudrate,
+                          const BDI_VersionT* version,
+                          const BDI_LayoutT*  layout,
+                          const char*         szHostIP,
+                          const char*         szBdiIP,
+                          const char*         szSubnetMask,
+                          const char*         szDefaultGateway,
+                          const char*         szSetupFileName)
+{
+  int       result;
+  PLN_PlanT plan;
+  FILE*     file;
+  BYTE      configData[BDI_NETWORK_CONFIG_SIZE];
+  DWORD     configSector;
+  DWORD     regdefSector;
+  DWORD     sectorSize;
+  int       changed;
+  BOOL      withConfig;
+  BDI_ConfigImagesT images;
+
+  file = BDI_OpenPlan(&plan);
+  if (file == NULL) return BDI_ERR_FILE_ACCESS;
+
+  BDI_WritePlanHeader(file, "config", szPort, baudrate, version);
+  PLN_WriteString(file, "host", szHostIP);
+  PLN_WriteString(file, "ip", szBdiIP);
+  PLN_WriteString(file, "mask", szSubnetMask);
+  PLN_WriteString(file, "gateway", szDefaultGateway);
+  BDI_WritePlanFile(file, "config_file", szSetupFileName);
+  fprintf(file, "  \"strip\": %s,\n", stripConfig ? "true" : "false");
+
+  /* build the data, compare it with the BDI flash now */
+  BDI_BuildNetworkConfig(version, szHostIP, szBdiIP, szSubnetMask, szDefaultGateway,
+                         szSetupFileName, configData);
+  withConfig = (BDI_IPAddrMotorola(szHostIP) == INADDR_NONE) && (strlen(szSetupFileName) > 0);
+  (void)memset(&images, 0, sizeof images);
+  result = BDI_OKAY;
+  if (withConfig) {
+    if (   (layout->configAddr == 0)
+        || !BDI_FindSector(layout, layout->configAddr, &configSector, &sectorSize)
+        || !BDI_FindSector(layout, layout->regdefAddr, &regdefSector, &sectorSize)) {
+      result = BDI_ERR_INVALID_PARAMETER;
+    } /* if */
+    if (result == BDI_OKAY) result = BDI_OpenConfigImages(szSetupFileName, NULL, &images);
+  } /* if */
+  if (result == BDI_OKAY) {
+    result = BDI_FindConfigChanges(layout, configData, withConfig ? &images : NULL, &changed);
+  } /* if */
+  if (result == BDI_OKAY) BDI_PrintConfigChanges(changed, withConfig);
+
+  /* the comparison, stops at the first difference when executed */
+  if (result == BDI_OKAY) {
+    result = BDI_ScheduleRead(&plan, "compare", layout->networkAddr, sizeof configData, configData);
+  } /* if */
+  if ((result == BDI_OKAY) && withConfig) {
+    result = BDI_ScheduleStream(&plan, "compare", layout, layout->configAddr, &images.romConfig,
+                                CNF_IMAGE_SIZE(images.romConfig.size));
+  } /* if */
+  if ((result == BDI_OKAY) && withConfig) {
+    result = BDI_ScheduleStream(&plan, "compare", layout, layout->regdefAddr, &images.romRegdef,
+                                CNF_IMAGE_SIZE(images.romRegdef.size));
+  } /* if */
+
+  /* network configuration, always read back */
+  if ((result == BDI_OKAY) && ((changed & BDI_CHANGED_NETWORK) != 0)) {
+    result = BDI_ScheduleErase(&plan, layout, layout->networkAddr);
+    if (result == BDI_OKAY) {
+      result = BDI_ScheduleProgram(&plan, "program", layout, layout->networkAddr,
+                                   sizeof configData, configData);
+    } /* if */
+    if (result == BDI_OKAY) {
+      result = BDI_ScheduleRead(&plan, "verify", layout->networkAddr, sizeof configData, configData);
+    } /* if */
+  } /* if */
+
+  /* configuration and register definitions, whole blocks are programmed */
+  if ((result == BDI_OKAY) && ((changed & BDI_CHANGED_CONFIG) != 0)) {
+    result = BDI_ScheduleErase(&plan, layout, configSector);
+    if (result == BDI_OKAY) {
+      result = BDI_ScheduleStream(&plan, "program", layout, layout->configAddr, &images.romConfig,
+                                  images.romConfig.size);
+    } /* if */
+    if ((result == BDI_OKAY) && verifyFlash) {
+      result = BDI_ScheduleStream(&plan, "verify", layout, layout->configAddr, &images.romConfig,
+                                  images.romConfig.size);
+    } /* if */
+  } /* if */
+  if ((result == BDI_OKAY) && ((changed & BDI_CHANGED_REGDEF) != 0)) {
+    if (regdefSector != configSector) result = BDI_ScheduleErase(&plan, layout, regdefSector);
+    if (result == BDI_OKAY) {
+      result = BDI_ScheduleStream(&plan, "program", layout, layout->regdefAddr, &images.romRegdef,
+                                  images.romRegdef.size);
+    } /* if */
+    if ((result == BDI_OKAY) && verifyFlash) {
+      result = BDI_ScheduleStream(&plan, "verify", layout, layout->regdefAddr, &images.romRegdef,
+                                  images.romRegdef.size);
+    } /* if */
+  } /* if */
+
+  BDI_CloseConfigImages(&images);
+  result = BDI_ClosePlan(file, &plan, result);
+  if (result == BDI_OKAY) {
+    printf("Plan with %i transactions written\n", plan.count);
+  } /* if */
+  PLN_Free(&plan);
+  return result;
+} /* BDI_PlanConfig */
+
+
+/****************************************************************************
+ ****************************************************************************
+                helper functions
+ ****************************************************************************
+ ****************************************************************************/
+
+/****************************************************************************
+ ****************************************************************************
+
+    B30_VerifyLoaderCode :
+
+    Check if illegal data is stored in the flash
+
+    INPUT:  -
+    OUTPUT: return        error code
+
+ ****************************************************************************/
+
+static BOOL AllErased(WORD count, const BYTE* data)
+{
+  while (count--) {
+    if (*data != 0xFF) return FALSE;
+    data++;
+  } /* while */
+  return TRUE;
+} /* AllErased */
+
+static int B30_VerifyLoaderCode(void)
+{
+  DWORD addr;
+  WORD  crc;
+
+  /* check unused part of boot sector */
+  addr = 0x00000510;
+  while (addr < 0x2000) {
+    (void)BDI_ReadMemory(addr, BDI_MAX_BLOCK_SIZE, blockBuffer);
+    if (!AllErased(BDI_MAX_BLOCK_SIZE, blockBuffer)) return BDI_ERR_VERIFY;
+    addr += BDI_MAX_BLOCK_SIZE;
+  } /* while */
+
+  /* check unused part of loader sector */
+  (void)BDI_ReadMemory(0x10000, BDI_MAX_BLOCK_SIZE, blockBuffer);
+  (void)BDI_ExtractLong(&addr, (blockBuffer + 12));
+  addr = 0x10040 + (4 * addr);
+  while (addr < 0x30000) {
+    (void)BDI_ReadMemory(addr, BDI_MAX_BLOCK_SIZE, blockBuffer);
+    if (!AllErased(BDI_MAX_BLOCK_SIZE, blockBuffer)) return BDI_ERR_VERIFY;
+    addr += BDI_MAX_BLOCK_SIZE;
+  } /* while */
+
+  /* calculate crc16 over boot/loader sectors */
+  crc  = 0;
+  addr = 0x00000000;
+  while (addr < 0x30000) {
+    (void)BDI_ReadMemory(addr, BDI_MAX_BLOCK_SIZE, blockBuffer);
+    if (addr == 0x00000000) {
+      (void)memset(blockBuffer + 0x20, 0, 8); /* serial number */
+    } /* if */
+    crc = CRC_Accumulate(crc, blockBuffer, BDI_MAX_BLOCK_SIZE);
+    addr += BDI_MAX_BLOCK_SIZE;
+  } /* while */
+  printf("CRC over boot/loader sectors is %i\n", crc);
+
+  return BDI_OKAY;
+} /* B30_VerifyLoaderCode */
+
+
+/****************************************************************************
+ ****************************************************************************
+                main functions
+ ****************************************************************************
+ ****************************************************************************/
+
+/****************************************************************************
+ ****************************************************************************
+
+  BDI_ExitLoader :
+
+  Transfer the exit loader command
+
+  INPUT:  -
+  OUTPUT: return        error code
+
+ ****************************************************************************/
+
+
+static int BDI_ExitLoader()
+{
+  BYTE     *cmdPtr;
+  int       rxCount;
+
+  /* prepare command */
+  cmdPtr = BDI_AppendByte(BDI_LDR_EXIT_LOADER, cmdBuffer);
+
+  /* BDI transaction */
+  rxCount = BDI_Transaction(cmdPtr-cmdBuffer, cmdBuffer, sizeof ansBuffer, ansBuffer, 200);
+  if (rxCount < 0) return rxCount;
+
+  return BDI_OKAY;
+} /* BDI_ExitLoader */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    BDI_ConnectLoader :
+
+    Connects to the Loader an get the current versions
+
+     INPUT  : szPort          the communication port (e.g. "/dev/tty1")
+     OUTPUT : bdiType         the BDI type
+              loaderVersion   the current loader version
+              firmwareVersion the current firmware version
+              logicVersion    the current logic version
+              RETURN          0 if okay or a negativ number if error
+
+ ****************************************************************************/
+
+static int BDI_ConnectLoader(const char* szPort, DWORD baudrate, BDI_VersionT *pVersion)
+{
+  BYTE *cmdPtr;
+  BYTE *ansPtr;
+  int   rxCount;
+  BYTE  answer;
+  int   result;
+  int   i;
+
+  /* connect to BDI */
+  result = BDI_OKAY;
+  asyncErase = -1;
+  for (i = 0; i < 3; i++) {
+    result = BDI_Open(szPort, baudrate);
+    if ((result == BDI_OKAY) || (result == BDI_ASYN_SETUP)) break;
+  } /* for */
+  if (result != BDI_OKAY) return result;
 
   /* send start loader command */
   cmdPtr  = BDI_AppendByte(BDI_LDR_START_LOADER, cmdBuffer);
@@ -2271,89 +3646,894 @@ static int BDI_ConnectLoader(const char* szPort, DWORD baudrate, BDI_VersionT *p
     return rxCount;
   } /* if */
 
-  /* delay and connect again if loader not alredy activ */
-  if (*ansBuffer == BDI_LDR_START_LOADER) {
-    BDI_Close();
-    BDI_DoDelay(1000);
-    result = BDI_Open(szPort, baudrate);
-    if (result != BDI_OKAY) return result;
+  /* delay and connect again if loader not alredy activ */
+  if (*ansBuffer == BDI_LDR_START_LOADER) {
+    BDI_Close();
+    BDI_DoDelay(1000);
+    result = BDI_Open(szPort, baudrate);
+    if (result != BDI_OKAY) return result;
+  } /* if */
+
+  /* read version */
+  cmdPtr  = BDI_AppendByte(BDI_LDR_READ_VERSION, cmdBuffer);
+  rxCount = BDI_Transaction(cmdPtr-cmdBuffer,
+                            cmdBuffer,
+                            sizeof ansBuffer,
+                            ansBuffer, 1000);
+  if (rxCount < 0) {
+    BDI_Close();
+    return rxCount;
+  } /* if */
+
+  /* select BDI type */
+  if ((rxCount == 15) || (rxCount == 17)) {
+    pVersion->bdi = BDI_TYPE_20;
+  } /* if */
+  else if (rxCount == 7) {
+    pVersion->bdi = BDI_TYPE_HS;
+  } /* else if */
+  else if (rxCount == 23) {
+    pVersion->bdi = BDI_TYPE_10;
+  } /* else if */
+  else if (rxCount == 21) {
+    pVersion->bdi = BDI_TYPE_30;
+  } /* else if */
+  else {
+    BDI_Close();
+    return BDI_ERR_UNKNOWN_BDI;
+  } /* else */
+
+  /* analyse response */
+  ansPtr = BDI_ExtractByte(&answer, ansBuffer);
+  if (answer != BDI_LDR_READ_VERSION) {
+    BDI_Close();
+    return BDI_ERR_INVALID_RESPONSE;
+  } /* if */
+  ansPtr = BDI_ExtractWord(&pVersion->loader,   ansPtr);
+  ansPtr = BDI_ExtractWord(&pVersion->firmware, ansPtr);
+  if (pVersion->bdi == BDI_TYPE_30) {
+    pVersion->logic = 0;
+    ansPtr += 4;                /* skip BDI3000 CPLD UES */
+  } /* if */
+  else {
+    ansPtr = BDI_ExtractWord(&pVersion->logic,    ansPtr);
+  } /* else */
+  for (i = 0; i < 8; i++) pVersion->sn[i] = (char)(*ansPtr++);
+  pVersion->sn[8] = 0;
+  if (rxCount == 17) {
+    ansPtr++;   /* skip '-' */
+    if (*ansPtr == 'C') pVersion->bdi = BDI_TYPE_21;
+  } /* if */
+
+  /* an executed plan is only valid for the same BDI type */
+  if ((planBdi >= 0) && (pVersion->bdi != (WORD)planBdi)) {
+    printf("### plan was made for another BDI type\n");
+    BDI_Close();
+    return BDI_ERR_INVALID_PARAMETER;
+  } /* if */
+  if ((szPlanSerial[0] != 0) && (strcmp(pVersion->sn, szPlanSerial) != 0)) {
+    printf("Warning: plan was made for BDI %s, connected to BDI %s\n", szPlanSerial, pVersion->sn);
+  } /* if */
+
+  return BDI_OKAY;
+} /* BDI_ConnectLoader */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+  BDI_PrefetchLogic :
+
+  Idle function, loads the fuse map while the firmware flash is erased.
+  Errors are reported when the logic is programmed.
+
+  INPUT:  context       the BDI_PrefetchT
+  OUTPUT: return        FALSE, there is no more work
+
+ ****************************************************************************/
+
+static BOOL BDI_PrefetchLogic(void* context)
+{
+  BDI_PrefetchT*  prefetch;
+
+  prefetch = (BDI_PrefetchT*)context;
+  if (prefetch->done) return FALSE;
+  if (ISP_GetGeometry(prefetch->bdi) != NULL) {
+    (void)ISP_LoadFuseMap(ISP_GetGeometry(prefetch->bdi), prefetch->fileName);
+  } /* if */
+  prefetch->done = TRUE;
+  return FALSE;
+} /* BDI_PrefetchLogic */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+  BDI_ProgramFirmwareLogic :
+
+  Erase the logic, program the firmware and program the logic.
+  A CPLD already equal to the JEDEC file is not erased and programmed,
+  if only the UES differs only the UES is programmed.
+  The Loader must be activ and waiting for a command.
+
+  INPUT:  version         the versions of the connected BDI
+          szFirmwareName  the firmware file
+          szLogicName     the JEDEC file
+          logicVersion    the logic version number to program
+          updateFirmware  TRUE to update the firmware
+          updateLogic     TRUE to update the logic
+  OUTPUT: return          error code
+
+ ****************************************************************************/
+
+static int BDI_ProgramFirmwareLogic(const BDI_VersionT* version,
+                                    const char*         szFirmwareName,
+                                    const char*         szLogicName,
+                                    WORD                logicVersion,
+                                    BOOL                updateFirmware,
+                                    BOOL                updateLogic)
+{
+  int                   result;
+  int                   match;
+  BOOL                  updateUES;
+  BYTE                  ispDeviceId;
+  BDI_PrefetchT         prefetch;
+  const FUS_GeometryT*  geometry;
+
+  /* compare the logic with the JEDEC file */
+  result    = BDI_OKAY;
+  updateUES = FALSE;
+  geometry  = ISP_GetGeometry(version->bdi);
+  if (updateLogic && (geometry != NULL)) {
+    printf("Checking CPLD\n");
+    result = ISP_CheckLogic(geometry, logicVersion, szLogicName, &match);
+    if (result != BDI_OKAY) {
+      printf("Checking CPLD failed (%i)\n", result);
+    } /* if */
+    else if (match == ISP_MATCH_ALL) {
+      printf("CPLD already matches %s\n", szLogicName);
+      updateLogic = FALSE;
+    } /* else if */
+    else if (match == ISP_MATCH_ROWS) {
+      printf("CPLD matches %s except the UES\n", szLogicName);
+      updateLogic = FALSE;
+      updateUES   = TRUE;
+    } /* else if */
+  } /* if */
+
+  /* first, erase logic */
+  if (updateLogic && (result == BDI_OKAY)) {
+    printf("Erasing CPLD\n");
+    if (result == BDI_OKAY) result = ISP_Enable();
+    if (result == BDI_OKAY) result = ISP_GetDeviceId(&ispDeviceId);
+    if (result == BDI_OKAY) result = ISP_Erase();
+    if (result == BDI_OKAY) result = ISP_Disable();
+    if ((result == BDI_OKAY) && (geometry != NULL) && (ispDeviceId != geometry->deviceId)) {
+      result = BDI_ERR_LOGIC_DEVICE;
+    } /* if */
+    if (result != BDI_OKAY) printf("Erasing CPLD failed (%i)\n", result);
+  } /* if */
+
+  /* update firmware */
+  if (updateFirmware && (result == BDI_OKAY)) {
+    printf("Programming firmware with %s\n", szFirmwareName);
+    prefetch.bdi      = version->bdi;
+    prefetch.fileName = szLogicName;
+    prefetch.done     = !updateLogic;
+    result = BDI_UpdateFirmware(BDI_GetLayout(version->bdi), szFirmwareName, version->sn,
+                                BDI_PrefetchLogic, &prefetch);
+    if (result != BDI_OKAY) printf("Programming firmware failed (%i)\n", result);
+  } /* if */
+
+  /* program logic */
+  if (updateLogic && (result == BDI_OKAY)) {
+    printf("Programming CPLD with %s\n", szLogicName);
+    if (geometry != NULL) result = ISP_UpdateLogic(geometry, logicVersion, szLogicName);
+    if (result != BDI_OKAY) printf("Programming CPLD failed (%i)\n", result);
+  } /* if */
+
+  /* program UES only, a failed UES is recovered with the whole sequence */
+  if (updateUES && (result == BDI_OKAY)) {
+    printf("Programming CPLD UES\n");
+    result = ISP_UpdateUES(geometry, logicVersion);
+    if (result != BDI_OKAY) {
+      printf("Programming CPLD UES failed (%i), erasing and programming CPLD\n", result);
+      result = ISP_Enable();
+      if (result == BDI_OKAY) result = ISP_Erase();
+      if (result == BDI_OKAY) result = ISP_Disable();
+      else                    (void)ISP_Disable();
+      if (result == BDI_OKAY) result = ISP_UpdateLogic(geometry, logicVersion, szLogicName);
+      if (result != BDI_OKAY) printf("Programming CPLD failed (%i)\n", result);
+    } /* if */
+  } /* if */
+
+  if (result == BDI_OKAY) printf("Programming passed\n");
+  return result;
+} /* BDI_ProgramFirmwareLogic */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+  BDI_EraseFirmwareLogic :
+
+  Erase firmware and logic.
+
+  INPUT:  szPort        the communication port (e.g. /dev/tty1 )
+          baudrate      the baudrate for the port
+  OUTPUT: return        error code
+
+ ****************************************************************************/
+
+int BDI_EraseFirmwareLogic(const char* szPort, DWORD baudrate)
+{
+  int                   result;
+  BDI_VersionT          version;
+  BYTE                  ispDeviceId;
+  const FUS_GeometryT*  geometry;
+
+  /* connect to BDI loader and read versions */
+  printf("Connecting to BDI loader\n");
+  result = BDI_ConnectLoader(szPort, baudrate, &version);
+  if (result < 0) {
+    printf("Connecting to BDI loader failed (%i)\n", result);
+    return result;
+  } /* if */
+  if (BDI_GetLayout(version.bdi) == NULL) {
+    BDI_Close();
+    printf("### invalid BDI connected\n");
+    return BDI_ERR_INVALID_PARAMETER;
+  } /* if */
+
+  /* first, erase logic */
+  if ((result == BDI_OKAY) && (version.bdi != BDI_TYPE_30)) {
+    printf("Erasing CPLD\n");
+    if (result == BDI_OKAY) result = ISP_Enable();
+    if (result == BDI_OKAY) result = ISP_GetDeviceId(&ispDeviceId);
+    if (result == BDI_OKAY) result = ISP_Erase();
+    if (result == BDI_OKAY) result = ISP_Disable();
+    if (result == BDI_OKAY) {
+      geometry = ISP_GetGeometry(version.bdi);
+      if ((geometry != NULL) && (ispDeviceId != geometry->deviceId)) result = BDI_ERR_LOGIC_DEVICE;
+    } /* if */
+    if (result != BDI_OKAY) printf("Erasing CPLD failed (%i)\n", result);
+  } /* if */
+
+  /* for security reasons, erase (almost) all sectors */
+  if (result == BDI_OKAY) {
+    printf("Erasing all flash sectors\n");
+    result = BDI_EraseSectors(BDI_GetLayout(version.bdi)->eraseAll);
+
+    /* check for illegal data stored in flash */
+    if ((result == BDI_OKAY) && (version.bdi == BDI_TYPE_30)) {
+      printf("Checking for illegal data in boot/loader sectors\n");
+      result = B30_VerifyLoaderCode();
+      if (result != BDI_OKAY) {
+        printf("Illegal data in boot/loader sectors detected!\n");
+      } /* if */
+    } /* if */
+    if (result != BDI_OKAY) printf("Erasing firmware failed (%i)\n", result);
+  } /* if */
+
+  if (result == BDI_OKAY) printf("Erasing passed\n");
+
+  /* disconnect */
+  BDI_Close();
+  return result;
+} /* BDI_EraseFirmwareLogic */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    BDI_UpdateFirmwareLogic:
+
+     Updates the firmware and the logic of the BDI.
+
+     INPUT  : szPort      the communication port (e.g. /dev/tty1 )
+              baudrate    the baudrate for the port
+              szPath      the directory path to the firmware files
+              targetType  the connected target type (e.g. BDI_FWT_MPC)
+              updateMode  the update mode
+                            BDI_UPDATE_AUTO
+                            BDI_UPDATE_FIRMWARE
+                            BDI_UPDATE_LOGIC
+                            BDI_UPDATE_ALL
+     OUTPUT : RETURN      0 if okay or a negativ number if error.
+
+ ****************************************************************************/
+
+int BDI_UpdateFirmwareLogic(const char* szPort,
+                                  DWORD baudrate,
+                            const char* szPath,
+                                  WORD  targetType,
+                                  WORD  updateMode)
+{
+  int             result;
+  BDI_VersionT    version;
+  WORD            newestFirmware;
+  WORD            newestLogic;
+  char            szFirmwareName[MAXPATHLEN];
+  char            szLogicName[MAXPATHLEN];
+  BOOL            updateFirmware;
+  BOOL            updateLogic;
+  size_t          len;
+  MAN_ManifestT   manifest;
+
+  const BDI_SetupInfoT* setupInfo;
+
+  /* check parameter */
+  if (targetType >= (sizeof B20_SetupInfo / sizeof B20_SetupInfo[0])) {
+    return BDI_ERR_INVALID_PARAMETER;
+  } /* if */
+
+  /* connect to BDI loader and read versions */
+  printf("Connecting to BDI loader\n");
+  result = BDI_ConnectLoader(szPort, baudrate, &version);
+  if (result < 0) {
+    printf("Connecting to BDI loader failed (%i)\n", result);
+    return result;
+  } /* if */
+
+  /* get setup info based on BDI type */
+  if      (version.bdi == BDI_TYPE_HS) setupInfo = &BHS_SetupInfo[targetType];
+  else if (version.bdi == BDI_TYPE_20) setupInfo = &B20_SetupInfo[targetType];
+  else if (version.bdi == BDI_TYPE_21) setupInfo = &B21_SetupInfo[targetType];
+  else if (version.bdi == BDI_TYPE_10) setupInfo = &B10_SetupInfo[targetType];
+  else if (version.bdi == BDI_TYPE_30) setupInfo = &B30_SetupInfo[targetType];
+  else {
+    BDI_Close();
+    return BDI_ERR_INVALID_PARAMETER;
+  } /* else */
+
+  /* check for full qualified BDI3000 firmware file */
+  szFirmwareName[0] = 0;
+  szLogicName[0]    = 0;
+  newestLogic       = 0;
+  len = strlen(szPath);
+  if ((version.bdi == BDI_TYPE_30) && (len >= 12)) {
+    if (    (szPath[len-12] == 'b')
+         && (szPath[len-11] == '3')
+         && (szPath[len-10] == '0')
+         && (szPath[len-4]  == '.')
+        ) {
+      (void)strcpy(szFirmwareName, szPath);
+      updateMode = BDI_UPDATE_FIRMWARE;
+    } /* if */
+  } /* if */
+
+  /* get newest firmware and logic from the directory manifest */
+  if (szFirmwareName[0] == 0) {
+    result = MAN_Open(szPath, &manifest);
+    if (result != BDI_OKAY) {
+      BDI_Close();
+      return result;
+    } /* if */
+    newestFirmware = MAN_GetNewest(&manifest, setupInfo->firmwareName, szFirmwareName);
+    if (version.bdi != BDI_TYPE_30) {
+      newestLogic = MAN_GetNewest(&manifest, setupInfo->logicName, szLogicName);
+    } /* if */
+    MAN_Close(&manifest);
+    if (newestFirmware == 0) {
+      printf("No valid firmware file found in %s\n", szPath);
+      BDI_Close();
+      return BDI_ERR_FIRMWARE_FILE;
+    } /* if */
+    if ((version.bdi != BDI_TYPE_30) && (newestLogic == 0)) {
+      printf("No valid JEDEC file found in %s\n", szPath);
+      BDI_Close();
+      return BDI_ERR_LOGIC_FILE;
+    } /* if */
+  } /* if */
+
+  /* decide if firmware update is neccecary */
+  updateFirmware = ((updateMode == BDI_UPDATE_ALL) || (updateMode == BDI_UPDATE_FIRMWARE));
+  if (!updateFirmware) {
+    updateFirmware = (   ((version.firmware - setupInfo->firmwareType) > BDI_MAX_FW_VERSION)
+                      || ((version.firmware - setupInfo->firmwareType) < newestFirmware) );
+    if (!updateFirmware) printf("Firmware is already up to date\n");
+  } /* if */
+
+  /* decide if logic update is neccecary */
+  updateLogic = FALSE;
+  if (version.bdi != BDI_TYPE_30) {
+    updateLogic = ((updateMode == BDI_UPDATE_ALL) || (updateMode == BDI_UPDATE_LOGIC));
+    if (!updateLogic) {
+      updateLogic = (   ((version.logic - setupInfo->logicType) > BDI_MAX_LOGIC_VERSION)
+                     || ((version.logic - setupInfo->logicType) < newestLogic) );
+      if (!updateLogic) printf("CPLD is already up to date\n");
+    } /* if */
   } /* if */
 
-  /* read version */
-  cmdPtr  = BDI_AppendByte(BDI_LDR_READ_VERSION, cmdBuffer);
-  rxCount = BDI_Transaction(cmdPtr-cmdBuffer,
-                            cmdBuffer,
-                            sizeof ansBuffer,
-                            ansBuffer, 1000);
-  if (rxCount < 0) {
+  /* only plan the update */
+  if (planMode) {
+    result = BDI_PlanFirmwareLogic(szPort, baudrate, &version, szFirmwareName, szLogicName,
+                                   (WORD)(newestLogic + setupInfo->logicType),
+                                   updateFirmware, updateLogic);
+  } /* if */
+  else {
+    result = BDI_ProgramFirmwareLogic(&version, szFirmwareName, szLogicName,
+                                      (WORD)(newestLogic + setupInfo->logicType),
+                                      updateFirmware, updateLogic);
+  } /* else */
+
+  /* disconnect */
+  BDI_Close();
+  return result;
+} /* BDI_UpdateFirmwareLogic */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ BDI_ProgramConfig :
+
+   Transfer the BDI network configuration, the configuration and register
+   definitions are built from the file or taken from a unit of a fleet
+
+  INPUT:  szPort                the communication port (e.g. /dev/tty1 )
+          baudrate              the baudrate for the port
+          szHostIP              the IP address of the host
+          szBdiIP               the IP address of the BDI
+          szSubnetMask      	the subnet mask
+          szDefaultGateway  	the default gateway
+          szSetupFileName       the name of the setup file on the host
+          szSerial              the serial number of the BDI, NULL if any
+          unit                  the built images, NULL to build them
+  OUTPUT: return                error code
+
+ ****************************************************************************/
+
+static int BDI_ProgramConfig(const char* szPort,
+                                   DWORD baudrate,
+                             const char* szHostIP,
+                             const char* szBdiIP,
+                             const char* szSubnetMask,
+                             const char* szDefaultGateway,
+                             const char* szSetupFileName,
+                             const char* szSerial,
+                             const FLT_UnitT* unit)
+{
+  int           result;
+  BDI_VersionT  version;
+  BYTE          configData[BDI_NETWORK_CONFIG_SIZE];
+  BYTE          configReadBack[BDI_NETWORK_CONFIG_SIZE];
+  DWORD         errorAddr;
+  DWORD         networkAddr;
+  const BDI_LayoutT* layout;
+  DWORD         configAddr;
+  DWORD         regdefAddr;
+  DWORD         configSector;
+  DWORD         regdefSector;
+  DWORD         sectorSize;
+
+  WORD          fwType;
+  DWORD         hostIP;
+  int           changed;
+  BOOL          withConfig;
+  BDI_ConfigImagesT images;
+
+  /* connect to BDI loader and read versions */
+  printf("Connecting to BDI loader\n");
+  result = BDI_ConnectLoader(szPort, baudrate, &version);
+  if (result < 0) {
+    printf("Connecting to BDI loader failed (%i)\n", result);
+    return result;
+  } /* if */
+
+  /* the BDI of the unit */
+  if ((szSerial != NULL) && (strcmp(version.sn, szSerial) != 0)) {
     BDI_Close();
-    return rxCount;
+    printf("### BDI %s connected instead of %s\n", version.sn, szSerial);
+    return BDI_ERR_INVALID_PARAMETER;
   } /* if */
 
-  /* select BDI type */
-  if ((rxCount == 15) || (rxCount == 17)) {
-    pVersion->bdi = BDI_TYPE_20;
+  /* get firmware type */
+  if (version.bdi == BDI_TYPE_30) {
+    fwType = version.firmware >> 8;
   } /* if */
-  else if (rxCount == 7) {
-    pVersion->bdi = BDI_TYPE_HS;
-  } /* else if */
-  else if (rxCount == 23) {
-    pVersion->bdi = BDI_TYPE_10;
-  } /* else if */
-  else if (rxCount == 21) {
-    pVersion->bdi = BDI_TYPE_30;
+  else if (version.firmware < 0xC000) {
+    fwType = version.firmware >> 12;
   } /* else if */
   else {
-    BDI_Close();
-    return BDI_ERR_UNKNOWN_BDI;
+    fwType = (version.firmware - 0xC000) >> 8;
   } /* else */
 
-  /* analyse response */
-  ansPtr = BDI_ExtractByte(&answer, ansBuffer);
-  if (answer != BDI_LDR_READ_VERSION) {
+  /* set network configuration addresses */
+  layout = BDI_GetLayout(version.bdi);
+  if ((layout == NULL) || (layout->networkAddr == 0)) {
     BDI_Close();
-    return BDI_ERR_INVALID_RESPONSE;
+    printf("### invalid BDI connected\n");
+    return BDI_ERR_INVALID_PARAMETER;
   } /* if */
-  ansPtr = BDI_ExtractWord(&pVersion->loader,   ansPtr);
-  ansPtr = BDI_ExtractWord(&pVersion->firmware, ansPtr);
-  if (pVersion->bdi == BDI_TYPE_30) {
-    pVersion->logic = 0;
-    ansPtr += 4;                /* skip BDI3000 CPLD UES */
+  networkAddr = layout->networkAddr;
+
+  /* only plan the configuration */
+  if (planMode) {
+    result = BDI_PlanConfig(szPort, baudrate, &version, layout, szHostIP, szBdiIP,
+                            szSubnetMask, szDefaultGateway, szSetupFileName);
+    BDI_Close();
+    return result;
   } /* if */
-  else {
-    ansPtr = BDI_ExtractWord(&pVersion->logic,    ansPtr);
-  } /* else */
-  for (i = 0; i < 8; i++) pVersion->sn[i] = (char)(*ansPtr++);
-  pVersion->sn[8] = 0;
-  if (rxCount == 17) {
-    ansPtr++;   /* skip '-' */
-    if (*ansPtr == 'C') pVersion->bdi = BDI_TYPE_21;
+
+  /* compile the configuration and open the files before any flash is erased */
+  hostIP = BDI_IPAddrMotorola(szHostIP);
+  withConfig = (hostIP == INADDR_NONE) && (strlen(szSetupFileName) > 0);
+  configAddr = layout->configAddr;
+  regdefAddr = layout->regdefAddr;
+  (void)memset(&images, 0, sizeof images);
+  if (withConfig) {
+    if (configAddr == 0) {
+      BDI_Close();
+      printf("### invalid BDI connected\n");
+      return BDI_ERR_INVALID_PARAMETER;
+    } /* if */
+    result = BDI_OpenConfigImages(szSetupFileName, unit, &images);
   } /* if */
 
-  return BDI_OKAY;
-} /* BDI_ConnectLoader */
+  /* build network configuration data */
+  BDI_BuildNetworkConfig(&version, szHostIP, szBdiIP, szSubnetMask, szDefaultGateway,
+                         szSetupFileName, configData);
+
+  /* compare with the BDI flash, only the parts that differ are rewritten */
+  if (result == BDI_OKAY) {
+    result = BDI_FindConfigChanges(layout, configData, withConfig ? &images : NULL, &changed);
+  } /* if */
+  if (result == BDI_OKAY) BDI_PrintConfigChanges(changed, withConfig);
+
+  /* erase configuration flash sector, program and verify network data */
+  if ((result == BDI_OKAY) && ((changed & BDI_CHANGED_NETWORK) != 0)) {
+    printf("Writing network configuration\n");
+    result = BDI_EraseSector(networkAddr);
+    if (result == BDI_OKAY) result = layout->programFlash(networkAddr, sizeof configData, configData, &errorAddr);
+    if (result == BDI_OKAY) result = BDI_ReadMemory(networkAddr, sizeof configReadBack, configReadBack);
+    if (result == BDI_OKAY) {
+      if (memcmp(configData, configReadBack, sizeof configData) != 0) result = BDI_ERR_FLASH_VERIFY;
+    } /* if */
+  } /* if */
+
+  /* program configuration and register definitions into BDI flash */
+  if ((result == BDI_OKAY) && ((changed & (BDI_CHANGED_CONFIG | BDI_CHANGED_REGDEF)) != 0)) {
+    if (   !BDI_FindSector(layout, configAddr, &configSector, &sectorSize)
+        || !BDI_FindSector(layout, regdefAddr, &regdefSector, &sectorSize)) {
+      result = BDI_ERR_INVALID_PARAMETER;
+    } /* if */
+  } /* if */
+
+  /* erase the configuration sector, program config data */
+  if ((result == BDI_OKAY) && ((changed & BDI_CHANGED_CONFIG) != 0)) {
+    printf("Writing configuration\n");
+    result = BDI_EraseSector(configSector);
+    if (result == BDI_OKAY) result = BDI_ProgramStream(layout, configAddr, &images.romConfig);
+  } /* if */
+
+  /* erase the regdef sector if not shared, program regdef data */
+  if ((result == BDI_OKAY) && ((changed & BDI_CHANGED_REGDEF) != 0)) {
+    printf("Writing register definitions\n");
+    if (regdefSector != configSector) result = BDI_EraseSector(regdefSector);
+    if (result == BDI_OKAY) result = BDI_ProgramStream(layout, regdefAddr, &images.romRegdef);
+  } /* if */
+
+  if (result == BDI_OKAY) printf("Configuration passed\n");
+  else                    printf("Configuration failed (%i)\n", result);
+
+  /* disconnect */
+  BDI_CloseConfigImages(&images);
+  BDI_Close();
+  return result;
+} /* BDI_ProgramConfig */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ BDI_UpdateConfig :
+
+   Transfer the BDI network configuration
+
+  INPUT:  szPort                the communication port (e.g. /dev/tty1 )
+          baudrate              the baudrate for the port
+          szHostIP              the IP address of the host
+          szBdiIP               the IP address of the BDI
+          szSubnetMask      	the subnet mask
+          szDefaultGateway  	the default gateway
+          szSetupFileName       the name of the setup file on the host
+  OUTPUT: return                error code
+
+ ****************************************************************************/
+
+int  BDI_UpdateConfig(const char* szPort,
+                            DWORD baudrate,
+                      const char* szHostIP,
+                      const char* szBdiIP,
+                      const char* szSubnetMask,
+                      const char* szDefaultGateway,
+                      const char* szSetupFileName)
+{
+  return BDI_ProgramConfig(szPort, baudrate, szHostIP, szBdiIP, szSubnetMask,
+                           szDefaultGateway, szSetupFileName, NULL, NULL);
+} /* BDI_UpdateConfig */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ BDI_UpdateFleet :
+
+   Build the configurations of all units of an inventory from a template,
+   then transfer them to the BDIs one after the other. Nothing is
+   programmed if a configuration fails. The values PORT, SN, IP, HOST,
+   MASK, GATEWAY and FILE of a unit replace the command line parameters,
+   NAME names the unit in messages.
+
+  INPUT:  szPort                the default communication port
+          baudrate              the baudrate for the port
+          szHostIP              the default IP address of the host
+          szBdiIP               the default IP address of the BDI
+          szSubnetMask      	the default subnet mask
+          szDefaultGateway  	the default gateway
+          szTemplateFile        the configuration template
+          szInventoryFile       the units and their variables
+          checkOnly             only build and check the configurations
+  OUTPUT: return                error code
+
+ ****************************************************************************/
+
+static const char* BDI_UnitValue(const FLT_FleetT* fleet, int unit,
+                                 const char* szName, const char* szDefault)
+{
+  const char* szValue;
+
+  szValue = FLT_GetValue(fleet, unit, szName);
+  return (szValue != NULL) ? szValue : szDefault;
+} /* BDI_UnitValue */
+
+
+static void BDI_UnitName(const FLT_FleetT* fleet, int unit, char* szName)
+{
+  const char* szValue;
+
+  szValue = BDI_UnitValue(fleet, unit, "NAME", BDI_UnitValue(fleet, unit, "SN",
+                          FLT_GetValue(fleet, unit, "IP")));
+  if (szValue != NULL) sprintf(szName, "%.40s", szValue);
+  else                 sprintf(szName, "line %i", fleet->unit[unit].line);
+} /* BDI_UnitName */
+
+
+static int BDI_UpdateFleet(const char* szPort,
+                                 DWORD baudrate,
+                           const char* szHostIP,
+                           const char* szBdiIP,
+                           const char* szSubnetMask,
+                           const char* szDefaultGateway,
+                           const char* szTemplateFile,
+                           const char* szInventoryFile,
+                           BOOL        checkOnly)
+{
+  int           result;
+  int           unitResult;
+  int           failed;
+  int           i;
+  DWORD         startTime;
+  char          szName[48];
+  FLT_FleetT    fleet;
+
+  /* build and check all configurations */
+  startTime = BDI_GetMicroseconds();
+  result = FLT_LoadInventory(szInventoryFile, &fleet);
+  if (result == BDI_ERR_CONFIG_SYNTAX) {
+    printf("### %s line %i: %s\n", szInventoryFile, fleet.errorLine, fleet.szError);
+  } /* if */
+  if (result != BDI_OKAY) {
+    printf("Reading inventory %s failed (%i)\n", szInventoryFile, result);
+    FLT_Free(&fleet);
+    return result;
+  } /* if */
+  failed = FLT_BuildFleet(szTemplateFile, stripConfig, &fleet);
+  if (failed < 0) {
+    printf("Reading template %s failed (%i)\n", szTemplateFile, failed);
+    FLT_Free(&fleet);
+    return failed;
+  } /* if */
+  for (i = 0; i < fleet.count; i++) {
+    if (fleet.unit[i].result == BDI_OKAY) continue;
+    BDI_UnitName(&fleet, i, szName);
+    if (fleet.unit[i].result == BDI_ERR_CONFIG_SYNTAX) {
+      printf("### %s: %s line %i: %s\n", szName, szTemplateFile,
+             fleet.unit[i].errorLine, fleet.unit[i].szError);
+    } /* if */
+    else {
+      printf("### %s: building configuration failed (%i)\n", szName, fleet.unit[i].result);
+    } /* else */
+  } /* for */
+  printf("%i configurations built in %lu ms, %i register definition images\n", fleet.count,
+         (BDI_GetMicroseconds() - startTime) / 1000UL, fleet.regdefCount);
+  if (failed > 0) {
+    printf("Fleet failed, %i of %i configurations invalid\n", failed, fleet.count);
+    FLT_Free(&fleet);
+    return BDI_ERR_CONFIG_SYNTAX;
+  } /* if */
+  if (checkOnly) {
+    FLT_Free(&fleet);
+    return BDI_OKAY;
+  } /* if */
+
+  /* program the units, a failed unit does not stop the others */
+  for (i = 0; i < fleet.count; i++) {
+    BDI_UnitName(&fleet, i, szName);
+    printf("Configuring %s\n", szName);
+    unitResult = BDI_ProgramConfig(BDI_UnitValue(&fleet, i, "PORT",    szPort),
+                                   baudrate,
+                                   BDI_UnitValue(&fleet, i, "HOST",    szHostIP),
+                                   BDI_UnitValue(&fleet, i, "IP",      szBdiIP),
+                                   BDI_UnitValue(&fleet, i, "MASK",    szSubnetMask),
+                                   BDI_UnitValue(&fleet, i, "GATEWAY", szDefaultGateway),
+                                   BDI_UnitValue(&fleet, i, "FILE",    szTemplateFile),
+                                   FLT_GetValue(&fleet, i, "SN"),
+                                   &fleet.unit[i]);
+    if (unitResult != BDI_OKAY) {
+      if (result == BDI_OKAY) result = unitResult;
+      failed++;
+    } /* if */
+  } /* for */
+  printf("Fleet %s, %i of %i units configured\n", (failed == 0) ? "passed" : "failed",
+         fleet.count - failed, fleet.count);
+  FLT_Free(&fleet);
+  return result;
+} /* BDI_UpdateFleet */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ Read a text region of the BDI flash up to its first 0xFF.
+ Maximal blocks are read with up to BDI_PipeDepth() commands outstanding,
+ no more blocks are requested after the block with the first 0xFF.
+
+  INPUT:  addr            start address of the region
+          size            size of the region
+  OUTPUT: data            the read blocks
+          count           number of bytes before the first 0xFF
+          return          error code
+
+ ****************************************************************************/
+
+static BOOL BDI_TextBlock(DWORD addr, const BYTE* readData, WORD readCount, void* context)
+{
+  BDI_TextT*  text = (BDI_TextT*)context;
+  BYTE*       data = text->data + (addr - text->addr);
+  BYTE*       end;
+
+  (void)memcpy(data, readData, readCount);
+  end = (BYTE*)memchr(data, 0xFF, readCount);
+  if (end == NULL) return TRUE;
+  *text->count = (DWORD)(end - text->data);
+  return FALSE;
+} /* BDI_TextBlock */
+
+
+static int BDI_ReadFlashText(DWORD addr, DWORD size, BYTE* data, DWORD* count)
+{
+  BDI_TextT text;
+
+  *count     = size;
+  text.addr  = addr;
+  text.data  = data;
+  text.count = count;
+  return BDI_ReadMemoryPipe(addr, size, BDI_TextBlock, &text);
+} /* BDI_ReadFlashText */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ Write a file
+
+  INPUT:  szFileName      the file name
+          data            the file contents
+          size            number of bytes
+  OUTPUT: return          error code
+
+ ****************************************************************************/
+
+static int BDI_WriteFile(const char* szFileName, const BYTE* data, int size)
+{
+  int   result;
+  FILE* file;
+
+  result = BDI_OKAY;
+  file = fopen(szFileName, "wb");
+  if (   (file == NULL)
+      || (fwrite(data, 1, (size_t)size, file) != (size_t)size)) result = BDI_ERR_FILE_ACCESS;
+  if ((file != NULL) && (fclose(file) != 0)) result = BDI_ERR_FILE_ACCESS;
+  return result;
+} /* BDI_WriteFile */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ The file of a register definition read from the BDI flash. The name
+ from the [REGS] part is placed in the directory of the configuration.
+
+  INPUT:  szSetupFileName       the configuration file written
+          config                the compiled configuration, NULL if none
+          index                 index of the register definition
+  OUTPUT: szRegdefName          the file name
+          return                TRUE if named by the configuration
+
+ ****************************************************************************/
+
+static BOOL BDI_RegdefFileName(const char*        szSetupFileName,
+                               const CNF_ConfigT* config,
+                               int                index,
+                               char*              szRegdefName)
+{
+  char        szName[MAXPATHLEN];
+  const char* szBase;
+  const char* p;
+  size_t      dirLength;
+  int         core;
+  BOOL        named;
+
+  named = (config != NULL)
+       && CNF_GetRegdefName(szSetupFileName, config, index, szName, (int)sizeof szName, &core);
+  if (!named) sprintf(szName, "regdef%i.def", index);
+  szBase = szName;
+  for (p = szName; *p != 0; p++) {
+    if ((*p == '/') || (*p == '\\') || (*p == ':')) szBase = p + 1;
+  } /* for */
+
+  /* never outside the directory of the configuration */
+  dirLength = 0;
+  for (p = szSetupFileName; *p != 0; p++) {
+    if ((*p == '/') || (*p == '\\') || (*p == ':')) dirLength = (size_t)(p + 1 - szSetupFileName);
+  } /* for */
+  if (dirLength + strlen(szBase) >= MAXPATHLEN) dirLength = 0;
+  (void)memcpy(szRegdefName, szSetupFileName, dirLength);
+  (void)strcpy(szRegdefName + dirLength, szBase);
+  return named;
+} /* BDI_RegdefFileName */
 
 
 /****************************************************************************
  ****************************************************************************
 
-  BDI_EraseFirmwareLogic :
+ BDI_ReadConfig :
 
-  Erase firmware and logic.
+   Read back the configuration and register definitions stored in the
+   BDI flash. Both are read up to their first 0xFF. The register
+   definitions are split at the core bytes (0x80 | core) written by
+   CNF_OpenRomRegdef and named after the [REGS] part of the read
+   configuration. A core byte is only taken at the start of a line, so
+   non-ASCII text within a file does not split it.
 
-  INPUT:  szPort        the communication port (e.g. /dev/tty1 )
-          baudrate      the baudrate for the port
-  OUTPUT: return        error code
+  INPUT:  szPort                the communication port (e.g. /dev/tty1 )
+          baudrate              the baudrate for the port
+          szSetupFileName       the file to write the configuration to,
+                                empty to only list what is stored
+  OUTPUT: return                error code
 
  ****************************************************************************/
 
-int BDI_EraseFirmwareLogic(const char* szPort, DWORD baudrate)
+static int BDI_ReadConfig(const char* szPort, DWORD baudrate, const char* szSetupFileName)
 {
   int           result;
-  int	        sector;
-  DWORD	        address;
+  int           regdefCount;
+  int           index;
+  BOOL          compiled;
+  BOOL          named;
   BDI_VersionT  version;
-  BYTE          ispDeviceId;
+  const BDI_LayoutT* layout;
+  BYTE*         romConfig;
+  BYTE*         romRegdef;
+  DWORD         configSize;
+  DWORD         regdefSize;
+  DWORD         start;
+  DWORD         end;
+  DWORD         startTime;
+  CNF_ConfigT   config;
+  char          szRegdefName[MAXPATHLEN];
 
   /* connect to BDI loader and read versions */
   printf("Connecting to BDI loader\n");
@@ -2362,453 +4542,533 @@ int BDI_EraseFirmwareLogic(const char* szPort, DWORD baudrate)
     printf("Connecting to BDI loader failed (%i)\n", result);
     return result;
   } /* if */
+  layout = BDI_GetLayout(version.bdi);
+  if ((layout == NULL) || (layout->configAddr == 0)) {
+    BDI_Close();
+    printf("### no configuration stored in the flash of this BDI\n");
+    return BDI_ERR_INVALID_PARAMETER;
+  } /* if */
 
-  /* first, erase logic */
-  if ((result == BDI_OKAY) && (version.bdi != BDI_TYPE_30)) {
-    printf("Erasing CPLD\n");
-    if (result == BDI_OKAY) result = ISP_Enable();
-    if (result == BDI_OKAY) result = ISP_GetDeviceId(&ispDeviceId);
-    if (result == BDI_OKAY) result = ISP_Erase();
-    if (result == BDI_OKAY) result = ISP_Disable();
-    if (result == BDI_OKAY) {
-      if (    ((version.bdi == BDI_TYPE_HS) && (ispDeviceId != ISP_2032_ID))
-           || ((version.bdi == BDI_TYPE_20) && (ispDeviceId != ISP_2096_ID))
-           || ((version.bdi == BDI_TYPE_21) && (ispDeviceId != ISP_2096_ID))
-           || ((version.bdi == BDI_TYPE_10) && (ispDeviceId != ISP_2064_ID))
-         ) result = BDI_ERR_LOGIC_DEVICE;
-    } /* if */
-    if (result != BDI_OKAY) printf("Erasing CPLD failed (%i)\n", result);
+  romConfig = (BYTE*)malloc(BDI_MAX_CONFIG_SIZE);
+  romRegdef = (BYTE*)malloc(BDI_MAX_REGDEF_SIZE);
+  if ((romConfig == NULL) || (romRegdef == NULL)) {
+    BDI_Close();
+    free(romConfig);
+    free(romRegdef);
+    return BDI_ERR_FILE_ACCESS;
   } /* if */
 
+  /* read both regions up to their end */
+  startTime = BDI_GetMicroseconds();
+  configSize = 0;
+  regdefSize = 0;
+  result = BDI_ReadFlashText(layout->configAddr, BDI_MAX_CONFIG_SIZE, romConfig, &configSize);
   if (result == BDI_OKAY) {
-    printf("Erasing all flash sectors\n");
-    if (version.bdi == BDI_TYPE_HS) {
-      result = BDI_EraseSector(0x0A0000);
+    result = BDI_ReadFlashText(layout->regdefAddr, BDI_MAX_REGDEF_SIZE, romRegdef, &regdefSize);
+  } /* if */
+  BDI_Close();
+  if (result != BDI_OKAY) {
+    printf("Reading configuration failed (%i)\n", result);
+    free(romConfig);
+    free(romRegdef);
+    return result;
+  } /* if */
+  printf("BDI %s: configuration %lu bytes, register definitions %lu bytes, read in %lu ms\n",
+         version.sn, configSize, regdefSize, (BDI_GetMicroseconds() - startTime) / 1000UL);
+
+  /* the names of the register definitions */
+  compiled = FALSE;
+  if (configSize > 0) {
+    compiled = (CNF_CompileText(romConfig, (int)configSize, &config) == BDI_OKAY);
+    if (!compiled) {
+      printf("### configuration line %i: %s\n", config.errorLine, config.szError);
+      CNF_Free(&config);
     } /* if */
-    /* for security reasons, erase all sectors of BDI2000 */
-    else if ((version.bdi == BDI_TYPE_20) || (version.bdi == BDI_TYPE_21)) {
-      if (result == BDI_OKAY) result = BDI_EraseSector(0x01008000L);
-      if (result == BDI_OKAY) result = BDI_EraseSector(0x0100C000L);
-      if (result == BDI_OKAY) result = BDI_EraseSector(0x01010000L);
-      if (result == BDI_OKAY) result = BDI_EraseSector(0x01040000L);
-      if (result == BDI_OKAY) result = BDI_EraseSector(0x01080000L);
-      if (result == BDI_OKAY) result = BDI_EraseSector(0x010C0000L);
-    } /* else if */
-    /* for security reasons, erase all sectors of BDI1000 */
-    else if (version.bdi == BDI_TYPE_10) {
-      if (result == BDI_OKAY) result = BDI_EraseSector(0x084000L);
-      if (result == BDI_OKAY) result = BDI_EraseSector(0x086000L);
-      if (result == BDI_OKAY) result = BDI_EraseSector(0x088000L);
-      if (result == BDI_OKAY) result = BDI_EraseSector(0x0A0000L);
-      if (result == BDI_OKAY) result = BDI_EraseSector(0x0C0000L);
-      if (result == BDI_OKAY) result = BDI_EraseSector(0x0E0000L);
-    } /* else if */
-
-    /* for security reasons, erase almost all sectors of BDI3000 */
-    else if (version.bdi == BDI_TYPE_30) {
-      /* erase configuration sectors */
-      address = 0x2000;
-      for (sector = 1; sector < 8; sector++) {
-        if (result == BDI_OKAY) result = BDI_EraseSector(address);
-        address += 0x02000;
-        putchar('.');
-        fflush(stdout);
-      } /* for */
-      /* erase unused loader sectors */
-      address = 0x30000;
-      for (sector = 3; sector < 16; sector++) {
-        if (result == BDI_OKAY) result = BDI_EraseSector(address);
-        address += 0x10000;
-        putchar('.');
-        fflush(stdout);
-      } /* for */
-      /* erase firmware sectors */
-      address = B30_FIRMWARE_ADDR;
-      for (sector = 0; sector < 48; sector++) {
-        if (result == BDI_OKAY) result = BDI_EraseSector(address);
-        address += 0x10000;
-        putchar('.');
-        fflush(stdout);
-      } /* for */
-      printf("\n");
-
-      /* check for illegal data stored in flash */
-      if (result == BDI_OKAY) {
-        printf("Checking for illegal data in boot/loader sectors\n");
-        result = B30_VerifyLoaderCode();
-        if (result != BDI_OKAY) {
-          printf("Illegal data in boot/loader sectors detected!\n");
-        } /* if */
-      } /* if */
-
-    } /* else if */
-    if (result != BDI_OKAY) printf("Erasing firmware failed (%i)\n", result);
   } /* if */
+  if (configSize == 0) printf("No configuration stored\n");
+  else if (szSetupFileName[0] != 0) {
+    result = BDI_WriteFile(szSetupFileName, romConfig, (int)configSize);
+    if (result == BDI_OKAY) printf("Configuration written to %s\n", szSetupFileName);
+  } /* else if */
 
-  if (result == BDI_OKAY) printf("Erasing passed\n");
+  /* one register definition file per core byte */
+  regdefCount = compiled ? CNF_GetRegdefCount(&config) : 0;
+  index = 0;
+  start = 0;
+  while ((result == BDI_OKAY) && (start < regdefSize)) {
+    end = start + 1;
+    while (    (end < regdefSize)
+            && (((romRegdef[end] & 0xC0) != 0x80) || (romRegdef[end - 1] != '\n'))) end++;
+    named = BDI_RegdefFileName(szSetupFileName,
+                               (index < regdefCount) ? &config : NULL, index, szRegdefName);
+    printf("Register definitions %s for core %i: %lu bytes", szRegdefName,
+           romRegdef[start] & 0x3F, end - start - 1);
+    if ((romRegdef[start] & 0x80) == 0) printf(" (no core byte)");
+    else if (!named)                    printf(" (not in [REGS])");
+    printf("\n");
+    if (szSetupFileName[0] != 0) {
+      result = BDI_WriteFile(szRegdefName, romRegdef + start + 1, (int)(end - start - 1));
+    } /* if */
+    start = end;
+    index++;
+  } /* while */
+  if ((result == BDI_OKAY) && (index != regdefCount) && compiled) {
+    printf("### %i register definitions stored, %i in [REGS]\n", index, regdefCount);
+  } /* if */
+  if (result != BDI_OKAY) printf("Writing configuration failed (%i)\n", result);
 
-  /* disconnect */
-  BDI_Close();
+  if (compiled) CNF_Free(&config);
+  free(romConfig);
+  free(romRegdef);
   return result;
-} /* BDI_EraseFirmwareLogic */
+} /* BDI_ReadConfig */
 
 
 /****************************************************************************
  ****************************************************************************
 
-    BDI_UpdateFirmwareLogic:
+ BDI_AnalyseInit :
 
-     Updates the firmware and the logic of the BDI.
+   Report the analysis of the [INIT] part of a configuration file and
+   optionally write the optimized configuration
 
-     INPUT  : szPort      the communication port (e.g. /dev/tty1 )
-              baudrate    the baudrate for the port
-              szPath      the directory path to the firmware files
-              targetType  the connected target type (e.g. BDI_FWT_MPC)
-              updateMode  the update mode
-                            BDI_UPDATE_AUTO
-                            BDI_UPDATE_FIRMWARE
-                            BDI_UPDATE_LOGIC
-                            BDI_UPDATE_ALL
-     OUTPUT : RETURN      0 if okay or a negativ number if error.
+  INPUT:  szSetupFileName       the configuration file
+          memory                the plain memory ranges
+          ranges                number of ranges
+          szOptimizeFile        the optimized configuration, empty if none
+  OUTPUT: return                error code
 
  ****************************************************************************/
 
-int BDI_UpdateFirmwareLogic(const char* szPort,
-                                  DWORD baudrate,
-                            const char* szPath,
-                                  WORD  targetType,
-                                  WORD  updateMode)
+static int BDI_AnalyseInit(const char*       szSetupFileName,
+                           const INI_RangeT* memory,
+                           int               ranges,
+                           const char*       szOptimizeFile)
 {
-  int             result;
-  BDI_VersionT    version;
-  WORD            newestFirmware;
-  WORD            newestLogic;
-  char            szFirmwareName[MAXPATHLEN];
-  char            szLogicName[MAXPATHLEN];
-  BOOL            updateFirmware;
-  BOOL            updateLogic;
-  BYTE            ispDeviceId;
-  size_t          len;
-
-  const BDI_SetupInfoT* setupInfo;
-
-  /* check parameter */
-  if (targetType >= (sizeof B20_SetupInfo / sizeof B20_SetupInfo[0])) {
-    return BDI_ERR_INVALID_PARAMETER;
+  int                 result;
+  int                 applied;
+  int                 i;
+  BYTE*               text;
+  int                 textSize;
+  const INI_FindingT* finding;
+  CNF_ConfigT         config;
+  INI_ReportT         report;
+
+  result = CNF_Compile(szSetupFileName, &config);
+  if (result == BDI_ERR_CONFIG_SYNTAX) {
+    printf("### %s line %i: %s\n", szSetupFileName, config.errorLine, config.szError);
   } /* if */
-
-  /* connect to BDI loader and read versions */
-  printf("Connecting to BDI loader\n");
-  result = BDI_ConnectLoader(szPort, baudrate, &version);
-  if (result < 0) {
-    printf("Connecting to BDI loader failed (%i)\n", result);
+  if (result == BDI_OKAY) result = INI_Analyse(&config, memory, ranges, &report);
+  if (result != BDI_OKAY) {
+    printf("Analysing %s failed (%i)\n", szSetupFileName, result);
+    CNF_Free(&config);
     return result;
   } /* if */
 
-  /* get setup info based on BDI type */
-  if      (version.bdi == BDI_TYPE_HS) setupInfo = &BHS_SetupInfo[targetType];
-  else if (version.bdi == BDI_TYPE_20) setupInfo = &B20_SetupInfo[targetType];
-  else if (version.bdi == BDI_TYPE_21) setupInfo = &B21_SetupInfo[targetType];
-  else if (version.bdi == BDI_TYPE_10) setupInfo = &B10_SetupInfo[targetType];
-  else if (version.bdi == BDI_TYPE_30) setupInfo = &B30_SetupInfo[targetType];
-  else {
-    BDI_Close();
-    return BDI_ERR_INVALID_PARAMETER;
-  } /* else */
+  printf("[INIT]: %i entries, %i memory writes, %i reads, %i register writes\n",
+         report.entries, report.memWrites, report.memReads, report.regWrites);
+  printf("[INIT]: %i delays, total DELAY time %lu ms\n", report.delays, report.delayTime);
+  applied = 0;
+  for (i = 0; i < report.count; i++) {
+    finding = &report.finding[i];
+    printf("line %i: ", config.entry[finding->entry].line);
+    switch (finding->kind) {
+      case INI_FIND_REPEATED:
+        printf("%s written %i times up to line %i", CNF_GetText(&config, &config.entry[finding->entry]),
+               finding->count, config.entry[finding->other].line);
+        break;
+      case INI_FIND_OVERWRITTEN:
+        printf("%s overwritten by line %i", CNF_GetText(&config, &config.entry[finding->entry]),
+               config.entry[finding->other].line);
+        break;
+      case INI_FIND_MERGEABLE:
+        printf("%i writes up to line %i mergeable into WM%i 0x%08lx 0x%0*llx", finding->count,
+               config.entry[finding->other].line, 8 * finding->size, finding->addr,
+               2 * finding->size, finding->value);
+        break;
+      default:
+        printf("%i delays up to line %i combined into DELAY %lu", finding->count,
+               config.entry[finding->other].line, (unsigned long)finding->value);
+        break;
+    } /* switch */
+    if (finding->apply) applied++;
+    else                printf(" (kept, not plain memory)");
+    printf("\n");
+  } /* for */
 
-  /* check for full qualified BDI3000 firmware file */
-  szFirmwareName[0] = 0;
-  len = strlen(szPath);
-  if ((version.bdi == BDI_TYPE_30) && (len >= 12)) {
-    if (    (szPath[len-12] == 'b')
-         && (szPath[len-11] == '3')
-         && (szPath[len-10] == '0')
-         && (szPath[len-4]  == '.')
-        ) {
-      (void)strcpy(szFirmwareName, szPath);
-      updateMode = BDI_UPDATE_FIRMWARE;
+  /* write the optimized configuration */
+  if (szOptimizeFile[0] != 0) {
+    result = INI_Rewrite(&config, &report, &text, &textSize);
+    if (result == BDI_OKAY) {
+      result = BDI_WriteFile(szOptimizeFile, text, textSize);
+      free(text);
     } /* if */
+    if (result == BDI_OKAY) printf("%i of %i findings applied to %s\n", applied, report.count, szOptimizeFile);
+    else                    printf("Writing %s failed (%i)\n", szOptimizeFile, result);
   } /* if */
 
-  /* get newest firmware */
-  if (szFirmwareName[0] == 0) {
-    newestFirmware = BDI_GetNewest(szPath, setupInfo->firmwareName, szFirmwareName);
-    if (newestFirmware == 0) {
-      printf("No valid firmware file found in %s\n", szPath);
-      BDI_Close();
-      return BDI_ERR_FIRMWARE_FILE;
+  INI_Free(&report);
+  CNF_Free(&config);
+  return result;
+} /* BDI_AnalyseInit */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ BDI_TargetMemory :
+
+   Read or write target memory through the BDI firmware. The TSZ ranges
+   and the byte order of the target are taken from the configuration.
+
+  INPUT:  szPort                the port
+          baudrate              the baudrate
+          szSetupFileName       the configuration file, empty if none
+          space                 the memory space, -1 for the default
+          szRead                A,N: read N bytes at address A, empty if none
+          szWrite               A,XX..: write hex bytes at address A, empty if none
+  OUTPUT: return                error code
+
+ ****************************************************************************/
+
+static int BDI_TargetMemory(const char* szPort,
+                            DWORD       baudrate,
+                            const char* szSetupFileName,
+                            int         space,
+                            const char* szRead,
+                            const char* szWrite)
+{
+  int           result;
+  int           i;
+  DWORD         addr;
+  DWORD         count;
+  DWORD         startTime;
+  DWORD         elapsed;
+  BYTE*         data;
+  const char*   hex;
+  char*         next;
+  char          szByte[3];
+  CNF_ConfigT   config;
+  MEM_SessionT  session;
+
+  MEM_Init(&session);
+  if (szSetupFileName[0] != 0) {
+    result = CNF_Compile(szSetupFileName, &config);
+    if (result == BDI_ERR_CONFIG_SYNTAX) {
+      printf("### %s line %i: %s\n", szSetupFileName, config.errorLine, config.szError);
     } /* if */
+    if (result == BDI_OKAY) result = MEM_SetConfig(&session, &config);
+    CNF_Free(&config);
+    if (result != BDI_OKAY) return result;
   } /* if */
 
-  /* get newest logic */
-  if (version.bdi != BDI_TYPE_30) {
-    newestLogic = BDI_GetNewest(szPath, setupInfo->logicName, szLogicName);
-    if (newestLogic == 0) {
-      printf("No valid JEDEC file found in %s\n", szPath);
-      BDI_Close();
-      return BDI_ERR_LOGIC_FILE;
+  /* the address and the size or data */
+  hex   = NULL;
+  addr  = strtoul((szRead[0] != 0) ? szRead : szWrite, &next, 0);
+  count = 0;
+  if (*next == ',') {
+    if (szRead[0] != 0) count = strtoul(next + 1, &next, 0);
+    else {
+      hex   = next + 1;
+      count = (DWORD)strlen(hex) / 2;
+      next  = (char*)hex + 2 * count;
+    } /* else */
+  } /* if */
+  if ((*next != 0) || (count == 0)) {
+    printf("Invalid address or size\n");
+    return BDI_ERR_INVALID_PARAMETER;
+  } /* if */
+  data = (BYTE*)malloc((size_t)count);
+  if (data == NULL) return BDI_ERR_FILE_ACCESS;
+  for (i = 0; (hex != NULL) && (i < (int)count); i++) {
+    szByte[0] = hex[2*i];
+    szByte[1] = hex[2*i+1];
+    szByte[2] = 0;
+    data[i] = (BYTE)strtoul(szByte, &next, 16);
+    if ((*next != 0) || !isxdigit((BYTE)szByte[0])) {
+      printf("Invalid data\n");
+      free(data);
+      return BDI_ERR_INVALID_PARAMETER;
     } /* if */
+  } /* for */
+
+  /* connect to the BDI firmware */
+  for (i = 0; i < 3; i++) {
+    result = BDI_Open(szPort, baudrate);
+    if ((result == BDI_OKAY) || (result == BDI_ASYN_SETUP)) break;
+  } /* for */
+  if (result != BDI_OKAY) {
+    printf("Connecting to BDI failed (%i)\n", result);
+    free(data);
+    return result;
   } /* if */
 
-  /* decide if firmware update is neccecary */
-  updateFirmware = ((updateMode == BDI_UPDATE_ALL) || (updateMode == BDI_UPDATE_FIRMWARE));
-  if (!updateFirmware) {
-    updateFirmware = (   ((version.firmware - setupInfo->firmwareType) > BDI_MAX_FW_VERSION)
-                      || ((version.firmware - setupInfo->firmwareType) < newestFirmware) );
-    if (!updateFirmware) printf("Firmware is already up to date\n");
+  startTime = BDI_GetMicroseconds();
+  if (space >= 0) result = MEM_SetSpace(&session, (BYTE)space);
+  if (result == BDI_OKAY) {
+    if (hex == NULL) result = MEM_Read(&session, addr, count, data);
+    else             result = MEM_Write(&session, addr, count, data);
+  } /* if */
+  elapsed = (BDI_GetMicroseconds() - startTime) / 1000UL;
+  BDI_Close();
+  if (result != BDI_OKAY) {
+    printf("%s target memory failed (%i)\n", (hex == NULL) ? "Reading" : "Writing", result);
+    free(data);
+    return result;
   } /* if */
 
-  /* decide if logic update is neccecary */
-  updateLogic = FALSE;
-  if (version.bdi != BDI_TYPE_30) {
-    updateLogic = ((updateMode == BDI_UPDATE_ALL) || (updateMode == BDI_UPDATE_LOGIC));
-    if (!updateLogic) {
-      updateLogic = (   ((version.logic - setupInfo->logicType) > BDI_MAX_LOGIC_VERSION)
-                     || ((version.logic - setupInfo->logicType) < newestLogic) );
-      if (!updateLogic) printf("CPLD is already up to date\n");
+  /* hex dump of the read data */
+  for (i = 0; (hex == NULL) && (i < (int)count); i++) {
+    if ((i % 16) == 0) printf("%08lX:", addr + (DWORD)i);
+    printf(" %02X", data[i]);
+    if (((i % 16) == 15) || (i == (int)count - 1)) printf("\n");
+  } /* for */
+  printf("%s %lu bytes at 0x%08lX in %lu ms, %lu commands\n", (hex == NULL) ? "Read" : "Wrote",
+         count, addr, elapsed, session.commands);
+  free(data);
+  return BDI_OKAY;
+} /* BDI_TargetMemory */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ BDI_LoadApplication :
+
+   Download an application file into target memory and set the PC to
+   its entry point.
+
+  INPUT:  szPort                the port
+          baudrate              the baudrate
+          szLoad                F[,A]: the ELF, S-Record or binary file F,
+                                a binary file is loaded at address A
+  OUTPUT: return                error code
+
+ ****************************************************************************/
+
+static int BDI_LoadApplication(const char* szPort, DWORD baudrate, const char* szLoad)
+{
+  int             result;
+  int             i;
+  DWORD           addr;
+  DWORD           startTime;
+  DWORD           elapsed;
+  char*           next;
+  char            szFileName[MAXPATHLEN];
+  IMG_ImageT      image;
+  LDR_StatisticsT statistics;
+
+  /* the file and the address of a binary file */
+  addr = 0;
+  strncpy(szFileName, szLoad, sizeof szFileName - 1);
+  szFileName[sizeof szFileName - 1] = 0;
+  next = strrchr(szFileName, ',');
+  if (next != NULL) {
+    *next = 0;
+    addr = strtoul(next + 1, &next, 0);
+    if (*next != 0) {
+      printf("Invalid load address\n");
+      return BDI_ERR_INVALID_PARAMETER;
     } /* if */
   } /* if */
+  IMG_Init(&image);
+  result = IMG_LoadFile(szFileName, addr, &image);
+  if (result != BDI_OKAY) {
+    printf("Loading %s failed (%i)\n", szFileName, result);
+    return result;
+  } /* if */
 
-  /* first, erase logic */
-  if (updateLogic && (result == BDI_OKAY)) {
-    printf("Erasing CPLD\n");
-    if (result == BDI_OKAY) result = ISP_Enable();
-    if (result == BDI_OKAY) result = ISP_GetDeviceId(&ispDeviceId);
-    if (result == BDI_OKAY) result = ISP_Erase();
-    if (result == BDI_OKAY) result = ISP_Disable();
-    if (result == BDI_OKAY) {
-      if (    ((version.bdi == BDI_TYPE_HS) && (ispDeviceId != ISP_2032_ID))
-           || ((version.bdi == BDI_TYPE_20) && (ispDeviceId != ISP_2096_ID))
-           || ((version.bdi == BDI_TYPE_21) && (ispDeviceId != ISP_2096_ID))
-           || ((version.bdi == BDI_TYPE_10) && (ispDeviceId != ISP_2064_ID))
-         ) result = BDI_ERR_LOGIC_DEVICE;
-    } /* if */
-    if (result != BDI_OKAY) printf("Erasing CPLD failed (%i)\n", result);
+  /* connect to the BDI firmware */
+  for (i = 0; i < 3; i++) {
+    result = BDI_Open(szPort, baudrate);
+    if ((result == BDI_OKAY) || (result == BDI_ASYN_SETUP)) break;
+  } /* for */
+  if (result != BDI_OKAY) {
+    printf("Connecting to BDI failed (%i)\n", result);
+    IMG_Free(&image);
+    return result;
   } /* if */
 
-  /* update firmware */
-  if (updateFirmware && (result == BDI_OKAY)) {
-    printf("Programming firmware with %s\n", szFirmwareName);
-    if      (version.bdi == BDI_TYPE_HS) result = BHS_UpdateFirmware(szFirmwareName);
-    else if (version.bdi == BDI_TYPE_20) result = B20_UpdateFirmware(szFirmwareName);
-    else if (version.bdi == BDI_TYPE_21) result = B20_UpdateFirmware(szFirmwareName);
-    else if (version.bdi == BDI_TYPE_10) result = B10_UpdateFirmware(szFirmwareName);
-    else if (version.bdi == BDI_TYPE_30) result = B30_UpdateFirmware(szFirmwareName);
-    if (result != BDI_OKAY) printf("Programming firmware failed (%i)\n", result);
+  startTime = BDI_GetMicroseconds();
+  result    = LDR_LoadImage(&image, TRUE, &statistics);
+  elapsed   = (BDI_GetMicroseconds() - startTime) / 1000UL;
+  BDI_Close();
+  if (result != BDI_OKAY) {
+    printf("Downloading %s failed after %lu bytes (%i)\n", szFileName, statistics.bytes, result);
+    IMG_Free(&image);
+    return result;
   } /* if */
 
-  /* program logic */
-  if (updateLogic && (result == BDI_OKAY)) {
-    printf("Programming CPLD with %s\n", szLogicName);
-    newestLogic += setupInfo->logicType;
-    if      (version.bdi == BDI_TYPE_HS) result = BHS_UpdateLogic(newestLogic, szLogicName);
-    else if (version.bdi == BDI_TYPE_20) result = B20_UpdateLogic(newestLogic, szLogicName);
-    else if (version.bdi == BDI_TYPE_21) result = B20_UpdateLogic(newestLogic, szLogicName);
-    else if (version.bdi == BDI_TYPE_10) result = B10_UpdateLogic(newestLogic, szLogicName);
-    if (result != BDI_OKAY) printf("Programming CPLD failed (%i)\n", result);
+  printf("Loaded %lu bytes in %i segments in %lu ms", statistics.bytes, image.count, elapsed);
+  if (elapsed > 0) printf(" (%lu KB/s)", statistics.bytes / elapsed);
+  printf(", %lu commands\n", statistics.commands);
+  if (statistics.fastLoad) {
+    printf("Fast load: %lu bytes in %i chunks, %i chunks loaded again\n",
+           statistics.fastBytes, statistics.chunks, statistics.repeated);
+  } /* if */
+  else {
+    printf("No fast load, loaded with single blocks\n");
+  } /* else */
+  if (image.hasEntry) printf("PC set to entry point 0x%08lX\n", image.entry);
+  IMG_Free(&image);
+  return BDI_OKAY;
+} /* BDI_LoadApplication */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ BDI_DumpMemory :
+
+   Dump a range of target memory into a file, one dot per written buffer
+
+  INPUT:  szPort                the port
+          baudrate              the baudrate
+          szDump                A,N,F: N bytes at address A into file F
+          format                DMP_FORMAT_xxx
+  OUTPUT: return                error code
+
+ ****************************************************************************/
+
+static void BDI_DumpProgress(const DMP_ProgressT* progress, void* context)
+{
+  (void)progress;
+  (void)context;
+  putchar('.');
+  fflush(stdout);
+} /* BDI_DumpProgress */
+
+
+static int BDI_DumpMemory(const char* szPort, DWORD baudrate, const char* szDump, int format)
+{
+  int           result;
+  int           i;
+  DWORD         addr;
+  DWORD         size;
+  char*         next;
+  DMP_ProgressT progress;
+
+  addr = strtoul(szDump, &next, 0);
+  size = 0;
+  if (*next == ',') size = strtoul(next + 1, &next, 0);
+  if ((*next != ',') || (next[1] == 0) || (size == 0)) {
+    printf("Invalid address, size or file\n");
+    return BDI_ERR_INVALID_PARAMETER;
   } /* if */
 
-  if (result == BDI_OKAY) printf("Programming passed\n");
+  /* connect to the BDI firmware */
+  for (i = 0; i < 3; i++) {
+    result = BDI_Open(szPort, baudrate);
+    if ((result == BDI_OKAY) || (result == BDI_ASYN_SETUP)) break;
+  } /* for */
+  if (result != BDI_OKAY) {
+    printf("Connecting to BDI failed (%i)\n", result);
+    return result;
+  } /* if */
 
-  /* disconnect */
-  BDI_Close();
-  return result;
-} /* BDI_UpdateFirmwareLogic */
+  printf("Dumping %lu bytes at 0x%08lX to %s ", size, addr, next + 1);
+  fflush(stdout);
+  result = DMP_Dump(addr, size, next + 1, format, BDI_DumpProgress, NULL, &progress);
+  BDI_Close();
+  printf("\n");
+  if (result != BDI_OKAY) {
+    printf("Dumping target memory failed after %lu bytes (%i)\n", progress.read, result);
+    return result;
+  } /* if */
+  printf("Read %lu bytes in %lu ms", progress.read, progress.elapsed);
+  if (progress.elapsed > 0) printf(" (%lu KB/s)", progress.read / progress.elapsed);
+  printf(" with %s, %lu bytes written, %lu bytes skipped\n",
+         progress.dumpBlock ? "DUMP_SINGLE_BLOCK" : "GET_BLOCK", progress.written, progress.skipped);
+  return BDI_OKAY;
+} /* BDI_DumpMemory */
 
 
 /****************************************************************************
  ****************************************************************************
 
- BDI_UpdateConfig :
+ BDI_ProfileTarget :
 
-   Transfer the BDI network configuration
+   Profile the running target with bdiSpy, one dot per second
 
-  INPUT:  szPort                the communication port (e.g. /dev/tty1 )
-          baudrate              the baudrate for the port
-          szHostIP              the IP address of the host
-          szBdiIP               the IP address of the BDI
-          szSubnetMask      	the subnet mask
-          szDefaultGateway  	the default gateway
-          szSetupFileName       the name of the setup file on the host
+  INPUT:  szPort                the port
+          baudrate              the baudrate
+          szElf                 the ELF file of the running application
+          duration              profiling time in seconds
+          interval              poll interval in ms
+          szFolded              file for the folded stacks, empty if none
   OUTPUT: return                error code
 
  ****************************************************************************/
 
-#define B10_NETWORK_ADDR          0x00084000L /* base address of network configuration */
-
-#define B20_NETWORK_ADDR          0x01008000L /* base address of network configuration */
-#define B20_CONFIG_ADDR           0x010C0000L /* base address of configuration */
-#define B20_REGDEF_ADDR           0x010D0000L /* base address of register definition */
+static void BDI_ProfileProgress(const SPY_ProfileT* profile, void* context)
+{
+  DWORD* seconds = (DWORD*)context;
 
-#define B30_NETWORK_ADDR          0x00006000L /* base address of network configuration */
-#define B30_CONFIG_ADDR           0x00200000L /* base address of configuration */
-#define B30_REGDEF_ADDR           0x00210000L /* base address of register definition */
+  if (profile->elapsed / 1000UL > *seconds) {
+    *seconds = profile->elapsed / 1000UL;
+    putchar('.');
+    fflush(stdout);
+  } /* if */
+} /* BDI_ProfileProgress */
 
 
-int  BDI_UpdateConfig(const char* szPort,
-                            DWORD baudrate,
-                      const char* szHostIP,
-                      const char* szBdiIP,
-                      const char* szSubnetMask,
-                      const char* szDefaultGateway,
-                      const char* szSetupFileName)
+static int BDI_ProfileTarget(const char* szPort, DWORD baudrate, const char* szElf,
+                             DWORD duration, DWORD interval, const char* szFolded)
 {
   int           result;
-  BDI_VersionT  version;
-  BYTE          configData[104];
-  BYTE          configReadBack[104];
-  BYTE*         configPtr;
-  DWORD         errorAddr;
-  DWORD         networkAddr;
-  DWORD         configAddr;
-  DWORD         regdefAddr;
-  size_t        nameLength;
-  size_t        i;
-
-  WORD          fwType;
-  DWORD         hostIP;
-  DWORD         flashAddr;
-  int           romConfigSize;
-  int           romRegdefSize;
-  BYTE          romConfig[BDI_MAX_CONFIG_SIZE];
-  BYTE          romRegdef[BDI_MAX_REGDEF_SIZE];
-
-  /* connect to BDI loader and read versions */
-  printf("Connecting to BDI loader\n");
-  result = BDI_ConnectLoader(szPort, baudrate, &version);
-  if (result < 0) {
-    printf("Connecting to BDI loader failed (%i)\n", result);
+  int           i;
+  DWORD         seconds;
+  FILE*         file;
+  IMG_SymbolsT  symbols;
+  SPY_ProfileT  profile;
+
+  IMG_InitSymbols(&symbols);
+  result = IMG_LoadSymbols(szElf, &symbols);
+  if (result == BDI_OKAY) result = SPY_Init(&profile, &symbols);
+  if (result != BDI_OKAY) {
+    printf("Loading the functions of %s failed (%i)\n", szElf, result);
+    IMG_FreeSymbols(&symbols);
     return result;
   } /* if */
 
-  /* get firmware type */
-  if (version.bdi == BDI_TYPE_30) {
-    fwType = version.firmware >> 8;
+  /* connect to the BDI firmware */
+  for (i = 0; i < 3; i++) {
+    result = BDI_Open(szPort, baudrate);
+    if ((result == BDI_OKAY) || (result == BDI_ASYN_SETUP)) break;
+  } /* for */
+  if (result != BDI_OKAY) {
+    printf("Connecting to BDI failed (%i)\n", result);
+    SPY_Free(&profile);
+    IMG_FreeSymbols(&symbols);
+    return result;
   } /* if */
-  else if (version.firmware < 0xC000) {
-    fwType = version.firmware >> 12;
-  } /* else if */
-  else {
-    fwType = (version.firmware - 0xC000) >> 8;
-  } /* else */
 
-  /* set network configuration addresses */
-  if ((version.bdi == BDI_TYPE_20) || (version.bdi == BDI_TYPE_21)) {
-    networkAddr = B20_NETWORK_ADDR;
+  printf("Profiling %i functions for %lu s ", profile.count, duration);
+  fflush(stdout);
+  seconds = 0;
+  result  = SPY_Run(&profile, 1000UL * duration, interval, BDI_ProfileProgress, &seconds);
+  BDI_Close();
+  printf("\n");
+  if (result != BDI_OKAY) {
+    printf("Profiling failed after %lu polls (%i)\n", profile.polls, result);
   } /* if */
-  else if (version.bdi == BDI_TYPE_10) {
-    networkAddr = B10_NETWORK_ADDR;
-  } /* else if */
-  else if (version.bdi == BDI_TYPE_30) {
-    networkAddr = B30_NETWORK_ADDR;
-  } /* else if */
   else {
-    BDI_Close();
-    printf("### invalid BDI connected\n");
-    return BDI_ERR_INVALID_PARAMETER;
+    result = SPY_WriteFlat(&profile, stdout);
   } /* else */
 
-  /* build network configuration data */
-  printf("Writing network configuration\n");
-  configPtr = configData;
-  *configPtr++ = 0x00;
-  *configPtr++ = 0x0C;
-  *configPtr++ = 0x01;
-  *configPtr++ = (BYTE)((version.sn[0]-'0') * 16 + (version.sn[1]-'0'));
-  *configPtr++ = (BYTE)((version.sn[2]-'0') * 16 + (version.sn[3]-'0'));
-  *configPtr++ = (BYTE)((version.sn[4]-'0') * 16 + (version.sn[5]-'0'));
-
-  /* gap */
-  *configPtr++ = 0xFF;
-  *configPtr++ = 0xFF;
-
-  /* IP addresses */
-  configPtr  = BDI_AppendLong(BDI_IPAddrMotorola(szBdiIP), configPtr);
-  configPtr  = BDI_AppendLong(BDI_IPAddrMotorola(szSubnetMask), configPtr);
-  configPtr  = BDI_AppendLong(BDI_IPAddrMotorola(szDefaultGateway), configPtr);
-
-  /* Host IP and Configuration File */
-  hostIP = BDI_IPAddrMotorola(szHostIP);
-  configPtr = BDI_AppendLong(hostIP, configPtr);
-  nameLength = strlen(szSetupFileName);
-  if (nameLength > 79) nameLength = 79;
-  for (i=0; i<nameLength; i++) {
-    configPtr = BDI_AppendByte((BYTE)szSetupFileName[i], configPtr);
-  } /* for */
-  configPtr = BDI_AppendByte(0x00, configPtr);  /* terminating zero */
-
-  /* erase configuration flash sector */
-  if (result == BDI_OKAY) result = BDI_EraseSector(networkAddr);
-
-  /* program and verify network data */
-  if ((configPtr-configData) > (int)(sizeof configData)) result = -9999; /* adjust config data buffers */
-  if (result == BDI_OKAY) result = B20_ProgramFlash(networkAddr, sizeof configData, configData, &errorAddr);
-  if (result == BDI_OKAY) result = BDI_ReadMemory(networkAddr, sizeof configReadBack, configReadBack);
-  if (result == BDI_OKAY) {
-    if (memcmp(configData, configReadBack, sizeof configData) != 0) result = BDI_ERR_FLASH_VERIFY;
-  } /* if */
-
-  /* program configuration and register definitions into BDI flash */
-  if ((result == BDI_OKAY) && (hostIP == INADDR_NONE) && (strlen(szSetupFileName) > 0)) {
-
-    if ((version.bdi == BDI_TYPE_20) || (version.bdi == BDI_TYPE_21)) {
-      configAddr  = B20_CONFIG_ADDR;
-      regdefAddr  = B20_REGDEF_ADDR;
-      if (result == BDI_OKAY) result = BDI_EraseSector(configAddr);
-    } /* if */
-    else if (version.bdi == BDI_TYPE_30) {
-      configAddr  = B30_CONFIG_ADDR;
-      regdefAddr  = B30_REGDEF_ADDR;
-      if (result == BDI_OKAY) result = BDI_EraseSector(configAddr);
-      if (result == BDI_OKAY) result = BDI_EraseSector(regdefAddr);
-    } /* else if */
+  if ((result == BDI_OKAY) && (szFolded[0] != 0)) {
+    file = fopen(szFolded, "w");
+    if (file == NULL) result = BDI_ERR_FILE_ACCESS;
     else {
-      BDI_Close();
-      printf("### invalid BDI connected\n");
-      return BDI_ERR_INVALID_PARAMETER;
+      result = SPY_WriteFolded(&profile, file);
+      if (fclose(file) != 0) result = BDI_ERR_FILE_ACCESS;
     } /* else */
-
-    /* build config data from file */
-    memset(romConfig, 0xff, sizeof romConfig);
-    romConfigSize = CNF_BuildRomConfig(szSetupFileName, romConfig);
-    if (romConfigSize < 0) result = romConfigSize;
-    if (romConfigSize >= BDI_MAX_CONFIG_SIZE) result = BDI_ERR_FILE_ACCESS;
-
-    /* program config data */
-    configPtr = romConfig;
-    flashAddr = configAddr;
-    while ((result == BDI_OKAY) && (romConfigSize > 0)) {
-      result = B20_ProgramFlash(flashAddr, BDI_MAX_BLOCK_SIZE, configPtr, &errorAddr);
-      romConfigSize -= BDI_MAX_BLOCK_SIZE;
-      configPtr += BDI_MAX_BLOCK_SIZE;
-      flashAddr += BDI_MAX_BLOCK_SIZE;
-    } /* while */
-
-    /* build regdef data from file */
-    memset(romRegdef, 0xff, sizeof romRegdef);
-    romRegdefSize = CNF_BuildRomRegdef(szSetupFileName, romConfig, romRegdef);
-    if (romRegdefSize < 0) result = romRegdefSize;
-    if (romRegdefSize >= BDI_MAX_REGDEF_SIZE) result = BDI_ERR_FILE_ACCESS;
-
-    // program regdef data
-    configPtr = romRegdef;
-    flashAddr = regdefAddr;
-    while ((result == BDI_OKAY) && (romRegdefSize > 0)) {
-      result = B20_ProgramFlash(flashAddr, BDI_MAX_BLOCK_SIZE, configPtr, &errorAddr);
-      romRegdefSize -= BDI_MAX_BLOCK_SIZE;
-      configPtr += BDI_MAX_BLOCK_SIZE;
-      flashAddr += BDI_MAX_BLOCK_SIZE;
-    } /* while */
-
+    if (result != BDI_OKAY) printf("Writing %s failed (%i)\n", szFolded, result);
   } /* if */
-
-  if (result == BDI_OKAY) printf("Configuration passed\n");
-  else                    printf("Configuration failed (%i)\n", result);
-
-  /* disconnect */
-  BDI_Close();
+  SPY_Free(&profile);
+  IMG_FreeSymbols(&symbols);
   return result;
-} /* BDI_UpdateConfig */
+} /* BDI_ProfileTarget */
 
 
 /****************************************************************************
@@ -2914,6 +5174,7 @@ int  BDI_DisplayVersion(const char* szPort, DWORD baudrate, BOOL start)
   const char*   szLogicType = "unknown logic type";
   char          szVersion[5];
   DWORD         networkAddr;
+  const BDI_LayoutT* layout;
   BYTE          cnf[104];
 
   /* connect to BDI loader and read versions */
@@ -2984,20 +5245,13 @@ int  BDI_DisplayVersion(const char* szPort, DWORD baudrate, BOOL start)
   } /* if */
 
   /* set network configuration address */
-  if ((version.bdi == BDI_TYPE_20) || (version.bdi == BDI_TYPE_21)) {
-    networkAddr = B20_NETWORK_ADDR;
-  } /* if */
-  else if (version.bdi == BDI_TYPE_10) {
-    networkAddr = B10_NETWORK_ADDR;
-  } /* else if */
-  else if (version.bdi == BDI_TYPE_30) {
-    networkAddr = B30_NETWORK_ADDR;
-  } /* else if */
-  else {
+  layout = BDI_GetLayout(version.bdi);
+  if ((layout == NULL) || (layout->networkAddr == 0)) {
     if (start) result = BDI_ExitLoader();
     BDI_Close();
     return result;
-  } /* else */
+  } /* if */
+  networkAddr = layout->networkAddr;
 
   /* read back configuration data */
   result = BDI_ReadMemory(networkAddr, sizeof cnf, cnf);
@@ -3026,6 +5280,154 @@ int  BDI_DisplayVersion(const char* szPort, DWORD baudrate, BOOL start)
 } /* BDI_DisplayVersion */
 
 
+/****************************************************************************
+ ****************************************************************************
+
+ BDI_CheckPlanFile :
+
+   Check that a file of a plan has not changed since the plan was made
+
+  INPUT:  szPlan          the loaded plan
+          szKey           the member with the file name
+          szFileName      buffer for the file name
+  OUTPUT: return          error code
+
+ ****************************************************************************/
+
+static int BDI_CheckPlanFile(const char* szPlan, const char* szKey, char* szFileName)
+{
+  char                szHashKey[32];
+  char                szHash[16 + 1];
+  unsigned long long  planHash;
+  unsigned long long  hash;
+
+  if (!PLN_GetString(szPlan, szKey, szFileName, MAXPATHLEN)) return BDI_ERR_INVALID_PARAMETER;
+  sprintf(szHashKey, "%s_hash", szKey);
+  /* a file not readable when planning is not read by the update either */
+  if (!PLN_GetString(szPlan, szHashKey, szHash, sizeof szHash)) return BDI_OKAY;
+  if (   (sscanf(szHash, "%llx", &planHash) != 1)
+      || !CCH_HashFile(szFileName, &hash) || (hash != planHash)) {
+    printf("### %s changed since the plan was made\n", szFileName);
+    return BDI_ERR_FILE_ACCESS;
+  } /* if */
+  return BDI_OKAY;
+} /* BDI_CheckPlanFile */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+ BDI_ExecutePlan :
+
+   Execute a plan written with --plan. The files of the plan must not have
+   changed and the connected BDI must be of the same type.
+
+  INPUT:  szPlanName      the plan file
+          szPort          the communication port or NULL to use the plan's
+          baudrate        the baudrate for the port or 0 to use the plan's
+  OUTPUT: return          error code
+
+ ****************************************************************************/
+
+int BDI_ExecutePlan(const char* szPlanName, const char* szPort, DWORD baudrate)
+{
+  int           result;
+  char*         szPlan;
+  char          szCommand[16];
+  char          szPlanPort[MAXPATHLEN];
+  char          szFirmwareName[MAXPATHLEN];
+  char          szLogicName[MAXPATHLEN];
+  char          szConfigName[MAXPATHLEN];
+  char          szHost[32];
+  char          szIP[32];
+  char          szMask[32];
+  char          szGate[32];
+  unsigned long value;
+  unsigned long updateFirmware;
+  unsigned long updateLogic;
+  unsigned long logicVersion;
+  BOOL          valid;
+  BDI_VersionT  version;
+
+  szPlan = PLN_Load(szPlanName);
+  if (szPlan == NULL) {
+    printf("Cannot read plan %s\n", szPlanName);
+    return BDI_ERR_FILE_ACCESS;
+  } /* if */
+
+  /* common members */
+  valid = (   PLN_GetNumber(szPlan, "format", &value) && (value == PLN_FORMAT)
+           && PLN_GetString(szPlan, "command", szCommand, sizeof szCommand)
+           && PLN_GetString(szPlan, "port", szPlanPort, sizeof szPlanPort)
+           && PLN_GetNumber(szPlan, "baudrate", &value)
+           && PLN_GetString(szPlan, "serial", szPlanSerial, sizeof szPlanSerial));
+  if (szPort == NULL) szPort   = szPlanPort;
+  if (baudrate == 0)  baudrate = value;
+  if (valid && PLN_GetNumber(szPlan, "bdi", &value)) planBdi = (int)value;
+  else                                              valid   = FALSE;
+  if (PLN_GetNumber(szPlan, "verify", &value)) verifyFlash = (value != 0);
+  if (PLN_GetNumber(szPlan, "strip", &value))  stripConfig = (value != 0);
+
+  /* members of the command */
+  szFirmwareName[0] = 0;
+  szLogicName[0]    = 0;
+  updateFirmware    = 0;
+  updateLogic       = 0;
+  logicVersion      = 0;
+  if (valid && (strcmp(szCommand, "update") == 0)) {
+    valid = (   PLN_GetNumber(szPlan, "update_firmware", &updateFirmware)
+             && PLN_GetNumber(szPlan, "update_logic", &updateLogic)
+             && (!updateLogic || PLN_GetNumber(szPlan, "logic_version", &logicVersion)));
+  } /* if */
+  else if (valid && (strcmp(szCommand, "config") == 0)) {
+    valid = (   PLN_GetString(szPlan, "host", szHost, sizeof szHost)
+             && PLN_GetString(szPlan, "ip", szIP, sizeof szIP)
+             && PLN_GetString(szPlan, "mask", szMask, sizeof szMask)
+             && PLN_GetString(szPlan, "gateway", szGate, sizeof szGate));
+  } /* else if */
+  else {
+    valid = FALSE;
+  } /* else */
+  if (!valid) {
+    printf("Invalid plan %s\n", szPlanName);
+    free(szPlan);
+    return BDI_ERR_INVALID_PARAMETER;
+  } /* if */
+
+  /* firmware/logic update */
+  result = BDI_OKAY;
+  if (strcmp(szCommand, "update") == 0) {
+    if (updateFirmware) result = BDI_CheckPlanFile(szPlan, "firmware", szFirmwareName);
+    if ((result == BDI_OKAY) && updateLogic) {
+      result = BDI_CheckPlanFile(szPlan, "logic", szLogicName);
+    } /* if */
+    if (result == BDI_OKAY) {
+      printf("Connecting to BDI loader\n");
+      result = BDI_ConnectLoader(szPort, baudrate, &version);
+      if (result == BDI_OKAY) {
+        result = BDI_ProgramFirmwareLogic(&version, szFirmwareName, szLogicName, (WORD)logicVersion,
+                                          updateFirmware != 0, updateLogic != 0);
+        BDI_Close();
+      } /* if */
+      else {
+        printf("Connecting to BDI loader failed (%i)\n", result);
+      } /* else */
+    } /* if */
+  } /* if */
+
+  /* network configuration */
+  else {
+    result = BDI_CheckPlanFile(szPlan, "config_file", szConfigName);
+    if (result == BDI_OKAY) {
+      result = BDI_UpdateConfig(szPort, baudrate, szHost, szIP, szMask, szGate, szConfigName);
+    } /* if */
+  } /* else */
+
+  free(szPlan);
+  return result;
+} /* BDI_ExecutePlan */
+
+
 /****************************************************************************
  ****************************************************************************
 
@@ -3038,6 +5440,11 @@ int  BDI_DisplayVersion(const char* szPort, DWORD baudrate, BOOL start)
 #define CMD_ERASE       2
 #define CMD_UPDATE      3
 #define CMD_CONFIG      4
+#define CMD_EXECUTE     5
+#define CMD_ANALYSE     6
+#define CMD_READ        7
+#define CMD_MEMORY      8
+#define CMD_PROFILE     9
 
 #define APP_GDB         0
 #define APP_TOR         1
@@ -3089,6 +5496,22 @@ int main(int argc, char *argv[ ])
   char  port[MAXPATHLEN] = "/dev/ttyS0";
   char  dir[MAXPATHLEN]  = ".";
   char  file[MAXPATHLEN] = "";
+  char  fleet[MAXPATHLEN] = "";  /* inventory of a fleet */
+  char  optimize[MAXPATHLEN] = "";  /* optimized configuration */
+  char* readArg  = "";          /* target memory to read */
+  char* writeArg = "";          /* target memory to write */
+  char* loadArg  = "";          /* application to download */
+  char* dumpArg  = "";          /* target memory to dump */
+  int   dumpFormat = DMP_FORMAT_BINARY;
+  char* elfArg   = "";          /* application to profile */
+  char* foldedArg = "";         /* folded stacks of the profile */
+  DWORD profileTime = 10;       /* profiling time in seconds */
+  DWORD pollInterval = 100;     /* poll interval of the profile in ms */
+  int   space    = -1;          /* default memory space */
+
+  INI_RangeT memory[INI_MAX_RANGES];  /* plain memory of the [INIT] analysis */
+  int   ranges   = 0;
+  char* next;
 
   char  ip[32]   = "0.0.0.0";   /* selects bootp */
   char  host[32] = "255.255.255.255";
@@ -3096,7 +5519,10 @@ int main(int argc, char *argv[ ])
   char  gate[32] = "255.255.255.255";
 
   DWORD baudrate = 38400;       /* default baudrate */
+  BOOL  portSet  = FALSE;       /* port given, overrides the plan's */
+  BOOL  baudSet  = FALSE;       /* baudrate given, overrides the plan's */
   BOOL  start    = FALSE;       /* default firmware startup */
+  BOOL  check    = FALSE;       /* only check the configurations of a fleet */
   int   appType  = APP_GDB;     /* default application type */
   int   cpuType  = CPU_MPC800;  /* default target CPU type  */
 
@@ -3108,17 +5534,31 @@ int main(int argc, char *argv[ ])
     else if (strcmp(argv[1], "-e") == 0) command = CMD_ERASE;
     else if (strcmp(argv[1], "-u") == 0) command = CMD_UPDATE;
     else if (strcmp(argv[1], "-c") == 0) command = CMD_CONFIG;
+    else if (strcmp(argv[1], "-x") == 0) command = CMD_EXECUTE;
+    else if (strcmp(argv[1], "-r") == 0) command = CMD_ANALYSE;
+    else if (strcmp(argv[1], "-l") == 0) command = CMD_READ;
+    else if (strcmp(argv[1], "-w") == 0) command = CMD_MEMORY;
+    else if (strcmp(argv[1], "-y") == 0) command = CMD_PROFILE;
   } /* if */
 
   /* get parameters */
   for (i = 2; i < argc; i++) {
     arg = argv[i];
 
+    /* update plan, written by -u/-c and executed by -x */
+    if (strncmp(arg, "--plan", 6) == 0) {
+      arg += 6;
+      planMode = TRUE;
+      if      (*arg == '=') strcpy(szPlanFile, arg + 1);
+      else if (*arg != 0)   command = CMD_USAGE;
+    } /* if */
+
     /* serial communication device */
-    if (strncmp(arg, "-p", 2) == 0) {
+    else if (strncmp(arg, "-p", 2) == 0) {
       arg += 2;
       strcpy(port, arg);
-    } /* if */
+      portSet = TRUE;
+    } /* else if */
 
     /* serial baud rate */
     else if (strncmp(arg, "-b", 2) == 0) {
@@ -3129,6 +5569,7 @@ int main(int argc, char *argv[ ])
       else if (strcmp(arg,  "57") == 0) baudrate = 57600;
       else if (strcmp(arg, "115") == 0) baudrate = 115200;
       else command = CMD_USAGE;
+      baudSet = TRUE;
     } /* else if */
 
     /* application type */
@@ -3227,6 +5668,112 @@ int main(int argc, char *argv[ ])
       start = TRUE;
     } /* else if */
 
+    /* program the configuration without comments */
+    else if (strcmp(arg, "--strip") == 0) {
+      stripConfig = TRUE;
+    } /* else if */
+
+    /* configure the units of an inventory */
+    else if (strncmp(arg, "--fleet=", 8) == 0) {
+      arg += 8;
+      strcpy(fleet, arg);
+    } /* else if */
+
+    /* only check the configurations of a fleet */
+    else if (strcmp(arg, "--check") == 0) {
+      check = TRUE;
+    } /* else if */
+
+    /* plain memory, writes may be optimized */
+    else if (strncmp(arg, "--memory=", 9) == 0) {
+      arg += 9;
+      if (ranges == INI_MAX_RANGES) command = CMD_USAGE;
+      else {
+        memory[ranges].start = strtoul(arg, &next, 0);
+        memory[ranges].end   = memory[ranges].start;
+        if (*next != ',') command = CMD_USAGE;
+        else memory[ranges].end = strtoul(next + 1, &next, 0);
+        if ((*next != 0) || (memory[ranges].end < memory[ranges].start)) command = CMD_USAGE;
+        ranges++;
+      } /* else */
+    } /* else if */
+
+    /* optimized configuration */
+    else if (strncmp(arg, "--optimize=", 11) == 0) {
+      arg += 11;
+      strcpy(optimize, arg);
+    } /* else if */
+
+    /* target memory to read */
+    else if (strncmp(arg, "--read=", 7) == 0) {
+      readArg = arg + 7;
+    } /* else if */
+
+    /* target memory to write */
+    else if (strncmp(arg, "--write=", 8) == 0) {
+      writeArg = arg + 8;
+    } /* else if */
+
+    /* application to download */
+    else if (strncmp(arg, "--load=", 7) == 0) {
+      loadArg = arg + 7;
+    } /* else if */
+
+    /* target memory to dump */
+    else if (strncmp(arg, "--dump=", 7) == 0) {
+      dumpArg = arg + 7;
+    } /* else if */
+
+    /* dump as S-Record file */
+    else if (strcmp(arg, "--srec") == 0) {
+      dumpFormat = DMP_FORMAT_SRECORD;
+    } /* else if */
+
+    /* application to profile */
+    else if (strncmp(arg, "--elf=", 6) == 0) {
+      elfArg = arg + 6;
+    } /* else if */
+
+    /* profiling time */
+    else if (strncmp(arg, "--time=", 7) == 0) {
+      profileTime = strtoul(arg + 7, &next, 0);
+      if ((*next != 0) || (profileTime == 0)) command = CMD_USAGE;
+    } /* else if */
+
+    /* poll interval of the profile */
+    else if (strncmp(arg, "--interval=", 11) == 0) {
+      pollInterval = strtoul(arg + 11, &next, 0);
+      if ((*next != 0) || (pollInterval == 0)) command = CMD_USAGE;
+    } /* else if */
+
+    /* folded stacks of the profile */
+    else if (strncmp(arg, "--folded=", 9) == 0) {
+      foldedArg = arg + 9;
+    } /* else if */
+
+    /* memory space of the target memory access */
+    else if (strncmp(arg, "--space=", 8) == 0) {
+      space = (int)strtoul(arg + 8, &next, 0);
+      if ((*next != 0) || (space > 255)) command = CMD_USAGE;
+    } /* else if */
+
+    /* do not verify programmed flash */
+    else if (strncmp(arg, "-n", 2) == 0) {
+      verifyFlash = FALSE;
+    } /* else if */
+
+    /* cache directory for parsed firmware/logic files */
+    else if (strncmp(arg, "-k", 2) == 0) {
+      arg += 2;
+      CCH_SetDirectory(arg);
+    } /* else if */
+
+    /* journal directory for interrupted firmware updates */
+    else if (strncmp(arg, "-j", 2) == 0) {
+      arg += 2;
+      JRN_SetDirectory(arg);
+    } /* else if */
+
     /* invalid parameter */
     else {
       command = CMD_USAGE;
@@ -3240,6 +5787,9 @@ int main(int argc, char *argv[ ])
   if (fwType < 0) command = CMD_USAGE;
 
 
+  /* progress messages must not go into a plan on standard output */
+  if (planMode && (szPlanFile[0] == 0) && (command != CMD_EXECUTE)) BDI_PlanToStdout();
+
   /* execute command */
   switch (command) {
 
@@ -3256,7 +5806,61 @@ int main(int argc, char *argv[ ])
     break;
 
   case CMD_CONFIG:
-    result = BDI_UpdateConfig(port, baudrate, host, ip, mask, gate, file);
+    if (fleet[0] == 0) {
+      result = BDI_UpdateConfig(port, baudrate, host, ip, mask, gate, file);
+    } /* if */
+    else if (planMode || (file[0] == 0)) {
+      printf("--fleet needs -fF and no --plan\n");
+      result = BDI_ERR_INVALID_PARAMETER;
+    } /* else if */
+    else {
+      result = BDI_UpdateFleet(port, baudrate, host, ip, mask, gate, file, fleet, check);
+    } /* else */
+    break;
+
+  case CMD_ANALYSE:
+    result = BDI_AnalyseInit(file, memory, ranges, optimize);
+    break;
+
+  case CMD_READ:
+    result = BDI_ReadConfig(port, baudrate, file);
+    break;
+
+  case CMD_MEMORY:
+    if ((readArg[0] != 0) + (writeArg[0] != 0) + (loadArg[0] != 0) + (dumpArg[0] != 0) != 1) {
+      printf("-w needs one of --read, --write, --load or --dump\n");
+      result = BDI_ERR_INVALID_PARAMETER;
+    } /* if */
+    else if (dumpArg[0] != 0) {
+      result = BDI_DumpMemory(port, baudrate, dumpArg, dumpFormat);
+    } /* else if */
+    else if (loadArg[0] != 0) {
+      result = BDI_LoadApplication(port, baudrate, loadArg);
+    } /* else if */
+    else {
+      result = BDI_TargetMemory(port, baudrate, file, space, readArg, writeArg);
+    } /* else */
+    break;
+
+  case CMD_PROFILE:
+    if (elfArg[0] == 0) {
+      printf("Missing --elf=E\n");
+      result = BDI_ERR_INVALID_PARAMETER;
+    } /* if */
+    else {
+      result = BDI_ProfileTarget(port, baudrate, elfArg, profileTime, pollInterval, foldedArg);
+    } /* else */
+    break;
+
+  case CMD_EXECUTE:
+    planMode = FALSE;
+    if (szPlanFile[0] == 0) {
+      printf("Missing --plan=FILE\n");
+      result = BDI_ERR_INVALID_PARAMETER;
+    } /* if */
+    else {
+      result = BDI_ExecutePlan(szPlanFile, portSet ? port : NULL, baudSet ? baudrate : 0);
+    } /* else */
     break;
 
   default:
@@ -3273,7 +5877,7 @@ int main(int argc, char *argv[ ])
     printf("   P  Port (/dev/ttyS0) or IP address\n");
     printf("   B  Baudrate 9, 19, 38, 57 or 115\n");
     printf("\n");
-    printf("bdisetup -u [-pP] [-bB] [-aA] [-tT] [-dD]\n");
+    printf("bdisetup -u [-pP] [-bB] [-aA] [-tT] [-dD] [-kK] [-jJ] [-n] [--plan[=F]]\n");
     printf("  -u  Update firmware and/or logic\n");
     printf("   P  Port (/dev/ttyS0) or IP address\n");
     printf("   B  Baudrate 9, 19, 38, 57 or 115\n");
@@ -3282,9 +5886,13 @@ int main(int argc, char *argv[ ])
     printf("                   MPC7400,MPC7450,MPC8200,MPC8300,MPC8500,PQ3,P2020,MPC8641\n");
     printf("                   ARM,ARM11,ARMSWD,ARMV8,SWDV8,XSCALE,MIPS,MIPS64,XLS,XLR\n");
     printf("                   CPU32,MCF,HC12,MCORE,P3041,P4080,P5020,QP3,QP4,QP5\n");
-    printf("   D  Directory with the firmware/logic files\n");
+    printf("   D  Directory or zip/tar archive with the firmware/logic files\n");
+    printf("   K  Cache directory for parsed firmware/logic files\n");
+    printf("   J  Journal directory, an interrupted update continues\n");
+    printf("  -n  if present, do not verify the programmed flash\n");
+    printf("   F  if present, only write the update plan (JSON) to F or stdout\n");
     printf("\n");
-    printf("bdisetup -c [-pP] [-bB] [-iI] [-hH] [-mM] [-gG] [-fF]\n");
+    printf("bdisetup -c [-pP] [-bB] [-iI] [-hH] [-mM] [-gG] [-fF] [-kK] [-n] [--strip] [--plan[=F]]\n");
     printf("  -c  Program network configuration\n");
     printf("   P  Port (/dev/ttyS0) or IP address\n");
     printf("   B  Baudrate 9, 19, 38, 57 or 115\n");
@@ -3293,6 +5901,58 @@ int main(int argc, char *argv[ ])
     printf("   M  Subnet mask (default: 255.255.255.255)\n");
     printf("   G  Gateway IP address (default: 255.255.255.255)\n");
     printf("   F  Configuration file name\n");
+    printf("   K  Cache directory for the built configuration\n");
+    printf("  -n  if present, do not verify the programmed flash\n");
+    printf("  --strip  if present, program the configuration without comments\n");
+    printf("\n");
+    printf("bdisetup -c -fF --fleet=L [-pP] [-bB] [-iI] [-hH] [-mM] [-gG] [-n] [--strip] [--check]\n");
+    printf("  -c  Program the configurations of many BDIs\n");
+    printf("   F  Configuration template, ${NAME} is replaced with the value of a unit\n");
+    printf("   L  Inventory, CSV or JSON with one unit per line/object. The values\n");
+    printf("      PORT,SN,IP,HOST,MASK,GATEWAY,FILE replace the parameters\n");
+    printf("  --check  if present, only build and check all configurations\n");
+    printf("\n");
+    printf("bdisetup -r -fF [--memory=S,E] [--optimize=O]\n");
+    printf("  -r  Analyse the [INIT] part of a configuration\n");
+    printf("   F  Configuration file name\n");
+    printf("   S  First address of plain memory, writes may be removed or merged\n");
+    printf("   E  Last address of plain memory\n");
+    printf("   O  if present, write the optimized configuration to O\n");
+    printf("\n");
+    printf("bdisetup -l [-pP] [-bB] [-fF]\n");
+    printf("  -l  Read back the configuration stored in the BDI\n");
+    printf("   P  Port (/dev/ttyS0) or IP address\n");
+    printf("   B  Baudrate 9, 19, 38, 57 or 115\n");
+    printf("   F  if present, write the configuration to F and the register\n");
+    printf("      definitions into the same directory\n");
+    printf("\n");
+    printf("bdisetup -w [-pP] [-bB] [-fF] [--space=S] {--read=A,N | --write=A,D | --load=L[,A] |\n");
+    printf("            --dump=A,N,O [--srec]}\n");
+    printf("  -w  Read or write target memory, the BDI firmware in debug mode\n");
+    printf("   P  Port (/dev/ttyS0) or IP address\n");
+    printf("   B  Baudrate 9, 19, 38, 57 or 115\n");
+    printf("   F  if present, the configuration with the TSZ ranges and ENDIAN\n");
+    printf("   S  if present, the memory space\n");
+    printf("   A  Address\n");
+    printf("   N  Number of bytes to read\n");
+    printf("   D  Bytes to write in hex, e.g. 0102A0FF\n");
+    printf("   L  ELF, S-Record or binary file to download, a binary file at A\n");
+    printf("   O  Dump file, sparse binary or with --srec S-Record\n");
+    printf("\n");
+    printf("bdisetup -y --elf=E [-pP] [-bB] [--time=T] [--interval=I] [--folded=O]\n");
+    printf("  -y  Profile the running target with bdiSpy\n");
+    printf("   E  ELF file of the application with its symbol table\n");
+    printf("   P  Port (/dev/ttyS0) or IP address\n");
+    printf("   B  Baudrate 9, 19, 38, 57 or 115\n");
+    printf("   T  if present, profiling time in seconds (10)\n");
+    printf("   I  if present, poll interval in ms (100)\n");
+    printf("   O  if present, write folded stacks for flame graphs to O\n");
+    printf("\n");
+    printf("bdisetup -x --plan=F [-pP] [-bB]\n");
+    printf("  -x  Execute an update plan written with --plan\n");
+    printf("   F  Plan file name\n");
+    printf("   P  Port, overrides the port of the plan\n");
+    printf("   B  Baudrate, overrides the baudrate of the plan\n");
     printf("\n");
     break;
   } /* switch */
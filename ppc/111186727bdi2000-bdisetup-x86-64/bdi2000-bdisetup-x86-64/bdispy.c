@@ -0,0 +1,459 @@
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdispy.c
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX / UNIX
+|  TARGET HW   : PC
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  This module profiles a running target with bdiSpy. The BDI samples the
+|  PC of the target and counts the samples within each of up to
+|  SPY_MAX_RANGES address ranges, the target itself is not disturbed.
+|  Every function of the ELF symbol table is one range. The counters are
+|  polled every interval and added on the host, a 32 bit counter of the
+|  BDI may wrap between two polls only after 2^32 samples.
+|
+|  An application with more functions than SPY_MAX_RANGES is counted in
+|  groups of ranges, the group changes with every poll. The hits of a
+|  function are scaled with the samples taken while its group was
+|  counted, so each function gets its share of the whole profile.
+|
+|  Commands and answers (link format, Motorola byte order):
+|    SET_SPY_MODE    mode                  ACK
+|    SET_RANGES      count {start end}     ACK
+|    RESET_SPA                             ACK
+|    START_SPA                             ACK
+|    GET_SPA                               SEND_BLOCK samples {hits}
+|  The counters of GET_SPA are 32 bit, counted since RESET_SPA.
+|
+|*************************************************************************/
+
+/*************************************************************************
+|  INCLUDES
+|*************************************************************************/
+
+#if defined(WIN32)
+#include <windows.h>
+#endif
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "bdierror.h"
+#include "bdicmd.h"
+#include "bdidll.h"
+#include "bdiimg.h"
+#include "bdispy.h"
+
+/*************************************************************************
+|  TYPEDEFS
+|*************************************************************************/
+
+/* a line of the flat profile */
+typedef struct {
+  unsigned long long  samples;
+  const SPY_RangeT*   range;
+} SPY_EntryT;
+
+/*************************************************************************
+|  LOCALS
+|*************************************************************************/
+
+static BYTE spyCommand[3 + 8 * SPY_MAX_RANGES];
+static BYTE spyAnswer[BDI_MAX_FRAME_SIZE];
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    BDI_Append___ :
+
+    Host independent helper function to append a numeric value to a buffer.
+    The bytes will be stored in the link format order (Motorola byte order).
+
+     INPUT  : value     value
+              buffer    pointer to buffer
+     OUTPUT : RETURN    pointer to next byte after the stored value
+
+ ****************************************************************************/
+
+static BYTE* BDI_AppendByte(BYTE  value, BYTE* buffer)
+{
+  *buffer++ = value;
+  return buffer;
+} /* BDI_AppendByte */
+
+static BYTE* BDI_AppendWord(WORD value, BYTE* buffer)
+{
+  *buffer++ = (BYTE)(value>>8);
+  *buffer++ = (BYTE)value;
+  return buffer;
+} /* BDI_AppendWord */
+
+static BYTE* BDI_AppendLong(DWORD value, BYTE* buffer)
+{
+  *buffer++ = (BYTE)(value>>24);
+  *buffer++ = (BYTE)(value>>16);
+  *buffer++ = (BYTE)(value>>8);
+  *buffer++ = (BYTE)value;
+  return buffer;
+} /* BDI_AppendLong */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    SPY_Command :
+
+    Executes a command answered with ACK.
+
+     INPUT  : length    length of the command in spyCommand
+     OUTPUT : RETURN    error code, BDI_ERR_INVALID_RESPONSE if not ACK
+
+ ****************************************************************************/
+
+static int SPY_Command(int length)
+{
+  int     rxCount;
+
+  rxCount = BDI_Transaction(length, spyCommand, sizeof spyAnswer, spyAnswer, SPY_EXEC_TIME);
+  if (rxCount < 0) return rxCount;
+  if ((rxCount != 1) || (spyAnswer[0] != BDI_ANS_ACK)) return BDI_ERR_INVALID_RESPONSE;
+  return BDI_OKAY;
+} /* SPY_Command */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    SPY_Init / SPY_Free :
+
+    Creates one range for every function of an application / releases
+    the ranges.
+
+     INPUT  : symbols   the functions, kept as long as the profile is used
+     OUTPUT : profile   the profile
+              RETURN    error code
+
+ ****************************************************************************/
+
+int SPY_Init(SPY_ProfileT* profile, const IMG_SymbolsT* symbols)
+{
+  SPY_RangeT* range;
+  int         i;
+
+  (void)memset(profile, 0, sizeof *profile);
+  if (symbols->count == 0) return BDI_ERR_INVALID_PARAMETER;
+  profile->range = (SPY_RangeT*)calloc((size_t)symbols->count, sizeof(SPY_RangeT));
+  if (profile->range == NULL) return BDI_ERR_FILE_ACCESS;
+  for (i = 0; i < symbols->count; i++) {
+    range = &profile->range[i];
+    range->start   = symbols->symbol[i].addr;
+    range->end     = symbols->symbol[i].addr + symbols->symbol[i].size - 1;
+    range->name    = symbols->symbol[i].name;
+    range->section = symbols->symbol[i].section;
+  } /* for */
+  profile->count = symbols->count;
+  return BDI_OKAY;
+} /* SPY_Init */
+
+
+void SPY_Free(SPY_ProfileT* profile)
+{
+  free(profile->range);
+  (void)memset(profile, 0, sizeof *profile);
+} /* SPY_Free */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    SPY_StartGroup :
+
+    Sets the ranges of a group and starts counting from zero.
+
+     INPUT  : profile   the profile
+              first     index of the first range of the group
+              count     number of ranges in the group
+     OUTPUT : RETURN    error code
+
+ ****************************************************************************/
+
+static int SPY_StartGroup(const SPY_ProfileT* profile, int first, int count)
+{
+  BYTE*   cmdPtr;
+  int     result;
+  int     i;
+
+  cmdPtr = BDI_AppendByte(BDI_SPY_SET_RANGES, spyCommand);
+  cmdPtr = BDI_AppendWord((WORD)count, cmdPtr);
+  for (i = first; i < first + count; i++) {
+    cmdPtr = BDI_AppendLong(profile->range[i].start, cmdPtr);
+    cmdPtr = BDI_AppendLong(profile->range[i].end, cmdPtr);
+  } /* for */
+  result = SPY_Command(cmdPtr-spyCommand);
+  if (result != BDI_OKAY) return result;
+  cmdPtr = BDI_AppendByte(BDI_SPY_RESET_SPA, spyCommand);
+  result = SPY_Command(cmdPtr-spyCommand);
+  if (result != BDI_OKAY) return result;
+  cmdPtr = BDI_AppendByte(BDI_SPY_START_SPA, spyCommand);
+  return SPY_Command(cmdPtr-spyCommand);
+} /* SPY_StartGroup */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    SPY_Harvest :
+
+    Reads the counters of a group and adds what was counted since the
+    last poll.
+
+     INPUT  : profile   the profile
+              first     index of the first range of the group
+              count     number of ranges in the group
+              last      the counters of the last poll, samples first
+     OUTPUT : profile   the counts added
+              last      the counters of this poll
+              RETURN    error code
+
+ ****************************************************************************/
+
+static int SPY_Harvest(SPY_ProfileT* profile, int first, int count, DWORD* last)
+{
+  BYTE*   cmdPtr;
+  BYTE*   ansPtr;
+  DWORD   value;
+  DWORD   samples;
+  int     rxCount;
+  int     i;
+
+  cmdPtr  = BDI_AppendByte(BDI_SPY_GET_SPA, spyCommand);
+  rxCount = BDI_Transaction(cmdPtr-spyCommand, spyCommand, sizeof spyAnswer, spyAnswer, SPY_EXEC_TIME);
+  profile->polls++;
+  if (rxCount < 0) return rxCount;
+  if ((rxCount != 1 + 4 * (count + 1)) || (spyAnswer[0] != BDI_ANS_SEND_BLOCK)) {
+    return BDI_ERR_INVALID_RESPONSE;
+  } /* if */
+
+  /* the counters wrap at 32 bit */
+  ansPtr = spyAnswer + 1;
+  for (i = 0; i <= count; i++) {
+    value  = ((DWORD)ansPtr[0] << 24) + ((DWORD)ansPtr[1] << 16) + ((DWORD)ansPtr[2] << 8) + ansPtr[3];
+    ansPtr += 4;
+    if (i == 0) {
+      samples = (value - last[0]) & 0xFFFFFFFFUL;
+      profile->samples += samples;
+    } /* if */
+    else {
+      profile->range[first + i - 1].hits    += (value - last[i]) & 0xFFFFFFFFUL;
+      profile->range[first + i - 1].samples += samples;
+    } /* else */
+    last[i] = value;
+  } /* for */
+  return BDI_OKAY;
+} /* SPY_Harvest */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    SPY_Run :
+
+    Profiles the running target. Between two polls the host sleeps, the
+    only link traffic is one GET_SPA per interval (and the next group of
+    ranges if there is more than one). Sampling is switched off at the
+    end even after an error.
+
+     INPUT  : profile       the profile
+              duration      profiling time in ms
+              interval      poll interval in ms
+              progressFunc  called after every poll, may be NULL
+              context       passed to progressFunc
+     OUTPUT : profile       the counts
+              RETURN        error code
+
+ ****************************************************************************/
+
+int SPY_Run(SPY_ProfileT* profile, DWORD duration, DWORD interval,
+            SPY_ProgressFuncT progressFunc, void* context)
+{
+  DWORD   last[SPY_MAX_RANGES + 1];
+  DWORD   startTime;
+  DWORD   next;
+  BYTE*   cmdPtr;
+  int     first;
+  int     count;
+  int     result;
+  int     stop;
+
+  if ((profile->count == 0) || (interval == 0)) return BDI_ERR_INVALID_PARAMETER;
+  cmdPtr = BDI_AppendByte(BDI_SPY_SET_SPY_MODE, spyCommand);
+  cmdPtr = BDI_AppendByte(SPY_MODE_PC, cmdPtr);
+  result = SPY_Command(cmdPtr-spyCommand);
+  if (result != BDI_OKAY) return result;
+
+  first = 0;
+  count = (profile->count < SPY_MAX_RANGES) ? profile->count : SPY_MAX_RANGES;
+  result = SPY_StartGroup(profile, first, count);
+  (void)memset(last, 0, sizeof last);
+  startTime = BDI_GetMicroseconds();
+  next      = interval;
+  while (result == BDI_OKAY) {
+    profile->elapsed = (BDI_GetMicroseconds() - startTime) / 1000UL;
+    if (profile->elapsed < next) BDI_DoDelay(next - profile->elapsed);
+    result = SPY_Harvest(profile, first, count, last);
+    profile->elapsed = (BDI_GetMicroseconds() - startTime) / 1000UL;
+    if (result != BDI_OKAY) break;
+    if (progressFunc != NULL) progressFunc(profile, context);
+    if (profile->elapsed >= duration) break;
+
+    /* catch up after a late poll */
+    next += interval;
+    if (next < profile->elapsed) next = profile->elapsed;
+
+    /* the next group of ranges */
+    if (profile->count > SPY_MAX_RANGES) {
+      first += count;
+      if (first == profile->count) first = 0;
+      count = profile->count - first;
+      if (count > SPY_MAX_RANGES) count = SPY_MAX_RANGES;
+      result = SPY_StartGroup(profile, first, count);
+      (void)memset(last, 0, sizeof last);
+    } /* if */
+  } /* while */
+
+  cmdPtr = BDI_AppendByte(BDI_SPY_SET_SPY_MODE, spyCommand);
+  cmdPtr = BDI_AppendByte(SPY_MODE_OFF, cmdPtr);
+  stop   = SPY_Command(cmdPtr-spyCommand);
+  return (result != BDI_OKAY) ? result : stop;
+} /* SPY_Run */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    SPY_Estimate :
+
+    The hits of a range scaled to the whole profile.
+
+     INPUT  : profile   the profile
+              range     the range
+     OUTPUT : RETURN    estimated samples within the range
+
+ ****************************************************************************/
+
+static unsigned long long SPY_Estimate(const SPY_ProfileT* profile, const SPY_RangeT* range)
+{
+  if (range->samples == 0) return 0;
+  if (range->samples == profile->samples) return range->hits;
+  return (unsigned long long)((double)range->hits * (double)profile->samples / (double)range->samples + 0.5);
+} /* SPY_Estimate */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    SPY_WriteFlat :
+
+    Writes the functions with samples, most samples first. The samples
+    outside of all functions are listed as [unknown].
+
+     INPUT  : profile   the profile
+              file      the output file
+     OUTPUT : RETURN    error code
+
+ ****************************************************************************/
+
+static int SPY_CompareEntry(const void* p1, const void* p2)
+{
+  const SPY_EntryT* e1 = (const SPY_EntryT*)p1;
+  const SPY_EntryT* e2 = (const SPY_EntryT*)p2;
+
+  if (e1->samples > e2->samples) return -1;
+  if (e1->samples < e2->samples) return  1;
+  if (e1->range->start < e2->range->start) return -1;
+  if (e1->range->start > e2->range->start) return  1;
+  return 0;
+} /* SPY_CompareEntry */
+
+
+int SPY_WriteFlat(const SPY_ProfileT* profile, FILE* file)
+{
+  SPY_EntryT*         entry;
+  unsigned long long  known;
+  unsigned long long  cumulated;
+  double              total;
+  int                 count;
+  int                 i;
+
+  entry = (SPY_EntryT*)malloc((size_t)(profile->count + 1) * sizeof(SPY_EntryT));
+  if (entry == NULL) return BDI_ERR_FILE_ACCESS;
+  count = 0;
+  known = 0;
+  for (i = 0; i < profile->count; i++) {
+    entry[count].samples = SPY_Estimate(profile, &profile->range[i]);
+    entry[count].range   = &profile->range[i];
+    known += entry[count].samples;
+    if (entry[count].samples > 0) count++;
+  } /* for */
+  qsort(entry, (size_t)count, sizeof(SPY_EntryT), SPY_CompareEntry);
+
+  total = (profile->samples > 0) ? (double)profile->samples : 1.0;
+  fprintf(file, "%llu samples in %lu ms, %lu polls\n", profile->samples, profile->elapsed, profile->polls);
+  fprintf(file, "  %%self   %%cum     samples  address   function\n");
+  cumulated = 0;
+  for (i = 0; i < count; i++) {
+    cumulated += entry[i].samples;
+    fprintf(file, "%6.2f %6.2f %11llu  %08lX  %s\n",
+            100.0 * (double)entry[i].samples / total, 100.0 * (double)cumulated / total,
+            entry[i].samples, entry[i].range->start, entry[i].range->name);
+  } /* for */
+  if (profile->samples > known) {
+    fprintf(file, "%6.2f %6.2f %11llu            [unknown]\n",
+            100.0 * (double)(profile->samples - known) / total, 100.0, profile->samples - known);
+  } /* if */
+  free(entry);
+  return ferror(file) ? BDI_ERR_FILE_ACCESS : BDI_OKAY;
+} /* SPY_WriteFlat */
+
+
+/****************************************************************************
+ ****************************************************************************
+
+    SPY_WriteFolded :
+
+    Writes the profile as folded stacks for flame graph tools. Only the
+    PC is sampled, so a stack is the section and the function.
+
+     INPUT  : profile   the profile
+              file      the output file
+     OUTPUT : RETURN    error code
+
+ ****************************************************************************/
+
+int SPY_WriteFolded(const SPY_ProfileT* profile, FILE* file)
+{
+  const SPY_RangeT*   range;
+  unsigned long long  samples;
+  unsigned long long  known;
+  int                 i;
+
+  known = 0;
+  for (i = 0; i < profile->count; i++) {
+    range   = &profile->range[i];
+    samples = SPY_Estimate(profile, range);
+    known  += samples;
+    if (samples > 0) fprintf(file, "%s;%s %llu\n", range->section, range->name, samples);
+  } /* for */
+  if (profile->samples > known) fprintf(file, "[unknown] %llu\n", profile->samples - known);
+  return ferror(file) ? BDI_ERR_FILE_ACCESS : BDI_OKAY;
+} /* SPY_WriteFolded */
@@ -0,0 +1,86 @@
+#ifndef __BDISPY_H__
+#define __BDISPY_H__
+/*************************************************************************
+|  COPYRIGHT (c) 2000 BY ABATRON AG
+|*************************************************************************
+|
+|  PROJECT NAME: BDI Setup Utility
+|  FILENAME    : bdispy.h
+|
+|  COMPILER    : GCC
+|
+|  TARGET OS   : LINUX
+|  TARGET HW   : PC
+|
+|  PROGRAMMER  : Abatron / RD
+|  CREATION    : 19.10.26
+|
+|*************************************************************************
+|
+|  DESCRIPTION :
+|  Statistical profile of a running target with bdiSpy
+|
+|
+|*************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*************************************************************************
+|  DEFINES
+|*************************************************************************/
+
+#define SPY_MAX_RANGES          128    /* ranges counted by the BDI at once */
+#define SPY_EXEC_TIME           1000   /* execution time of a bdiSpy command */
+
+/* modes of SET_SPY_MODE */
+#define SPY_MODE_OFF            0
+#define SPY_MODE_PC             1      /* sample the PC of the running target */
+
+/*************************************************************************
+|  TYPEDEFS
+|*************************************************************************/
+
+/* a function of the application */
+typedef struct {
+  DWORD               start;
+  DWORD               end;            /* last address */
+  const char*         name;
+  const char*         section;
+  unsigned long long  hits;           /* samples within the range */
+  unsigned long long  samples;        /* all samples while the range was counted */
+} SPY_RangeT;
+
+typedef struct {
+  SPY_RangeT*         range;
+  int                 count;
+  unsigned long long  samples;        /* all samples */
+  DWORD               polls;          /* GET_SPA sent */
+  DWORD               elapsed;        /* ms since the start */
+} SPY_ProfileT;
+
+/* called after every poll */
+typedef void (*SPY_ProgressFuncT)(const SPY_ProfileT* profile, void* context);
+
+/*************************************************************************
+|  FUNCTIONS
+|*************************************************************************/
+
+/* one range per function, the names are taken from the symbols */
+int   SPY_Init(SPY_ProfileT* profile, const IMG_SymbolsT* symbols);
+void  SPY_Free(SPY_ProfileT* profile);
+
+/* samples for duration ms, the counts are polled every interval ms */
+int   SPY_Run(SPY_ProfileT* profile, DWORD duration, DWORD interval,
+              SPY_ProgressFuncT progressFunc, void* context);
+
+/* flat profile and folded stacks (section;function count) */
+int   SPY_WriteFlat(const SPY_ProfileT* profile, FILE* file);
+int   SPY_WriteFolded(const SPY_ProfileT* profile, FILE* file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif